@@ -0,0 +1,85 @@
+"""
+Converts PEM root certificates to a C source with their DER bytes.
+
+Usage: generate_root_certificates.py <output.c> [<certificate.pem> ...]
+
+The source defines AZURE_IOT_ROOT_CERTIFICATES, a tls_certificate_t array
+ended by a certificate without data, parsed at runtime by azure_iot_certificate.c
+without decoding or copying: the DER bytes stay in flash.
+"""
+
+import base64
+import os
+import re
+import sys
+
+PEM_PATTERN = re.compile(r"-----BEGIN CERTIFICATE-----(.+?)-----END CERTIFICATE-----", re.DOTALL)
+BYTES_PER_LINE = 16
+
+
+def read_der(path):
+    with open(path, "r", encoding="ascii") as pem_file:
+        blocks = PEM_PATTERN.findall(pem_file.read())
+
+    if len(blocks) != 1:
+        raise ValueError(f"{path}: expected one certificate, found {len(blocks)}")
+
+    return base64.b64decode("".join(blocks[0].split()), validate=True)
+
+
+def format_array(name, der):
+    lines = []
+
+    for offset in range(0, len(der), BYTES_PER_LINE):
+        chunk = der[offset:offset + BYTES_PER_LINE]
+        lines.append("    " + ", ".join(f"0x{byte:02x}" for byte in chunk) + ",")
+
+    return f"static const uint8_t {name}[] = {{\n" + "\n".join(lines) + "\n};\n"
+
+
+def generate(output_path, pem_paths):
+    arrays = []
+    entries = []
+
+    for index, path in enumerate(pem_paths):
+        der = read_der(path)
+
+        if len(der) > 0xFFFF:
+            raise ValueError(f"{path}: {len(der)} bytes, more than tls_certificate_t can hold")
+
+        name = f"AZURE_IOT_ROOT_CERTIFICATE_{index}"
+
+        arrays.append(f"/* {os.path.basename(path)} */\n" + format_array(name, der))
+        entries.append(f"    {{.data = {name}, .format = TLS_CERT_FORMAT_DER, .length = sizeof({name})}},")
+
+    entries.append("    {.data = NULL, .format = TLS_CERT_FORMAT_DER, .length = 0}};")
+
+    source = (
+        "// Generated by generate_root_certificates.py: do not edit.\n"
+        "\n"
+        "#include <stddef.h>\n"
+        "#include <stdint.h>\n"
+        "#include \"infrastructure/transport.h\"\n"
+        "\n"
+        + "\n".join(arrays)
+        + ("\n" if arrays else "")
+        + "const tls_certificate_t AZURE_IOT_ROOT_CERTIFICATES[] = {\n"
+        + "\n".join(entries)
+        + "\n"
+    )
+
+    # Rewritten only when changed, to not rebuild the component for nothing.
+    if os.path.exists(output_path):
+        with open(output_path, "r", encoding="ascii") as output_file:
+            if output_file.read() == source:
+                return
+
+    with open(output_path, "w", encoding="ascii", newline="\n") as output_file:
+        output_file.write(source)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+
+    generate(sys.argv[1], sys.argv[2:])
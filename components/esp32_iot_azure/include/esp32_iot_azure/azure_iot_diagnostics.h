@@ -0,0 +1,165 @@
+#ifndef __ESP32_IOT_AZURE_IOT_DIAGNOSTICS_H__
+#define __ESP32_IOT_AZURE_IOT_DIAGNOSTICS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp32_iot_azure/azure_iot_common.h"
+#include "esp32_iot_azure/azure_iot_hub.h"
+#include "azure_iot_json_reader.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @brief Diagnostics component name, to add to the @ref AzureIoTHubClientOptions_t `pxComponentList`.
+ */
+#define AZURE_IOT_DIAGNOSTICS_COMPONENT_NAME "diagnostics"
+
+/**
+ * @brief Diagnostics writable property: seconds between reports, 0 to stop them.
+ */
+#define AZURE_IOT_DIAGNOSTICS_PRP_INTERVAL_NAME "interval"
+
+/**
+ * @brief Diagnostics writable property: fields reported, as a mask of @ref azure_iot_diagnostics_field_t.
+ */
+#define AZURE_IOT_DIAGNOSTICS_PRP_FIELDS_NAME "fields"
+
+    /**
+     * @brief Fields of a diagnostics report.
+     */
+    typedef enum
+    {
+        AZURE_IOT_DIAGNOSTICS_FIELD_HEAP = 0x01,       /** @brief `heapFree`, `heapMinFree` and `heapLargestBlock`, in bytes. */
+        AZURE_IOT_DIAGNOSTICS_FIELD_STACKS = 0x02,     /** @brief `stackWatermarks`: stack never used of each task watched, in bytes. */
+        AZURE_IOT_DIAGNOSTICS_FIELD_RECONNECTS = 0x04, /** @brief `reconnectAttempts`, `reconnectFailures`, `circuitOpens` and `networkDown`, since boot. */
+        AZURE_IOT_DIAGNOSTICS_FIELD_LATENCY = 0x08,    /** @brief `publishCount` and `publishP50Ms`, `publishP90Ms`, `publishP99Ms`: PUBACK latency since the last report. */
+        AZURE_IOT_DIAGNOSTICS_FIELD_ERRORS = 0x10,     /** @brief `errorCount` since boot and `lastErrors`, most recent first. */
+        AZURE_IOT_DIAGNOSTICS_FIELD_ALL = 0x1F
+    } azure_iot_diagnostics_field_t;
+
+    /**
+     * @typedef azure_iot_diagnostics_t
+     * @brief Diagnostics component: reports the device health as telemetry of the
+     * @ref AZURE_IOT_DIAGNOSTICS_COMPONENT_NAME component.
+     * @details Reports are sent every `interval` seconds, with the `fields` selected;
+     * both are writable properties of the component, to tune a fleet from the twin.
+     * Latency percentiles come from the @ref AZURE_IOT_METRIC_HUB_PUBACK histogram,
+     * measured between reports without resetting the metrics.
+     * @note Not thread safe: use it from the task calling @ref azure_iot_hub_process_loop.
+     */
+    typedef struct azure_iot_diagnostics_t azure_iot_diagnostics_t;
+
+    /**
+     * @brief Create the diagnostics component.
+     * @note The component must be released by @ref azure_iot_diagnostics_free.
+     * @param[in] hub_context IoT context to send the reports with.
+     * @param[in] buffer Buffer to write the reports and property acknowledgments in.
+     * Must be kept until the component is released.
+     * @return @ref azure_iot_diagnostics_t on success or null on failure.
+     */
+    azure_iot_diagnostics_t *azure_iot_diagnostics_create(azure_iot_hub_context_t *hub_context, buffer_t *buffer);
+
+    /**
+     * @brief Report the stack watermark of a task.
+     * @note Without any task watched, the one calling @ref azure_iot_diagnostics_process is reported.
+     * @param[in] diagnostics Diagnostics component.
+     * @param[in] task Task handle; must be unwatched before the task is deleted.
+     * @return @ref AzureIoTResult_t with the result of the operation;
+     * @ref eAzureIoTErrorOutOfMemory if `CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_TASKS_MAX` tasks are already watched.
+     */
+    AzureIoTResult_t azure_iot_diagnostics_watch_task(azure_iot_diagnostics_t *diagnostics, TaskHandle_t task);
+
+    /**
+     * @brief Stop reporting the stack watermark of a task.
+     * @param[in] diagnostics Diagnostics component.
+     * @param[in] task Task handle.
+     */
+    void azure_iot_diagnostics_unwatch_task(azure_iot_diagnostics_t *diagnostics, TaskHandle_t task);
+
+    /**
+     * @brief Record an error code, reported in `lastErrors`.
+     * @details The last `CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_ERRORS_MAX` codes are kept.
+     * @param[in] diagnostics Diagnostics component.
+     * @param[in] code Error code, like an @ref AzureIoTResult_t or an `esp_err_t`.
+     */
+    void azure_iot_diagnostics_record_error(azure_iot_diagnostics_t *diagnostics, int32_t code);
+
+    /**
+     * @brief Send a report if the interval elapsed since the last one.
+     * @note Must be called periodically, like @ref azure_iot_hub_process_loop.
+     * @param[in] diagnostics Diagnostics component.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     */
+    AzureIoTResult_t azure_iot_diagnostics_process(azure_iot_diagnostics_t *diagnostics);
+
+    /**
+     * @brief Send a report now, with the fields selected.
+     * @param[in] diagnostics Diagnostics component.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     */
+    AzureIoTResult_t azure_iot_diagnostics_send(azure_iot_diagnostics_t *diagnostics);
+
+    /**
+     * @brief Returns whether the component is the diagnostics one.
+     * @note If it is, user should follow by parsing the property
+     * with the @ref azure_iot_diagnostics_parse_property() call.
+     * @param[in] diagnostics Diagnostics component.
+     * @param[in] component_name Name of writable property component to be checked.
+     * @param[in] component_name_length Name of writable property component length.
+     * @return true if the writable property belongs to the diagnostics component.
+     */
+    bool azure_iot_diagnostics_is_component(azure_iot_diagnostics_t *diagnostics,
+                                            const uint8_t *component_name,
+                                            uint32_t component_name_length);
+
+    /**
+     * @brief Parse a diagnostics writable property, applying it.
+     * @note The JSON reader returned to the caller from @ref AzureIoTHubClientProperties_GetNextComponentProperty()
+     * should be passed to this API. Unknown properties are skipped.
+     * @param[in] diagnostics Diagnostics component.
+     * @param[in,out] json_reader The JSON reader positioned at the property name; left after its value.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     */
+    AzureIoTResult_t azure_iot_diagnostics_parse_property(azure_iot_diagnostics_t *diagnostics,
+                                                          AzureIoTJSONReader_t *json_reader);
+
+    /**
+     * @brief Acknowledge the diagnostics writable properties, reporting their current values.
+     * @note Call it after the properties of a writable property message are parsed;
+     * also at start up, with version 0, to report the defaults.
+     * @param[in] diagnostics Diagnostics component.
+     * @param[in] version Version of the writable properties.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     */
+    AzureIoTResult_t azure_iot_diagnostics_send_response(azure_iot_diagnostics_t *diagnostics, uint32_t version);
+
+    /**
+     * @brief Get the seconds between reports.
+     * @param[in] diagnostics Diagnostics component.
+     * @return Seconds between reports; 0 if stopped.
+     */
+    uint32_t azure_iot_diagnostics_get_interval(const azure_iot_diagnostics_t *diagnostics);
+
+    /**
+     * @brief Get the fields reported.
+     * @param[in] diagnostics Diagnostics component.
+     * @return Mask of @ref azure_iot_diagnostics_field_t.
+     */
+    uint32_t azure_iot_diagnostics_get_fields(const azure_iot_diagnostics_t *diagnostics);
+
+    /**
+     * @brief Cleanup and free the component.
+     * @note Will not free the @ref azure_iot_hub_context_t passed on @ref azure_iot_diagnostics_create().
+     * @param[in] diagnostics Diagnostics component.
+     */
+    void azure_iot_diagnostics_free(azure_iot_diagnostics_t *diagnostics);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -2,6 +2,7 @@
 #define __ESP32_IOT_AZURE_IOT_HTTP_CLIENT_H__
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "azure_iot_http.h"
 
 #ifdef __cplusplus
@@ -15,6 +16,27 @@ extern "C"
      */
     typedef struct azure_http_context_t azure_http_context_t;
 
+    /**
+     * @brief Azure HTTP client statistics.
+     */
+    typedef struct
+    {
+        uint32_t requests;    /** @brief Requests sent, size requests included. */
+        uint32_t connections; /** @brief Connections established, the first included. */
+    } azure_http_statistics_t;
+
+    /**
+     * @brief Azure HTTP response received by @ref azure_http_receive_response.
+     */
+    typedef struct
+    {
+        uint16_t status_code;    /** @brief Response status code. */
+        uint32_t headers_length; /** @brief Length of the status line and headers, blank line included. The body follows them. */
+        uint32_t content_length; /** @brief Body length, from the Content-Length header. */
+        uint32_t range_start;    /** @brief First body byte on the resource, from the Content-Range header; 0 if absent. */
+        bool connection_close;   /** @brief Whether the server will close the connection after this response. */
+    } azure_http_response_t;
+
     /**
      * @brief Create an Azure HTTP context.
      * @note The context must be released by @ref azure_http_free.
@@ -22,12 +44,17 @@ extern "C"
      * @param[in] url_length Length of \p url without null-termination.
      * @param[in] path Path to use for this request. Must be null-terminated.
      * @param[in] path_length Length of \p path without null-termination.
+     * @param[in] port Server port; named in the `Host` header unless the default of the scheme.
+     * @param[in] secure Whether to use TLS (HTTPS), validated against the Azure root certificates.
+     * The TLS session is reused on reconnections when supported by the transport.
      * @return @ref azure_http_context_t on success or null on failure.
      */
     azure_http_context_t *azure_http_create(const char *url,
                                             uint32_t url_length,
                                             const char *path,
-                                            uint32_t path_length);
+                                            uint32_t path_length,
+                                            uint16_t port,
+                                            bool secure);
 
     /**
      * @brief Connect the Azure HTTP client.
@@ -79,6 +106,8 @@ extern "C"
 
     /**
      * @brief Send a get content request.
+     * @note The connection is kept alive between requests. When the
+     * server answers with `Connection: close` the next request reconnects first.
      * @param[in] context HTTP context.
      * @param[in] range_start The start point for the request payload.
      * @param[in] range_end The end point for the request payload.
@@ -96,6 +125,92 @@ extern "C"
                                             char **output_data,
                                             uint32_t *output_data_length);
 
+    /**
+     * @brief Send a get content request without waiting for its response.
+     * @details Lets requests be pipelined: the responses are received,
+     * in the order the requests were sent, by @ref azure_http_receive_response.
+     * Bypasses the @ref azure_http_init request.
+     * @param[in] context HTTP context.
+     * @param[out] request_buffer The buffer where the request will be built.
+     * @param[in] request_buffer_length The length of \p request_buffer.
+     * @param[in] range_start The first resource byte requested.
+     * @param[in] range_end The last resource byte requested.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     */
+    AzureIoTHTTPResult_t azure_http_send_range_request(azure_http_context_t *context,
+                                                       char *request_buffer,
+                                                       uint32_t request_buffer_length,
+                                                       uint32_t range_start,
+                                                       uint32_t range_end);
+
+    /**
+     * @brief Send a get content request, for the whole resource, without waiting for its response.
+     * @details The response is received by @ref azure_http_receive_response_headers
+     * and its body, as it arrives, by @ref azure_http_receive_data.
+     * @param[in] context HTTP context.
+     * @param[out] request_buffer The buffer where the request will be built.
+     * @param[in] request_buffer_length The length of \p request_buffer.
+     * @param[in] range_start The first resource byte requested. When greater than 0
+     * the rest of the resource is requested with an open `Range`.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     */
+    AzureIoTHTTPResult_t azure_http_send_get_request(azure_http_context_t *context,
+                                                     char *request_buffer,
+                                                     uint32_t request_buffer_length,
+                                                     uint32_t range_start);
+
+    /**
+     * @brief Receive the status line and headers of the oldest request sent.
+     * @note Body bytes received with the headers follow them on \p data_buffer.
+     * @param[in] context HTTP context.
+     * @param[in,out] data_buffer The buffer into which the response header will be placed.
+     * The response starts at the beginning of the buffer.
+     * @param[in] data_buffer_length The length of \p data_buffer.
+     * @param[in,out] buffered_length Bytes already on \p data_buffer when called;
+     * bytes on \p data_buffer when returning, possibly more than the headers.
+     * @param[out] response Pointer to where to store the response.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     */
+    AzureIoTHTTPResult_t azure_http_receive_response_headers(azure_http_context_t *context,
+                                                             char *data_buffer,
+                                                             uint32_t data_buffer_length,
+                                                             uint32_t *buffered_length,
+                                                             azure_http_response_t *response);
+
+    /**
+     * @brief Receive the bytes available on the connection, waiting for
+     * CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_RECV_RETRY_TIMEOUT_MS at most.
+     * @param[in] context HTTP context.
+     * @param[in,out] data_buffer The buffer into which the bytes will be appended.
+     * @param[in] data_buffer_length The length of \p data_buffer.
+     * @param[in,out] buffered_length Bytes already on \p data_buffer; updated with the bytes received.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     */
+    AzureIoTHTTPResult_t azure_http_receive_data(azure_http_context_t *context,
+                                                 char *data_buffer,
+                                                 uint32_t data_buffer_length,
+                                                 uint32_t *buffered_length);
+
+    /**
+     * @brief Receive the response of the oldest request sent by @ref azure_http_send_range_request.
+     * @note Bytes received past the response belong to the next one: the caller must
+     * move them to the start of \p data_buffer, and update \p buffered_length, before
+     * receiving the next response.
+     * @param[in] context HTTP context.
+     * @param[in,out] data_buffer The buffer into which the response header and payload will be placed.
+     * The response starts at the beginning of the buffer.
+     * @param[in] data_buffer_length The length of \p data_buffer. Must fit the headers and the payload.
+     * @param[in,out] buffered_length Bytes already on \p data_buffer when called;
+     * bytes on \p data_buffer when returning, possibly more than the response.
+     * @param[out] response Pointer to where to store the response.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     */
+    AzureIoTHTTPResult_t azure_http_receive_response(azure_http_context_t *context,
+                                                     char *data_buffer,
+                                                     uint32_t data_buffer_length,
+                                                     uint32_t *buffered_length,
+                                                     azure_http_response_t *response);
+
     /**
      * @brief Deinitialize a get content request.
      * @param[in] context HTTP context.
@@ -103,6 +218,13 @@ extern "C"
      */
     AzureIoTHTTPResult_t azure_http_deinit(azure_http_context_t *context);
 
+    /**
+     * @brief Get the client statistics.
+     * @param[in] context HTTP context.
+     * @return Statistics since the context creation.
+     */
+    const azure_http_statistics_t *azure_http_get_statistics(const azure_http_context_t *context);
+
     /**
      * @brief Cleanup and free the context.
      * @param[in] context HTTP context.
@@ -17,6 +17,14 @@ extern "C"
      */
     typedef struct azure_iot_hub_context_t azure_iot_hub_context_t;
 
+    /**
+     * @brief Callback invoked when a telemetry message sent by @ref azure_iot_hub_send_telemetry_async completes.
+     * @param[in] result @ref eAzureIoTSuccess when the hub acknowledged the message;
+     * @ref eAzureIoTErrorFailed when it was discarded, not acknowledged, by @ref azure_iot_hub_deinit.
+     * @param[in] callback_context Context passed to @ref azure_iot_hub_send_telemetry_async.
+     */
+    typedef void (*azure_iot_hub_telemetry_callback_t)(AzureIoTResult_t result, void *callback_context);
+
     /**
      * @brief Create an Azure IoT Hub Client context.
      * @note The context must be released by @ref azure_iot_hub_free.
@@ -46,6 +54,11 @@ extern "C"
     /**
      * @brief Initialize the Azure IoT Hub Client with a given device id on a
      * given hostname.
+     * @note The @ref AzureIoTHubClientOptions_t `xTelemetryCallback` option is kept and
+     * invoked after the acknowledgments are matched against the publish window.
+     * @note Acknowledgments are matched to the context processed by the calling task. Received
+     * outside @ref azure_iot_hub_process_loop and @ref azure_iot_hub_process_events, like while
+     * subscribing, they are only matched when a single context exists, and dropped otherwise.
      * @param[in] context IoT context.
      * @param[in] hostname IoT Hub hostname.
      * @param[in] hostname_length IoT Hub hostname length.
@@ -80,6 +93,9 @@ extern "C"
 
     /**
      * @brief Connect via MQTT to the IoT Hub endpoint.
+     * @note Telemetry messages on the publish window, not acknowledged before a disconnection,
+     * are sent again: they may be received twice. When they fail to be sent, the context
+     * is disconnected again and the failure returned: they are sent on the next connection.
      * @param[in] context IoT context.
      * @return @ref AzureIoTResult_t with the result of the operation.
      */
@@ -224,6 +240,42 @@ extern "C"
                                                   AzureIoTHubMessageQoS_t qos,
                                                   uint16_t *packet_id);
 
+    /**
+     * @brief Send QoS 1 telemetry data to IoT Hub without waiting for its acknowledgment.
+     * @details The message is copied to the publish window, where it stays until the hub
+     * acknowledges it, invoking \p callback, and is sent again after a reconnection.
+     * Up to `CONFIG_ESP32_IOT_AZURE_HUB_PUBLISH_WINDOW_SIZE` messages can be in flight,
+     * keeping the link busy instead of waiting a round trip per message.
+     * @note Acknowledgments are received by @ref azure_iot_hub_process_loop or @ref azure_iot_hub_process_events.
+     * @note When the window is full, incoming messages are processed for up to
+     * `CONFIG_ESP32_IOT_AZURE_HUB_PUBLISH_WINDOW_WAIT_MS`, waiting for room:
+     * subscription callbacks can be invoked from this function.
+     * @param[in] context IoT context.
+     * @param[in] payload User defined telemetry payload.
+     * @param[in] payload_length Payload length.
+     * @param[in] properties Properties to send with the telemetry, serialized: `name=value` pairs
+     * joined by `&`, as written on the buffer of an @ref AzureIoTMessageProperties_t. Can be `NULL`.
+     * @param[in] properties_length Length of \p properties.
+     * @param[in] callback Callback to invoke when the message completes. Can be `NULL`.
+     * @param[in] callback_context Context to pass to the callback.
+     * @return @ref AzureIoTResult_t with the result of the operation:
+     * @ref eAzureIoTErrorPending if the window is still full, the message not being sent.
+     */
+    AzureIoTResult_t azure_iot_hub_send_telemetry_async(azure_iot_hub_context_t *context,
+                                                        const uint8_t *payload,
+                                                        uint32_t payload_length,
+                                                        const uint8_t *properties,
+                                                        uint32_t properties_length,
+                                                        azure_iot_hub_telemetry_callback_t callback,
+                                                        void *callback_context);
+
+    /**
+     * @brief Get how many telemetry messages are on the publish window, waiting for acknowledgment.
+     * @param[in] context IoT context.
+     * @return Messages in flight.
+     */
+    uint32_t azure_iot_hub_get_telemetry_in_flight(const azure_iot_hub_context_t *context);
+
     /**
      * @brief Receive any incoming MQTT messages from and manage the MQTT connection to IoT Hub.
      * @note This API will receive any messages sent to the device and manage the connection such as sending `PING` messages.
@@ -232,8 +284,30 @@ extern "C"
      */
     AzureIoTResult_t azure_iot_hub_process_loop(azure_iot_hub_context_t *context);
 
+    /**
+     * @brief Wait for incoming MQTT messages and process them, as soon as they arrive.
+     * @details Unlike @ref azure_iot_hub_process_loop, which blocks for the loop timeout, sleeps on
+     * the socket until bytes arrive, @ref azure_iot_hub_wake is called, the keep-alive `PING` is due
+     * or \p max_wait_ms elapses, whichever comes first; then processes what was received, without
+     * waiting for more. Commands and cloud to device messages are handled without polling latency,
+     * and the CPU idles, or light-sleeps, between events.
+     * @note Transport drivers not able to wait fall back to @ref azure_iot_hub_process_loop.
+     * @param[in] context IoT context.
+     * @param[in] max_wait_ms Maximum time to wait, in milliseconds, like until the next telemetry is due.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     */
+    AzureIoTResult_t azure_iot_hub_process_events(azure_iot_hub_context_t *context, uint32_t max_wait_ms);
+
+    /**
+     * @brief Wake the task waiting on @ref azure_iot_hub_process_events, like when a message is queued to be sent.
+     * @note Can be called from any task. If no task is waiting, the next wait returns right away.
+     * @param[in] context IoT context.
+     */
+    void azure_iot_hub_wake(azure_iot_hub_context_t *context);
+
     /**
      * @brief Deinitialize the Azure IoT Hub Client.
+     * @note Telemetry messages on the publish window are discarded, completing with @ref eAzureIoTErrorFailed.
      * @param[in] context IoT context.
      */
     void azure_iot_hub_deinit(azure_iot_hub_context_t *context);
@@ -0,0 +1,113 @@
+#ifndef __ESP32_IOT_AZURE_IOT_HUB_TASK_H__
+#define __ESP32_IOT_AZURE_IOT_HUB_TASK_H__
+
+#include <stdint.h>
+#include "esp32_iot_azure/azure_iot_hub.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @typedef azure_iot_hub_task_t
+     * @brief Network task owning an Azure IoT Hub Client context.
+     * @details The task runs the process loop and sends the requests other tasks enqueue:
+     * telemetry, reported properties and command responses are copied to a queue and
+     * the caller returns right away, never waiting for the network.
+     * Between requests, the task sleeps on @ref azure_iot_hub_process_events, woken
+     * by incoming messages and by the requests enqueued. When processing fails, like
+     * while the hub is disconnected, the task backs off before trying again.
+     * QoS 1 telemetry is sent through the hub publish window, see @ref azure_iot_hub_send_telemetry_async.
+     * @note While the task runs, the hub context must only be used by the task:
+     * subscription callbacks run on it and can use the context directly.
+     * @note Functions enqueuing requests are thread safe.
+     */
+    typedef struct azure_iot_hub_task_t azure_iot_hub_task_t;
+
+    /**
+     * @brief Network task counters, since the task was created.
+     */
+    typedef struct
+    {
+        uint32_t sent;             /** @brief Requests sent. */
+        uint32_t failed;           /** @brief Requests failing to be sent, like when the hub is not connected. */
+        uint32_t dropped;          /** @brief Requests not enqueued for the queue being full. */
+        uint32_t process_failures; /** @brief Event processing failures, each followed by a back-off. */
+    } azure_iot_hub_task_statistics_t;
+
+    /**
+     * @brief Create the network task for a hub context.
+     * @note The task must be released by @ref azure_iot_hub_task_free, before the \p hub_context.
+     * @param[in] hub_context IoT context, connected and subscribed.
+     * @return @ref azure_iot_hub_task_t on success or null on failure.
+     */
+    azure_iot_hub_task_t *azure_iot_hub_task_create(azure_iot_hub_context_t *hub_context);
+
+    /**
+     * @brief Enqueue telemetry data to be sent to IoT Hub.
+     * @param[in] task Network task.
+     * @param[in] payload User defined telemetry payload.
+     * @param[in] payload_length Payload length.
+     * @param[in] properties Properties to send with the telemetry, serialized: `name=value` pairs
+     * joined by `&`, as written on the buffer of an @ref AzureIoTMessageProperties_t. Can be `NULL`.
+     * @param[in] properties_length Length of \p properties.
+     * @param[in] qos The QOS to use for the telemetry.
+     * @return @ref AzureIoTResult_t with the result of the operation:
+     * @ref eAzureIoTErrorOutOfMemory if the queue is full.
+     */
+    AzureIoTResult_t azure_iot_hub_task_send_telemetry(azure_iot_hub_task_t *task,
+                                                       const uint8_t *payload,
+                                                       uint32_t payload_length,
+                                                       const uint8_t *properties,
+                                                       uint32_t properties_length,
+                                                       AzureIoTHubMessageQoS_t qos);
+
+    /**
+     * @brief Enqueue reported device properties to be sent to IoT Hub.
+     * @param[in] task Network task.
+     * @param[in] payload Properly formatted, reported properties.
+     * @param[in] payload_length Payload length.
+     * @return @ref AzureIoTResult_t with the result of the operation:
+     * @ref eAzureIoTErrorOutOfMemory if the queue is full.
+     */
+    AzureIoTResult_t azure_iot_hub_task_send_properties_reported(azure_iot_hub_task_t *task,
+                                                                 const uint8_t *payload,
+                                                                 uint32_t payload_length);
+
+    /**
+     * @brief Enqueue a response to a received Direct Method (command) message.
+     * @note Only the request id is copied: \p command_request is not needed after the call.
+     * @param[in] task Network task.
+     * @param[in] command_request Command request to which a response is being sent.
+     * @param[in] payload User defined response payload. Can be `NULL`.
+     * @param[in] payload_length Payload length.
+     * @param[in] status_code User code that indicates the result of the command.
+     * @return @ref AzureIoTResult_t with the result of the operation:
+     * @ref eAzureIoTErrorOutOfMemory if the queue is full.
+     */
+    AzureIoTResult_t azure_iot_hub_task_send_command_response(azure_iot_hub_task_t *task,
+                                                              const AzureIoTHubClientCommandRequest_t *command_request,
+                                                              const uint8_t *payload,
+                                                              uint32_t payload_length,
+                                                              uint32_t status_code);
+
+    /**
+     * @brief Get the network task counters.
+     * @param[in] task Network task.
+     * @param[out] statistics Where to write the counters.
+     */
+    void azure_iot_hub_task_get_statistics(const azure_iot_hub_task_t *task,
+                                           azure_iot_hub_task_statistics_t *statistics);
+
+    /**
+     * @brief Stop and free the task, giving the hub context back to the caller.
+     * @note Requests not sent yet are discarded.
+     * @param[in] task Network task.
+     */
+    void azure_iot_hub_task_free(azure_iot_hub_task_t *task);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
\ No newline at end of file
@@ -0,0 +1,101 @@
+#ifndef __ESP32_IOT_AZURE_IOT_METRICS_H__
+#define __ESP32_IOT_AZURE_IOT_METRICS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @brief Latency buckets of each histogram, see @ref azure_iot_metrics_get_bucket_bound_us.
+ */
+#define AZURE_IOT_METRICS_BUCKET_COUNT 14U
+
+    /**
+     * @brief Operations measured, across every transport and client.
+     */
+    typedef enum
+    {
+        AZURE_IOT_METRIC_TCP_CONNECT = 0,  /** @brief Raw TCP connection, like the HTTP ones. */
+        AZURE_IOT_METRIC_TLS_CONNECT,      /** @brief TCP connection and TLS handshake. */
+        AZURE_IOT_METRIC_TRANSPORT_WRITE,  /** @brief Transport write; writes not sending a byte are not measured. */
+        AZURE_IOT_METRIC_TRANSPORT_READ,   /** @brief Transport read; reads timing out without a byte are not measured. */
+        AZURE_IOT_METRIC_HUB_CONNECT,      /** @brief Hub MQTT CONNECT until CONNACK, the transport connected. */
+        AZURE_IOT_METRIC_HUB_SUBSCRIBE,    /** @brief Hub SUBSCRIBE until SUBACK. */
+        AZURE_IOT_METRIC_HUB_PUBACK,       /** @brief Hub publish window PUBLISH until PUBACK. */
+        AZURE_IOT_METRIC_HTTP_REQUEST,     /** @brief HTTP request until its response, like the Device Update range requests. */
+        AZURE_IOT_METRIC_COUNT
+    } azure_iot_metric_t;
+
+    /**
+     * @brief Latency histogram of an operation.
+     */
+    typedef struct
+    {
+        uint32_t count;                                   /** @brief Operations measured, failed ones included. */
+        uint32_t errors;                                  /** @brief Operations failed. */
+        uint32_t max_us;                                  /** @brief Longest operation, in microseconds. */
+        uint64_t total_us;                                /** @brief Sum of the operation latencies, in microseconds. */
+        uint32_t buckets[AZURE_IOT_METRICS_BUCKET_COUNT]; /** @brief Operations per latency bucket. */
+    } azure_iot_metric_histogram_t;
+
+    /**
+     * @brief Copy of every histogram.
+     */
+    typedef struct
+    {
+        azure_iot_metric_histogram_t histograms[AZURE_IOT_METRIC_COUNT]; /** @brief Histograms, by @ref azure_iot_metric_t. */
+        uint32_t period_ms;                                              /** @brief Milliseconds measured, since the last reset. */
+    } azure_iot_metrics_snapshot_t;
+
+    /**
+     * @brief Copy the histograms, measured since @ref azure_iot_sdk_init or the last reset.
+     * @note Thread safe; operations are measured only after @ref azure_iot_sdk_init.
+     * @param[out] snapshot Where to copy the histograms.
+     * @param[in] reset Whether to reset the histograms after copying them, for periodic reports.
+     */
+    void azure_iot_metrics_snapshot(azure_iot_metrics_snapshot_t *snapshot, bool reset);
+
+    /**
+     * @brief Reset every histogram.
+     */
+    void azure_iot_metrics_reset();
+
+    /**
+     * @brief Copy the histogram of an operation, without resetting it.
+     * @param[in] metric Operation.
+     * @param[out] histogram Where to copy the histogram; zeroed if out of range.
+     */
+    void azure_iot_metrics_get_histogram(azure_iot_metric_t metric, azure_iot_metric_histogram_t *histogram);
+
+    /**
+     * @brief Estimate a latency percentile of a histogram.
+     * @details The upper bound of the bucket the percentile lands in, capped by the longest operation.
+     * @param[in] histogram Histogram.
+     * @param[in] percentile Percentile, from 1 to 100. Ex: 99.
+     * @return Latency, in microseconds; 0 if the histogram is empty.
+     */
+    uint32_t azure_iot_metrics_get_percentile_us(const azure_iot_metric_histogram_t *histogram, uint32_t percentile);
+
+    /**
+     * @brief Get the name of an operation, for reports. Ex: `tls_connect`.
+     * @param[in] metric Operation.
+     * @return The name; `unknown` if out of range.
+     */
+    const char *azure_iot_metrics_get_name(azure_iot_metric_t metric);
+
+    /**
+     * @brief Get the upper bound of a latency bucket.
+     * @details Bounds grow 1-2.5-5 from 500 us to 5 s; the last bucket has no bound.
+     * @param[in] bucket Bucket index, below @ref AZURE_IOT_METRICS_BUCKET_COUNT.
+     * @return Latencies up to this bound, in microseconds, land in the bucket; UINT32_MAX for the last one.
+     */
+    uint32_t azure_iot_metrics_get_bucket_bound_us(uint32_t bucket);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -2,6 +2,7 @@
 #define __ESP32_IOT_AZURE_PROVISIONING_H__
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "esp32_iot_azure/azure_iot_common.h"
 #include "azure_iot_provisioning_client.h"
 
@@ -16,6 +17,16 @@ extern "C"
      */
     typedef struct azure_dps_context_t azure_dps_context_t;
 
+    /**
+     * @brief Statistics of the last @ref azure_dps_register.
+     */
+    typedef struct
+    {
+        uint32_t polls;            /** @brief Operation status responses waited for before the registration completed. */
+        uint32_t waited_ms;        /** @brief Milliseconds waited between polls, retry-after and jitter. */
+        uint32_t initial_delay_ms; /** @brief Milliseconds waited before connecting to DPS. */
+    } azure_dps_statistics_t;
+
     /**
      * @brief Create an Azure IoT Provisioning Client context.
      * @note The context must be released by @ref azure_dps_free.
@@ -92,6 +103,13 @@ extern "C"
      * @brief Begin the provisioning process and wait until the device is registered or fail.
      * @note This method only returns after a device is registered of fails; there is
      * no need to check for @ref eAzureIoTErrorPending.
+     * @note While DPS assigns the device, the operation status is polled on the service
+     * retry-after interval plus a jittered back-off, growing with every poll. With
+     * `CONFIG_ESP32_IOT_AZURE_DPS_INITIAL_DELAY_MAX_MS`, a random delay precedes the
+     * connection, spreading a fleet restarting at once.
+     * @note With `CONFIG_ESP32_IOT_AZURE_DPS_CACHE_ENABLED`, the registration is kept in NVS,
+     * keyed by scope and registration id: the next ones return it without connecting to DPS,
+     * until @ref azure_dps_clear_cache.
      * @note IoT Plug and Play (PnP) devices may use the payload to send their model
      * ID when they register with DPS.
      * @note IoT Central devices that connect through DPS should follow IoT Plug
@@ -117,6 +135,26 @@ extern "C"
                                                   uint8_t *device_id,
                                                   uint32_t *device_id_length);
 
+    /**
+     * @brief Get whether the last @ref azure_dps_register returned the cached registration.
+     * @param[in] context DPS context.
+     * @return true if the registration was cached; false if registered with DPS.
+     */
+    bool azure_dps_is_registration_cached(const azure_dps_context_t *context);
+
+    /**
+     * @brief Get the statistics of the last @ref azure_dps_register.
+     * @param[in] context DPS context.
+     * @param[out] statistics Where to write the statistics.
+     */
+    void azure_dps_get_statistics(const azure_dps_context_t *context, azure_dps_statistics_t *statistics);
+
+    /**
+     * @brief Forget the cached registration: the next @ref azure_dps_register registers with DPS.
+     * @note Call when the cached hub refuses the device, like after it was moved to another hub or deleted.
+     */
+    void azure_dps_clear_cache();
+
     /**
      * @brief Get extended code for Provisioning failure.
      * @note Extended code is 6 digit error code last returned via the Provisioning service, when registration is done.
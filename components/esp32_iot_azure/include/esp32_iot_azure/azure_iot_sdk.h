@@ -1,6 +1,7 @@
 #ifndef __ESP32_IOT_AZURE_IOT_SDK_H__
 #define __ESP32_IOT_AZURE_IOT_SDK_H__
 
+#include <stdint.h>
 #include "azure_iot_result.h"
 
 #ifdef __cplusplus
@@ -8,6 +9,29 @@ extern "C"
 {
 #endif
 
+    /**
+     * @brief TLS handshake statistics, of all connections since @ref azure_iot_sdk_init.
+     * @note Handshakes offering a session of a previous connection are not counted
+     * when the transport cannot tell whether it was resumed, as with ESP-TLS.
+     */
+    typedef struct
+    {
+        uint32_t full_handshakes;    /** @brief Handshakes done in full. */
+        uint32_t resumed_handshakes; /** @brief Handshakes resuming the session of a previous connection. */
+    } azure_iot_tls_statistics_t;
+
+    /**
+     * @brief Reconnection statistics, of all servers since @ref azure_iot_sdk_init.
+     */
+    typedef struct
+    {
+        uint32_t attempts;      /** @brief Connection attempts made. */
+        uint32_t failures;      /** @brief Connection attempts failed. */
+        uint32_t circuit_opens; /** @brief Times a server was left alone after repeated failures. */
+        uint32_t rejected;      /** @brief Connection attempts not made for the server circuit being open. */
+        uint32_t network_down;  /** @brief Connection attempts not made for the network being down. */
+    } azure_iot_reconnect_statistics_t;
+
     /**
      * @brief Initialize the Azure SDK.
      * @return @ref AzureIoTResult_t with the result of the operation.
@@ -19,6 +43,19 @@ extern "C"
      */
     void azure_iot_sdk_deinit();
 
+    /**
+     * @brief Get the TLS handshake statistics.
+     * @note Sessions are resumed only with `CONFIG_ESP32_IOT_AZURE_TRANSPORT_TLS_SESSION_REUSE`.
+     * @param[out] statistics Where to write the statistics.
+     */
+    void azure_iot_sdk_get_tls_statistics(azure_iot_tls_statistics_t *statistics);
+
+    /**
+     * @brief Get the reconnection statistics.
+     * @param[out] statistics Where to write the statistics.
+     */
+    void azure_iot_sdk_get_reconnect_statistics(azure_iot_reconnect_statistics_t *statistics);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,101 @@
+#ifndef __ESP32_IOT_AZURE_IOT_TELEMETRY_BATCH_H__
+#define __ESP32_IOT_AZURE_IOT_TELEMETRY_BATCH_H__
+
+#include <stdint.h>
+#include "esp32_iot_azure/azure_iot_common.h"
+#include "esp32_iot_azure/azure_iot_hub.h"
+#include "esp32_iot_azure/azure_iot_telemetry_queue.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @typedef azure_iot_telemetry_batch_t
+     * @brief Telemetry batch: samples packed in a JSON array, sent in one message.
+     * @details Samples are added to the array until it would not fit in the batch buffer,
+     * or until it is older than the batch max age; then the array is sent as one
+     * message with the component, content type ("application/json") and content
+     * encoding ("utf-8") properties, built once on creation.
+     * One message per batch means fewer PUBLISH and PUBACK packets, less TLS
+     * overhead and fewer IoT Hub messages billed.
+     * @note Not thread safe: use it from the task calling @ref azure_iot_hub_process_loop.
+     */
+    typedef struct azure_iot_telemetry_batch_t azure_iot_telemetry_batch_t;
+
+    /**
+     * @brief Create a telemetry batch.
+     * @note The batch must be released by @ref azure_iot_telemetry_batch_free.
+     * @param[in] hub_context IoT context to send the batches with.
+     * @param[in] component_name Component name. Can be `NULL` for the root component.
+     * @param[in] component_name_length Component name length.
+     * @param[in] buffer Buffer to pack the samples in: its length is the largest batch sent.
+     * Must be kept until the batch is released.
+     * @param[in] max_age_ms Milliseconds a batch waits for more samples, since its first one;
+     * 0 to wait until full or flushed.
+     * @param[in] qos The QOS to use for the batches.
+     * @return @ref azure_iot_telemetry_batch_t on success or null on failure.
+     */
+    azure_iot_telemetry_batch_t *azure_iot_telemetry_batch_create(azure_iot_hub_context_t *hub_context,
+                                                                  const uint8_t *component_name,
+                                                                  uint32_t component_name_length,
+                                                                  buffer_t *buffer,
+                                                                  uint32_t max_age_ms,
+                                                                  AzureIoTHubMessageQoS_t qos);
+
+    /**
+     * @brief Send the batches through a telemetry queue, to store them while the hub is not reachable.
+     * @param[in] batch Telemetry batch.
+     * @param[in] queue Telemetry queue. Can be `NULL` to send directly.
+     * @param[in] time_to_live_s Seconds a stored batch is worth sending for; 0 for no limit.
+     */
+    void azure_iot_telemetry_batch_set_queue(azure_iot_telemetry_batch_t *batch,
+                                             azure_iot_telemetry_queue_t *queue,
+                                             uint32_t time_to_live_s);
+
+    /**
+     * @brief Add a sample to the batch, sending the batch first if the sample does not fit.
+     * @param[in] batch Telemetry batch.
+     * @param[in] sample Sample, as a JSON value. Ex: `{"temperature":21}`.
+     * @param[in] sample_length Sample length.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     * The sample is not added if sending the batch failed.
+     */
+    AzureIoTResult_t azure_iot_telemetry_batch_add(azure_iot_telemetry_batch_t *batch,
+                                                   const uint8_t *sample,
+                                                   uint32_t sample_length);
+
+    /**
+     * @brief Send the batch if it is older than its max age.
+     * @note Must be called periodically, like @ref azure_iot_hub_process_loop.
+     * @param[in] batch Telemetry batch.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     */
+    AzureIoTResult_t azure_iot_telemetry_batch_process(azure_iot_telemetry_batch_t *batch);
+
+    /**
+     * @brief Send the batch, if it has samples.
+     * @param[in] batch Telemetry batch.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     * The samples are kept, to be sent again, on failure.
+     */
+    AzureIoTResult_t azure_iot_telemetry_batch_flush(azure_iot_telemetry_batch_t *batch);
+
+    /**
+     * @brief Get how many samples the batch holds.
+     * @param[in] batch Telemetry batch.
+     * @return Samples not sent yet.
+     */
+    uint32_t azure_iot_telemetry_batch_get_sample_count(const azure_iot_telemetry_batch_t *batch);
+
+    /**
+     * @brief Cleanup and free the batch. Samples not flushed are discarded.
+     * @param[in] batch Telemetry batch.
+     */
+    void azure_iot_telemetry_batch_free(azure_iot_telemetry_batch_t *batch);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
\ No newline at end of file
@@ -0,0 +1,104 @@
+#ifndef __ESP32_IOT_AZURE_IOT_TELEMETRY_QUEUE_H__
+#define __ESP32_IOT_AZURE_IOT_TELEMETRY_QUEUE_H__
+
+#include <stdint.h>
+#include "esp32_iot_azure/azure_iot_hub.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @typedef azure_iot_telemetry_queue_t
+     * @brief Store-and-forward telemetry queue of an Azure IoT Hub Client.
+     * @details Telemetry is sent directly while the hub is reachable. When a send fails,
+     * the message is stored on the `CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_PARTITION_LABEL`
+     * partition, and so are the ones after it, to keep them in order.
+     * Stored messages survive reboots, and are sent by @ref azure_iot_telemetry_queue_process
+     * once the hub is reachable again, at `CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_DRAIN_RATE`.
+     * @details Stored QoS 1 messages are kept until the hub acknowledges them,
+     * and sent again after a reconnection otherwise: they may be received twice.
+     * When the partition is full, the oldest messages are dropped.
+     * @note Not thread safe: use it from the task calling @ref azure_iot_hub_process_loop.
+     */
+    typedef struct azure_iot_telemetry_queue_t azure_iot_telemetry_queue_t;
+
+    /**
+     * @brief Telemetry queue counters, since the queue was created.
+     */
+    typedef struct
+    {
+        uint32_t sent;    /** @brief Messages sent; stored QoS 1 ones when acknowledged. */
+        uint32_t queued;  /** @brief Messages stored to be sent later. */
+        uint32_t expired; /** @brief Stored messages dropped for being older than their time to live. */
+        uint32_t dropped; /** @brief Stored messages dropped to make room for newer ones, or corrupted. */
+        uint32_t pending; /** @brief Stored messages not sent yet, including the ones of previous boots. */
+    } azure_iot_telemetry_queue_statistics_t;
+
+    /**
+     * @brief Create a telemetry queue for a hub context, recovering the messages stored before a reboot.
+     * @note The queue must be released by @ref azure_iot_telemetry_queue_free, before the \p hub_context.
+     * @note Only one queue can exist at a time: they would share the partition.
+     * @param[in] hub_context IoT context to send telemetry with.
+     * @return @ref azure_iot_telemetry_queue_t on success or null on failure, like a missing partition.
+     */
+    azure_iot_telemetry_queue_t *azure_iot_telemetry_queue_create(azure_iot_hub_context_t *hub_context);
+
+    /**
+     * @brief Send telemetry data to IoT Hub, storing it to be sent later if the hub is not reachable.
+     * @note Time to live needs the system time to be set, which authentication also does.
+     * @param[in] queue Telemetry queue.
+     * @param[in] payload User defined telemetry payload.
+     * @param[in] payload_length Payload length.
+     * @param[in] properties Properties to send with the telemetry, serialized: `name=value` pairs
+     * joined by `&`, as written on the buffer of an @ref AzureIoTMessageProperties_t. Can be `NULL`.
+     * @param[in] properties_length Length of \p properties.
+     * @param[in] qos The QOS to use for the telemetry.
+     * @param[in] time_to_live_s Seconds the message is worth sending for, if stored; 0 for no limit.
+     * @return @ref AzureIoTResult_t with the result of the operation:
+     * @ref eAzureIoTSuccess when the message was sent or stored.
+     */
+    AzureIoTResult_t azure_iot_telemetry_queue_send(azure_iot_telemetry_queue_t *queue,
+                                                    const uint8_t *payload,
+                                                    uint32_t payload_length,
+                                                    const uint8_t *properties,
+                                                    uint32_t properties_length,
+                                                    AzureIoTHubMessageQoS_t qos,
+                                                    uint32_t time_to_live_s);
+
+    /**
+     * @brief Send the stored messages, oldest first, without going over the drain rate.
+     * @note Must be called periodically, like @ref azure_iot_hub_process_loop.
+     * @param[in] queue Telemetry queue.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     */
+    AzureIoTResult_t azure_iot_telemetry_queue_process(azure_iot_telemetry_queue_t *queue);
+
+    /**
+     * @brief Notify the queue that the hub acknowledged a QoS 1 telemetry message.
+     * @note Must be called from the @ref AzureIoTHubClientOptions_t `xTelemetryCallback` option.
+     * Packets not sent by the queue are ignored.
+     * @param[in] queue Telemetry queue.
+     * @param[in] packet_id Packet id acknowledged.
+     */
+    void azure_iot_telemetry_queue_acknowledge(azure_iot_telemetry_queue_t *queue, uint16_t packet_id);
+
+    /**
+     * @brief Get the telemetry queue counters.
+     * @param[in] queue Telemetry queue.
+     * @param[out] statistics Where to write the counters.
+     */
+    void azure_iot_telemetry_queue_get_statistics(const azure_iot_telemetry_queue_t *queue,
+                                                  azure_iot_telemetry_queue_statistics_t *statistics);
+
+    /**
+     * @brief Cleanup and free the queue. Stored messages are kept.
+     * @param[in] queue Telemetry queue.
+     */
+    void azure_iot_telemetry_queue_free(azure_iot_telemetry_queue_t *queue);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
\ No newline at end of file
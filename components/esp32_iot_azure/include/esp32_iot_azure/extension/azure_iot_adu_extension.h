@@ -2,6 +2,7 @@
 #define __ESP32_IOT_AZURE_IOT_ADU_EXT_H__
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "esp32_iot_azure/azure_iot_adu.h"
 #include "esp32_iot_azure/extension/azure_iot_http_client_extension.h"
 
@@ -20,10 +21,13 @@ extern "C"
         uint32_t hostname_length; /** @brief Length of the hostname returned by \p hostname, including the null-terminator. */
         uint8_t *path;            /** @brief Pointer to the point in the buffer where the path starts. */
         uint32_t path_length;     /** @brief Length of the path returned by \p path, including the null-terminator. */
+        uint16_t port;            /** @brief Server port: the explicit one or the scheme default (80 or 443). */
+        bool secure;              /** @brief Whether the scheme is `https`. */
     } parsed_file_url_t;
 
     /**
-     * @brief Parse a @ref AzureIoTADUUpdateManifestFileUrl_t into hostname and path.
+     * @brief Parse a @ref AzureIoTADUUpdateManifestFileUrl_t into hostname, port and path.
+     * @details Accepts `http://` and `https://` urls, with an optional port after the hostname.
      * @param[in] file_url Pointer to a @ref AzureIoTADUUpdateManifestFileUrl_t.
      * @param[in] parse_buffer Buffer on which the parsed values will be copied.
      * It must have at least (file_url.ulUrlLength + 2) size.
@@ -43,7 +47,9 @@ extern "C"
      * @param[in] chunk_size How many bytes should be read per range request.
      * @param[in] callback Callback invoked when a resource chunk is downloaded.
      * @param[in] callback_context Pointer to a context to pass to the callback.
+     * @param[in] start_offset File offset to start from, to resume an interrupted download; 0 for the whole file.
      * @param[in] file_size Pointer to where to store the file total size.
+     * @param[out] statistics Optional pointer to where to store the download statistics.
      * @return @ref AzureIoTResult_t with the result of the operation.
      */
     AzureIoTResult_t azure_adu_file_download(parsed_file_url_t *parsed_url,
@@ -52,7 +58,9 @@ extern "C"
                                              uint16_t chunk_size,
                                              azure_http_download_callback_t callback,
                                              void *callback_context,
-                                             uint32_t *file_size);
+                                             uint32_t start_offset,
+                                             uint32_t *file_size,
+                                             azure_http_statistics_t *statistics);
 #ifdef __cplusplus
 }
 #endif
@@ -39,12 +39,17 @@ extern "C"
 
     /**
      * @brief Download a resource.
+     * @note Streamed, by @ref azure_http_download_resource_streamed, when
+     * CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_DOWNLOAD_STREAMED is enabled. Otherwise
+     * pipelined, by @ref azure_http_download_resource_pipelined, when
+     * CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_PIPELINE_DEPTH is greater than 1.
      * @param[in] context HTTP context.
      * @param[in,out] data_buffer The buffer into which the response header and payload will be placed.
      * @param[in] data_buffer_length The length of \p data_buffer.
      * @param[in] chunk_size How many bytes should be read per range request.
      * @param[in] callback Optional callback invoked when a resource chunk is downloaded.
      * @param[in] callback_context Pointer to a context to pass to the callback.
+     * @param[in] start_offset Resource offset to start from; 0 for the whole resource.
      * @param[in] resource_size Resource total size.
      * @return @ref AzureIoTResult_t with the result of the operation.
      */
@@ -54,8 +59,63 @@ extern "C"
                                                       uint16_t chunk_size,
                                                       azure_http_download_callback_t callback,
                                                       void *callback_context,
+                                                      uint32_t start_offset,
                                                       uint32_t resource_size);
 
+    /**
+     * @brief Download a resource keeping many range requests in flight on the same connection.
+     * @details Hides the round trip on high latency links: the server answers the next
+     * requests while the current chunk is being processed. The chunks are delivered to
+     * \p callback in offset order, one at a time, from \p data_buffer.
+     * @note The server must support HTTP/1.1 pipelining. When it closes the connection,
+     * the requests left unanswered are sent again.
+     * @param[in] context HTTP context.
+     * @param[in,out] data_buffer The buffer into which the requests, response header and payload will be placed.
+     * @param[in] data_buffer_length The length of \p data_buffer. Must fit a response header and \p chunk_size.
+     * @param[in] chunk_size How many bytes should be read per range request.
+     * @param[in] pipeline_depth Maximum range requests in flight. 1 waits for each response before the next request.
+     * @param[in] callback Optional callback invoked when a resource chunk is downloaded.
+     * @param[in] callback_context Pointer to a context to pass to the callback.
+     * @param[in] start_offset Resource offset to start from; 0 for the whole resource.
+     * @param[in] resource_size Resource total size.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     */
+    AzureIoTHTTPResult_t azure_http_download_resource_pipelined(azure_http_context_t *context,
+                                                                char *data_buffer,
+                                                                uint32_t data_buffer_length,
+                                                                uint16_t chunk_size,
+                                                                uint8_t pipeline_depth,
+                                                                azure_http_download_callback_t callback,
+                                                                void *callback_context,
+                                                                uint32_t start_offset,
+                                                                uint32_t resource_size);
+
+    /**
+     * @brief Download a resource with a single request, streaming its body.
+     * @details No per chunk request and response headers, and the connection keeps
+     * receiving while a chunk is being processed. The body is delivered to \p callback
+     * in slices of \p chunk_size, in offset order, from \p data_buffer.
+     * @note When the connection breaks the download resumes, on a new connection,
+     * with a `Range` request from the first byte not delivered.
+     * @param[in] context HTTP context.
+     * @param[in,out] data_buffer The buffer into which the requests, response header and payload will be placed.
+     * @param[in] data_buffer_length The length of \p data_buffer. Must fit a response header and \p chunk_size.
+     * @param[in] chunk_size How many bytes should be delivered per callback.
+     * @param[in] callback Optional callback invoked when a resource chunk is downloaded.
+     * @param[in] callback_context Pointer to a context to pass to the callback.
+     * @param[in] start_offset Resource offset to start from; 0 for the whole resource.
+     * @param[in] resource_size Resource total size.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     */
+    AzureIoTHTTPResult_t azure_http_download_resource_streamed(azure_http_context_t *context,
+                                                               char *data_buffer,
+                                                               uint32_t data_buffer_length,
+                                                               uint16_t chunk_size,
+                                                               azure_http_download_callback_t callback,
+                                                               void *callback_context,
+                                                               uint32_t start_offset,
+                                                               uint32_t resource_size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -2,14 +2,37 @@
 #define __ESP32_IOT_AZURE_FLASH_PLAT_PORT_H__
 
 #include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "mbedtls/sha256.h"
+#include "azure_iot_result.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
 #include "esp_partition.h"
 #include "esp_ota_ops.h"
+#endif
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+#if CONFIG_IDF_TARGET_LINUX
+    /**
+     * @typedef AzureADUImageContext_t
+     * @brief Context for in-memory partition update operations, used on the Linux host.
+     */
+    typedef struct AzureADUImageContext
+    {
+        uint8_t *partition;            /** @brief In-memory partition bytes. */
+        uint32_t partition_size;       /** @brief In-memory partition size. */
+        uint32_t image_size;           /** @brief Image size to write. */
+        mbedtls_sha256_context sha256; /** @brief Hash of the blocks written so far. */
+        uint32_t hashed_size;          /** @brief Bytes hashed; only blocks written in order are hashed. */
+        uint32_t erased_size;          /** @brief Bytes erased, from the partition start. */
+        bool hashes_download;          /** @brief The hash is of the downloaded file, not of the blocks written. */
+    } AzureADUImageContext_t;
+#else
     /**
      * @typedef AzureADUImageContext_t
      * @brief Context for partition update operations.
@@ -19,7 +42,12 @@ extern "C"
         const esp_partition_t *partition; /** @brief ESP partition context. */
         esp_ota_handle_t ota;             /** @brief ESP OTA context */
         uint32_t image_size;              /** @brief Image size to write. */
+        mbedtls_sha256_context sha256;    /** @brief Hash of the blocks written so far. */
+        uint32_t hashed_size;             /** @brief Bytes hashed; only blocks written in order are hashed. */
+        uint32_t erased_size;             /** @brief Bytes erased, from the partition start. */
+        bool hashes_download;             /** @brief The hash is of the downloaded file, not of the blocks written. */
     } AzureADUImageContext_t;
+#endif
 
     /**
      * @typedef AzureADUImage_t
@@ -28,7 +56,68 @@ extern "C"
      */
     typedef AzureADUImageContext_t AzureADUImage_t;
 
+    /**
+     * @brief Continue writing an image interrupted by a reboot or power loss.
+     * @details The partition bytes before \p offset are kept, and the image hash
+     * continues from \p hash_state. Must be called after AzureIoTPlatform_Init
+     * and before the first AzureIoTPlatform_WriteBlock.
+     * @param[in] pxAduImage Image context.
+     * @param[in] offset Image bytes already written.
+     * @param[in] hash_state Optional hash of the first \p offset bytes. When null,
+     * the image is read back from flash on verification.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     */
+    AzureIoTResult_t AzureIoTPlatform_ResumeImage(AzureADUImage_t *const pxAduImage,
+                                                  uint32_t offset,
+                                                  const mbedtls_sha256_context *hash_state);
+
+    /**
+     * @brief Release an image whose download failed, before it is verified.
+     * @details Frees the image hash and, on the device, aborts the OTA. What was written
+     * stays in the partition, for a later download to resume from.
+     * Must not be called after AzureIoTPlatform_VerifyImage, which releases the image itself.
+     * @param[in] pxAduImage Image context, initialized by AzureIoTPlatform_Init.
+     */
+    void AzureIoTPlatform_AbortImage(AzureADUImage_t *const pxAduImage);
+
+    /**
+     * @brief Get an identifier of the partition the image is written to.
+     * @details Used to tell if an interrupted download targeted the same partition.
+     * @param[in] pxAduImage Image context.
+     * @return Partition flash address; 0 on the Linux host.
+     */
+    uint32_t AzureIoTPlatform_GetImageLocation(const AzureADUImage_t *const pxAduImage);
+
+    /**
+     * @brief Hash a block of the downloaded file, for files not written as downloaded.
+     * @details The update manifest hash is of the downloaded file: when it is transformed
+     * before written, like a compressed image, the blocks written are no longer hashed and
+     * the image is verified against the downloaded blocks instead, with no read back.
+     * The image size must be the downloaded file size.
+     * @param[in] pxAduImage Image context.
+     * @param[in] offset Offset of \p pData in the downloaded file. Only blocks given in order are hashed.
+     * @param[in] pData Downloaded bytes.
+     * @param[in] ulBlockSize Length of \p pData.
+     */
+    void AzureIoTPlatform_HashDownloadBlock(AzureADUImage_t *const pxAduImage,
+                                            uint32_t offset,
+                                            const uint8_t *pData,
+                                            uint32_t ulBlockSize);
+
+    /**
+     * @brief Read the image currently running, the base of delta updates.
+     * @param[in] pxAduImage Image context.
+     * @param[in] offset Running image offset to read from.
+     * @param[out] pData Where to read to.
+     * @param[in] ulBlockSize Bytes to read.
+     * @return @ref AzureIoTResult_t with the result of the operation.
+     */
+    AzureIoTResult_t AzureIoTPlatform_ReadRunningImage(AzureADUImage_t *const pxAduImage,
+                                                       uint32_t offset,
+                                                       uint8_t *pData,
+                                                       uint32_t ulBlockSize);
+
 #ifdef __cplusplus
 }
 #endif
-#endif
\ No newline at end of file
+#endif
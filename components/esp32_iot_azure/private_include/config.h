@@ -31,6 +31,13 @@ extern "C"
 #define CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DU_ENABLED 0
 #endif
 
+#ifndef CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DIAGNOSTICS_ENABLED
+/**
+ * @brief Enables the diagnostics component feature.
+ */
+#define CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DIAGNOSTICS_ENABLED 0
+#endif
+
 #ifndef CONFIG_ESP32_IOT_AZURE_HUB_SERVER_HOSTNAME
 /**
  * @brief Azure IoT Hub server hostname.
@@ -109,6 +116,82 @@ extern "C"
  * @brief Use Azure China Cloud certificate.
  */
 #define CONFIG_ESP32_IOT_AZURE_HUB_CERT_USE_AZURE_CN 0
+#endif
+
+   // ==============================
+   // AZURE IOT HUB: TELEMETRY QUEUE
+   // ==============================
+
+#ifndef CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_PARTITION_LABEL
+/**
+ * @brief Label of the data partition telemetry is stored on
+ * while the hub is not reachable.
+ */
+#define CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_PARTITION_LABEL "az_telemetry"
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_DRAIN_RATE
+/**
+ * @brief Stored messages sent per second after the hub is reachable again.
+ */
+#define CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_DRAIN_RATE 10U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_IN_FLIGHT_MAX
+/**
+ * @brief Stored QoS 1 messages sent and waiting for the hub acknowledgment.
+ */
+#define CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_IN_FLIGHT_MAX 4U
+#endif
+
+   // =============================
+   // AZURE IOT HUB: PUBLISH WINDOW
+   // =============================
+
+#ifndef CONFIG_ESP32_IOT_AZURE_HUB_PUBLISH_WINDOW_SIZE
+/**
+ * @brief QoS 1 telemetry messages sent and waiting for the hub acknowledgment.
+ */
+#define CONFIG_ESP32_IOT_AZURE_HUB_PUBLISH_WINDOW_SIZE 4U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_HUB_PUBLISH_WINDOW_WAIT_MS
+/**
+ * @brief Milliseconds a send waits for room when the window is full.
+ */
+#define CONFIG_ESP32_IOT_AZURE_HUB_PUBLISH_WINDOW_WAIT_MS 0U
+#endif
+
+   // ===========================
+   // AZURE IOT HUB: NETWORK TASK
+   // ===========================
+
+#ifndef CONFIG_ESP32_IOT_AZURE_HUB_TASK_STACK_SIZE
+/**
+ * @brief Network task stack size, in bytes.
+ */
+#define CONFIG_ESP32_IOT_AZURE_HUB_TASK_STACK_SIZE 6144U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_HUB_TASK_PRIORITY
+/**
+ * @brief Network task priority.
+ */
+#define CONFIG_ESP32_IOT_AZURE_HUB_TASK_PRIORITY 5U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_HUB_TASK_CORE
+/**
+ * @brief Core the network task is pinned to; -1 for no affinity.
+ */
+#define CONFIG_ESP32_IOT_AZURE_HUB_TASK_CORE -1
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_HUB_TASK_QUEUE_LENGTH
+/**
+ * @brief Requests waiting to be sent by the network task.
+ */
+#define CONFIG_ESP32_IOT_AZURE_HUB_TASK_QUEUE_LENGTH 16U
 #endif
 
    // ============
@@ -160,6 +243,36 @@ extern "C"
  * @brief Azure DPS server registration timeout, in milliseconds.
  */
 #define CONFIG_ESP32_IOT_AZURE_DPS_REGISTRATION_TIMEOUT_MS 10000U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DPS_POLL_BACKOFF_BASE_MS
+/**
+ * @brief Azure DPS base back-off delay, in milliseconds, added to the retry-after interval
+ * between operation status polls.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DPS_POLL_BACKOFF_BASE_MS 500U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DPS_POLL_BACKOFF_MAX_DELAY_MS
+/**
+ * @brief Azure DPS maximum back-off delay, in milliseconds, added to the retry-after interval
+ * between operation status polls.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DPS_POLL_BACKOFF_MAX_DELAY_MS 10000U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DPS_INITIAL_DELAY_MAX_MS
+/**
+ * @brief Azure DPS maximum random delay, in milliseconds, before registering; 0 to disable.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DPS_INITIAL_DELAY_MAX_MS 0U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DPS_CACHE_ENABLED
+/**
+ * @brief Keep the DPS registration in NVS, to skip DPS on warm boots.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DPS_CACHE_ENABLED 0
 #endif
 
    // ===================
@@ -244,6 +357,158 @@ extern "C"
    #endif
 #endif
 
+   // ===========================
+   // AZURE DEVICE UPDATE: VERIFY
+   // ===========================
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DU_VERIFY_READ_BACK
+/**
+ * @brief Read the image back from flash, after the download, to verify it.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DU_VERIFY_READ_BACK 0
+#endif
+
+   // ===========================
+   // AZURE DEVICE UPDATE: RESUME
+   // ===========================
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DU_RESUME_ENABLED
+/**
+ * @brief Save the download progress to resume it after a reboot.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DU_RESUME_ENABLED 0
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DU_RESUME_CHECKPOINT_INTERVAL_KB
+/**
+ * @brief Image kilobytes downloaded between progress saves.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DU_RESUME_CHECKPOINT_INTERVAL_KB 64U
+#endif
+
+   // ================================
+   // AZURE DEVICE UPDATE: COMPRESSION
+   // ================================
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_ENABLED
+/**
+ * @brief Decompress images, compressed with heatshrink, while downloaded.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_ENABLED 0
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_FILE_EXTENSION
+/**
+ * @brief Update file name suffix telling the file is compressed.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_FILE_EXTENSION ".hs"
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_WINDOW_BITS
+/**
+ * @brief Decompression window size, in bits.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_WINDOW_BITS 11U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_LOOKAHEAD_BITS
+/**
+ * @brief Decompression lookahead size, in bits.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_LOOKAHEAD_BITS 4U
+#endif
+
+   // ==========================
+   // AZURE DEVICE UPDATE: DELTA
+   // ==========================
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DU_DELTA_ENABLED
+/**
+ * @brief Rebuild images from patches against the running image.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DU_DELTA_ENABLED 0
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DU_DELTA_FILE_EXTENSION
+/**
+ * @brief Update file name suffix telling the file is a patch.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DU_DELTA_FILE_EXTENSION ".delta"
+#endif
+
+   // =================================
+   // AZURE DEVICE UPDATE: FLASH WRITER
+   // =================================
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_ENABLED
+/**
+ * @brief Write downloaded chunks to flash on a dedicated task.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_ENABLED 0
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_BUFFERS
+/**
+ * @brief Number of chunk sized buffers between the download and the flash writer task.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_BUFFERS 2U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_TASK_STACK_SIZE
+/**
+ * @brief Flash writer task stack size, in bytes.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_TASK_STACK_SIZE 3072U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_TASK_PRIORITY
+/**
+ * @brief Flash writer task priority.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_TASK_PRIORITY 5U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_TASK_CORE
+/**
+ * @brief Core the flash writer task is pinned to; -1 for no affinity.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_TASK_CORE -1
+#endif
+
+   // =====================
+   // DIAGNOSTICS COMPONENT
+   // =====================
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_INTERVAL_S
+/**
+ * @brief Seconds between diagnostics reports, until set by the
+ * `interval` writable property; 0 to not report.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_INTERVAL_S 300U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_FIELDS
+/**
+ * @brief Fields of the diagnostics reports, until set by the
+ * `fields` writable property. Mask of azure_iot_diagnostics_field_t.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_FIELDS 0x1FU
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_TASKS_MAX
+/**
+ * @brief Tasks whose stack watermark can be reported.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_TASKS_MAX 4U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_ERRORS_MAX
+/**
+ * @brief Last error codes kept for the diagnostics reports.
+ */
+#define CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_ERRORS_MAX 4U
+#endif
+
    // ==================
    // TRANSPORT BACK-OFF
    // ==================
@@ -283,6 +548,45 @@ extern "C"
  * @brief Transport maximum number of retries for network operation with the server.
  */
 #define CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_RETRY_MAX_ATTEMPTS 5U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_TRANSPORT_CIRCUIT_BREAKER_THRESHOLD
+/**
+ * @brief Consecutive connection failures to a server opening its circuit; 0 to disable.
+ */
+#define CONFIG_ESP32_IOT_AZURE_TRANSPORT_CIRCUIT_BREAKER_THRESHOLD 10U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_TRANSPORT_CIRCUIT_BREAKER_OPEN_MS
+/**
+ * @brief Time, in milliseconds, a server circuit stays open before a probe.
+ */
+#define CONFIG_ESP32_IOT_AZURE_TRANSPORT_CIRCUIT_BREAKER_OPEN_MS 30000U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_TRANSPORT_RECONNECT_SERVERS
+/**
+ * @brief Number of servers whose back-off delay and circuit state are kept.
+ */
+#define CONFIG_ESP32_IOT_AZURE_TRANSPORT_RECONNECT_SERVERS 4U
+#endif
+
+   // =============
+   // TRANSPORT TLS
+   // =============
+
+#ifndef CONFIG_ESP32_IOT_AZURE_TRANSPORT_TLS_SESSION_REUSE
+/**
+ * @brief Resume TLS sessions on reconnections.
+ */
+#define CONFIG_ESP32_IOT_AZURE_TRANSPORT_TLS_SESSION_REUSE 0
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_TRANSPORT_TLS_SESSION_CACHE_SIZE
+/**
+ * @brief Number of servers whose TLS session is kept.
+ */
+#define CONFIG_ESP32_IOT_AZURE_TRANSPORT_TLS_SESSION_CACHE_SIZE 3U
 #endif
 
    // ==============
@@ -315,6 +619,20 @@ extern "C"
  * @brief Maximum size, in bytes, of headers allowed from the server for HTTP operations.
  */
 #define CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_MAX_RESPONSE_HEADERS_SIZE_BYTES 3072U
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_DOWNLOAD_STREAMED
+/**
+ * @brief Download resources with a single request, streaming the body.
+ */
+#define CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_DOWNLOAD_STREAMED 0
+#endif
+
+#ifndef CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_PIPELINE_DEPTH
+/**
+ * @brief Number of range requests kept in flight when downloading a resource.
+ */
+#define CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_PIPELINE_DEPTH 1U
 #endif
 
    // ==============
@@ -326,6 +644,18 @@ extern "C"
  * @brief Maximum PUBLISH messages pending, for MQTT operations.
  */
 #define CONFIG_ESP32_IOT_AZURE_TRANSPORT_MQTT_STATE_ARRAY_MAX_COUNT 10U
+#endif
+
+   // ===========
+   // HOST (LINUX)
+   // ===========
+
+#ifndef CONFIG_ESP32_IOT_AZURE_HOST_FLASH_BANK_SIZE
+/**
+ * @brief Size, in bytes, of the in-memory partition used
+ * for Device Update images on the Linux host.
+ */
+#define CONFIG_ESP32_IOT_AZURE_HOST_FLASH_BANK_SIZE 0x100000U
 #endif
 
 #ifdef __cplusplus
@@ -1,6 +1,7 @@
 #ifndef __ESP32_IOT_AZURE_INFRA_AZURE_IOT_CERT_H__
 #define __ESP32_IOT_AZURE_INFRA_AZURE_IOT_CERT_H__
 
+#include <stdbool.h>
 #include "infrastructure/transport.h"
 
 #ifdef __cplusplus
@@ -9,10 +10,32 @@ extern "C"
 #endif
 
         /**
-         * @brief Get the Azure IoT root certificate chain used by Azure IoT services.
-         * @return Poiter to the certificate.
+         * @brief Initialize the Azure IoT trust store.
+         * @note Optional: @ref azure_iot_certificate_take initializes it on first use.
+         * @return true on success; false otherwise.
          */
-        const tls_certificate_t *azure_iot_certificate_get();
+        bool azure_iot_certificate_init();
+
+        /**
+         * @brief Release the Azure IoT trust store.
+         */
+        void azure_iot_certificate_deinit();
+
+        /**
+         * @brief Take the Azure IoT trust store: the root certificates used by Azure IoT services.
+         * @details The roots are parsed by the first taker and shared by the next ones, until
+         * the last one releases them. Hub, DPS and Device Update transports share one chain,
+         * private to them: the ESP-TLS global CA store is left to the application.
+         * @note Must be released by @ref azure_iot_certificate_release.
+         * @return Certificate of @ref TLS_CERT_FORMAT_X509 format; `NULL` on failure.
+         */
+        const tls_certificate_t *azure_iot_certificate_take();
+
+        /**
+         * @brief Release the Azure IoT trust store taken by @ref azure_iot_certificate_take.
+         * @details The chain is freed with the last reference.
+         */
+        void azure_iot_certificate_release();
 
 #endif
 #ifdef __cplusplus
@@ -19,6 +19,15 @@ extern "C"
     void azure_transport_interface_init(transport_t *transport,
                                         AzureIoTTransportInterface_t *interface);
 
+    /**
+     * @brief Set how long the interface waits for bytes on receive.
+     * @param[in] interface Azure transport interface.
+     * @param[in] timeout_ms Timeout in milliseconds; 0 to only read bytes already received.
+     * The default is `CONFIG_ESP32_IOT_AZURE_TRANSPORT_RECEIVE_TIMEOUT_MS`.
+     */
+    void azure_transport_interface_set_receive_timeout(AzureIoTTransportInterface_t *interface,
+                                                       uint16_t timeout_ms);
+
     /**
      * @brief Cleanup and free the interface.
      * @param[in] interface Azure transport interface.
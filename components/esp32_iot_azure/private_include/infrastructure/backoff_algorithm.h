@@ -126,6 +126,20 @@ extern "C"
                                                           uint16_t *next_backoff);
     /* @[define_backoff_algorithm_get_next] */
 
+    /**
+     * @brief Decorrelated jitter: the next delay is a random value between the base
+     * and three times the previous delay, capped by the maximum.
+     * @details Unlike the exponential backoff, delays do not follow the attempt count:
+     * clients failing at once drift apart instead of retrying together.
+     * @param[in] backoff_base The minimum delay, in milliseconds.
+     * @param[in] max_back_off The maximum delay, in milliseconds.
+     * @param[in] previous The previous delay returned; 0 for the first attempt.
+     * @return The delay, in milliseconds, before the next attempt.
+     */
+    uint32_t backoff_algorithm_get_decorrelated(uint32_t backoff_base,
+                                                uint32_t max_back_off,
+                                                uint32_t previous);
+
 #endif
 #ifdef __cplusplus
 }
@@ -1,6 +1,7 @@
 #ifndef __ESP32_IOT_AZURE_INFRA_CRYPTO_H__
 #define __ESP32_IOT_AZURE_INFRA_CRYPTO_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -8,8 +9,38 @@ extern "C"
 {
 #endif
 
+    /**
+     * @brief Crypto statistics.
+     * @note Kept from @ref crypto_init on.
+     */
+    typedef struct
+    {
+        uint32_t hmac_calls;       /** @brief HMAC operations. */
+        uint32_t hmac_key_hits;    /** @brief HMAC operations that reused the cached pre-keyed state; 0 when not cached. */
+        uint32_t hmac_last_cycles; /** @brief CPU cycles of the last HMAC operation; nanoseconds on the host. */
+        uint64_t hmac_cycles;      /** @brief CPU cycles of all HMAC operations; nanoseconds on the host. */
+        bool hardware;             /** @brief Whether the HMAC SHA-256 runs on the SHA peripheral. */
+    } crypto_statistics_t;
+
+    /**
+     * @brief Initialize the crypto backend.
+     * @note Without it, HMAC operations work but do not cache the pre-keyed state.
+     * @return true on success; false otherwise.
+     */
+    bool crypto_init();
+
+    /**
+     * @brief Release the crypto backend, wiping the cached key.
+     */
+    void crypto_deinit();
+
     /**
      * @brief HMAC256 function that complies with @ref AzureIoTGetHMACFunc_t contract.
+     * @details The SHA-256 is run on the SHA peripheral when mbedTLS hardware SHA is enabled.
+     * The hash state after the key pads is cached for the last key used, so signing repeatedly
+     * with the same device key (one SAS token per connection) skips two SHA blocks per call.
+     * Not on the ESP32 with hardware SHA: mbedTLS would hash the cloned cached states in
+     * software, so each call keys the peripheral instead.
      * @param[in] key The key to use for the HMAC operation.
      * @param[in] key_length The length of \p key.
      * @param[in] data The data on which the operation will take place.
@@ -27,7 +58,13 @@ extern "C"
                                   uint8_t *output_buffer,
                                   uint32_t output_buffer_length,
                                   uint32_t *bytes_copied);
+
+    /**
+     * @brief Get the crypto statistics.
+     * @param[out] statistics Statistics since @ref crypto_init.
+     */
+    void crypto_get_statistics(crypto_statistics_t *statistics);
 #endif
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
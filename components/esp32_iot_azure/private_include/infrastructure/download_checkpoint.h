@@ -0,0 +1,47 @@
+#ifndef __ESP32_IOT_AZURE_INFRA_DOWNLOAD_CHECKPOINT_H__
+#define __ESP32_IOT_AZURE_INFRA_DOWNLOAD_CHECKPOINT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mbedtls/sha256.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Progress of an image download, kept across reboots.
+     * @details Stored in NVS on the device and in memory on the Linux host.
+     */
+    typedef struct
+    {
+        uint8_t update_id[32];             /** @brief SHA-256 of the update identity: provider, name, version and file hash. */
+        uint32_t location;                 /** @brief Partition the image is written to. */
+        uint32_t offset;                   /** @brief Image bytes written to flash. */
+        bool has_hash_state;               /** @brief Whether \p hash_state holds the hash of the first \p offset bytes. */
+        mbedtls_sha256_context hash_state; /** @brief Hash of the first \p offset bytes. */
+    } download_checkpoint_t;
+
+    /**
+     * @brief Load the saved checkpoint.
+     * @param[out] checkpoint Pointer to where to store the checkpoint.
+     * @return true if there is a checkpoint; false otherwise.
+     */
+    bool download_checkpoint_load(download_checkpoint_t *checkpoint);
+
+    /**
+     * @brief Save a checkpoint, replacing the one saved.
+     * @param[in] checkpoint Checkpoint to save.
+     * @return true on success; false otherwise.
+     */
+    bool download_checkpoint_save(const download_checkpoint_t *checkpoint);
+
+    /**
+     * @brief Delete the saved checkpoint.
+     */
+    void download_checkpoint_clear();
+#endif
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,77 @@
+#ifndef __ESP32_IOT_AZURE_INFRA_FLASH_WRITER_H__
+#define __ESP32_IOT_AZURE_INFRA_FLASH_WRITER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "azure_iot_flash_platform.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @typedef flash_writer_t
+     * @brief Writes image blocks to flash on a dedicated task.
+     * @details Blocks are copied to one of a ring of buffers and written, in order,
+     * by the writer task: the caller can receive the next block while the previous
+     * one is erased and programmed. When every buffer is waiting to be written the
+     * caller blocks until one is released (back-pressure).
+     */
+    typedef struct flash_writer_t flash_writer_t;
+
+    /**
+     * @brief Writer statistics.
+     */
+    typedef struct
+    {
+        uint32_t blocks;         /** @brief Blocks written. */
+        uint32_t stalls;         /** @brief Times the caller waited for a free buffer. */
+        uint32_t stalled_ms;     /** @brief Time, in milliseconds, the caller waited for a free buffer. */
+        uint32_t flash_write_ms; /** @brief Time, in milliseconds, spent writing to flash. */
+    } flash_writer_statistics_t;
+
+    /**
+     * @brief Create a writer and start its task.
+     * @note The writer must be released by @ref flash_writer_free.
+     * @param[in] image Image to write to. Must remain in memory while the writer exists.
+     * @param[in] block_size Maximum block size.
+     * @param[in] buffers_count Number of buffers, each of \p block_size bytes.
+     * @return @ref flash_writer_t on success or null on failure.
+     */
+    flash_writer_t *flash_writer_create(AzureADUImage_t *image, uint32_t block_size, uint8_t buffers_count);
+
+    /**
+     * @brief Queue a block to be written.
+     * @note Blocks until a buffer is free.
+     * @param[in] writer Writer context.
+     * @param[in] offset Image offset where the block will be written.
+     * @param[in] block Block bytes. Copied.
+     * @param[in] block_length Length of \p block.
+     * @return false if a previous write failed or the block is too big; true otherwise.
+     */
+    bool flash_writer_write(flash_writer_t *writer, uint32_t offset, const uint8_t *block, uint32_t block_length);
+
+    /**
+     * @brief Wait until all queued blocks are written.
+     * @param[in] writer Writer context.
+     * @return true if all blocks were written; false otherwise.
+     */
+    bool flash_writer_flush(flash_writer_t *writer);
+
+    /**
+     * @brief Get the writer statistics.
+     * @param[in] writer Writer context.
+     */
+    const flash_writer_statistics_t *flash_writer_get_statistics(const flash_writer_t *writer);
+
+    /**
+     * @brief Stop the writer task and free the writer.
+     * @note Blocks queued and not yet written are discarded.
+     * @param[in] writer Writer context.
+     */
+    void flash_writer_free(flash_writer_t *writer);
+#endif
+#ifdef __cplusplus
+}
+#endif
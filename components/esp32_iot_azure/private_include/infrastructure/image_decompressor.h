@@ -0,0 +1,81 @@
+#ifndef __ESP32_IOT_AZURE_INFRA_IMAGE_DECOMPRESSOR_H__
+#define __ESP32_IOT_AZURE_INFRA_IMAGE_DECOMPRESSOR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @typedef image_decompressor_t
+     * @brief Streaming decompressor of heatshrink (LZSS) compressed images.
+     * @details Compressed bytes are fed as they are downloaded, in any split. The
+     * decompressed bytes are gathered on an output buffer and handed over in blocks
+     * of its size. RAM used is the window (2 ^ window bits) plus the output buffer,
+     * whatever the image size.
+     * @note The window and lookahead bits must be the ones the image was compressed
+     * with: heatshrink -e -w <window bits> -l <lookahead bits>.
+     */
+    typedef struct image_decompressor_t image_decompressor_t;
+
+    /**
+     * @brief Called with each decompressed block.
+     * @param[in] block Decompressed bytes. Only valid during the call.
+     * @param[in] block_length Length of \p block.
+     * @param[in] offset Offset of \p block in the decompressed image.
+     * @param[in] callback_context Context given to @ref image_decompressor_create.
+     * @return true to continue; false to abort the decompression.
+     */
+    typedef bool (*image_decompressor_output_t)(uint8_t *block, uint32_t block_length, uint32_t offset, void *callback_context);
+
+    /**
+     * @brief Create a decompressor.
+     * @note The decompressor must be released by @ref image_decompressor_free.
+     * @param[in] window_bits Window size, in bits: 8 to 15.
+     * @param[in] lookahead_bits Lookahead size, in bits: 3 to \p window_bits - 1.
+     * @param[in] block_size Size of the blocks handed to \p callback.
+     * @param[in] callback Called with each decompressed block.
+     * @param[in] callback_context Context passed to \p callback.
+     * @return @ref image_decompressor_t on success or null on failure.
+     */
+    image_decompressor_t *image_decompressor_create(uint8_t window_bits,
+                                                    uint8_t lookahead_bits,
+                                                    uint32_t block_size,
+                                                    image_decompressor_output_t callback,
+                                                    void *callback_context);
+
+    /**
+     * @brief Decompress the next compressed bytes.
+     * @param[in] decompressor Decompressor context.
+     * @param[in] data Compressed bytes.
+     * @param[in] data_length Length of \p data.
+     * @return false if the callback failed; true otherwise.
+     */
+    bool image_decompressor_write(image_decompressor_t *decompressor, const uint8_t *data, uint32_t data_length);
+
+    /**
+     * @brief Hand over the last, partial, block.
+     * @details Must be called after the last compressed bytes were written.
+     * @param[in] decompressor Decompressor context.
+     * @return false if the stream ended in the middle of a back-reference or the callback failed; true otherwise.
+     */
+    bool image_decompressor_finish(image_decompressor_t *decompressor);
+
+    /**
+     * @brief Get the decompressed bytes so far.
+     * @param[in] decompressor Decompressor context.
+     */
+    uint32_t image_decompressor_get_size(const image_decompressor_t *decompressor);
+
+    /**
+     * @brief Free the decompressor.
+     * @param[in] decompressor Decompressor context.
+     */
+    void image_decompressor_free(image_decompressor_t *decompressor);
+#endif
+#ifdef __cplusplus
+}
+#endif
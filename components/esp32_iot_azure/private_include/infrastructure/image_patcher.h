@@ -0,0 +1,97 @@
+#ifndef __ESP32_IOT_AZURE_INFRA_IMAGE_PATCHER_H__
+#define __ESP32_IOT_AZURE_INFRA_IMAGE_PATCHER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @brief Patch magic bytes.
+ */
+#define IMAGE_PATCHER_MAGIC "AZDL"
+
+    /**
+     * @typedef image_patcher_t
+     * @brief Streaming applier of delta patches, rebuilding an image from the old one.
+     * @details A patch is the bsdiff control, diff and extra blocks interleaved in one
+     * stream, as detools sequential patches, so it can be applied as downloaded:
+     *
+     * header: magic (4 bytes, @ref IMAGE_PATCHER_MAGIC), new image size (uint32 little endian)
+     * record: diff length (uint32 le), diff bytes, extra length (uint32 le), extra bytes, adjustment (int32 le)
+     *
+     * Each diff byte is added to the old image byte at the old offset, which then moves on;
+     * extra bytes are new, copied as is; the adjustment moves the old offset. Records repeat
+     * until the new image size is reached. The rebuilt bytes are handed over in blocks.
+     */
+    typedef struct image_patcher_t image_patcher_t;
+
+    /**
+     * @brief Called to read the old image.
+     * @param[in] offset Old image offset to read from.
+     * @param[out] buffer Where to read to.
+     * @param[in] length Bytes to read.
+     * @param[in] callback_context Context given to @ref image_patcher_create.
+     * @return true on success; false otherwise.
+     */
+    typedef bool (*image_patcher_read_t)(uint32_t offset, uint8_t *buffer, uint32_t length, void *callback_context);
+
+    /**
+     * @brief Called with each block of the new image.
+     * @param[in] block New image bytes. Only valid during the call.
+     * @param[in] block_length Length of \p block.
+     * @param[in] offset Offset of \p block in the new image.
+     * @param[in] callback_context Context given to @ref image_patcher_create.
+     * @return true to continue; false to abort the patch.
+     */
+    typedef bool (*image_patcher_output_t)(uint8_t *block, uint32_t block_length, uint32_t offset, void *callback_context);
+
+    /**
+     * @brief Create a patcher.
+     * @note The patcher must be released by @ref image_patcher_free.
+     * @param[in] block_size Size of the blocks handed to \p output.
+     * @param[in] read Called to read the old image.
+     * @param[in] output Called with each block of the new image.
+     * @param[in] callback_context Context passed to \p read and \p output.
+     * @return @ref image_patcher_t on success or null on failure.
+     */
+    image_patcher_t *image_patcher_create(uint32_t block_size,
+                                          image_patcher_read_t read,
+                                          image_patcher_output_t output,
+                                          void *callback_context);
+
+    /**
+     * @brief Apply the next patch bytes.
+     * @param[in] patcher Patcher context.
+     * @param[in] data Patch bytes.
+     * @param[in] data_length Length of \p data.
+     * @return false if the patch is invalid or a callback failed; true otherwise.
+     */
+    bool image_patcher_write(image_patcher_t *patcher, const uint8_t *data, uint32_t data_length);
+
+    /**
+     * @brief Hand over the last, partial, block.
+     * @details Must be called after the last patch bytes were written.
+     * @param[in] patcher Patcher context.
+     * @return false if the new image is incomplete or the callback failed; true otherwise.
+     */
+    bool image_patcher_finish(image_patcher_t *patcher);
+
+    /**
+     * @brief Get the new image bytes rebuilt so far.
+     * @param[in] patcher Patcher context.
+     */
+    uint32_t image_patcher_get_size(const image_patcher_t *patcher);
+
+    /**
+     * @brief Free the patcher.
+     * @param[in] patcher Patcher context.
+     */
+    void image_patcher_free(image_patcher_t *patcher);
+#endif
+#ifdef __cplusplus
+}
+#endif
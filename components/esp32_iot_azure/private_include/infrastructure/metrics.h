@@ -0,0 +1,42 @@
+#ifndef __ESP32_IOT_AZURE_INFRA_METRICS_H__
+#define __ESP32_IOT_AZURE_INFRA_METRICS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp32_iot_azure/azure_iot_metrics.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Initialize the metrics registry, with every histogram reset.
+     * @note Without it, operations are not measured.
+     * @return true on success; false otherwise.
+     */
+    bool metrics_init();
+
+    /**
+     * @brief Release the metrics registry.
+     */
+    void metrics_deinit();
+
+    /**
+     * @brief Get the monotonic time operations are measured with.
+     * @return Microseconds since an arbitrary point.
+     */
+    uint64_t metrics_get_time_us();
+
+    /**
+     * @brief Measure an operation, ended now.
+     * @note Does not allocate: safe to call on every read and write.
+     * @param[in] metric Operation.
+     * @param[in] started_at_us When the operation started, from @ref metrics_get_time_us.
+     * @param[in] failed Whether the operation failed.
+     */
+    void metrics_record(azure_iot_metric_t metric, uint64_t started_at_us, bool failed);
+#endif
+#ifdef __cplusplus
+}
+#endif
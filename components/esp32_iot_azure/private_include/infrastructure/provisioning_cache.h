@@ -0,0 +1,54 @@
+#ifndef __ESP32_IOT_AZURE_INFRA_PROVISIONING_CACHE_H__
+#define __ESP32_IOT_AZURE_INFRA_PROVISIONING_CACHE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp32_iot_azure/azure_iot_common.h"
+
+#define PROVISIONING_CACHE_SCOPE_ID_MAX_LENGTH 32U
+#define PROVISIONING_CACHE_REGISTRATION_ID_MAX_LENGTH 128U
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Result of the last DPS registration, kept across reboots.
+     * @details Stored in NVS on the device and in memory on the Linux host.
+     * Keyed by the scope and registration id it was registered with.
+     */
+    typedef struct
+    {
+        uint8_t scope_id[PROVISIONING_CACHE_SCOPE_ID_MAX_LENGTH];
+        uint16_t scope_id_length;
+        uint8_t registration_id[PROVISIONING_CACHE_REGISTRATION_ID_MAX_LENGTH];
+        uint16_t registration_id_length;
+        uint8_t hostname[AZURE_CONST_HOSTNAME_MAX_LENGTH]; /** @brief Assigned IoT Hub hostname. */
+        uint16_t hostname_length;
+        uint8_t device_id[AZURE_CONST_DEVICE_ID_MAX_LENGTH]; /** @brief Assigned device id. */
+        uint16_t device_id_length;
+    } provisioning_cache_t;
+
+    /**
+     * @brief Load the saved registration.
+     * @param[out] cache Pointer to where to store the registration.
+     * @return true if there is a registration; false otherwise.
+     */
+    bool provisioning_cache_load(provisioning_cache_t *cache);
+
+    /**
+     * @brief Save a registration, replacing the one saved.
+     * @param[in] cache Registration to save.
+     * @return true on success; false otherwise.
+     */
+    bool provisioning_cache_save(const provisioning_cache_t *cache);
+
+    /**
+     * @brief Delete the saved registration.
+     */
+    void provisioning_cache_clear();
+#endif
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,89 @@
+#ifndef __ESP32_IOT_AZURE_INFRA_RECONNECT_POLICY_H__
+#define __ESP32_IOT_AZURE_INFRA_RECONNECT_POLICY_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Decision of @ref reconnect_policy_acquire.
+     */
+    typedef enum
+    {
+        RECONNECT_POLICY_ATTEMPT = 0, /** @brief Connect now. */
+        RECONNECT_POLICY_WAIT = 1     /** @brief Circuit open: do not connect before the wait elapses. */
+    } reconnect_policy_decision_t;
+
+    /**
+     * @brief Reconnection statistics, of every server.
+     */
+    typedef struct
+    {
+        uint32_t attempts;      /** @brief Connection attempts allowed. */
+        uint32_t failures;      /** @brief Connection attempts failed. */
+        uint32_t circuit_opens; /** @brief Circuits opened, by repeated failures or a failed probe. */
+        uint32_t rejected;      /** @brief Connection attempts refused while a circuit was open. */
+        uint32_t network_down;  /** @brief Connection attempts skipped for the network being down. */
+    } reconnect_policy_statistics_t;
+
+    /**
+     * @brief Initialize the reconnect policy.
+     * @details Keeps the state of each server (hostname and port): the decorrelated
+     * jitter delay and a circuit breaker. After
+     * `CONFIG_ESP32_IOT_AZURE_TRANSPORT_CIRCUIT_BREAKER_THRESHOLD` consecutive failures
+     * the circuit opens: attempts are refused for
+     * `CONFIG_ESP32_IOT_AZURE_TRANSPORT_CIRCUIT_BREAKER_OPEN_MS`, then a single probe
+     * is allowed (half-open). It closes the circuit on success, and opens it again on failure.
+     * @note Without it, every attempt is allowed and delays are not kept.
+     * @return true on success; false otherwise.
+     */
+    bool reconnect_policy_init();
+
+    /**
+     * @brief Release the reconnect policy, forgetting the state of every server.
+     */
+    void reconnect_policy_deinit();
+
+    /**
+     * @brief Ask whether to connect to a server.
+     * @param[in] hostname Server address. Must be null-terminated.
+     * @param[in] port Server port.
+     * @param[out] wait_ms Milliseconds until the next attempt is allowed, on @ref RECONNECT_POLICY_WAIT.
+     * @return @ref reconnect_policy_decision_t with the decision.
+     */
+    reconnect_policy_decision_t reconnect_policy_acquire(const char *hostname, uint16_t port, uint32_t *wait_ms);
+
+    /**
+     * @brief Report a failed connection to a server, allowed by @ref reconnect_policy_acquire.
+     * @param[in] hostname Server address. Must be null-terminated.
+     * @param[in] port Server port.
+     * @return Milliseconds to wait before the next attempt: a decorrelated jitter delay.
+     */
+    uint32_t reconnect_policy_failed(const char *hostname, uint16_t port);
+
+    /**
+     * @brief Report a connection to a server, allowed by @ref reconnect_policy_acquire: closes its circuit.
+     * @param[in] hostname Server address. Must be null-terminated.
+     * @param[in] port Server port.
+     */
+    void reconnect_policy_succeeded(const char *hostname, uint16_t port);
+
+    /**
+     * @brief Count an attempt skipped for the network being down.
+     * @note Not a failure of the server: its circuit is left as is.
+     */
+    void reconnect_policy_count_network_down();
+
+    /**
+     * @brief Get the reconnection statistics.
+     * @param[out] statistics Statistics since @ref reconnect_policy_init.
+     */
+    void reconnect_policy_get_statistics(reconnect_policy_statistics_t *statistics);
+#endif
+#ifdef __cplusplus
+}
+#endif
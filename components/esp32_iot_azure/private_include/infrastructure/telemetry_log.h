@@ -0,0 +1,134 @@
+#ifndef __ESP32_IOT_AZURE_INFRA_TELEMETRY_LOG_H__
+#define __ESP32_IOT_AZURE_INFRA_TELEMETRY_LOG_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @typedef telemetry_log_t
+     * @brief Ring log of telemetry messages, persisted to a flash partition.
+     * @details The partition is split in sectors written in turn, each one erased only
+     * when the log wraps around to it: all sectors wear the same. Records are written
+     * once and marked consumed in place, by clearing bits of their header.
+     * When the log is full, the oldest sector is erased and its records dropped.
+     * @details Stored in the `CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_PARTITION_LABEL`
+     * partition on the device and in memory on the Linux host.
+     * @note Not thread safe. A partition must be opened by one log at a time.
+     */
+    typedef struct telemetry_log_t telemetry_log_t;
+
+    /**
+     * @brief Position on the log, to read records after the oldest pending one.
+     */
+    typedef struct
+    {
+        uint32_t sequence; /** @brief Sequence of the sector; stale when the sector is erased. */
+        uint16_t sector;   /** @brief Sector index. */
+        uint16_t offset;   /** @brief Offset inside the sector. */
+    } telemetry_log_cursor_t;
+
+    /**
+     * @brief Record read from the log.
+     */
+    typedef struct
+    {
+        telemetry_log_cursor_t position; /** @brief Where the record is, to consume it. */
+        uint8_t qos;                     /** @brief MQTT QoS to send with. */
+        uint32_t expires_at;             /** @brief Unix time the record expires at; 0 if never. */
+        uint16_t properties_length;      /** @brief Properties bytes, read first. */
+        uint16_t payload_length;         /** @brief Payload bytes, read after the properties. */
+    } telemetry_log_record_t;
+
+    /**
+     * @brief Log counters.
+     */
+    typedef struct
+    {
+        uint32_t pending; /** @brief Records written and not consumed. */
+        uint32_t dropped; /** @brief Records erased before being consumed, since opened. */
+    } telemetry_log_statistics_t;
+
+    /**
+     * @brief Open the log, recovering the records pending from a previous boot.
+     * @note The log must be released by @ref telemetry_log_close.
+     * @return @ref telemetry_log_t on success or null on failure.
+     */
+    telemetry_log_t *telemetry_log_open();
+
+    /**
+     * @brief Largest properties plus payload length a record can have.
+     */
+    size_t telemetry_log_get_record_max_length();
+
+    /**
+     * @brief Write a record at the end of the log.
+     * @details Erases the oldest sector when there is no room, dropping its pending records.
+     * @param[in] log Log context.
+     * @param[in] qos MQTT QoS to send with.
+     * @param[in] expires_at Unix time the record expires at; 0 if never.
+     * @param[in] properties Serialized message properties. Can be `NULL` if \p properties_length is 0.
+     * @param[in] properties_length Properties length.
+     * @param[in] payload Payload.
+     * @param[in] payload_length Payload length.
+     * @return true on success; false otherwise.
+     */
+    bool telemetry_log_append(telemetry_log_t *log,
+                              uint8_t qos,
+                              uint32_t expires_at,
+                              const uint8_t *properties,
+                              uint16_t properties_length,
+                              const uint8_t *payload,
+                              uint16_t payload_length);
+
+    /**
+     * @brief Set a cursor on the oldest pending record.
+     * @param[in] log Log context.
+     * @param[out] cursor Cursor to set.
+     */
+    void telemetry_log_rewind(telemetry_log_t *log, telemetry_log_cursor_t *cursor);
+
+    /**
+     * @brief Read the pending record on a cursor, moving it to the next one.
+     * @details A cursor on an erased sector is moved to the oldest pending record.
+     * @param[in] log Log context.
+     * @param[in,out] cursor Cursor to read from.
+     * @param[out] record Record read.
+     * @param[out] data Where to read the properties followed by the payload.
+     * Must have room for @ref telemetry_log_get_record_max_length bytes.
+     * @return true if a record was read; false if there are no more pending records.
+     */
+    bool telemetry_log_read(telemetry_log_t *log,
+                            telemetry_log_cursor_t *cursor,
+                            telemetry_log_record_t *record,
+                            uint8_t *data);
+
+    /**
+     * @brief Mark a record as consumed, to not be read again.
+     * @note Records on erased sectors were dropped already and are ignored.
+     * @param[in] log Log context.
+     * @param[in] record Record to consume.
+     */
+    void telemetry_log_consume(telemetry_log_t *log, const telemetry_log_record_t *record);
+
+    /**
+     * @brief Get the log counters.
+     * @param[in] log Log context.
+     * @param[out] statistics Where to write the counters.
+     */
+    void telemetry_log_get_statistics(const telemetry_log_t *log, telemetry_log_statistics_t *statistics);
+
+    /**
+     * @brief Release the log. Pending records are kept on flash.
+     * @param[in] log Log context.
+     */
+    void telemetry_log_close(telemetry_log_t *log);
+#endif
+#ifdef __cplusplus
+}
+#endif
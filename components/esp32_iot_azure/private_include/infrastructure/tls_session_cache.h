@@ -0,0 +1,72 @@
+#ifndef __ESP32_IOT_AZURE_INFRA_TLS_SESSION_CACHE_H__
+#define __ESP32_IOT_AZURE_INFRA_TLS_SESSION_CACHE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "infrastructure/transport.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief TLS handshake statistics.
+     * @note Handshakes offering a session through a driver that cannot tell
+     * whether the server accepted it are not counted.
+     */
+    typedef struct
+    {
+        uint32_t full_handshakes;    /** @brief Handshakes without a session to offer, or refused by the server. */
+        uint32_t resumed_handshakes; /** @brief Handshakes resuming a cached session. */
+        uint32_t evictions;          /** @brief Sessions dropped to make room for another server. */
+    } tls_session_statistics_t;
+
+    /**
+     * @brief Initialize the TLS session cache.
+     * @note Without it, sessions are not cached and handshakes are not counted.
+     * @return true on success; false otherwise.
+     */
+    bool tls_session_cache_init();
+
+    /**
+     * @brief Release the TLS session cache, and the sessions in it.
+     */
+    void tls_session_cache_deinit();
+
+    /**
+     * @brief Take the session of a server out of the cache.
+     * @details Taken, not shared: the session is owned by the caller, to offer it on
+     * a connection while other transports replace the cached one.
+     * @param[in] driver Driver that created the session.
+     * @param[in] hostname Server address. Must be null-terminated.
+     * @param[in] port Server port.
+     * @return The session, to release with the driver `session_free`; `NULL` if none.
+     */
+    void *tls_session_cache_take(const transport_driver_t *driver, const char *hostname, uint16_t port);
+
+    /**
+     * @brief Keep the session of a server, replacing the cached one.
+     * @details Replaces the least recently used server when the cache is full.
+     * @param[in] driver Driver that created the session.
+     * @param[in] hostname Server address. Must be null-terminated.
+     * @param[in] port Server port.
+     * @param[in] session Session to keep, owned by the cache from now on. Can be `NULL`.
+     */
+    void tls_session_cache_put(const transport_driver_t *driver, const char *hostname, uint16_t port, void *session);
+
+    /**
+     * @brief Count a TLS handshake.
+     * @param[in] resumed Whether the handshake resumed a cached session.
+     */
+    void tls_session_cache_count_handshake(bool resumed);
+
+    /**
+     * @brief Get the TLS handshake statistics.
+     * @param[out] statistics Statistics since @ref tls_session_cache_init.
+     */
+    void tls_session_cache_get_statistics(tls_session_statistics_t *statistics);
+#endif
+#ifdef __cplusplus
+}
+#endif
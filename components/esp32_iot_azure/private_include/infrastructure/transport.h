@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 #include "esp32_iot_azure/azure_iot_common.h"
 
 #ifdef __cplusplus
@@ -22,7 +23,8 @@ extern "C"
     typedef enum
     {
         TLS_CERT_FORMAT_PEM = 0,
-        TLS_CERT_FORMAT_DER = 1
+        TLS_CERT_FORMAT_DER = 1,
+        TLS_CERT_FORMAT_X509 = 2 /** @brief Parsed chain: `data` points to a `mbedtls_x509_crt`, `length` is unused. */
     } tls_certificate_format_t;
 
     /**
@@ -30,7 +32,7 @@ extern "C"
      */
     typedef struct
     {
-        const uint8_t *data;             /** @brief Certificate bytes. */
+        const uint8_t *data;             /** @brief Certificate bytes, or chain. */
         tls_certificate_format_t format; /** @brief Certificate format. */
         uint16_t length;                 /** @brief Certificate bytes length. */
     } tls_certificate_t;
@@ -44,6 +46,77 @@ extern "C"
         TRANSPORT_STATUS_FAILURE = 1
     } transport_status_t;
 
+    /**
+     * @brief Result of @ref transport_wait.
+     */
+    typedef enum
+    {
+        TRANSPORT_WAIT_TIMEOUT = 0,    /** @brief Nothing happened before the timeout. */
+        TRANSPORT_WAIT_READABLE = 1,   /** @brief Bytes are ready to be read. */
+        TRANSPORT_WAIT_WOKEN = 2,      /** @brief Woken by @ref transport_wake. */
+        TRANSPORT_WAIT_FAILURE = 3,    /** @brief The connection failed. */
+        TRANSPORT_WAIT_UNSUPPORTED = 4 /** @brief The driver cannot wait: read, blocking for the read timeout. */
+    } transport_wait_result_t;
+
+    /**
+     * @typedef transport_driver_t
+     * @brief Operations backing every @ref transport_t.
+     * @details Decouples the transport logic (reconnection, back-off) from the
+     * network stack: ESP transport on device, POSIX sockets on the Linux host,
+     * or any in-memory implementation used by tests and benchmarks.
+     * @note Functions returning @ref int32_t follow the same contract as
+     * @ref transport_write and @ref transport_read.
+     */
+    typedef struct
+    {
+        /** @brief Create a driver handle. \p certificate is `NULL` for raw TCP transports. */
+        void *(*create)(const tls_certificate_t *certificate, void *driver_context);
+        /** @brief Configure a TLS handle with a client certificate. Can be `NULL` if not supported. */
+        transport_status_t (*set_client_certificate)(void *handle, const client_certificate_t *certificate);
+        /** @brief Copy the TLS session of the last connection, released by \p session_free; `NULL` if none. Can be `NULL` if not supported. */
+        void *(*session_get)(void *handle);
+        /** @brief Offer a session, from \p session_get, on the next connections; `NULL` to stop. Can be `NULL` if not supported. */
+        void (*session_set)(void *handle, void *session);
+        /** @brief Release a session from \p session_get. Can be `NULL` if not supported. */
+        void (*session_free)(void *session);
+        /** @brief Whether the server resumed the offered session on the last connection. Can be `NULL` if the driver cannot tell. */
+        bool (*session_resumed)(void *handle);
+        /** @brief Establish a connection to a server. */
+        transport_status_t (*connect)(void *handle, const char *hostname, uint16_t port, uint16_t timeout_ms);
+        /** @brief Write bytes; returns the number of bytes written or (-1) on error. */
+        int32_t (*write)(void *handle, const uint8_t *buffer, size_t length, uint16_t timeout_ms);
+        /** @brief Read bytes; returns the number of bytes read, 0 on timeout or (-1) on error. */
+        int32_t (*read)(void *handle, uint8_t *buffer, size_t length, uint16_t timeout_ms);
+        /** @brief Wait until bytes are readable, \p wake is called or the timeout elapses. Can be `NULL` if not supported. */
+        transport_wait_result_t (*wait)(void *handle, uint32_t timeout_ms);
+        /** @brief Wake the \p wait in progress, or the next one; called from any task. Can be `NULL` if not supported. */
+        void (*wake)(void *handle);
+        /** @brief Close the connection. */
+        transport_status_t (*close)(void *handle);
+        /** @brief Get the last socket error (errno) of the handle. */
+        int (*get_errno)(void *handle);
+        /** @brief Release the handle. */
+        void (*destroy)(void *handle);
+        /** @brief Whether a network interface is up with an address. Can be `NULL` if the network is always assumed up. */
+        bool (*is_network_up)(void *driver_context);
+        /** @brief Context passed back to \p create. */
+        void *context;
+    } transport_driver_t;
+
+    /**
+     * @brief Get the platform default driver.
+     * @return ESP transport on device, POSIX sockets on the Linux host.
+     */
+    const transport_driver_t *transport_driver_get_default();
+
+    /**
+     * @brief Replace the driver used by transports created from now on.
+     * @note Transports already created keep the driver they were created with.
+     * @param[in] driver Driver to use. `NULL` restores the platform default.
+     * Must remain in memory as long as there are transports using it.
+     */
+    void transport_set_driver(const transport_driver_t *driver);
+
     /**
      * @brief Creates a raw TCP transport.
      * @note The transport context must be released by @ref transport_free.
@@ -75,6 +148,19 @@ extern "C"
     transport_status_t transport_set_client_certificate(transport_t *transport,
                                                         const client_certificate_t *certificate);
 
+    /**
+     * @brief Resume TLS sessions on connections.
+     * @details The session of each handshake is kept in the TLS session cache, per
+     * hostname and port, and offered on the next connection to the same server, by
+     * this transport or any other: the server can resume it with an abbreviated
+     * handshake, saving the certificate exchange and the key agreement.
+     * @note The transport must be a TLS one. Call before @ref transport_connect.
+     * Sessions are only cached after @ref tls_session_cache_init.
+     * @param[in] transport Transport context.
+     * @return @ref transport_status_t with the result of the operation.
+     */
+    transport_status_t transport_enable_session_reuse(transport_t *transport);
+
     /**
      * @brief Establish a connection to a server.
      * @note The connection must be closed by @ref transport_disconnect.
@@ -114,6 +200,31 @@ extern "C"
                            size_t expected_length,
                            uint16_t timeout_ms);
 
+    /**
+     * @brief Wait for bytes to read, without reading them.
+     * @details Sleeps on the socket, and on the wake-up event of @ref transport_wake,
+     * instead of blocking on a read: the task wakes as soon as there is something
+     * to do, and the CPU idles meanwhile.
+     * @param[in] transport Transport context.
+     * @param[in] timeout_ms Maximum time to wait, in milliseconds.
+     * @return @ref transport_wait_result_t with what ended the wait.
+     */
+    transport_wait_result_t transport_wait(transport_t *transport, uint32_t timeout_ms);
+
+    /**
+     * @brief Wake the task waiting on @ref transport_wait; if none, the next wait returns right away.
+     * @note Can be called from any task.
+     * @param[in] transport Transport context.
+     */
+    void transport_wake(transport_t *transport);
+
+    /**
+     * @brief Get the time since bytes were last written, like to know when a keep-alive is due.
+     * @param[in] transport Transport context.
+     * @return Milliseconds since the last write, or since connected.
+     */
+    uint32_t transport_get_idle_ms(const transport_t *transport);
+
     /**
      * @brief Close a connection to the server.
      * @param[in] transport Transport context.
@@ -4,6 +4,10 @@
 #include "esp32_iot_azure/extension/azure_iot_adu_extension.h"
 #include "esp32_iot_azure/extension/azure_iot_http_client_extension.h"
 #include "infrastructure/azure_adu_root_key.h"
+#include "infrastructure/download_checkpoint.h"
+#include "infrastructure/flash_writer.h"
+#include "infrastructure/image_decompressor.h"
+#include "infrastructure/image_patcher.h"
 #include "azure_iot_flash_platform.h"
 #include "config.h"
 #include "log.h"
@@ -17,20 +21,51 @@ static AzureIoTResult_t azure_adu_workflow_download_and_enable_image(azure_adu_w
                                                                      uint16_t chunk_size,
                                                                      azure_adu_workflow_download_progress_callback_t callback,
                                                                      void *callback_context);
+static AzureIoTResult_t azure_adu_workflow_download_image(azure_adu_workflow_t *context,
+                                                          AzureADUImage_t *image,
+                                                          buffer_t *download_buffer,
+                                                          uint16_t chunk_size,
+                                                          azure_adu_workflow_download_progress_callback_t callback,
+                                                          void *callback_context);
 static AzureIoTResult_t azure_adu_workflow_send_update_results(azure_adu_workflow_t *context);
+#if CONFIG_ESP32_IOT_AZURE_DU_RESUME_ENABLED
+static uint32_t azure_adu_workflow_resume_image(const azure_adu_workflow_t *context, AzureADUImage_t *image, download_checkpoint_t *checkpoint);
+static void azure_adu_workflow_get_update_id(const azure_adu_workflow_t *context, uint8_t *update_id);
+#endif
+#if CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_ENABLED || CONFIG_ESP32_IOT_AZURE_DU_DELTA_ENABLED
+static uint32_t azure_adu_workflow_strip_extension(const uint8_t *file_name, uint32_t file_name_length, const char *extension);
+#endif
 static bool download_callback_write_to_flash(uint8_t *data,
                                              uint32_t data_length,
                                              uint32_t current_offset,
                                              uint32_t resource_size,
                                              void *callback_context);
+static bool download_write_block(uint8_t *block,
+                                 uint32_t block_length,
+                                 uint32_t offset,
+                                 void *callback_context);
+static bool download_patch_block(uint8_t *block,
+                                 uint32_t block_length,
+                                 uint32_t offset,
+                                 void *callback_context);
+static bool download_read_running_image(uint32_t offset,
+                                        uint8_t *buffer,
+                                        uint32_t length,
+                                        void *callback_context);
 typedef struct
 {
     azure_adu_workflow_t *context;
     AzureADUImage_t *image;
+    flash_writer_t *writer;
+    image_decompressor_t *decompressor;
+    image_patcher_t *patcher;
+    download_checkpoint_t *checkpoint;
     azure_adu_workflow_download_progress_callback_t callback;
     void *callback_context;
 } download_callback_context_t;
 
+static bool download_save_checkpoint(download_callback_context_t *context, uint32_t offset);
+
 struct azure_adu_workflow_t
 {
     AzureIoTADUUpdateRequest_t update_request;
@@ -248,6 +283,11 @@ static AzureIoTResult_t azure_adu_workflow_cancel_update(azure_adu_workflow_t *c
 {
     context->has_update = false;
 
+#if CONFIG_ESP32_IOT_AZURE_DU_RESUME_ENABLED
+    // What was downloaded of a cancelled update is of no use.
+    download_checkpoint_clear();
+#endif
+
     AzureIoTResult_t result = eAzureIoTSuccess;
 
     if ((result = azure_adu_send_agent_state(context->adu_context,
@@ -294,7 +334,6 @@ static AzureIoTResult_t azure_adu_workflow_download_and_enable_image(azure_adu_w
                                                                      azure_adu_workflow_download_progress_callback_t callback,
                                                                      void *callback_context)
 {
-    parsed_file_url_t parsed_url;
     AzureADUImage_t image;
     AzureIoTResult_t result;
 
@@ -304,6 +343,49 @@ static AzureIoTResult_t azure_adu_workflow_download_and_enable_image(azure_adu_w
         return eAzureIoTErrorFailed;
     }
 
+    if ((result = azure_adu_workflow_download_image(context, &image, download_buffer, chunk_size, callback, callback_context)) != eAzureIoTSuccess)
+    {
+        // The checkpoint is kept: the next attempt resumes from it.
+        CMP_LOGE(TAG_AZ_ADU_WKF, "failure downloading image: %d", result);
+        AzureIoTPlatform_AbortImage(&image);
+        return eAzureIoTErrorFailed;
+    }
+
+    result = AzureIoTPlatform_VerifyImage(&image,
+                                          context->update_request.xUpdateManifest.pxFiles[0].pxHashes[0].pucHash,
+                                          context->update_request.xUpdateManifest.pxFiles[0].pxHashes[0].ulHashLength);
+
+#if CONFIG_ESP32_IOT_AZURE_DU_RESUME_ENABLED
+    // Either done or corrupted: the next attempt starts over.
+    download_checkpoint_clear();
+#endif
+
+    if (result != eAzureIoTSuccess)
+    {
+        CMP_LOGE(TAG_AZ_ADU_WKF, "failure validating image: %d", result);
+        return eAzureIoTErrorFailed;
+    }
+
+    if ((result = AzureIoTPlatform_EnableImage(&image)) != eAzureIoTSuccess)
+    {
+        CMP_LOGE(TAG_AZ_ADU_WKF, "failure enabling image: %d", result);
+        return eAzureIoTErrorFailed;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+static AzureIoTResult_t azure_adu_workflow_download_image(azure_adu_workflow_t *context,
+                                                          AzureADUImage_t *image,
+                                                          buffer_t *download_buffer,
+                                                          uint16_t chunk_size,
+                                                          azure_adu_workflow_download_progress_callback_t callback,
+                                                          void *callback_context)
+{
+    parsed_file_url_t parsed_url;
+    AzureIoTResult_t result;
+    uint32_t start_offset = 0;
+
     if ((result = azure_adu_file_parse_url(&context->update_request.pxFileUrls[0],
                                            context->scratch_buffer->buffer,
                                            &parsed_url)) != eAzureIoTSuccess)
@@ -314,37 +396,134 @@ static AzureIoTResult_t azure_adu_workflow_download_and_enable_image(azure_adu_w
 
     download_callback_context_t download_context = {
         .context = context,
-        .image = &image,
+        .image = image,
+        .writer = NULL,
+        .decompressor = NULL,
+        .patcher = NULL,
+        .checkpoint = NULL,
         .callback = callback,
         .callback_context = callback_context};
 
-    if ((result = azure_adu_file_download(&parsed_url,
-                                          download_buffer->buffer,
-                                          download_buffer->length,
-                                          chunk_size,
-                                          &download_callback_write_to_flash,
-                                          &download_context,
-                                          &image.image_size)) != eAzureIoTSuccess)
+#if CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_ENABLED || CONFIG_ESP32_IOT_AZURE_DU_DELTA_ENABLED
+    // Extensions, from the last: "firmware.bin.delta.hs" is a compressed delta.
+    const uint8_t *file_name = context->update_request.xUpdateManifest.pxFiles[0].pucFileName;
+    uint32_t file_name_length = context->update_request.xUpdateManifest.pxFiles[0].ulFileNameLength;
+#endif
+
+#if CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_ENABLED
+    uint32_t stripped_length = azure_adu_workflow_strip_extension(file_name, file_name_length, CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_FILE_EXTENSION);
+    bool is_compressed = stripped_length != file_name_length;
+
+    file_name_length = stripped_length;
+#endif
+
+#if CONFIG_ESP32_IOT_AZURE_DU_DELTA_ENABLED
+    bool is_delta = azure_adu_workflow_strip_extension(file_name, file_name_length, CONFIG_ESP32_IOT_AZURE_DU_DELTA_FILE_EXTENSION) != file_name_length;
+
+    // Rebuilt into chunk sized blocks from the running image.
+    if (is_delta &&
+        (download_context.patcher = image_patcher_create(chunk_size,
+                                                         &download_read_running_image,
+                                                         &download_write_block,
+                                                         &download_context)) == NULL)
     {
-        CMP_LOGE(TAG_AZ_ADU_WKF, "failure downloading image: %d", result);
+        CMP_LOGE(TAG_AZ_ADU_WKF, "failure creating patcher");
         return eAzureIoTErrorFailed;
     }
-
-    if ((result = AzureIoTPlatform_VerifyImage(&image,
-                                               context->update_request.xUpdateManifest.pxFiles[0].pxHashes[0].pucHash,
-                                               context->update_request.xUpdateManifest.pxFiles[0].pxHashes[0].ulHashLength)) != eAzureIoTSuccess)
+#endif
+
+#if CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_ENABLED
+    // Decompressed into chunk sized blocks: written, or patched, as an uncompressed download would be.
+    if (is_compressed &&
+        (download_context.decompressor = image_decompressor_create(CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_WINDOW_BITS,
+                                                                   CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_LOOKAHEAD_BITS,
+                                                                   chunk_size,
+                                                                   download_context.patcher != NULL ? &download_patch_block : &download_write_block,
+                                                                   &download_context)) == NULL)
     {
-        CMP_LOGE(TAG_AZ_ADU_WKF, "failure validating image: %d", result);
+        CMP_LOGE(TAG_AZ_ADU_WKF, "failure creating decompressor");
+        image_patcher_free(download_context.patcher);
         return eAzureIoTErrorFailed;
     }
+#endif
 
-    if ((result = AzureIoTPlatform_EnableImage(&image)) != eAzureIoTSuccess)
+#if CONFIG_ESP32_IOT_AZURE_DU_RESUME_ENABLED
+    download_checkpoint_t checkpoint;
+
+    // The decompressor and patcher states are not saved: those downloads start over.
+    if (download_context.decompressor == NULL && download_context.patcher == NULL)
     {
-        CMP_LOGE(TAG_AZ_ADU_WKF, "failure enabling image: %d", result);
-        return eAzureIoTErrorFailed;
+        start_offset = azure_adu_workflow_resume_image(context, image, &checkpoint);
+
+        download_context.checkpoint = &checkpoint;
     }
+#endif
 
-    return eAzureIoTSuccess;
+#if CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_ENABLED
+    if ((download_context.writer = flash_writer_create(image, chunk_size, CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_BUFFERS)) == NULL)
+    {
+        CMP_LOGW(TAG_AZ_ADU_WKF, "failure creating flash writer: writing on the download");
+    }
+#endif
+
+    result = azure_adu_file_download(&parsed_url,
+                                     download_buffer->buffer,
+                                     download_buffer->length,
+                                     chunk_size,
+                                     &download_callback_write_to_flash,
+                                     &download_context,
+                                     start_offset,
+                                     &image->image_size,
+                                     NULL);
+
+    if (download_context.decompressor != NULL)
+    {
+        if (result == eAzureIoTSuccess && !image_decompressor_finish(download_context.decompressor))
+        {
+            CMP_LOGE(TAG_AZ_ADU_WKF, "failure decompressing image");
+            result = eAzureIoTErrorFailed;
+        }
+
+        CMP_LOGI(TAG_AZ_ADU_WKF,
+                 "decompressed %lu bytes into %lu",
+                 (unsigned long)image->image_size,
+                 (unsigned long)image_decompressor_get_size(download_context.decompressor));
+
+        image_decompressor_free(download_context.decompressor);
+    }
+
+    if (download_context.patcher != NULL)
+    {
+        if (result == eAzureIoTSuccess && !image_patcher_finish(download_context.patcher))
+        {
+            CMP_LOGE(TAG_AZ_ADU_WKF, "failure patching image");
+            result = eAzureIoTErrorFailed;
+        }
+
+        CMP_LOGI(TAG_AZ_ADU_WKF, "patched image: %lu bytes", (unsigned long)image_patcher_get_size(download_context.patcher));
+
+        image_patcher_free(download_context.patcher);
+    }
+
+    if (download_context.writer != NULL)
+    {
+        if (!flash_writer_flush(download_context.writer) && result == eAzureIoTSuccess)
+        {
+            CMP_LOGE(TAG_AZ_ADU_WKF, "failure writing image");
+            result = eAzureIoTErrorFailed;
+        }
+
+        const flash_writer_statistics_t *writer_statistics = flash_writer_get_statistics(download_context.writer);
+
+        CMP_LOGI(TAG_AZ_ADU_WKF,
+                 "flash writer: %lu ms writing, %lu ms waited by the download",
+                 (unsigned long)writer_statistics->flash_write_ms,
+                 (unsigned long)writer_statistics->stalled_ms);
+
+        flash_writer_free(download_context.writer);
+    }
+
+    return result;
 }
 
 static AzureIoTResult_t azure_adu_workflow_send_update_results(azure_adu_workflow_t *context)
@@ -385,6 +564,80 @@ static AzureIoTResult_t azure_adu_workflow_send_update_results(azure_adu_workflo
     return eAzureIoTSuccess;
 }
 
+#if CONFIG_ESP32_IOT_AZURE_DU_RESUME_ENABLED
+static uint32_t azure_adu_workflow_resume_image(const azure_adu_workflow_t *context, AzureADUImage_t *image, download_checkpoint_t *checkpoint)
+{
+    download_checkpoint_t saved;
+
+    azure_adu_workflow_get_update_id(context, checkpoint->update_id);
+
+    checkpoint->location = AzureIoTPlatform_GetImageLocation(image);
+    checkpoint->offset = 0;
+    checkpoint->has_hash_state = false;
+
+    // Only the same update, to the same partition, and not finished: a finished
+    // download was interrupted while being verified, and is verified again from scratch.
+    if (!download_checkpoint_load(&saved) ||
+        memcmp(saved.update_id, checkpoint->update_id, sizeof(saved.update_id)) != 0 ||
+        saved.location != checkpoint->location ||
+        saved.offset == 0 ||
+        saved.offset >= context->update_request.xUpdateManifest.pxFiles[0].llSizeInBytes)
+    {
+        return 0;
+    }
+
+    if (AzureIoTPlatform_ResumeImage(image, saved.offset, saved.has_hash_state ? &saved.hash_state : NULL) != eAzureIoTSuccess)
+    {
+        CMP_LOGW(TAG_AZ_ADU_WKF, "failure resuming image: downloading from the start");
+        return 0;
+    }
+
+    CMP_LOGI(TAG_AZ_ADU_WKF, "resuming download at: %lu", (unsigned long)saved.offset);
+
+    checkpoint->offset = saved.offset;
+
+    return saved.offset;
+}
+
+static void azure_adu_workflow_get_update_id(const azure_adu_workflow_t *context, uint8_t *update_id)
+{
+    mbedtls_sha256_context sha256;
+
+    mbedtls_sha256_init(&sha256);
+    mbedtls_sha256_starts(&sha256, 0);
+    mbedtls_sha256_update(&sha256,
+                          context->update_request.xUpdateManifest.xUpdateId.pucProvider,
+                          context->update_request.xUpdateManifest.xUpdateId.ulProviderLength);
+    mbedtls_sha256_update(&sha256,
+                          context->update_request.xUpdateManifest.xUpdateId.pucName,
+                          context->update_request.xUpdateManifest.xUpdateId.ulNameLength);
+    mbedtls_sha256_update(&sha256,
+                          context->update_request.xUpdateManifest.xUpdateId.pucVersion,
+                          context->update_request.xUpdateManifest.xUpdateId.ulVersionLength);
+    mbedtls_sha256_update(&sha256,
+                          context->update_request.xUpdateManifest.pxFiles[0].pxHashes[0].pucHash,
+                          context->update_request.xUpdateManifest.pxFiles[0].pxHashes[0].ulHashLength);
+    mbedtls_sha256_finish(&sha256, update_id);
+    mbedtls_sha256_free(&sha256);
+}
+#endif
+
+#if CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_ENABLED || CONFIG_ESP32_IOT_AZURE_DU_DELTA_ENABLED
+static uint32_t azure_adu_workflow_strip_extension(const uint8_t *file_name, uint32_t file_name_length, const char *extension)
+{
+    uint32_t extension_length = strlen(extension);
+
+    if (extension_length > 0 &&
+        file_name_length > extension_length &&
+        memcmp(file_name + file_name_length - extension_length, extension, extension_length) == 0)
+    {
+        return file_name_length - extension_length;
+    }
+
+    return file_name_length;
+}
+#endif
+
 static bool download_callback_write_to_flash(uint8_t *chunk,
                                              uint32_t chunk_length,
                                              uint32_t start_offset,
@@ -393,10 +646,35 @@ static bool download_callback_write_to_flash(uint8_t *chunk,
 {
     download_callback_context_t *context = (download_callback_context_t *)callback_context;
 
-    if (AzureIoTPlatform_WriteBlock(context->image,
-                                    start_offset,
-                                    chunk,
-                                    chunk_length) != eAzureIoTSuccess)
+    // The manifest hash is of the file downloaded: hashed before transformed.
+    if (context->decompressor != NULL || context->patcher != NULL)
+    {
+        AzureIoTPlatform_HashDownloadBlock(context->image, start_offset, chunk, chunk_length);
+    }
+
+    if (context->decompressor != NULL)
+    {
+        if (!image_decompressor_write(context->decompressor, chunk, chunk_length))
+        {
+            CMP_LOGE(TAG_AZ_ADU_WKF, "failure decompressing image");
+            return false;
+        }
+    }
+    else if (context->patcher != NULL)
+    {
+        if (!download_patch_block(chunk, chunk_length, start_offset, context))
+        {
+            return false;
+        }
+    }
+    else if (!download_write_block(chunk, chunk_length, start_offset, context))
+    {
+        return false;
+    }
+
+    if (context->checkpoint != NULL &&
+        start_offset + chunk_length - context->checkpoint->offset >= CONFIG_ESP32_IOT_AZURE_DU_RESUME_CHECKPOINT_INTERVAL_KB * 1024U &&
+        !download_save_checkpoint(context, start_offset + chunk_length))
     {
         CMP_LOGE(TAG_AZ_ADU_WKF, "failure writing to flash");
         return false;
@@ -409,3 +687,88 @@ static bool download_callback_write_to_flash(uint8_t *chunk,
 
     return true;
 }
+
+static bool download_write_block(uint8_t *block,
+                                 uint32_t block_length,
+                                 uint32_t offset,
+                                 void *callback_context)
+{
+    download_callback_context_t *context = (download_callback_context_t *)callback_context;
+
+    if (context->writer != NULL)
+    {
+        // Written by the writer task while the next chunk is received.
+        if (!flash_writer_write(context->writer, offset, block, block_length))
+        {
+            CMP_LOGE(TAG_AZ_ADU_WKF, "failure writing to flash");
+            return false;
+        }
+    }
+    else if (AzureIoTPlatform_WriteBlock(context->image,
+                                         offset,
+                                         block,
+                                         block_length) != eAzureIoTSuccess)
+    {
+        CMP_LOGE(TAG_AZ_ADU_WKF, "failure writing to flash");
+        return false;
+    }
+
+    return true;
+}
+
+static bool download_patch_block(uint8_t *block,
+                                 uint32_t block_length,
+                                 uint32_t offset,
+                                 void *callback_context)
+{
+    download_callback_context_t *context = (download_callback_context_t *)callback_context;
+
+    if (!image_patcher_write(context->patcher, block, block_length))
+    {
+        CMP_LOGE(TAG_AZ_ADU_WKF, "failure patching image");
+        return false;
+    }
+
+    return true;
+}
+
+static bool download_read_running_image(uint32_t offset,
+                                        uint8_t *buffer,
+                                        uint32_t length,
+                                        void *callback_context)
+{
+    download_callback_context_t *context = (download_callback_context_t *)callback_context;
+
+    return AzureIoTPlatform_ReadRunningImage(context->image, offset, buffer, length) == eAzureIoTSuccess;
+}
+
+static bool download_save_checkpoint(download_callback_context_t *context, uint32_t offset)
+{
+    download_checkpoint_t *checkpoint = context->checkpoint;
+
+    // Everything before the offset must be on flash, and hashed,
+    // before saying so: the writer task is idle after a flush.
+    if (context->writer != NULL && !flash_writer_flush(context->writer))
+    {
+        return false;
+    }
+
+    checkpoint->offset = offset;
+    checkpoint->has_hash_state = context->image->hashed_size == offset;
+
+    mbedtls_sha256_init(&checkpoint->hash_state);
+
+    if (checkpoint->has_hash_state)
+    {
+        mbedtls_sha256_clone(&checkpoint->hash_state, &context->image->sha256);
+    }
+
+    if (!download_checkpoint_save(checkpoint))
+    {
+        CMP_LOGW(TAG_AZ_ADU_WKF, "failure saving download checkpoint at: %lu", (unsigned long)offset);
+    }
+
+    mbedtls_sha256_free(&checkpoint->hash_state);
+
+    return true;
+}
@@ -0,0 +1,461 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp32_iot_azure/azure_iot_diagnostics.h"
+#include "esp32_iot_azure/azure_iot_metrics.h"
+#include "esp32_iot_azure/azure_iot_sdk.h"
+#include "esp32_iot_azure/extension/azure_iot_hub_extension.h"
+#include "esp32_iot_azure/extension/azure_iot_json_reader_extension.h"
+#include "azure_iot_json_writer.h"
+#include "assertion.h"
+#include "config.h"
+#include "log.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_heap_caps.h"
+#endif
+
+static const char TAG_DIAGNOSTICS[] = "AZ_DIAGNOSTICS";
+
+struct azure_iot_diagnostics_t
+{
+    azure_iot_hub_context_t *hub_context;
+    buffer_t *buffer;
+    uint32_t interval_s;
+    uint32_t fields;
+    TickType_t sent_at; /** @brief When the last report was sent, or the component created. */
+    TaskHandle_t tasks[CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_TASKS_MAX];
+    int32_t errors[CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_ERRORS_MAX]; /** @brief Ring of the last codes, the latest at `(error_count - 1) % max`. */
+    uint32_t error_count;
+    azure_iot_metric_histogram_t puback_reported; /** @brief PUBACK histogram at the last report, for the latency between reports. */
+};
+
+static AzureIoTResult_t azure_iot_diagnostics_write_report(azure_iot_diagnostics_t *diagnostics, AzureIoTJSONWriter_t *json_writer);
+static AzureIoTResult_t azure_iot_diagnostics_write_stacks(azure_iot_diagnostics_t *diagnostics, AzureIoTJSONWriter_t *json_writer);
+static AzureIoTResult_t azure_iot_diagnostics_write_latency(azure_iot_diagnostics_t *diagnostics, AzureIoTJSONWriter_t *json_writer);
+static AzureIoTResult_t azure_iot_diagnostics_write_errors(azure_iot_diagnostics_t *diagnostics, AzureIoTJSONWriter_t *json_writer);
+static AzureIoTResult_t azure_iot_diagnostics_write_response(azure_iot_diagnostics_t *diagnostics,
+                                                             AzureIoTJSONWriter_t *json_writer,
+                                                             const uint8_t *property_name,
+                                                             uint32_t property_name_length,
+                                                             uint32_t value,
+                                                             uint32_t version);
+
+azure_iot_diagnostics_t *azure_iot_diagnostics_create(azure_iot_hub_context_t *hub_context, buffer_t *buffer)
+{
+    CMP_CHECK(TAG_DIAGNOSTICS, (buffer != NULL && buffer->buffer != NULL && buffer->length > 0), "buffer null", NULL)
+
+    azure_iot_diagnostics_t *diagnostics = (azure_iot_diagnostics_t *)malloc(sizeof(azure_iot_diagnostics_t));
+
+    CMP_CHECK(TAG_DIAGNOSTICS, (diagnostics != NULL), "failure allocating diagnostics", NULL)
+
+    memset(diagnostics, 0, sizeof(azure_iot_diagnostics_t));
+
+    diagnostics->hub_context = hub_context;
+    diagnostics->buffer = buffer;
+    diagnostics->interval_s = CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_INTERVAL_S;
+    diagnostics->fields = CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_FIELDS & AZURE_IOT_DIAGNOSTICS_FIELD_ALL;
+    diagnostics->sent_at = xTaskGetTickCount();
+
+    azure_iot_metrics_get_histogram(AZURE_IOT_METRIC_HUB_PUBACK, &diagnostics->puback_reported);
+
+    return diagnostics;
+}
+
+AzureIoTResult_t azure_iot_diagnostics_watch_task(azure_iot_diagnostics_t *diagnostics, TaskHandle_t task)
+{
+    TaskHandle_t *free_slot = NULL;
+
+    for (size_t i = 0; i < CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_TASKS_MAX; i++)
+    {
+        if (diagnostics->tasks[i] == task)
+        {
+            return eAzureIoTSuccess;
+        }
+
+        if (diagnostics->tasks[i] == NULL && free_slot == NULL)
+        {
+            free_slot = &diagnostics->tasks[i];
+        }
+    }
+
+    CMP_CHECK(TAG_DIAGNOSTICS, (free_slot != NULL), "too many tasks watched", eAzureIoTErrorOutOfMemory)
+
+    *free_slot = task;
+
+    return eAzureIoTSuccess;
+}
+
+void azure_iot_diagnostics_unwatch_task(azure_iot_diagnostics_t *diagnostics, TaskHandle_t task)
+{
+    for (size_t i = 0; i < CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_TASKS_MAX; i++)
+    {
+        if (diagnostics->tasks[i] == task)
+        {
+            diagnostics->tasks[i] = NULL;
+        }
+    }
+}
+
+void azure_iot_diagnostics_record_error(azure_iot_diagnostics_t *diagnostics, int32_t code)
+{
+    diagnostics->errors[diagnostics->error_count % CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_ERRORS_MAX] = code;
+    diagnostics->error_count++;
+}
+
+AzureIoTResult_t azure_iot_diagnostics_process(azure_iot_diagnostics_t *diagnostics)
+{
+    if (diagnostics->interval_s == 0 ||
+        pdTICKS_TO_MS(xTaskGetTickCount() - diagnostics->sent_at) < diagnostics->interval_s * 1000ULL)
+    {
+        return eAzureIoTSuccess;
+    }
+
+    return azure_iot_diagnostics_send(diagnostics);
+}
+
+AzureIoTResult_t azure_iot_diagnostics_send(azure_iot_diagnostics_t *diagnostics)
+{
+    AzureIoTJSONWriter_t json_writer;
+
+    // Not sent again until the next interval, even on failure: the link is likely down.
+    diagnostics->sent_at = xTaskGetTickCount();
+
+    AzureIoTResult_t result = azure_iot_diagnostics_write_report(diagnostics, &json_writer);
+
+    if (result != eAzureIoTSuccess)
+    {
+        CMP_LOGE(TAG_DIAGNOSTICS, "failure writing report: %d", result);
+
+        azure_iot_diagnostics_record_error(diagnostics, result);
+        return result;
+    }
+
+    // QoS 0: a report lost is replaced by the next one, and takes no room in the publish window.
+    result = azure_iot_hub_send_json_telemetry_from_component(diagnostics->hub_context,
+                                                              (const uint8_t *)AZURE_IOT_DIAGNOSTICS_COMPONENT_NAME,
+                                                              sizeof_l(AZURE_IOT_DIAGNOSTICS_COMPONENT_NAME),
+                                                              diagnostics->buffer->buffer,
+                                                              (uint32_t)AzureIoTJSONWriter_GetBytesUsed(&json_writer),
+                                                              eAzureIoTHubMessageQoS0,
+                                                              NULL);
+
+    if (result != eAzureIoTSuccess)
+    {
+        CMP_LOGW(TAG_DIAGNOSTICS, "failure sending report: %d", result);
+
+        azure_iot_diagnostics_record_error(diagnostics, result);
+    }
+
+    return result;
+}
+
+bool azure_iot_diagnostics_is_component(azure_iot_diagnostics_t *diagnostics,
+                                        const uint8_t *component_name,
+                                        uint32_t component_name_length)
+{
+    return component_name_length == sizeof_l(AZURE_IOT_DIAGNOSTICS_COMPONENT_NAME) &&
+           strncmp(AZURE_IOT_DIAGNOSTICS_COMPONENT_NAME, (const char *)component_name, component_name_length) == 0;
+}
+
+AzureIoTResult_t azure_iot_diagnostics_parse_property(azure_iot_diagnostics_t *diagnostics,
+                                                      AzureIoTJSONReader_t *json_reader)
+{
+    uint32_t value = 0;
+
+    AZ_CHECK_BEGIN()
+
+    if (AzureIoTJSONReader_TokenIsTextEqual(json_reader,
+                                            (uint8_t *)AZURE_IOT_DIAGNOSTICS_PRP_INTERVAL_NAME,
+                                            sizeof_l(AZURE_IOT_DIAGNOSTICS_PRP_INTERVAL_NAME)))
+    {
+        AZ_CHECK(AzureIoTJSONReader_NextToken(json_reader))
+        AZ_CHECK(AzureIoTJSONReader_GetTokenUInt32(json_reader, &value))
+        AZ_CHECK(AzureIoTJSONReader_NextToken(json_reader))
+
+        CMP_LOGI(TAG_DIAGNOSTICS, "interval: %lu s", (unsigned long)value);
+
+        diagnostics->interval_s = value;
+    }
+    else if (AzureIoTJSONReader_TokenIsTextEqual(json_reader,
+                                                 (uint8_t *)AZURE_IOT_DIAGNOSTICS_PRP_FIELDS_NAME,
+                                                 sizeof_l(AZURE_IOT_DIAGNOSTICS_PRP_FIELDS_NAME)))
+    {
+        AZ_CHECK(AzureIoTJSONReader_NextToken(json_reader))
+        AZ_CHECK(AzureIoTJSONReader_GetTokenUInt32(json_reader, &value))
+        AZ_CHECK(AzureIoTJSONReader_NextToken(json_reader))
+
+        CMP_LOGI(TAG_DIAGNOSTICS, "fields: 0x%02lx", (unsigned long)value);
+
+        diagnostics->fields = value & AZURE_IOT_DIAGNOSTICS_FIELD_ALL;
+    }
+    else
+    {
+        AZ_CHECK(AzureIoTJSONReader_SkipPropertyAndValue(json_reader))
+    }
+
+    AZ_CHECK_RETURN_LAST()
+}
+
+AzureIoTResult_t azure_iot_diagnostics_send_response(azure_iot_diagnostics_t *diagnostics, uint32_t version)
+{
+    AzureIoTJSONWriter_t json_writer;
+    AzureIoTHubClient_t *iot_client = azure_iot_hub_get_iot_client(diagnostics->hub_context);
+
+    AZ_CHECK_BEGIN()
+
+    AZ_CHECK(AzureIoTJSONWriter_Init(&json_writer, diagnostics->buffer->buffer, diagnostics->buffer->length))
+    AZ_CHECK(AzureIoTJSONWriter_AppendBeginObject(&json_writer))
+    AZ_CHECK(AzureIoTHubClientProperties_BuilderBeginComponent(iot_client,
+                                                               &json_writer,
+                                                               (const uint8_t *)AZURE_IOT_DIAGNOSTICS_COMPONENT_NAME,
+                                                               sizeof_l(AZURE_IOT_DIAGNOSTICS_COMPONENT_NAME)))
+    AZ_CHECK(azure_iot_diagnostics_write_response(diagnostics,
+                                                  &json_writer,
+                                                  (const uint8_t *)AZURE_IOT_DIAGNOSTICS_PRP_INTERVAL_NAME,
+                                                  sizeof_l(AZURE_IOT_DIAGNOSTICS_PRP_INTERVAL_NAME),
+                                                  diagnostics->interval_s,
+                                                  version))
+    AZ_CHECK(azure_iot_diagnostics_write_response(diagnostics,
+                                                  &json_writer,
+                                                  (const uint8_t *)AZURE_IOT_DIAGNOSTICS_PRP_FIELDS_NAME,
+                                                  sizeof_l(AZURE_IOT_DIAGNOSTICS_PRP_FIELDS_NAME),
+                                                  diagnostics->fields,
+                                                  version))
+    AZ_CHECK(AzureIoTHubClientProperties_BuilderEndComponent(iot_client, &json_writer))
+    AZ_CHECK(AzureIoTJSONWriter_AppendEndObject(&json_writer))
+
+    AZ_CHECK(azure_iot_hub_send_properties_reported(diagnostics->hub_context,
+                                                    diagnostics->buffer->buffer,
+                                                    (uint32_t)AzureIoTJSONWriter_GetBytesUsed(&json_writer),
+                                                    NULL))
+
+    AZ_CHECK_RETURN_LAST()
+}
+
+uint32_t azure_iot_diagnostics_get_interval(const azure_iot_diagnostics_t *diagnostics)
+{
+    return diagnostics->interval_s;
+}
+
+uint32_t azure_iot_diagnostics_get_fields(const azure_iot_diagnostics_t *diagnostics)
+{
+    return diagnostics->fields;
+}
+
+void azure_iot_diagnostics_free(azure_iot_diagnostics_t *diagnostics)
+{
+    free(diagnostics);
+}
+
+//
+// PRIVATE
+//
+
+static AzureIoTResult_t azure_iot_diagnostics_write_report(azure_iot_diagnostics_t *diagnostics, AzureIoTJSONWriter_t *json_writer)
+{
+    AZ_CHECK_BEGIN()
+
+    AZ_CHECK(AzureIoTJSONWriter_Init(json_writer, diagnostics->buffer->buffer, diagnostics->buffer->length))
+    AZ_CHECK(AzureIoTJSONWriter_AppendBeginObject(json_writer))
+
+#if !CONFIG_IDF_TARGET_LINUX
+    if (diagnostics->fields & AZURE_IOT_DIAGNOSTICS_FIELD_HEAP)
+    {
+        AZ_CHECK(AzureIoTJSONWriter_AppendPropertyWithInt32Value(json_writer,
+                                                                 (const uint8_t *)"heapFree",
+                                                                 sizeof_l("heapFree"),
+                                                                 (int32_t)heap_caps_get_free_size(MALLOC_CAP_8BIT)))
+        AZ_CHECK(AzureIoTJSONWriter_AppendPropertyWithInt32Value(json_writer,
+                                                                 (const uint8_t *)"heapMinFree",
+                                                                 sizeof_l("heapMinFree"),
+                                                                 (int32_t)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT)))
+        // Fragmentation: an allocation larger than the largest block fails, however much is free.
+        AZ_CHECK(AzureIoTJSONWriter_AppendPropertyWithInt32Value(json_writer,
+                                                                 (const uint8_t *)"heapLargestBlock",
+                                                                 sizeof_l("heapLargestBlock"),
+                                                                 (int32_t)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT)))
+    }
+#endif
+
+    if (diagnostics->fields & AZURE_IOT_DIAGNOSTICS_FIELD_STACKS)
+    {
+        AZ_CHECK(azure_iot_diagnostics_write_stacks(diagnostics, json_writer))
+    }
+
+    if (diagnostics->fields & AZURE_IOT_DIAGNOSTICS_FIELD_RECONNECTS)
+    {
+        azure_iot_reconnect_statistics_t statistics;
+
+        azure_iot_sdk_get_reconnect_statistics(&statistics);
+
+        AZ_CHECK(AzureIoTJSONWriter_AppendPropertyWithInt32Value(json_writer,
+                                                                 (const uint8_t *)"reconnectAttempts",
+                                                                 sizeof_l("reconnectAttempts"),
+                                                                 (int32_t)statistics.attempts))
+        AZ_CHECK(AzureIoTJSONWriter_AppendPropertyWithInt32Value(json_writer,
+                                                                 (const uint8_t *)"reconnectFailures",
+                                                                 sizeof_l("reconnectFailures"),
+                                                                 (int32_t)statistics.failures))
+        AZ_CHECK(AzureIoTJSONWriter_AppendPropertyWithInt32Value(json_writer,
+                                                                 (const uint8_t *)"circuitOpens",
+                                                                 sizeof_l("circuitOpens"),
+                                                                 (int32_t)statistics.circuit_opens))
+        AZ_CHECK(AzureIoTJSONWriter_AppendPropertyWithInt32Value(json_writer,
+                                                                 (const uint8_t *)"networkDown",
+                                                                 sizeof_l("networkDown"),
+                                                                 (int32_t)statistics.network_down))
+    }
+
+    if (diagnostics->fields & AZURE_IOT_DIAGNOSTICS_FIELD_LATENCY)
+    {
+        AZ_CHECK(azure_iot_diagnostics_write_latency(diagnostics, json_writer))
+    }
+
+    if (diagnostics->fields & AZURE_IOT_DIAGNOSTICS_FIELD_ERRORS)
+    {
+        AZ_CHECK(azure_iot_diagnostics_write_errors(diagnostics, json_writer))
+    }
+
+    AZ_CHECK(AzureIoTJSONWriter_AppendEndObject(json_writer))
+
+    AZ_CHECK_RETURN_LAST()
+}
+
+static AzureIoTResult_t azure_iot_diagnostics_write_stacks(azure_iot_diagnostics_t *diagnostics, AzureIoTJSONWriter_t *json_writer)
+{
+    TaskHandle_t tasks[CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_TASKS_MAX];
+    size_t task_count = 0;
+
+    for (size_t i = 0; i < CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_TASKS_MAX; i++)
+    {
+        if (diagnostics->tasks[i] != NULL)
+        {
+            tasks[task_count++] = diagnostics->tasks[i];
+        }
+    }
+
+    // No task watched: the calling one.
+    if (task_count == 0)
+    {
+        tasks[task_count++] = xTaskGetCurrentTaskHandle();
+    }
+
+    AZ_CHECK_BEGIN()
+
+    AZ_CHECK(AzureIoTJSONWriter_AppendPropertyName(json_writer, (const uint8_t *)"stackWatermarks", sizeof_l("stackWatermarks")))
+    AZ_CHECK(AzureIoTJSONWriter_AppendBeginObject(json_writer))
+
+    for (size_t i = 0; i < task_count; i++)
+    {
+        const char *name = pcTaskGetName(tasks[i]);
+
+        AZ_CHECK(AzureIoTJSONWriter_AppendPropertyWithInt32Value(json_writer,
+                                                                 (const uint8_t *)name,
+                                                                 (uint32_t)strlen(name),
+                                                                 (int32_t)uxTaskGetStackHighWaterMark(tasks[i])))
+    }
+
+    AZ_CHECK(AzureIoTJSONWriter_AppendEndObject(json_writer))
+
+    AZ_CHECK_RETURN_LAST()
+}
+
+static AzureIoTResult_t azure_iot_diagnostics_write_latency(azure_iot_diagnostics_t *diagnostics, AzureIoTJSONWriter_t *json_writer)
+{
+    azure_iot_metric_histogram_t current;
+    azure_iot_metric_histogram_t interval;
+
+    AZ_CHECK_BEGIN()
+
+    // Metrics are not reset: the PUBACKs since the last report are the difference with its copy.
+    azure_iot_metrics_get_histogram(AZURE_IOT_METRIC_HUB_PUBACK, &current);
+
+    if (current.count < diagnostics->puback_reported.count)
+    {
+        // Reset by the application meanwhile.
+        memset(&diagnostics->puback_reported, 0, sizeof(azure_iot_metric_histogram_t));
+    }
+
+    interval.count = current.count - diagnostics->puback_reported.count;
+    interval.errors = current.errors - diagnostics->puback_reported.errors;
+    interval.max_us = current.max_us;
+    interval.total_us = current.total_us - diagnostics->puback_reported.total_us;
+
+    for (uint32_t i = 0; i < AZURE_IOT_METRICS_BUCKET_COUNT; i++)
+    {
+        interval.buckets[i] = current.buckets[i] - diagnostics->puback_reported.buckets[i];
+    }
+
+    diagnostics->puback_reported = current;
+
+    AZ_CHECK(AzureIoTJSONWriter_AppendPropertyWithInt32Value(json_writer,
+                                                             (const uint8_t *)"publishCount",
+                                                             sizeof_l("publishCount"),
+                                                             (int32_t)interval.count))
+    AZ_CHECK(AzureIoTJSONWriter_AppendPropertyWithInt32Value(json_writer,
+                                                             (const uint8_t *)"publishP50Ms",
+                                                             sizeof_l("publishP50Ms"),
+                                                             (int32_t)((azure_iot_metrics_get_percentile_us(&interval, 50) + 999U) / 1000U)))
+    AZ_CHECK(AzureIoTJSONWriter_AppendPropertyWithInt32Value(json_writer,
+                                                             (const uint8_t *)"publishP90Ms",
+                                                             sizeof_l("publishP90Ms"),
+                                                             (int32_t)((azure_iot_metrics_get_percentile_us(&interval, 90) + 999U) / 1000U)))
+    AZ_CHECK(AzureIoTJSONWriter_AppendPropertyWithInt32Value(json_writer,
+                                                             (const uint8_t *)"publishP99Ms",
+                                                             sizeof_l("publishP99Ms"),
+                                                             (int32_t)((azure_iot_metrics_get_percentile_us(&interval, 99) + 999U) / 1000U)))
+
+    AZ_CHECK_RETURN_LAST()
+}
+
+static AzureIoTResult_t azure_iot_diagnostics_write_errors(azure_iot_diagnostics_t *diagnostics, AzureIoTJSONWriter_t *json_writer)
+{
+    uint32_t kept = diagnostics->error_count < CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_ERRORS_MAX
+                        ? diagnostics->error_count
+                        : CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_ERRORS_MAX;
+
+    AZ_CHECK_BEGIN()
+
+    AZ_CHECK(AzureIoTJSONWriter_AppendPropertyWithInt32Value(json_writer,
+                                                             (const uint8_t *)"errorCount",
+                                                             sizeof_l("errorCount"),
+                                                             (int32_t)diagnostics->error_count))
+    AZ_CHECK(AzureIoTJSONWriter_AppendPropertyName(json_writer, (const uint8_t *)"lastErrors", sizeof_l("lastErrors")))
+    AZ_CHECK(AzureIoTJSONWriter_AppendBeginArray(json_writer))
+
+    // Most recent first.
+    for (uint32_t i = 1; i <= kept; i++)
+    {
+        AZ_CHECK(AzureIoTJSONWriter_AppendInt32(json_writer,
+                                                diagnostics->errors[(diagnostics->error_count - i) % CONFIG_ESP32_IOT_AZURE_DIAGNOSTICS_ERRORS_MAX]))
+    }
+
+    AZ_CHECK(AzureIoTJSONWriter_AppendEndArray(json_writer))
+
+    AZ_CHECK_RETURN_LAST()
+}
+
+static AzureIoTResult_t azure_iot_diagnostics_write_response(azure_iot_diagnostics_t *diagnostics,
+                                                             AzureIoTJSONWriter_t *json_writer,
+                                                             const uint8_t *property_name,
+                                                             uint32_t property_name_length,
+                                                             uint32_t value,
+                                                             uint32_t version)
+{
+    AzureIoTHubClient_t *iot_client = azure_iot_hub_get_iot_client(diagnostics->hub_context);
+
+    AZ_CHECK_BEGIN()
+
+    AZ_CHECK(AzureIoTHubClientProperties_BuilderBeginResponseStatus(iot_client,
+                                                                    json_writer,
+                                                                    property_name,
+                                                                    property_name_length,
+                                                                    200,
+                                                                    version,
+                                                                    (const uint8_t *)"success",
+                                                                    sizeof_l("success")))
+    AZ_CHECK(AzureIoTJSONWriter_AppendInt32(json_writer, (int32_t)value))
+    AZ_CHECK(AzureIoTHubClientProperties_BuilderEndResponseStatus(iot_client, json_writer))
+
+    AZ_CHECK_RETURN_LAST()
+}
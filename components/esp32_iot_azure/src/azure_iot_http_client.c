@@ -1,34 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include "esp32_iot_azure/azure_iot_http_client.h"
 #include "infrastructure/transport.h"
 #include "infrastructure/azure_transport_interface.h"
+#include "infrastructure/metrics.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "config.h"
+#include "assertion.h"
+#include "log.h"
+
+static const char TAG_AZ_HTTP[] = "AZ_HTTP";
+
+static AzureIoTHTTPResult_t azure_http_reconnect_if_closed(azure_http_context_t *context);
+static AzureIoTHTTPResult_t azure_http_send(azure_http_context_t *context,
+                                            const char *request,
+                                            uint32_t request_length);
+static uint32_t http_response_find_headers_end(const char *response, uint32_t response_length);
+static const char *http_response_find_header(const char *response,
+                                             uint32_t response_length,
+                                             const char *name,
+                                             uint32_t name_length);
+static bool http_response_has_connection_close(const char *response, uint32_t response_length);
+static AzureIoTHTTPResult_t http_response_parse(const char *response,
+                                                uint32_t headers_length,
+                                                azure_http_response_t *parsed);
 
 struct azure_http_context_t
 {
     AzureIoTTransportInterface_t transport_interface;
     AzureIoTHTTP_t http;
+    azure_http_statistics_t statistics;
     transport_t *transport;
     const char *url;
     const char *path;
+    const char *host;
+    char *host_buffer;
     uint32_t url_length;
     uint32_t path_length;
+    uint32_t host_length;
+    uint16_t port;
+    bool server_closed;
 };
 
 azure_http_context_t *azure_http_create(const char *url,
                                         uint32_t url_length,
                                         const char *path,
-                                        uint32_t path_length)
+                                        uint32_t path_length,
+                                        uint16_t port,
+                                        bool secure)
 {
     azure_http_context_t *context = (azure_http_context_t *)malloc(sizeof(azure_http_context_t));
 
+    CMP_CHECK(TAG_AZ_HTTP, (context != NULL), "failure allocating context", NULL)
+
     memset(context, 0, sizeof(azure_http_context_t));
 
+    if ((context->transport = secure ? transport_create_azure() : transport_create_tcp()) == NULL)
+    {
+        CMP_LOGE(TAG_AZ_HTTP, "failure creating transport");
+        free(context);
+        return NULL;
+    }
+
     context->url = url;
     context->url_length = url_length;
     context->path = path;
     context->path_length = path_length;
-    context->transport = transport_create_tcp();
+    context->port = port;
+    context->host = url;
+    context->host_length = url_length;
+
+    // The Host header names the port, unless it is the default one of the scheme.
+    if (port != (secure ? 443 : 80))
+    {
+        int host_length = snprintf(NULL, 0, "%.*s:%u", (int)url_length, url, port);
+
+        if ((context->host_buffer = (char *)malloc(host_length + 1)) == NULL)
+        {
+            CMP_LOGE(TAG_AZ_HTTP, "failure allocating host");
+            transport_free(context->transport);
+            free(context);
+            return NULL;
+        }
+
+        snprintf(context->host_buffer, host_length + 1, "%.*s:%u", (int)url_length, url, port);
+
+        context->host = context->host_buffer;
+        context->host_length = (uint32_t)host_length;
+    }
+
+#if CONFIG_ESP32_IOT_AZURE_TRANSPORT_TLS_SESSION_REUSE
+    // The reconnections of a download resume the first TLS session,
+    // skipping the full handshake.
+    if (secure)
+    {
+        transport_enable_session_reuse(context->transport);
+    }
+#endif
 
     azure_transport_interface_init(context->transport, &context->transport_interface);
 
@@ -39,9 +110,12 @@ AzureIoTHTTPResult_t azure_http_connect(azure_http_context_t *context)
 {
     if (transport_connect(context->transport,
                           context->url,
-                          80,
+                          context->port,
                           CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_CONNECT_TIMEOUT_MS) == TRANSPORT_STATUS_SUCCESS)
     {
+        context->statistics.connections++;
+        context->server_closed = false;
+
         return eAzureIoTHTTPSuccess;
     }
 
@@ -59,8 +133,8 @@ AzureIoTHTTPResult_t azure_http_request_size_init(azure_http_context_t *context,
 {
     return AzureIoTHTTP_RequestSizeInit(&context->http,
                                         &context->transport_interface,
-                                        context->url,
-                                        context->url_length,
+                                        context->host,
+                                        context->host_length,
                                         context->path,
                                         context->path_length,
                                         header_buffer,
@@ -71,9 +145,23 @@ int32_t azure_http_request_size(azure_http_context_t *context,
                                 char *data_buffer,
                                 uint32_t data_buffer_length)
 {
-    return AzureIoTHTTP_RequestSize(&context->http,
-                                    data_buffer,
-                                    data_buffer_length);
+    if (azure_http_reconnect_if_closed(context) != eAzureIoTHTTPSuccess)
+    {
+        return -1;
+    }
+
+    context->statistics.requests++;
+
+    int32_t size = AzureIoTHTTP_RequestSize(&context->http,
+                                            data_buffer,
+                                            data_buffer_length);
+
+    if (size != -1)
+    {
+        context->server_closed = http_response_has_connection_close(data_buffer, data_buffer_length);
+    }
+
+    return size;
 }
 
 AzureIoTHTTPResult_t azure_http_init(azure_http_context_t *context,
@@ -82,8 +170,8 @@ AzureIoTHTTPResult_t azure_http_init(azure_http_context_t *context,
 {
     return AzureIoTHTTP_Init(&context->http,
                              &context->transport_interface,
-                             context->url,
-                             context->url_length,
+                             context->host,
+                             context->host_length,
                              context->path,
                              context->path_length,
                              header_buffer,
@@ -98,13 +186,215 @@ AzureIoTHTTPResult_t azure_http_request(azure_http_context_t *context,
                                         char **output_data,
                                         uint32_t *output_data_length)
 {
-    return AzureIoTHTTP_Request(&context->http,
-                                range_start,
-                                range_end,
-                                data_buffer,
-                                data_buffer_length,
-                                output_data,
-                                output_data_length);
+    AzureIoTHTTPResult_t result;
+
+    if ((result = azure_http_reconnect_if_closed(context)) != eAzureIoTHTTPSuccess)
+    {
+        return result;
+    }
+
+    context->statistics.requests++;
+
+    uint64_t started_at_us = metrics_get_time_us();
+
+    result = AzureIoTHTTP_Request(&context->http,
+                                  range_start,
+                                  range_end,
+                                  data_buffer,
+                                  data_buffer_length,
+                                  output_data,
+                                  output_data_length);
+
+    metrics_record(AZURE_IOT_METRIC_HTTP_REQUEST, started_at_us, result != eAzureIoTHTTPSuccess);
+
+    if (result == eAzureIoTHTTPSuccess)
+    {
+        // The headers sit right before the payload.
+        context->server_closed = http_response_has_connection_close(data_buffer, (uint32_t)(*output_data - data_buffer));
+    }
+
+    return result;
+}
+
+AzureIoTHTTPResult_t azure_http_send_range_request(azure_http_context_t *context,
+                                                   char *request_buffer,
+                                                   uint32_t request_buffer_length,
+                                                   uint32_t range_start,
+                                                   uint32_t range_end)
+{
+    if (azure_http_reconnect_if_closed(context) != eAzureIoTHTTPSuccess)
+    {
+        return eAzureIoTHTTPNetworkError;
+    }
+
+    int request_length = snprintf(request_buffer,
+                                  request_buffer_length,
+                                  "GET %.*s HTTP/1.1\r\n"
+                                  "Host: %.*s\r\n"
+                                  "Range: bytes=%lu-%lu\r\n\r\n",
+                                  (int)context->path_length,
+                                  context->path,
+                                  (int)context->host_length,
+                                  context->host,
+                                  (unsigned long)range_start,
+                                  (unsigned long)range_end);
+
+    if (request_length < 0 || (uint32_t)request_length >= request_buffer_length)
+    {
+        return eAzureIoTHTTPInsufficientMemory;
+    }
+
+    return azure_http_send(context, request_buffer, (uint32_t)request_length);
+}
+
+AzureIoTHTTPResult_t azure_http_send_get_request(azure_http_context_t *context,
+                                                 char *request_buffer,
+                                                 uint32_t request_buffer_length,
+                                                 uint32_t range_start)
+{
+    if (azure_http_reconnect_if_closed(context) != eAzureIoTHTTPSuccess)
+    {
+        return eAzureIoTHTTPNetworkError;
+    }
+
+    int request_length;
+
+    if (range_start == 0)
+    {
+        request_length = snprintf(request_buffer,
+                                  request_buffer_length,
+                                  "GET %.*s HTTP/1.1\r\n"
+                                  "Host: %.*s\r\n\r\n",
+                                  (int)context->path_length,
+                                  context->path,
+                                  (int)context->host_length,
+                                  context->host);
+    }
+    else
+    {
+        request_length = snprintf(request_buffer,
+                                  request_buffer_length,
+                                  "GET %.*s HTTP/1.1\r\n"
+                                  "Host: %.*s\r\n"
+                                  "Range: bytes=%lu-\r\n\r\n",
+                                  (int)context->path_length,
+                                  context->path,
+                                  (int)context->host_length,
+                                  context->host,
+                                  (unsigned long)range_start);
+    }
+
+    if (request_length < 0 || (uint32_t)request_length >= request_buffer_length)
+    {
+        return eAzureIoTHTTPInsufficientMemory;
+    }
+
+    return azure_http_send(context, request_buffer, (uint32_t)request_length);
+}
+
+AzureIoTHTTPResult_t azure_http_receive_response_headers(azure_http_context_t *context,
+                                                         char *data_buffer,
+                                                         uint32_t data_buffer_length,
+                                                         uint32_t *buffered_length,
+                                                         azure_http_response_t *response)
+{
+    AzureIoTHTTPResult_t result;
+    uint32_t headers_length;
+
+    memset(response, 0, sizeof(azure_http_response_t));
+
+    while ((headers_length = http_response_find_headers_end(data_buffer, *buffered_length)) == 0)
+    {
+        if (*buffered_length >= CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_MAX_RESPONSE_HEADERS_SIZE_BYTES)
+        {
+            return eAzureIoTHTTPSecurityAlertResponseHeadersSizeLimitExceeded;
+        }
+
+        if (*buffered_length == data_buffer_length)
+        {
+            return eAzureIoTHTTPInsufficientMemory;
+        }
+
+        if ((result = azure_http_receive_data(context, data_buffer, data_buffer_length, buffered_length)) != eAzureIoTHTTPSuccess)
+        {
+            return result;
+        }
+    }
+
+    if ((result = http_response_parse(data_buffer, headers_length, response)) != eAzureIoTHTTPSuccess)
+    {
+        return result;
+    }
+
+    // Applies to the next request, once the body is read.
+    context->server_closed = response->connection_close;
+
+    return eAzureIoTHTTPSuccess;
+}
+
+AzureIoTHTTPResult_t azure_http_receive_response(azure_http_context_t *context,
+                                                 char *data_buffer,
+                                                 uint32_t data_buffer_length,
+                                                 uint32_t *buffered_length,
+                                                 azure_http_response_t *response)
+{
+    AzureIoTHTTPResult_t result;
+
+    if ((result = azure_http_receive_response_headers(context,
+                                                      data_buffer,
+                                                      data_buffer_length,
+                                                      buffered_length,
+                                                      response)) != eAzureIoTHTTPSuccess)
+    {
+        return result;
+    }
+
+    if (response->content_length > data_buffer_length - response->headers_length)
+    {
+        CMP_LOGE(TAG_AZ_HTTP, "response does not fit the buffer: %lu bytes", (unsigned long)response->content_length);
+        return eAzureIoTHTTPInsufficientMemory;
+    }
+
+    while (*buffered_length < response->headers_length + response->content_length)
+    {
+        if ((result = azure_http_receive_data(context, data_buffer, data_buffer_length, buffered_length)) != eAzureIoTHTTPSuccess)
+        {
+            return result;
+        }
+    }
+
+    return eAzureIoTHTTPSuccess;
+}
+
+AzureIoTHTTPResult_t azure_http_receive_data(azure_http_context_t *context,
+                                             char *data_buffer,
+                                             uint32_t data_buffer_length,
+                                             uint32_t *buffered_length)
+{
+    TickType_t started_at = xTaskGetTickCount();
+
+    // Same contract as the coreHTTP receive loop: a read
+    // without data is retried until the retry timeout.
+    do
+    {
+        int32_t read = transport_read(context->transport,
+                                      (uint8_t *)data_buffer + *buffered_length,
+                                      data_buffer_length - *buffered_length,
+                                      CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_RECV_RETRY_TIMEOUT_MS);
+
+        if (read < 0)
+        {
+            return eAzureIoTHTTPNetworkError;
+        }
+
+        if (read > 0)
+        {
+            *buffered_length += (uint32_t)read;
+            return eAzureIoTHTTPSuccess;
+        }
+    } while (xTaskGetTickCount() - started_at < pdMS_TO_TICKS(CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_RECV_RETRY_TIMEOUT_MS));
+
+    return *buffered_length == 0 ? eAzureIoTHTTPNoResponse : eAzureIoTHTTPPartialResponse;
 }
 
 AzureIoTHTTPResult_t azure_http_deinit(azure_http_context_t *context)
@@ -112,11 +402,166 @@ AzureIoTHTTPResult_t azure_http_deinit(azure_http_context_t *context)
     return AzureIoTHTTP_Deinit(&context->http);
 }
 
+const azure_http_statistics_t *azure_http_get_statistics(const azure_http_context_t *context)
+{
+    return &context->statistics;
+}
+
 void azure_http_free(azure_http_context_t *context)
 {
     azure_transport_interface_free(&context->transport_interface);
 
     transport_free(context->transport);
 
+    free(context->host_buffer);
     free(context);
+}
+
+//
+// PRIVATE
+//
+
+static AzureIoTHTTPResult_t azure_http_reconnect_if_closed(azure_http_context_t *context)
+{
+    if (!context->server_closed)
+    {
+        return eAzureIoTHTTPSuccess;
+    }
+
+    // Writing to a connection the server is closing would fail
+    // and pay for the error before the reconnection.
+    CMP_LOGD(TAG_AZ_HTTP, "server closed the connection: reconnecting");
+
+    azure_http_disconnect(context);
+
+    return azure_http_connect(context);
+}
+
+static AzureIoTHTTPResult_t azure_http_send(azure_http_context_t *context,
+                                            const char *request,
+                                            uint32_t request_length)
+{
+    context->statistics.requests++;
+
+    TickType_t last_sent_at = xTaskGetTickCount();
+
+    for (uint32_t sent = 0; sent < request_length;)
+    {
+        int32_t written = transport_write(context->transport,
+                                          (const uint8_t *)request + sent,
+                                          request_length - sent,
+                                          CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_SEND_RETRY_TIMEOUT_MS);
+
+        if (written < 0)
+        {
+            return eAzureIoTHTTPNetworkError;
+        }
+
+        if (written > 0)
+        {
+            sent += (uint32_t)written;
+            last_sent_at = xTaskGetTickCount();
+        }
+        else if (xTaskGetTickCount() - last_sent_at >= pdMS_TO_TICKS(CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_SEND_RETRY_TIMEOUT_MS))
+        {
+            return eAzureIoTHTTPNetworkError;
+        }
+    }
+
+    return eAzureIoTHTTPSuccess;
+}
+
+static uint32_t http_response_find_headers_end(const char *response, uint32_t response_length)
+{
+    for (uint32_t i = 0; i + 4 <= response_length; i++)
+    {
+        if (memcmp(response + i, "\r\n\r\n", 4) == 0)
+        {
+            return i + 4;
+        }
+    }
+
+    return 0;
+}
+
+static const char *http_response_find_header(const char *response,
+                                             uint32_t response_length,
+                                             const char *name,
+                                             uint32_t name_length)
+{
+    for (uint32_t i = 0; i + name_length + 3 < response_length; i++)
+    {
+        // Stop at the end of the headers.
+        if (memcmp(response + i, "\r\n\r\n", 4) == 0)
+        {
+            return NULL;
+        }
+
+        if (memcmp(response + i, "\r\n", 2) != 0 ||
+            strncasecmp(response + i + 2, name, name_length) != 0 ||
+            response[i + 2 + name_length] != ':')
+        {
+            continue;
+        }
+
+        uint32_t value = i + 2 + name_length + 1;
+
+        while (value < response_length && (response[value] == ' ' || response[value] == '\t'))
+        {
+            value++;
+        }
+
+        return response + value;
+    }
+
+    return NULL;
+}
+
+static bool http_response_has_connection_close(const char *response, uint32_t response_length)
+{
+    static const char CLOSE_VALUE[] = "close";
+
+    const char *value = http_response_find_header(response, response_length, "connection", sizeof("connection") - 1);
+
+    return value != NULL &&
+           (uint32_t)(value - response) + sizeof(CLOSE_VALUE) - 1 <= response_length &&
+           strncasecmp(value, CLOSE_VALUE, sizeof(CLOSE_VALUE) - 1) == 0;
+}
+
+static AzureIoTHTTPResult_t http_response_parse(const char *response,
+                                                uint32_t headers_length,
+                                                azure_http_response_t *parsed)
+{
+    // "HTTP/1.1 206 ..."
+    if (headers_length < sizeof("HTTP/1.1 200") - 1 || strncmp(response, "HTTP/1.", sizeof("HTTP/1.") - 1) != 0)
+    {
+        return eAzureIoTHTTPSecurityAlertInvalidProtocolVersion;
+    }
+
+    parsed->status_code = (uint16_t)strtoul(response + sizeof("HTTP/1.1 ") - 1, NULL, 10);
+    parsed->headers_length = headers_length;
+
+    // The headers end with a blank line: values are
+    // never parsed past the buffer by strtoul.
+    const char *content_length = http_response_find_header(response, headers_length, "content-length", sizeof("content-length") - 1);
+
+    if (content_length == NULL)
+    {
+        CMP_LOGE(TAG_AZ_HTTP, "response without Content-Length header");
+        return eAzureIoTHTTPSecurityAlertInvalidContentLength;
+    }
+
+    parsed->content_length = (uint32_t)strtoul(content_length, NULL, 10);
+
+    // "Content-Range: bytes 0-1023/4096"
+    const char *content_range = http_response_find_header(response, headers_length, "content-range", sizeof("content-range") - 1);
+
+    if (content_range != NULL && strncasecmp(content_range, "bytes ", sizeof("bytes ") - 1) == 0)
+    {
+        parsed->range_start = (uint32_t)strtoul(content_range + sizeof("bytes ") - 1, NULL, 10);
+    }
+
+    parsed->connection_close = http_response_has_connection_close(response, headers_length);
+
+    return eAzureIoTHTTPSuccess;
 }
\ No newline at end of file
@@ -1,14 +1,37 @@
+#include <stdatomic.h>
+#include <stdlib.h>
 #include <string.h>
 #include "esp32_iot_azure/azure_iot_hub.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "infrastructure/time.h"
 #include "infrastructure/crypto.h"
 #include "infrastructure/transport.h"
 #include "infrastructure/azure_transport_interface.h"
+#include "infrastructure/metrics.h"
+#include "azure_iot_config.h"
 #include "config.h"
+#include "assertion.h"
 #include "log.h"
 
 static const char TAG_AZ_IOT[] = "AZ_IOT_HUB";
 
+// The MQTT loop sends a PINGREQ once the connection is idle for the keep-alive interval.
+#define HUB_KEEP_ALIVE_MS (azureiotconfigKEEP_ALIVE_TIMEOUT_SECONDS * 1000U)
+
+typedef struct
+{
+    uint16_t packet_id;
+    uint8_t *message; /** @brief Properties followed by the payload, copied to be sent again. */
+    uint32_t properties_length;
+    uint32_t payload_length;
+    AzureIoTMessageProperties_t properties; /** @brief Properties on the message copy. */
+    azure_iot_hub_telemetry_callback_t callback;
+    void *callback_context;
+    uint64_t sent_at_us; /** @brief When last sent, to measure the acknowledgment. */
+} hub_publish_window_entry_t;
+
 struct azure_iot_hub_context_t
 {
     AzureIoTHubClient_t iot_client;
@@ -16,8 +39,29 @@ struct azure_iot_hub_context_t
     AzureIoTHubClientOptions_t iot_client_options;
     transport_t *transport;
     buffer_t *mqtt_buffer;
+    AzureIoTHubClientTelemetryCallback_t telemetry_callback; /** @brief User `xTelemetryCallback` option. */
+    hub_publish_window_entry_t publish_window[CONFIG_ESP32_IOT_AZURE_HUB_PUBLISH_WINDOW_SIZE];
+    uint8_t publish_window_count;
+    azure_iot_hub_context_t *next; /** @brief Next context created, to match acknowledgments. */
+    TaskHandle_t processing_task;  /** @brief Task running the MQTT loop; `NULL` when not running. */
 };
 
+// The middleware telemetry callback has no context: acknowledgments are matched to
+// the context whose MQTT loop runs on the calling task. Contexts are created, freed
+// and processed by any task: the list and their processing tasks are guarded by the lock,
+// created with the first context and kept for the process lifetime.
+static azure_iot_hub_context_t *HUB_CONTEXTS = NULL;
+static _Atomic(SemaphoreHandle_t) HUB_LOCK = NULL;
+
+static bool azure_iot_hub_lock_init();
+static AzureIoTResult_t azure_iot_hub_process(azure_iot_hub_context_t *context, uint32_t timeout_ms);
+static void azure_iot_hub_set_processing_task(azure_iot_hub_context_t *context, TaskHandle_t task);
+static void azure_iot_hub_on_telemetry_acknowledged(uint16_t packet_id);
+static bool azure_iot_hub_publish_window_acknowledge(azure_iot_hub_context_t *context, uint16_t packet_id);
+static AzureIoTResult_t azure_iot_hub_publish_window_send(azure_iot_hub_context_t *context, hub_publish_window_entry_t *entry);
+static AzureIoTResult_t azure_iot_hub_publish_window_resend(azure_iot_hub_context_t *context);
+static void azure_iot_hub_publish_window_discard(azure_iot_hub_context_t *context);
+
 azure_iot_hub_context_t *azure_iot_hub_create(buffer_t *mqtt_buffer)
 {
     if (mqtt_buffer == NULL || mqtt_buffer->buffer == NULL)
@@ -26,13 +70,36 @@ azure_iot_hub_context_t *azure_iot_hub_create(buffer_t *mqtt_buffer)
         return NULL;
     }
 
+    CMP_CHECK(TAG_AZ_IOT, azure_iot_hub_lock_init(), "failure creating lock", NULL)
+
     azure_iot_hub_context_t *context = (azure_iot_hub_context_t *)malloc(sizeof(azure_iot_hub_context_t));
 
+    CMP_CHECK(TAG_AZ_IOT, (context != NULL), "failure allocating context", NULL)
+
     memset(context, 0, sizeof(azure_iot_hub_context_t));
 
-    context->transport = transport_create_azure();
+    if ((context->transport = transport_create_azure()) == NULL)
+    {
+        CMP_LOGE(TAG_AZ_IOT, "failure creating transport");
+        free(context);
+        return NULL;
+    }
+
     context->mqtt_buffer = mqtt_buffer;
 
+    SemaphoreHandle_t lock = atomic_load(&HUB_LOCK);
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    context->next = HUB_CONTEXTS;
+    HUB_CONTEXTS = context;
+
+    xSemaphoreGive(lock);
+
+#if CONFIG_ESP32_IOT_AZURE_TRANSPORT_TLS_SESSION_REUSE
+    transport_enable_session_reuse(context->transport);
+#endif
+
     return context;
 }
 
@@ -66,6 +133,13 @@ AzureIoTResult_t azure_iot_hub_init(azure_iot_hub_context_t *context,
 {
     azure_transport_interface_init(context->transport, &context->transport_interface);
 
+    // Invoked by azure_iot_hub_on_telemetry_acknowledged; kept if initialized again.
+    if (context->iot_client_options.xTelemetryCallback != azure_iot_hub_on_telemetry_acknowledged)
+    {
+        context->telemetry_callback = context->iot_client_options.xTelemetryCallback;
+        context->iot_client_options.xTelemetryCallback = azure_iot_hub_on_telemetry_acknowledged;
+    }
+
     return AzureIoTHubClient_Init(&context->iot_client,
                                   hostname,
                                   hostname_length,
@@ -107,13 +181,24 @@ AzureIoTResult_t azure_iot_hub_connect(azure_iot_hub_context_t *context)
         return eAzureIoTErrorFailed;
     }
 
+    uint64_t started_at_us = metrics_get_time_us();
     AzureIoTResult_t result = AzureIoTHubClient_Connect(&context->iot_client,
                                                         false,
                                                         &session_present,
                                                         CONFIG_ESP32_IOT_AZURE_HUB_CONNECT_TIMEOUT_MS);
+
+    metrics_record(AZURE_IOT_METRIC_HUB_CONNECT, started_at_us, result != eAzureIoTSuccess);
+
     if (result != eAzureIoTSuccess)
     {
         CMP_LOGE(TAG_AZ_IOT, "failure connecting to hub: %d", result);
+        return result;
+    }
+
+    // Not left connected with messages nothing sends again: they are on the next connection.
+    if ((result = azure_iot_hub_publish_window_resend(context)) != eAzureIoTSuccess)
+    {
+        azure_iot_hub_disconnect(context);
     }
 
     return result;
@@ -132,30 +217,45 @@ AzureIoTResult_t azure_iot_hub_subscribe_cloud_to_device_message(azure_iot_hub_c
                                                                  AzureIoTHubClientCloudToDeviceMessageCallback_t callback,
                                                                  void *callback_context)
 {
-    return AzureIoTHubClient_SubscribeCloudToDeviceMessage(&context->iot_client,
-                                                           callback,
-                                                           callback_context,
-                                                           CONFIG_ESP32_IOT_AZURE_HUB_SUBSCRIBE_TIMEOUT_MS);
+    uint64_t started_at_us = metrics_get_time_us();
+    AzureIoTResult_t result = AzureIoTHubClient_SubscribeCloudToDeviceMessage(&context->iot_client,
+                                                                              callback,
+                                                                              callback_context,
+                                                                              CONFIG_ESP32_IOT_AZURE_HUB_SUBSCRIBE_TIMEOUT_MS);
+
+    metrics_record(AZURE_IOT_METRIC_HUB_SUBSCRIBE, started_at_us, result != eAzureIoTSuccess);
+
+    return result;
 }
 
 AzureIoTResult_t azure_iot_hub_subscribe_command(azure_iot_hub_context_t *context,
                                                  AzureIoTHubClientCommandCallback_t callback,
                                                  void *callback_context)
 {
-    return AzureIoTHubClient_SubscribeCommand(&context->iot_client,
-                                              callback,
-                                              callback_context,
-                                              CONFIG_ESP32_IOT_AZURE_HUB_SUBSCRIBE_TIMEOUT_MS);
+    uint64_t started_at_us = metrics_get_time_us();
+    AzureIoTResult_t result = AzureIoTHubClient_SubscribeCommand(&context->iot_client,
+                                                                 callback,
+                                                                 callback_context,
+                                                                 CONFIG_ESP32_IOT_AZURE_HUB_SUBSCRIBE_TIMEOUT_MS);
+
+    metrics_record(AZURE_IOT_METRIC_HUB_SUBSCRIBE, started_at_us, result != eAzureIoTSuccess);
+
+    return result;
 }
 
 AzureIoTResult_t azure_iot_hub_subscribe_properties(azure_iot_hub_context_t *context,
                                                     AzureIoTHubClientPropertiesCallback_t callback,
                                                     void *callback_context)
 {
-    return AzureIoTHubClient_SubscribeProperties(&context->iot_client,
-                                                 callback,
-                                                 callback_context,
-                                                 CONFIG_ESP32_IOT_AZURE_HUB_SUBSCRIBE_TIMEOUT_MS);
+    uint64_t started_at_us = metrics_get_time_us();
+    AzureIoTResult_t result = AzureIoTHubClient_SubscribeProperties(&context->iot_client,
+                                                                    callback,
+                                                                    callback_context,
+                                                                    CONFIG_ESP32_IOT_AZURE_HUB_SUBSCRIBE_TIMEOUT_MS);
+
+    metrics_record(AZURE_IOT_METRIC_HUB_SUBSCRIBE, started_at_us, result != eAzureIoTSuccess);
+
+    return result;
 }
 
 AzureIoTResult_t azure_iot_hub_unsubscribe_cloud_to_device_message(azure_iot_hub_context_t *context)
@@ -228,21 +328,324 @@ AzureIoTResult_t azure_iot_hub_send_telemetry(azure_iot_hub_context_t *context,
                                            packet_id);
 }
 
+AzureIoTResult_t azure_iot_hub_send_telemetry_async(azure_iot_hub_context_t *context,
+                                                    const uint8_t *payload,
+                                                    uint32_t payload_length,
+                                                    const uint8_t *properties,
+                                                    uint32_t properties_length,
+                                                    azure_iot_hub_telemetry_callback_t callback,
+                                                    void *callback_context)
+{
+    const uint32_t wait_ms = CONFIG_ESP32_IOT_AZURE_HUB_PUBLISH_WINDOW_WAIT_MS;
+    TickType_t started_at = xTaskGetTickCount();
+
+    while (context->publish_window_count == CONFIG_ESP32_IOT_AZURE_HUB_PUBLISH_WINDOW_SIZE)
+    {
+        if (pdTICKS_TO_MS(xTaskGetTickCount() - started_at) >= wait_ms)
+        {
+            return eAzureIoTErrorPending;
+        }
+
+        // Zero timeout: returns as soon as the pending packets are processed.
+        AzureIoTResult_t result = azure_iot_hub_process(context, 0);
+
+        if (result != eAzureIoTSuccess)
+        {
+            return result;
+        }
+    }
+
+    hub_publish_window_entry_t *entry = &context->publish_window[context->publish_window_count];
+
+    if (properties == NULL)
+    {
+        properties_length = 0;
+    }
+
+    memset(entry, 0, sizeof(hub_publish_window_entry_t));
+
+    entry->message = (uint8_t *)malloc(properties_length + payload_length);
+
+    CMP_CHECK(TAG_AZ_IOT, (entry->message != NULL || properties_length + payload_length == 0), "failure allocating message", eAzureIoTErrorOutOfMemory)
+
+    entry->properties_length = properties_length;
+    entry->payload_length = payload_length;
+    entry->callback = callback;
+    entry->callback_context = callback_context;
+
+    if (properties_length > 0)
+    {
+        memcpy(entry->message, properties, properties_length);
+
+        AzureIoTMessage_PropertiesInit(&entry->properties, entry->message, properties_length, properties_length);
+    }
+
+    memcpy(entry->message + properties_length, payload, payload_length);
+
+    AzureIoTResult_t result = azure_iot_hub_publish_window_send(context, entry);
+
+    if (result != eAzureIoTSuccess)
+    {
+        free(entry->message);
+        return result;
+    }
+
+    context->publish_window_count++;
+
+    return eAzureIoTSuccess;
+}
+
+uint32_t azure_iot_hub_get_telemetry_in_flight(const azure_iot_hub_context_t *context)
+{
+    return context->publish_window_count;
+}
+
 AzureIoTResult_t azure_iot_hub_process_loop(azure_iot_hub_context_t *context)
 {
-    return AzureIoTHubClient_ProcessLoop(&context->iot_client, CONFIG_ESP32_IOT_AZURE_HUB_LOOP_TIMEOUT_MS);
+    return azure_iot_hub_process(context, CONFIG_ESP32_IOT_AZURE_HUB_LOOP_TIMEOUT_MS);
+}
+
+AzureIoTResult_t azure_iot_hub_process_events(azure_iot_hub_context_t *context, uint32_t max_wait_ms)
+{
+    uint32_t idle_ms = transport_get_idle_ms(context->transport);
+    uint32_t keep_alive_due_ms = idle_ms < HUB_KEEP_ALIVE_MS ? HUB_KEEP_ALIVE_MS - idle_ms : 0;
+    uint32_t wait_ms = max_wait_ms < keep_alive_due_ms ? max_wait_ms : keep_alive_due_ms;
+
+    switch (transport_wait(context->transport, wait_ms))
+    {
+    case TRANSPORT_WAIT_UNSUPPORTED:
+        // Blocks on the read instead.
+        return azure_iot_hub_process_loop(context);
+    case TRANSPORT_WAIT_WOKEN:
+        return eAzureIoTSuccess;
+    case TRANSPORT_WAIT_TIMEOUT:
+        if (wait_ms < keep_alive_due_ms)
+        {
+            return eAzureIoTSuccess;
+        }
+        break;
+    default:
+        // Readable, or failed: reported by the loop reading.
+        break;
+    }
+
+    // Only reads the bytes received: returns as soon as they are processed.
+    azure_transport_interface_set_receive_timeout(&context->transport_interface, 0);
+
+    AzureIoTResult_t result = azure_iot_hub_process(context, 0);
+
+    azure_transport_interface_set_receive_timeout(&context->transport_interface, CONFIG_ESP32_IOT_AZURE_TRANSPORT_RECEIVE_TIMEOUT_MS);
+
+    return result;
+}
+
+void azure_iot_hub_wake(azure_iot_hub_context_t *context)
+{
+    transport_wake(context->transport);
 }
 
 void azure_iot_hub_deinit(azure_iot_hub_context_t *context)
 {
+    azure_iot_hub_publish_window_discard(context);
+
     AzureIoTHubClient_Deinit(&context->iot_client);
 }
 
 void azure_iot_hub_free(azure_iot_hub_context_t *context)
 {
+    SemaphoreHandle_t lock = atomic_load(&HUB_LOCK);
+    azure_iot_hub_context_t **link = &HUB_CONTEXTS;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    while (*link != NULL && *link != context)
+    {
+        link = &(*link)->next;
+    }
+
+    if (*link != NULL)
+    {
+        *link = context->next;
+    }
+
+    xSemaphoreGive(lock);
+
+    azure_iot_hub_publish_window_discard(context);
     azure_transport_interface_free(&context->transport_interface);
 
     transport_free(context->transport);
 
     free(context);
-}
\ No newline at end of file
+}
+
+//
+// PRIVATE
+//
+
+static bool azure_iot_hub_lock_init()
+{
+    if (atomic_load(&HUB_LOCK) != NULL)
+    {
+        return true;
+    }
+
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    SemaphoreHandle_t expected = NULL;
+
+    if (lock == NULL)
+    {
+        return false;
+    }
+
+    // Creators may race to create it: the first one wins.
+    if (!atomic_compare_exchange_strong(&HUB_LOCK, &expected, lock))
+    {
+        vSemaphoreDelete(lock);
+    }
+
+    return true;
+}
+
+static AzureIoTResult_t azure_iot_hub_process(azure_iot_hub_context_t *context, uint32_t timeout_ms)
+{
+    azure_iot_hub_set_processing_task(context, xTaskGetCurrentTaskHandle());
+
+    AzureIoTResult_t result = AzureIoTHubClient_ProcessLoop(&context->iot_client, timeout_ms);
+
+    azure_iot_hub_set_processing_task(context, NULL);
+
+    return result;
+}
+
+static void azure_iot_hub_set_processing_task(azure_iot_hub_context_t *context, TaskHandle_t task)
+{
+    SemaphoreHandle_t lock = atomic_load(&HUB_LOCK);
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    context->processing_task = task;
+
+    xSemaphoreGive(lock);
+}
+
+static void azure_iot_hub_on_telemetry_acknowledged(uint16_t packet_id)
+{
+    SemaphoreHandle_t lock = atomic_load(&HUB_LOCK);
+    TaskHandle_t current_task = xTaskGetCurrentTaskHandle();
+    azure_iot_hub_context_t *context = NULL;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    for (azure_iot_hub_context_t *candidate = HUB_CONTEXTS; candidate != NULL && context == NULL; candidate = candidate->next)
+    {
+        if (candidate->processing_task == current_task)
+        {
+            context = candidate;
+        }
+    }
+
+    // Processed by the middleware outside azure_iot_hub_process, like while subscribing:
+    // only unambiguous with a single context.
+    if (context == NULL && HUB_CONTEXTS != NULL && HUB_CONTEXTS->next == NULL)
+    {
+        context = HUB_CONTEXTS;
+    }
+
+    xSemaphoreGive(lock);
+
+    if (context == NULL)
+    {
+        CMP_LOGW(TAG_AZ_IOT, "acknowledgment %u of an unknown context: dropped", packet_id);
+        return;
+    }
+
+    // Packet identifiers are per connection: only the window of the context processed can
+    // hold it. Not found, it is from azure_iot_hub_send_telemetry.
+    azure_iot_hub_publish_window_acknowledge(context, packet_id);
+
+    if (context->telemetry_callback != NULL)
+    {
+        context->telemetry_callback(packet_id);
+    }
+}
+
+static bool azure_iot_hub_publish_window_acknowledge(azure_iot_hub_context_t *context, uint16_t packet_id)
+{
+    for (uint8_t i = 0; i < context->publish_window_count; i++)
+    {
+        hub_publish_window_entry_t entry = context->publish_window[i];
+
+        if (entry.packet_id != packet_id)
+        {
+            continue;
+        }
+
+        context->publish_window_count--;
+
+        // Kept in send order, to be sent again in order.
+        memmove(&context->publish_window[i],
+                &context->publish_window[i + 1],
+                (context->publish_window_count - i) * sizeof(hub_publish_window_entry_t));
+
+        free(entry.message);
+
+        metrics_record(AZURE_IOT_METRIC_HUB_PUBACK, entry.sent_at_us, false);
+
+        if (entry.callback != NULL)
+        {
+            entry.callback(eAzureIoTSuccess, entry.callback_context);
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+static AzureIoTResult_t azure_iot_hub_publish_window_send(azure_iot_hub_context_t *context, hub_publish_window_entry_t *entry)
+{
+    entry->sent_at_us = metrics_get_time_us();
+
+    return AzureIoTHubClient_SendTelemetry(&context->iot_client,
+                                           entry->message + entry->properties_length,
+                                           entry->payload_length,
+                                           entry->properties_length > 0 ? &entry->properties : NULL,
+                                           eAzureIoTHubMessageQoS1,
+                                           &entry->packet_id);
+}
+
+static AzureIoTResult_t azure_iot_hub_publish_window_resend(azure_iot_hub_context_t *context)
+{
+    for (uint8_t i = 0; i < context->publish_window_count; i++)
+    {
+        AzureIoTResult_t result = azure_iot_hub_publish_window_send(context, &context->publish_window[i]);
+
+        if (result != eAzureIoTSuccess)
+        {
+            CMP_LOGE(TAG_AZ_IOT, "failure sending publish window again: %d", result);
+            return result;
+        }
+    }
+
+    if (context->publish_window_count > 0)
+    {
+        CMP_LOGI(TAG_AZ_IOT, "publish window sent again: %d", context->publish_window_count);
+    }
+
+    return eAzureIoTSuccess;
+}
+
+static void azure_iot_hub_publish_window_discard(azure_iot_hub_context_t *context)
+{
+    while (context->publish_window_count > 0)
+    {
+        hub_publish_window_entry_t entry = context->publish_window[--context->publish_window_count];
+
+        free(entry.message);
+
+        if (entry.callback != NULL)
+        {
+            entry.callback(eAzureIoTErrorFailed, entry.callback_context);
+        }
+    }
+}
@@ -0,0 +1,375 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp32_iot_azure/azure_iot_hub_task.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "infrastructure/backoff_algorithm.h"
+#include "config.h"
+#include "assertion.h"
+#include "log.h"
+
+static const char TAG_HUB_TASK[] = "AZ_HUB_TASK";
+
+typedef enum
+{
+    HUB_TASK_REQUEST_TELEMETRY = 0,
+    HUB_TASK_REQUEST_PROPERTIES_REPORTED,
+    HUB_TASK_REQUEST_COMMAND_RESPONSE
+} hub_task_request_type_t;
+
+typedef struct
+{
+    hub_task_request_type_t type;
+    uint8_t *data;          /** @brief Copy of the prefix followed by the payload. */
+    uint32_t prefix_length; /** @brief Telemetry properties or command request id length. */
+    uint32_t payload_length;
+    AzureIoTHubMessageQoS_t qos;
+    uint32_t status_code;
+} hub_task_request_t;
+
+struct azure_iot_hub_task_t
+{
+    azure_iot_hub_context_t *hub_context;
+    QueueHandle_t requests;
+    SemaphoreHandle_t stopped; /** @brief Given by the task when exiting. */
+    SemaphoreHandle_t lock;    /** @brief Guards the statistics, updated by every task. */
+    _Atomic(bool) stopping;    /** @brief Set by @ref azure_iot_hub_task_free. */
+    TaskHandle_t task;
+    azure_iot_hub_task_statistics_t statistics;
+};
+
+static void azure_iot_hub_task_run(void *arg);
+static AzureIoTResult_t azure_iot_hub_task_enqueue(azure_iot_hub_task_t *task,
+                                                   hub_task_request_t *request,
+                                                   const uint8_t *prefix,
+                                                   const uint8_t *payload);
+static AzureIoTResult_t azure_iot_hub_task_execute(azure_iot_hub_task_t *task, const hub_task_request_t *request);
+static void azure_iot_hub_task_wake(azure_iot_hub_task_t *task);
+static void azure_iot_hub_task_count(azure_iot_hub_task_t *task, uint32_t *counter);
+static void azure_iot_hub_task_release(azure_iot_hub_task_t *task);
+
+azure_iot_hub_task_t *azure_iot_hub_task_create(azure_iot_hub_context_t *hub_context)
+{
+    azure_iot_hub_task_t *task = (azure_iot_hub_task_t *)malloc(sizeof(azure_iot_hub_task_t));
+
+    CMP_CHECK(TAG_HUB_TASK, (task != NULL), "failure allocating task", NULL)
+
+    memset(task, 0, sizeof(azure_iot_hub_task_t));
+
+    task->hub_context = hub_context;
+    task->requests = xQueueCreate(CONFIG_ESP32_IOT_AZURE_HUB_TASK_QUEUE_LENGTH, sizeof(hub_task_request_t));
+    task->stopped = xSemaphoreCreateBinary();
+    task->lock = xSemaphoreCreateMutex();
+
+    if (task->requests == NULL || task->stopped == NULL || task->lock == NULL)
+    {
+        CMP_LOGE(TAG_HUB_TASK, "failure creating queue");
+        azure_iot_hub_task_release(task);
+        return NULL;
+    }
+
+    if (xTaskCreatePinnedToCore(azure_iot_hub_task_run,
+                                "az_hub",
+                                CONFIG_ESP32_IOT_AZURE_HUB_TASK_STACK_SIZE,
+                                task,
+                                CONFIG_ESP32_IOT_AZURE_HUB_TASK_PRIORITY,
+                                &task->task,
+                                CONFIG_ESP32_IOT_AZURE_HUB_TASK_CORE < 0 ? tskNO_AFFINITY : CONFIG_ESP32_IOT_AZURE_HUB_TASK_CORE) != pdPASS)
+    {
+        CMP_LOGE(TAG_HUB_TASK, "failure creating task");
+        azure_iot_hub_task_release(task);
+        return NULL;
+    }
+
+    return task;
+}
+
+AzureIoTResult_t azure_iot_hub_task_send_telemetry(azure_iot_hub_task_t *task,
+                                                   const uint8_t *payload,
+                                                   uint32_t payload_length,
+                                                   const uint8_t *properties,
+                                                   uint32_t properties_length,
+                                                   AzureIoTHubMessageQoS_t qos)
+{
+    hub_task_request_t request = {
+        .type = HUB_TASK_REQUEST_TELEMETRY,
+        .prefix_length = properties == NULL ? 0 : properties_length,
+        .payload_length = payload_length,
+        .qos = qos};
+
+    return azure_iot_hub_task_enqueue(task, &request, properties, payload);
+}
+
+AzureIoTResult_t azure_iot_hub_task_send_properties_reported(azure_iot_hub_task_t *task,
+                                                             const uint8_t *payload,
+                                                             uint32_t payload_length)
+{
+    hub_task_request_t request = {
+        .type = HUB_TASK_REQUEST_PROPERTIES_REPORTED,
+        .payload_length = payload_length};
+
+    return azure_iot_hub_task_enqueue(task, &request, NULL, payload);
+}
+
+AzureIoTResult_t azure_iot_hub_task_send_command_response(azure_iot_hub_task_t *task,
+                                                          const AzureIoTHubClientCommandRequest_t *command_request,
+                                                          const uint8_t *payload,
+                                                          uint32_t payload_length,
+                                                          uint32_t status_code)
+{
+    hub_task_request_t request = {
+        .type = HUB_TASK_REQUEST_COMMAND_RESPONSE,
+        .prefix_length = command_request->usRequestIDLength,
+        .payload_length = payload == NULL ? 0 : payload_length,
+        .status_code = status_code};
+
+    return azure_iot_hub_task_enqueue(task, &request, command_request->pucRequestID, payload);
+}
+
+void azure_iot_hub_task_get_statistics(const azure_iot_hub_task_t *task,
+                                       azure_iot_hub_task_statistics_t *statistics)
+{
+    xSemaphoreTake(task->lock, portMAX_DELAY);
+
+    *statistics = task->statistics;
+
+    xSemaphoreGive(task->lock);
+}
+
+void azure_iot_hub_task_free(azure_iot_hub_task_t *task)
+{
+    // Not a request: the queue may be full, and a request waiting for
+    // room on the publish window keeps the task from reading it.
+    atomic_store(&task->stopping, true);
+    azure_iot_hub_task_wake(task);
+    xSemaphoreTake(task->stopped, portMAX_DELAY);
+
+    azure_iot_hub_task_release(task);
+}
+
+//
+// PRIVATE
+//
+
+static void azure_iot_hub_task_run(void *arg)
+{
+    azure_iot_hub_task_t *task = (azure_iot_hub_task_t *)arg;
+    hub_task_request_t request;
+    uint32_t backoff_ms = 0;
+    bool has_request = false;
+    bool stopping = false;
+
+    while (!stopping)
+    {
+        if (!has_request)
+        {
+            has_request = xQueueReceive(task->requests, &request, 0) == pdTRUE;
+        }
+
+        while (has_request)
+        {
+            AzureIoTResult_t result = azure_iot_hub_task_execute(task, &request);
+
+            // Publish window full: sent once acknowledgments are received.
+            if (result == eAzureIoTErrorPending)
+            {
+                break;
+            }
+
+            if (result == eAzureIoTSuccess)
+            {
+                azure_iot_hub_task_count(task, &task->statistics.sent);
+            }
+            else
+            {
+                CMP_LOGE(TAG_HUB_TASK, "failure sending request %d: %d", request.type, result);
+
+                azure_iot_hub_task_count(task, &task->statistics.failed);
+            }
+
+            free(request.data);
+
+            has_request = xQueueReceive(task->requests, &request, 0) == pdTRUE;
+        }
+
+        // Read once the queue is drained: the requests enqueued before stopping are
+        // sent, unless one is waiting for room on the publish window.
+        stopping = atomic_load(&task->stopping);
+
+        if (!stopping)
+        {
+            // Sleeps until bytes are received, like the acknowledgments a request waiting for
+            // room on the publish window needs, or until a request is enqueued, waking the hub.
+            AzureIoTResult_t result = azure_iot_hub_process_events(task->hub_context, UINT32_MAX);
+
+            if (result == eAzureIoTSuccess)
+            {
+                backoff_ms = 0;
+            }
+            else
+            {
+                backoff_ms = backoff_algorithm_get_decorrelated(CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_BASE_MS,
+                                                                CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_MAX_DELAY_MS,
+                                                                backoff_ms);
+
+                CMP_LOGE(TAG_HUB_TASK, "failure processing events: %d, retrying in %lu ms", result, (unsigned long)backoff_ms);
+
+                azure_iot_hub_task_count(task, &task->statistics.process_failures);
+
+                // Fails right away while disconnected: waits instead of spinning,
+                // still woken by the requests enqueued and by stopping.
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(backoff_ms));
+            }
+        }
+    }
+
+    if (has_request)
+    {
+        free(request.data);
+    }
+
+    while (xQueueReceive(task->requests, &request, 0) == pdTRUE)
+    {
+        free(request.data);
+    }
+
+    xSemaphoreGive(task->stopped);
+
+    vTaskDelete(NULL);
+}
+
+static AzureIoTResult_t azure_iot_hub_task_enqueue(azure_iot_hub_task_t *task,
+                                                   hub_task_request_t *request,
+                                                   const uint8_t *prefix,
+                                                   const uint8_t *payload)
+{
+    request->data = (uint8_t *)malloc(request->prefix_length + request->payload_length);
+
+    CMP_CHECK(TAG_HUB_TASK, (request->data != NULL || request->prefix_length + request->payload_length == 0), "failure allocating request", eAzureIoTErrorOutOfMemory)
+
+    if (request->prefix_length > 0)
+    {
+        memcpy(request->data, prefix, request->prefix_length);
+    }
+
+    if (request->payload_length > 0)
+    {
+        memcpy(request->data + request->prefix_length, payload, request->payload_length);
+    }
+
+    // Never waits: the caller is not blocked by the network.
+    if (xQueueSend(task->requests, request, 0) != pdTRUE)
+    {
+        azure_iot_hub_task_count(task, &task->statistics.dropped);
+
+        free(request->data);
+        return eAzureIoTErrorOutOfMemory;
+    }
+
+    azure_iot_hub_task_wake(task);
+
+    return eAzureIoTSuccess;
+}
+
+static AzureIoTResult_t azure_iot_hub_task_execute(azure_iot_hub_task_t *task, const hub_task_request_t *request)
+{
+    const uint8_t *payload = request->data + request->prefix_length;
+
+    switch (request->type)
+    {
+    case HUB_TASK_REQUEST_TELEMETRY:
+    {
+        AzureIoTMessageProperties_t properties;
+        AzureIoTMessageProperties_t *properties_sent = NULL;
+
+        if (request->qos == eAzureIoTHubMessageQoS1)
+        {
+            return azure_iot_hub_send_telemetry_async(task->hub_context,
+                                                      payload,
+                                                      request->payload_length,
+                                                      request->data,
+                                                      request->prefix_length,
+                                                      NULL,
+                                                      NULL);
+        }
+
+        if (request->prefix_length > 0)
+        {
+            AzureIoTMessage_PropertiesInit(&properties, request->data, request->prefix_length, request->prefix_length);
+
+            properties_sent = &properties;
+        }
+
+        return azure_iot_hub_send_telemetry(task->hub_context,
+                                            payload,
+                                            request->payload_length,
+                                            properties_sent,
+                                            request->qos,
+                                            NULL);
+    }
+    case HUB_TASK_REQUEST_PROPERTIES_REPORTED:
+        return azure_iot_hub_send_properties_reported(task->hub_context,
+                                                      payload,
+                                                      request->payload_length,
+                                                      NULL);
+    case HUB_TASK_REQUEST_COMMAND_RESPONSE:
+    {
+        // Only the request id is used to respond.
+        AzureIoTHubClientCommandRequest_t command_request;
+
+        memset(&command_request, 0, sizeof(AzureIoTHubClientCommandRequest_t));
+
+        command_request.pucRequestID = request->data;
+        command_request.usRequestIDLength = (uint16_t)request->prefix_length;
+
+        return azure_iot_hub_send_command_response(task->hub_context,
+                                                   &command_request,
+                                                   request->payload_length == 0 ? NULL : payload,
+                                                   request->payload_length,
+                                                   request->status_code);
+    }
+    default:
+        return eAzureIoTErrorInvalidArgument;
+    }
+}
+
+static void azure_iot_hub_task_wake(azure_iot_hub_task_t *task)
+{
+    // Sleeping on the hub events, or backing off.
+    azure_iot_hub_wake(task->hub_context);
+    xTaskNotifyGive(task->task);
+}
+
+static void azure_iot_hub_task_count(azure_iot_hub_task_t *task, uint32_t *counter)
+{
+    xSemaphoreTake(task->lock, portMAX_DELAY);
+
+    (*counter)++;
+
+    xSemaphoreGive(task->lock);
+}
+
+static void azure_iot_hub_task_release(azure_iot_hub_task_t *task)
+{
+    if (task->lock != NULL)
+    {
+        vSemaphoreDelete(task->lock);
+    }
+
+    if (task->stopped != NULL)
+    {
+        vSemaphoreDelete(task->stopped);
+    }
+
+    if (task->requests != NULL)
+    {
+        vQueueDelete(task->requests);
+    }
+
+    free(task);
+}
\ No newline at end of file
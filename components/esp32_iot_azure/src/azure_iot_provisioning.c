@@ -1,10 +1,15 @@
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include "esp32_iot_azure/azure_iot_provisioning.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "infrastructure/time.h"
 #include "infrastructure/crypto.h"
 #include "infrastructure/transport.h"
 #include "infrastructure/azure_transport_interface.h"
+#include "infrastructure/provisioning_cache.h"
+#include "infrastructure/backoff_algorithm.h"
 #include "config.h"
 #include "assertion.h"
 #include "log.h"
@@ -18,8 +23,21 @@ struct azure_dps_context_t
     AzureIoTProvisioningClientOptions_t dps_client_options;
     transport_t *transport;
     buffer_t *mqtt_buffer;
+    const uint8_t *scope_id;        /** @brief Scope id the client was initialized with, keying the cache. */
+    uint32_t scope_id_length;
+    const uint8_t *registration_id; /** @brief Registration id the client was initialized with, keying the cache. */
+    uint32_t registration_id_length;
+    bool cached;                    /** @brief Whether the registration was loaded from the cache. */
+    TickType_t polled_at;           /** @brief When the last wait between polls ended, or the transport connected. */
+    provisioning_cache_t cache;
+    azure_dps_statistics_t statistics;
 };
 
+static bool azure_dps_cache_load(azure_dps_context_t *context);
+static void azure_dps_cache_save(azure_dps_context_t *context);
+static void azure_dps_initial_delay(azure_dps_context_t *context);
+static void azure_dps_poll_delay(azure_dps_context_t *context, backoff_algorithm_context_t *backoff_context);
+
 azure_dps_context_t *azure_dps_create(buffer_t *mqtt_buffer)
 {
     if (mqtt_buffer == NULL || mqtt_buffer->buffer == NULL)
@@ -30,11 +48,23 @@ azure_dps_context_t *azure_dps_create(buffer_t *mqtt_buffer)
 
     azure_dps_context_t *context = (azure_dps_context_t *)malloc(sizeof(azure_dps_context_t));
 
+    CMP_CHECK(TAG_AZ_DPS, (context != NULL), "failure allocating context", NULL)
+
     memset(context, 0, sizeof(azure_dps_context_t));
 
-    context->transport = transport_create_azure();
+    if ((context->transport = transport_create_azure()) == NULL)
+    {
+        CMP_LOGE(TAG_AZ_DPS, "failure creating transport");
+        free(context);
+        return NULL;
+    }
+
     context->mqtt_buffer = mqtt_buffer;
 
+#if CONFIG_ESP32_IOT_AZURE_TRANSPORT_TLS_SESSION_REUSE
+    transport_enable_session_reuse(context->transport);
+#endif
+
     return context;
 }
 
@@ -63,6 +93,12 @@ AzureIoTResult_t azure_dps_init(azure_dps_context_t *context,
 {
     azure_transport_interface_init(context->transport, &context->transport_interface);
 
+    context->scope_id = scope_id;
+    context->scope_id_length = scope_id_length;
+    context->registration_id = registration_id;
+    context->registration_id_length = registration_id_length;
+    context->cached = false;
+
     return AzureIoTProvisioningClient_Init(&context->dps_client,
                                            hostname,
                                            hostname_length,
@@ -104,6 +140,25 @@ AzureIoTResult_t azure_dps_set_registration_payload(azure_dps_context_t *context
 
 AzureIoTResult_t azure_dps_register(azure_dps_context_t *context)
 {
+    backoff_algorithm_context_t backoff_context;
+
+    memset(&context->statistics, 0, sizeof(azure_dps_statistics_t));
+
+    context->cached = false;
+
+#if CONFIG_ESP32_IOT_AZURE_DPS_CACHE_ENABLED
+    // Warm boot: the hub assigned on the last registration, without connecting to DPS.
+    if (azure_dps_cache_load(context))
+    {
+        CMP_LOGI(TAG_AZ_DPS, "registration cached: %.*s", (int)context->cache.hostname_length, (char *)context->cache.hostname);
+
+        context->cached = true;
+        return eAzureIoTSuccess;
+    }
+#endif
+
+    azure_dps_initial_delay(context);
+
     if (transport_connect(context->transport,
                           (const char *)context->dps_client._internal.pucEndpoint,
                           CONFIG_ESP32_IOT_AZURE_HUB_SERVER_PORT,
@@ -115,14 +170,34 @@ AzureIoTResult_t azure_dps_register(azure_dps_context_t *context)
 
     AzureIoTResult_t result = eAzureIoTErrorFailed;
 
+    context->polled_at = xTaskGetTickCount();
+
+    backoff_algorithm_initialize(&backoff_context,
+                                 CONFIG_ESP32_IOT_AZURE_DPS_POLL_BACKOFF_BASE_MS,
+                                 CONFIG_ESP32_IOT_AZURE_DPS_POLL_BACKOFF_MAX_DELAY_MS,
+                                 BACKOFF_ALGORITHM_RETRY_FOREVER);
     do
     {
         result = AzureIoTProvisioningClient_Register(&context->dps_client,
                                                      CONFIG_ESP32_IOT_AZURE_DPS_REGISTRATION_TIMEOUT_MS);
+
+        if (result == eAzureIoTErrorPending)
+        {
+            azure_dps_poll_delay(context, &backoff_context);
+        }
     } while (result == eAzureIoTErrorPending);
 
+    CMP_LOGI(TAG_AZ_DPS, "registration done: %d, after %lu polls", result, (unsigned long)context->statistics.polls);
+
     transport_disconnect(context->transport);
 
+#if CONFIG_ESP32_IOT_AZURE_DPS_CACHE_ENABLED
+    if (result == eAzureIoTSuccess)
+    {
+        azure_dps_cache_save(context);
+    }
+#endif
+
     return result;
 }
 
@@ -135,6 +210,17 @@ AzureIoTResult_t azure_dps_get_device_and_hub(azure_dps_context_t *context,
     CMP_CHECK(TAG_AZ_DPS, (*hostname_length >= AZURE_CONST_HOSTNAME_MAX_LENGTH), "small hostname buffer", eAzureIoTErrorOutOfMemory)
     CMP_CHECK(TAG_AZ_DPS, (*device_id_length >= AZURE_CONST_DEVICE_ID_MAX_LENGTH), "small device_id buffer", eAzureIoTErrorOutOfMemory)
 
+    if (context->cached)
+    {
+        memcpy(hostname, context->cache.hostname, context->cache.hostname_length);
+        memcpy(device_id, context->cache.device_id, context->cache.device_id_length);
+
+        *hostname_length = context->cache.hostname_length;
+        *device_id_length = context->cache.device_id_length;
+
+        return eAzureIoTSuccess;
+    }
+
     return AzureIoTProvisioningClient_GetDeviceAndHub(&context->dps_client,
                                                       hostname,
                                                       hostname_length,
@@ -142,6 +228,21 @@ AzureIoTResult_t azure_dps_get_device_and_hub(azure_dps_context_t *context,
                                                       device_id_length);
 }
 
+bool azure_dps_is_registration_cached(const azure_dps_context_t *context)
+{
+    return context->cached;
+}
+
+void azure_dps_get_statistics(const azure_dps_context_t *context, azure_dps_statistics_t *statistics)
+{
+    *statistics = context->statistics;
+}
+
+void azure_dps_clear_cache()
+{
+    provisioning_cache_clear();
+}
+
 AzureIoTResult_t azure_dps_get_extended_code(azure_dps_context_t *context, uint32_t *extended_code)
 {
     return AzureIoTProvisioningClient_GetExtendedCode(&context->dps_client, extended_code);
@@ -159,4 +260,116 @@ void azure_dps_free(azure_dps_context_t *context)
     transport_free(context->transport);
 
     free(context);
-}
\ No newline at end of file
+}
+
+//
+// PRIVATE
+//
+
+static bool azure_dps_cache_load(azure_dps_context_t *context)
+{
+    provisioning_cache_t *cache = &context->cache;
+
+    if (!provisioning_cache_load(cache))
+    {
+        return false;
+    }
+
+    // Registered with another scope or identity: not this device registration.
+    return cache->scope_id_length == context->scope_id_length &&
+           cache->registration_id_length == context->registration_id_length &&
+           memcmp(cache->scope_id, context->scope_id, context->scope_id_length) == 0 &&
+           memcmp(cache->registration_id, context->registration_id, context->registration_id_length) == 0 &&
+           cache->hostname_length > 0 &&
+           cache->hostname_length <= sizeof(cache->hostname) &&
+           cache->device_id_length > 0 &&
+           cache->device_id_length <= sizeof(cache->device_id);
+}
+
+static void azure_dps_cache_save(azure_dps_context_t *context)
+{
+    provisioning_cache_t *cache = &context->cache;
+    uint32_t hostname_length = sizeof(cache->hostname);
+    uint32_t device_id_length = sizeof(cache->device_id);
+
+    if (context->scope_id_length > sizeof(cache->scope_id) || context->registration_id_length > sizeof(cache->registration_id))
+    {
+        CMP_LOGW(TAG_AZ_DPS, "scope or registration id too long to be cached");
+        return;
+    }
+
+    memset(cache, 0, sizeof(provisioning_cache_t));
+
+    if (AzureIoTProvisioningClient_GetDeviceAndHub(&context->dps_client,
+                                                   cache->hostname,
+                                                   &hostname_length,
+                                                   cache->device_id,
+                                                   &device_id_length) != eAzureIoTSuccess)
+    {
+        CMP_LOGW(TAG_AZ_DPS, "failure getting device and hub to cache");
+        return;
+    }
+
+    memcpy(cache->scope_id, context->scope_id, context->scope_id_length);
+    memcpy(cache->registration_id, context->registration_id, context->registration_id_length);
+
+    cache->scope_id_length = (uint16_t)context->scope_id_length;
+    cache->registration_id_length = (uint16_t)context->registration_id_length;
+    cache->hostname_length = (uint16_t)hostname_length;
+    cache->device_id_length = (uint16_t)device_id_length;
+
+    provisioning_cache_save(cache);
+}
+
+static void azure_dps_initial_delay(azure_dps_context_t *context)
+{
+#if CONFIG_ESP32_IOT_AZURE_DPS_INITIAL_DELAY_MAX_MS > 0
+    backoff_algorithm_context_t backoff_context;
+    uint16_t delay_ms = 0U;
+
+    // A single attempt: a random delay up to the max.
+    backoff_algorithm_initialize(&backoff_context,
+                                 CONFIG_ESP32_IOT_AZURE_DPS_INITIAL_DELAY_MAX_MS,
+                                 CONFIG_ESP32_IOT_AZURE_DPS_INITIAL_DELAY_MAX_MS,
+                                 1U);
+    backoff_algorithm_get_next(&backoff_context, &delay_ms);
+
+    CMP_LOGI(TAG_AZ_DPS, "registering in %u ms", delay_ms);
+
+    vTaskDelay(pdMS_TO_TICKS(delay_ms));
+
+    context->statistics.initial_delay_ms = delay_ms;
+#else
+    (void)context;
+#endif
+}
+
+static void azure_dps_poll_delay(azure_dps_context_t *context, backoff_algorithm_context_t *backoff_context)
+{
+    // Only read: the client owns the response, keeping it until the next one.
+    const az_iot_provisioning_client_register_response *response = &context->dps_client._internal.xRegisterResponse;
+    uint32_t since_polled_ms = pdTICKS_TO_MS(xTaskGetTickCount() - context->polled_at);
+    uint16_t jitter_ms = 0U;
+
+    // Zero until an operation status response is received. A response waited for is not
+    // waited for again: the next one needs the client to write its request first.
+    if (response->retry_after_seconds == 0U || transport_get_idle_ms(context->transport) > since_polled_ms)
+    {
+        return;
+    }
+
+    uint32_t delay_ms = response->retry_after_seconds * 1000U;
+
+    backoff_algorithm_get_next(backoff_context, &jitter_ms);
+
+    delay_ms += jitter_ms;
+
+    context->statistics.polls++;
+    context->statistics.waited_ms += delay_ms;
+
+    CMP_LOGI(TAG_AZ_DPS, "assigning, polling in %lu ms", (unsigned long)delay_ms);
+
+    vTaskDelay(pdMS_TO_TICKS(delay_ms));
+
+    context->polled_at = xTaskGetTickCount();
+}
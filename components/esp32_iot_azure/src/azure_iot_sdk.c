@@ -1,12 +1,50 @@
 #include "esp32_iot_azure/azure_iot_sdk.h"
 #include "azure_iot.h"
+#include "infrastructure/azure_iot_certificate.h"
+#include "infrastructure/crypto.h"
+#include "infrastructure/tls_session_cache.h"
+#include "infrastructure/reconnect_policy.h"
+#include "infrastructure/metrics.h"
 
 AzureIoTResult_t azure_iot_sdk_init()
 {
+    if (!crypto_init() || !azure_iot_certificate_init() || !tls_session_cache_init() || !reconnect_policy_init() || !metrics_init())
+    {
+        return eAzureIoTErrorOutOfMemory;
+    }
+
     return AzureIoT_Init();
 }
 
 void azure_iot_sdk_deinit()
 {
     AzureIoT_Deinit();
+    metrics_deinit();
+    reconnect_policy_deinit();
+    tls_session_cache_deinit();
+    azure_iot_certificate_deinit();
+    crypto_deinit();
+}
+
+void azure_iot_sdk_get_tls_statistics(azure_iot_tls_statistics_t *statistics)
+{
+    tls_session_statistics_t session_statistics;
+
+    tls_session_cache_get_statistics(&session_statistics);
+
+    statistics->full_handshakes = session_statistics.full_handshakes;
+    statistics->resumed_handshakes = session_statistics.resumed_handshakes;
+}
+
+void azure_iot_sdk_get_reconnect_statistics(azure_iot_reconnect_statistics_t *statistics)
+{
+    reconnect_policy_statistics_t policy_statistics;
+
+    reconnect_policy_get_statistics(&policy_statistics);
+
+    statistics->attempts = policy_statistics.attempts;
+    statistics->failures = policy_statistics.failures;
+    statistics->circuit_opens = policy_statistics.circuit_opens;
+    statistics->rejected = policy_statistics.rejected;
+    statistics->network_down = policy_statistics.network_down;
 }
\ No newline at end of file
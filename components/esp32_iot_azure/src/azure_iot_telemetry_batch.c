@@ -0,0 +1,206 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp32_iot_azure/azure_iot_telemetry_batch.h"
+#include "esp32_iot_azure/extension/azure_iot_message_extension.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "assertion.h"
+#include "log.h"
+
+static const char TAG_TELEMETRY_BATCH[] = "AZ_TELEMETRY_BATCH";
+
+struct azure_iot_telemetry_batch_t
+{
+    azure_iot_hub_context_t *hub_context;
+    azure_iot_telemetry_queue_t *queue;
+    uint32_t time_to_live_s;
+    buffer_t *buffer;
+    uint32_t length; /** @brief Bytes of the array written, without the closing bracket. */
+    uint32_t sample_count;
+    uint32_t max_age_ms;
+    TickType_t started_at; /** @brief When the first sample was added. */
+    AzureIoTHubMessageQoS_t qos;
+    AzureIoTMessageProperties_t properties;
+    uint32_t properties_length; /** @brief Bytes of \ref properties_buffer written: what the queue stores. */
+    // Message format: /?property=value&property=value
+    // 6 + 1 -> $.sub=&
+    // 5 + 16 + 1 -> $.ct=application/json&
+    // 5 + 5 -> $.ce=utf-8
+    uint8_t properties_buffer[AZURE_CONST_COMPONENT_NAME_MAX_LENGTH + 7 + 22 + 10];
+};
+
+static AzureIoTResult_t azure_iot_telemetry_batch_build_properties(azure_iot_telemetry_batch_t *batch,
+                                                                   const uint8_t *component_name,
+                                                                   uint32_t component_name_length);
+
+azure_iot_telemetry_batch_t *azure_iot_telemetry_batch_create(azure_iot_hub_context_t *hub_context,
+                                                              const uint8_t *component_name,
+                                                              uint32_t component_name_length,
+                                                              buffer_t *buffer,
+                                                              uint32_t max_age_ms,
+                                                              AzureIoTHubMessageQoS_t qos)
+{
+    CMP_CHECK(TAG_TELEMETRY_BATCH, (buffer != NULL && buffer->buffer != NULL && buffer->length > 2), "buffer null", NULL)
+    CMP_CHECK(TAG_TELEMETRY_BATCH, (component_name_length <= AZURE_CONST_COMPONENT_NAME_MAX_LENGTH), "component name too long", NULL)
+
+    azure_iot_telemetry_batch_t *batch = (azure_iot_telemetry_batch_t *)malloc(sizeof(azure_iot_telemetry_batch_t));
+
+    CMP_CHECK(TAG_TELEMETRY_BATCH, (batch != NULL), "failure allocating batch", NULL)
+
+    memset(batch, 0, sizeof(azure_iot_telemetry_batch_t));
+
+    batch->hub_context = hub_context;
+    batch->buffer = buffer;
+    batch->max_age_ms = max_age_ms;
+    batch->qos = qos;
+
+    // Built once: sent with every batch.
+    AzureIoTResult_t result = azure_iot_telemetry_batch_build_properties(batch, component_name, component_name_length);
+
+    if (result != eAzureIoTSuccess)
+    {
+        CMP_LOGE(TAG_TELEMETRY_BATCH, "failure building properties: %d", result);
+
+        free(batch);
+        return NULL;
+    }
+
+    return batch;
+}
+
+void azure_iot_telemetry_batch_set_queue(azure_iot_telemetry_batch_t *batch,
+                                         azure_iot_telemetry_queue_t *queue,
+                                         uint32_t time_to_live_s)
+{
+    batch->queue = queue;
+    batch->time_to_live_s = time_to_live_s;
+}
+
+AzureIoTResult_t azure_iot_telemetry_batch_add(azure_iot_telemetry_batch_t *batch,
+                                               const uint8_t *sample,
+                                               uint32_t sample_length)
+{
+    // Brackets included.
+    CMP_CHECK(TAG_TELEMETRY_BATCH, (sample_length <= batch->buffer->length - 2), "sample larger than the buffer", eAzureIoTErrorOutOfMemory)
+
+    // Separator and closing bracket.
+    if (batch->sample_count > 0 && batch->length + 1 + sample_length + 1 > batch->buffer->length)
+    {
+        AzureIoTResult_t result = azure_iot_telemetry_batch_flush(batch);
+
+        if (result != eAzureIoTSuccess)
+        {
+            return result;
+        }
+    }
+
+    if (batch->sample_count == 0)
+    {
+        batch->buffer->buffer[0] = '[';
+        batch->length = 1;
+        batch->started_at = xTaskGetTickCount();
+    }
+    else
+    {
+        batch->buffer->buffer[batch->length++] = ',';
+    }
+
+    memcpy(batch->buffer->buffer + batch->length, sample, sample_length);
+
+    batch->length += sample_length;
+    batch->sample_count++;
+
+    return eAzureIoTSuccess;
+}
+
+AzureIoTResult_t azure_iot_telemetry_batch_process(azure_iot_telemetry_batch_t *batch)
+{
+    if (batch->sample_count == 0 ||
+        batch->max_age_ms == 0 ||
+        pdTICKS_TO_MS(xTaskGetTickCount() - batch->started_at) < batch->max_age_ms)
+    {
+        return eAzureIoTSuccess;
+    }
+
+    return azure_iot_telemetry_batch_flush(batch);
+}
+
+AzureIoTResult_t azure_iot_telemetry_batch_flush(azure_iot_telemetry_batch_t *batch)
+{
+    AzureIoTResult_t result;
+
+    if (batch->sample_count == 0)
+    {
+        return eAzureIoTSuccess;
+    }
+
+    // Written over by the next sample if the send fails.
+    batch->buffer->buffer[batch->length] = ']';
+
+    if (batch->queue != NULL)
+    {
+        result = azure_iot_telemetry_queue_send(batch->queue,
+                                                batch->buffer->buffer,
+                                                batch->length + 1,
+                                                batch->properties_buffer,
+                                                batch->properties_length,
+                                                batch->qos,
+                                                batch->time_to_live_s);
+    }
+    else
+    {
+        result = azure_iot_hub_send_telemetry(batch->hub_context,
+                                              batch->buffer->buffer,
+                                              batch->length + 1,
+                                              &batch->properties,
+                                              batch->qos,
+                                              NULL);
+    }
+
+    if (result != eAzureIoTSuccess)
+    {
+        CMP_LOGE(TAG_TELEMETRY_BATCH, "failure sending batch: %d", result);
+        return result;
+    }
+
+    batch->sample_count = 0;
+    batch->length = 0;
+
+    return eAzureIoTSuccess;
+}
+
+uint32_t azure_iot_telemetry_batch_get_sample_count(const azure_iot_telemetry_batch_t *batch)
+{
+    return batch->sample_count;
+}
+
+void azure_iot_telemetry_batch_free(azure_iot_telemetry_batch_t *batch)
+{
+    free(batch);
+}
+
+//
+// PRIVATE
+//
+
+static AzureIoTResult_t azure_iot_telemetry_batch_build_properties(azure_iot_telemetry_batch_t *batch,
+                                                                   const uint8_t *component_name,
+                                                                   uint32_t component_name_length)
+{
+    AZ_CHECK_BEGIN()
+
+    AZ_CHECK(AzureIoTMessage_PropertiesInit(&batch->properties, batch->properties_buffer, 0, sizeof(batch->properties_buffer)))
+
+    if (component_name != NULL && component_name_length > 0)
+    {
+        AZ_CHECK(AzureIoTMessage_PropertiesAppendComponentName(&batch->properties, component_name, component_name_length))
+    }
+
+    AZ_CHECK(AzureIoTMessage_PropertiesAppendContentType(&batch->properties, (const uint8_t *)"application/json", sizeof("application/json") - 1))
+    AZ_CHECK(AzureIoTMessage_PropertiesAppendContentEncoding(&batch->properties, (const uint8_t *)"utf-8", sizeof("utf-8") - 1))
+
+    // The middleware has no getter for the serialized length.
+    batch->properties_length = (uint32_t)batch->properties._internal.xProperties._internal.properties_written;
+
+    AZ_CHECK_RETURN_LAST()
+}
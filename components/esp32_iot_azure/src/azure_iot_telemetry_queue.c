@@ -0,0 +1,321 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp32_iot_azure/azure_iot_telemetry_queue.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "infrastructure/telemetry_log.h"
+#include "infrastructure/time.h"
+#include "config.h"
+#include "assertion.h"
+#include "log.h"
+
+// A stored QoS 1 message not acknowledged in this time was lost
+// with the connection: it is sent again.
+#define TELEMETRY_QUEUE_ACK_TIMEOUT_MS CONFIG_ESP32_IOT_AZURE_HUB_SUBSCRIBE_TIMEOUT_MS
+
+static const char TAG_TELEMETRY_QUEUE[] = "AZ_TELEMETRY_QUEUE";
+
+typedef struct
+{
+    uint16_t packet_id;
+    TickType_t sent_at;
+    telemetry_log_record_t record;
+} telemetry_queue_in_flight_t;
+
+struct azure_iot_telemetry_queue_t
+{
+    azure_iot_hub_context_t *hub_context;
+    telemetry_log_t *log;
+    telemetry_log_cursor_t cursor; /** @brief Next stored message to send. */
+    uint8_t *record_buffer;        /** @brief Properties and payload of the message being sent. */
+    telemetry_queue_in_flight_t in_flight[CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_IN_FLIGHT_MAX];
+    uint8_t in_flight_count;
+    uint32_t credit; /** @brief Messages that can be sent without going over the drain rate. */
+    TickType_t credited_at;
+    azure_iot_telemetry_queue_statistics_t statistics;
+};
+
+static AzureIoTResult_t azure_iot_telemetry_queue_store(azure_iot_telemetry_queue_t *queue,
+                                                        const uint8_t *payload,
+                                                        uint32_t payload_length,
+                                                        const uint8_t *properties,
+                                                        uint32_t properties_length,
+                                                        AzureIoTHubMessageQoS_t qos,
+                                                        uint32_t time_to_live_s);
+static AzureIoTResult_t azure_iot_telemetry_queue_send_record(azure_iot_telemetry_queue_t *queue,
+                                                              const telemetry_log_record_t *record);
+static void azure_iot_telemetry_queue_credit(azure_iot_telemetry_queue_t *queue);
+static void azure_iot_telemetry_queue_resend_in_flight(azure_iot_telemetry_queue_t *queue);
+
+azure_iot_telemetry_queue_t *azure_iot_telemetry_queue_create(azure_iot_hub_context_t *hub_context)
+{
+    azure_iot_telemetry_queue_t *queue = (azure_iot_telemetry_queue_t *)malloc(sizeof(azure_iot_telemetry_queue_t));
+
+    CMP_CHECK(TAG_TELEMETRY_QUEUE, (queue != NULL), "failure allocating queue", NULL)
+
+    memset(queue, 0, sizeof(azure_iot_telemetry_queue_t));
+
+    queue->hub_context = hub_context;
+    queue->log = telemetry_log_open();
+    queue->record_buffer = (uint8_t *)malloc(telemetry_log_get_record_max_length());
+    queue->credit = CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_DRAIN_RATE;
+    queue->credited_at = xTaskGetTickCount();
+
+    if (queue->log == NULL || queue->record_buffer == NULL)
+    {
+        CMP_LOGE(TAG_TELEMETRY_QUEUE, "failure opening telemetry log");
+
+        azure_iot_telemetry_queue_free(queue);
+        return NULL;
+    }
+
+    telemetry_log_rewind(queue->log, &queue->cursor);
+
+    return queue;
+}
+
+AzureIoTResult_t azure_iot_telemetry_queue_send(azure_iot_telemetry_queue_t *queue,
+                                                const uint8_t *payload,
+                                                uint32_t payload_length,
+                                                const uint8_t *properties,
+                                                uint32_t properties_length,
+                                                AzureIoTHubMessageQoS_t qos,
+                                                uint32_t time_to_live_s)
+{
+    telemetry_log_statistics_t log_statistics;
+    AzureIoTMessageProperties_t message_properties;
+    AzureIoTMessageProperties_t *properties_sent = NULL;
+
+    if (properties == NULL)
+    {
+        properties_length = 0;
+    }
+
+    if (properties_length > 0)
+    {
+        // Full from the start: the SDK only reads it.
+        CMP_CHECK(TAG_TELEMETRY_QUEUE,
+                  (AzureIoTMessage_PropertiesInit(&message_properties, (uint8_t *)properties, properties_length, properties_length) == eAzureIoTSuccess),
+                  "failure reading properties",
+                  eAzureIoTErrorInvalidArgument)
+
+        properties_sent = &message_properties;
+    }
+
+    telemetry_log_get_statistics(queue->log, &log_statistics);
+
+    // Sent after the stored ones, to keep the order.
+    if (log_statistics.pending == 0 &&
+        azure_iot_hub_send_telemetry(queue->hub_context, payload, payload_length, properties_sent, qos, NULL) == eAzureIoTSuccess)
+    {
+        queue->statistics.sent++;
+
+        return eAzureIoTSuccess;
+    }
+
+    return azure_iot_telemetry_queue_store(queue, payload, payload_length, properties, properties_length, qos, time_to_live_s);
+}
+
+AzureIoTResult_t azure_iot_telemetry_queue_process(azure_iot_telemetry_queue_t *queue)
+{
+    telemetry_log_record_t record;
+
+    if (queue->in_flight_count > 0 &&
+        pdTICKS_TO_MS(xTaskGetTickCount() - queue->in_flight[0].sent_at) >= TELEMETRY_QUEUE_ACK_TIMEOUT_MS)
+    {
+        CMP_LOGW(TAG_TELEMETRY_QUEUE, "acknowledgment timeout, sending again");
+
+        azure_iot_telemetry_queue_resend_in_flight(queue);
+    }
+
+    azure_iot_telemetry_queue_credit(queue);
+
+    while (queue->credit > 0 &&
+           queue->in_flight_count < CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_IN_FLIGHT_MAX &&
+           telemetry_log_read(queue->log, &queue->cursor, &record, queue->record_buffer))
+    {
+        if (record.expires_at != 0 && time_get_unix() >= record.expires_at)
+        {
+            queue->statistics.expired++;
+
+            telemetry_log_consume(queue->log, &record);
+            continue;
+        }
+
+        AzureIoTResult_t result = azure_iot_telemetry_queue_send_record(queue, &record);
+
+        if (result != eAzureIoTSuccess)
+        {
+            // Not reachable: sent again from the oldest not acknowledged.
+            azure_iot_telemetry_queue_resend_in_flight(queue);
+
+            return result;
+        }
+
+        queue->credit--;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+void azure_iot_telemetry_queue_acknowledge(azure_iot_telemetry_queue_t *queue, uint16_t packet_id)
+{
+    for (uint8_t i = 0; i < queue->in_flight_count; i++)
+    {
+        if (queue->in_flight[i].packet_id != packet_id)
+        {
+            continue;
+        }
+
+        telemetry_log_consume(queue->log, &queue->in_flight[i].record);
+
+        queue->statistics.sent++;
+        queue->in_flight_count--;
+
+        // Kept in send order: the first one is the oldest.
+        memmove(&queue->in_flight[i],
+                &queue->in_flight[i + 1],
+                (queue->in_flight_count - i) * sizeof(telemetry_queue_in_flight_t));
+
+        return;
+    }
+}
+
+void azure_iot_telemetry_queue_get_statistics(const azure_iot_telemetry_queue_t *queue,
+                                              azure_iot_telemetry_queue_statistics_t *statistics)
+{
+    telemetry_log_statistics_t log_statistics;
+
+    telemetry_log_get_statistics(queue->log, &log_statistics);
+
+    *statistics = queue->statistics;
+
+    statistics->dropped = log_statistics.dropped;
+    statistics->pending = log_statistics.pending;
+}
+
+void azure_iot_telemetry_queue_free(azure_iot_telemetry_queue_t *queue)
+{
+    if (queue == NULL)
+    {
+        return;
+    }
+
+    telemetry_log_close(queue->log);
+
+    free(queue->record_buffer);
+    free(queue);
+}
+
+//
+// PRIVATE
+//
+
+static AzureIoTResult_t azure_iot_telemetry_queue_store(azure_iot_telemetry_queue_t *queue,
+                                                        const uint8_t *payload,
+                                                        uint32_t payload_length,
+                                                        const uint8_t *properties,
+                                                        uint32_t properties_length,
+                                                        AzureIoTHubMessageQoS_t qos,
+                                                        uint32_t time_to_live_s)
+{
+    uint32_t expires_at = 0;
+
+    CMP_CHECK(TAG_TELEMETRY_QUEUE, (payload_length <= UINT16_MAX && properties_length <= UINT16_MAX), "message too long", eAzureIoTErrorOutOfMemory)
+
+    if (time_to_live_s > 0)
+    {
+        expires_at = (uint32_t)(time_get_unix() + time_to_live_s);
+    }
+
+    if (!telemetry_log_append(queue->log,
+                              (uint8_t)qos,
+                              expires_at,
+                              properties,
+                              (uint16_t)properties_length,
+                              payload,
+                              (uint16_t)payload_length))
+    {
+        return eAzureIoTErrorFailed;
+    }
+
+    queue->statistics.queued++;
+
+    return eAzureIoTSuccess;
+}
+
+static AzureIoTResult_t azure_iot_telemetry_queue_send_record(azure_iot_telemetry_queue_t *queue,
+                                                              const telemetry_log_record_t *record)
+{
+    AzureIoTMessageProperties_t properties;
+    AzureIoTMessageProperties_t *properties_sent = NULL;
+    uint16_t packet_id = 0;
+
+    if (record->properties_length > 0)
+    {
+        AzureIoTResult_t result = AzureIoTMessage_PropertiesInit(&properties,
+                                                                 queue->record_buffer,
+                                                                 record->properties_length,
+                                                                 record->properties_length);
+
+        CMP_CHECK(TAG_TELEMETRY_QUEUE, (result == eAzureIoTSuccess), "failure restoring properties", result)
+
+        properties_sent = &properties;
+    }
+
+    AzureIoTResult_t result = azure_iot_hub_send_telemetry(queue->hub_context,
+                                                           queue->record_buffer + record->properties_length,
+                                                           record->payload_length,
+                                                           properties_sent,
+                                                           (AzureIoTHubMessageQoS_t)record->qos,
+                                                           &packet_id);
+    if (result != eAzureIoTSuccess)
+    {
+        return result;
+    }
+
+    if (record->qos == eAzureIoTHubMessageQoS0)
+    {
+        queue->statistics.sent++;
+
+        telemetry_log_consume(queue->log, record);
+    }
+    else
+    {
+        telemetry_queue_in_flight_t *in_flight = &queue->in_flight[queue->in_flight_count++];
+
+        in_flight->packet_id = packet_id;
+        in_flight->sent_at = xTaskGetTickCount();
+        in_flight->record = *record;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+static void azure_iot_telemetry_queue_credit(azure_iot_telemetry_queue_t *queue)
+{
+    TickType_t now = xTaskGetTickCount();
+    uint32_t earned = (uint32_t)(((uint64_t)pdTICKS_TO_MS(now - queue->credited_at) * CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_DRAIN_RATE) / 1000U);
+
+    // Fractions are kept by not moving the credit time.
+    if (earned == 0)
+    {
+        return;
+    }
+
+    queue->credit += earned;
+    queue->credited_at = now;
+
+    // At most one second of messages at once.
+    if (queue->credit > CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_DRAIN_RATE)
+    {
+        queue->credit = CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_DRAIN_RATE;
+    }
+}
+
+static void azure_iot_telemetry_queue_resend_in_flight(azure_iot_telemetry_queue_t *queue)
+{
+    queue->in_flight_count = 0;
+
+    telemetry_log_rewind(queue->log, &queue->cursor);
+}
\ No newline at end of file
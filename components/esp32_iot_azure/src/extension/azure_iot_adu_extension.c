@@ -1,17 +1,50 @@
+#include <string.h>
+#include <strings.h>
 #include "esp32_iot_azure/extension/azure_iot_adu_extension.h"
+#include "assertion.h"
 #include "log.h"
 
+#define URL_SCHEME_HTTP "http://"
+#define URL_SCHEME_HTTPS "https://"
+#define URL_PORT_HTTP 80U
+#define URL_PORT_HTTPS 443U
+
 static const char TAG_AZ_ADU_EXT[] = "AZ_ADU_EXT";
 
+static bool azure_adu_file_parse_port(const char *start, const char *end, uint16_t *port);
+
 AzureIoTResult_t azure_adu_file_parse_url(AzureIoTADUUpdateManifestFileUrl_t *file_url,
                                           uint8_t *parse_buffer,
                                           parsed_file_url_t *parsed_url)
 {
-    // Skip the protocol prefix.
-    uint8_t *url_start_index = file_url->pucUrl + sizeof("http://") - 1;
+    const char *url = (const char *)file_url->pucUrl;
+    uint32_t scheme_length;
+
+    if (file_url->ulUrlLength > sizeof(URL_SCHEME_HTTPS) - 1 &&
+        strncasecmp(url, URL_SCHEME_HTTPS, sizeof(URL_SCHEME_HTTPS) - 1) == 0)
+    {
+        scheme_length = sizeof(URL_SCHEME_HTTPS) - 1;
+        parsed_url->port = URL_PORT_HTTPS;
+        parsed_url->secure = true;
+    }
+    else if (file_url->ulUrlLength > sizeof(URL_SCHEME_HTTP) - 1 &&
+             strncasecmp(url, URL_SCHEME_HTTP, sizeof(URL_SCHEME_HTTP) - 1) == 0)
+    {
+        scheme_length = sizeof(URL_SCHEME_HTTP) - 1;
+        parsed_url->port = URL_PORT_HTTP;
+        parsed_url->secure = false;
+    }
+    else
+    {
+        CMP_LOGE(TAG_AZ_ADU_EXT, "file url scheme not supported");
+        return eAzureIoTErrorInvalidArgument;
+    }
 
-    // Find the first '/' after the url.
-    const char *path_start_index = strstr((const char *)url_start_index, "/");
+    // Skip the scheme.
+    const char *url_start_index = url + scheme_length;
+
+    // Find the first '/' after the host.
+    const char *path_start_index = (const char *)memchr(url_start_index, '/', file_url->ulUrlLength - scheme_length);
 
     if (path_start_index == NULL)
     {
@@ -19,17 +52,27 @@ AzureIoTResult_t azure_adu_file_parse_url(AzureIoTADUUpdateManifestFileUrl_t *fi
         return eAzureIoTErrorInvalidArgument;
     }
 
+    // An explicit port ends the host.
+    const char *port_start_index = (const char *)memchr(url_start_index, ':', (size_t)(path_start_index - url_start_index));
+
+    if (port_start_index != NULL && !azure_adu_file_parse_port(port_start_index + 1, path_start_index, &parsed_url->port))
+    {
+        CMP_LOGE(TAG_AZ_ADU_EXT, "file url has an invalid port");
+        return eAzureIoTErrorInvalidArgument;
+    }
+
+    const char *hostname_end_index = port_start_index != NULL ? port_start_index : path_start_index;
+
     uint8_t *hostname = parse_buffer;
 
     // Extra space for the null-terminator.
-    uint32_t hostname_length = (uint32_t)(path_start_index - (char *)url_start_index + 1);
+    uint32_t hostname_length = (uint32_t)(hostname_end_index - url_start_index + 1);
 
     uint8_t *path = parse_buffer + hostname_length;
 
-    // Discouting the host and its null-terminator,
-    // and protocol prefix size, but adding space for
-    // a null-terminator.
-    uint32_t path_length = file_url->ulUrlLength - (hostname_length - 1) - (sizeof("http://") - 1) + 1;
+    // Discouting the scheme and host, but adding
+    // space for a null-terminator.
+    uint32_t path_length = file_url->ulUrlLength - (uint32_t)(path_start_index - url) + 1;
 
     // Final memory layout:
     // parse_buffer = www.hostname.com\n/some/path\n
@@ -37,7 +80,7 @@ AzureIoTResult_t azure_adu_file_parse_url(AzureIoTADUUpdateManifestFileUrl_t *fi
 
     memcpy(hostname, url_start_index, hostname_length - 1);
     memset(hostname + hostname_length - 1, 0, 1);
-    memcpy(path, path_start_index, path_length);
+    memcpy(path, path_start_index, path_length - 1);
     memset(path + path_length - 1, 0, 1);
 
     parsed_url->hostname = hostname;
@@ -54,17 +97,24 @@ AzureIoTResult_t azure_adu_file_download(parsed_file_url_t *parsed_url,
                                          uint16_t chunk_size,
                                          azure_http_download_callback_t callback,
                                          void *callback_context,
-                                         uint32_t *file_size)
+                                         uint32_t start_offset,
+                                         uint32_t *file_size,
+                                         azure_http_statistics_t *statistics)
 {
     AzureIoTResult_t result = eAzureIoTErrorFailed;
     azure_http_context_t *http = azure_http_create((const char *)parsed_url->hostname,
                                                    parsed_url->hostname_length - 1,
                                                    (const char *)parsed_url->path,
-                                                   parsed_url->path_length - 1);
+                                                   parsed_url->path_length - 1,
+                                                   parsed_url->port,
+                                                   parsed_url->secure);
+
+    CMP_CHECK(TAG_AZ_ADU_EXT, (http != NULL), "failure creating http client", eAzureIoTErrorOutOfMemory)
 
     if (azure_http_connect(http) != eAzureIoTHTTPSuccess)
     {
         CMP_LOGE(TAG_AZ_ADU_EXT, "failure connecting to: %s", parsed_url->hostname);
+        azure_http_free(http);
         return eAzureIoTErrorFailed;
     }
 
@@ -72,6 +122,10 @@ AzureIoTResult_t azure_adu_file_download(parsed_file_url_t *parsed_url,
     {
         CMP_LOGE(TAG_AZ_ADU_EXT, "failure getting image size: %s", parsed_url->hostname);
     }
+    else if (start_offset > *file_size)
+    {
+        CMP_LOGE(TAG_AZ_ADU_EXT, "start offset past the file end: %lu", (unsigned long)start_offset);
+    }
     else
     {
         result = azure_http_download_resource(http,
@@ -80,13 +134,57 @@ AzureIoTResult_t azure_adu_file_download(parsed_file_url_t *parsed_url,
                                               chunk_size,
                                               callback,
                                               callback_context,
+                                              start_offset,
                                               *file_size) == eAzureIoTHTTPSuccess
                      ? eAzureIoTSuccess
                      : eAzureIoTErrorFailed;
     }
 
+    const azure_http_statistics_t *http_statistics = azure_http_get_statistics(http);
+
+    CMP_LOGI(TAG_AZ_ADU_EXT,
+             "download finished: %lu requests, %lu connections",
+             (unsigned long)http_statistics->requests,
+             (unsigned long)http_statistics->connections);
+
+    if (statistics != NULL)
+    {
+        *statistics = *http_statistics;
+    }
+
     azure_http_disconnect(http);
     azure_http_free(http);
 
     return result;
-}
\ No newline at end of file
+}
+
+//
+// PRIVATE
+//
+
+static bool azure_adu_file_parse_port(const char *start, const char *end, uint16_t *port)
+{
+    uint32_t value = 0;
+
+    if (start == end)
+    {
+        return false;
+    }
+
+    for (const char *digit = start; digit < end; digit++)
+    {
+        if (*digit < '0' || *digit > '9' || (value = value * 10U + (uint32_t)(*digit - '0')) > UINT16_MAX)
+        {
+            return false;
+        }
+    }
+
+    if (value == 0)
+    {
+        return false;
+    }
+
+    *port = (uint16_t)value;
+
+    return true;
+}
@@ -1,3 +1,4 @@
+#include <string.h>
 #include "esp32_iot_azure/extension/azure_iot_http_client_extension.h"
 #include "log.h"
 #include "config.h"
@@ -38,10 +39,31 @@ AzureIoTHTTPResult_t azure_http_download_resource(azure_http_context_t *context,
                                                   uint16_t chunk_size,
                                                   azure_http_download_callback_t callback,
                                                   void *callback_context,
+                                                  uint32_t start_offset,
                                                   uint32_t resource_size)
 {
+#if CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_DOWNLOAD_STREAMED
+    return azure_http_download_resource_streamed(context,
+                                                 data_buffer,
+                                                 data_buffer_length,
+                                                 chunk_size,
+                                                 callback,
+                                                 callback_context,
+                                                 start_offset,
+                                                 resource_size);
+#elif CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_PIPELINE_DEPTH > 1
+    return azure_http_download_resource_pipelined(context,
+                                                  data_buffer,
+                                                  data_buffer_length,
+                                                  chunk_size,
+                                                  CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_PIPELINE_DEPTH,
+                                                  callback,
+                                                  callback_context,
+                                                  start_offset,
+                                                  resource_size);
+#else
     AzureIoTHTTPResult_t http_result = eAzureIoTHTTPSuccess;
-    uint32_t current_offset = 0;
+    uint32_t current_offset = start_offset;
     char *data_buffer_payload_pointer = NULL;
     uint32_t data_buffer_payload_length = 0;
 
@@ -96,5 +118,233 @@ AzureIoTHTTPResult_t azure_http_download_resource(azure_http_context_t *context,
         azure_http_deinit(context);
     }
 
+    return http_result;
+#endif
+}
+
+AzureIoTHTTPResult_t azure_http_download_resource_pipelined(azure_http_context_t *context,
+                                                            char *data_buffer,
+                                                            uint32_t data_buffer_length,
+                                                            uint16_t chunk_size,
+                                                            uint8_t pipeline_depth,
+                                                            azure_http_download_callback_t callback,
+                                                            void *callback_context,
+                                                            uint32_t start_offset,
+                                                            uint32_t resource_size)
+{
+    AzureIoTHTTPResult_t http_result = eAzureIoTHTTPSuccess;
+    azure_http_response_t response;
+    uint32_t current_offset = start_offset;
+    uint32_t request_offset = start_offset;
+    uint32_t buffered_length = 0;
+    uint8_t in_flight = 0;
+
+    while (current_offset < resource_size)
+    {
+        // Requests are built right after the bytes already received:
+        // they are sent before the buffer is read into again.
+        while (in_flight < pipeline_depth && request_offset < resource_size)
+        {
+            uint32_t range_end = resource_size - request_offset > chunk_size ? request_offset + chunk_size - 1 : resource_size - 1;
+
+            http_result = azure_http_send_range_request(context,
+                                                        data_buffer + buffered_length,
+                                                        data_buffer_length - buffered_length,
+                                                        request_offset,
+                                                        range_end);
+
+            if (http_result == eAzureIoTHTTPInsufficientMemory && in_flight > 0)
+            {
+                // The next responses fill the buffer: send
+                // once the current response is consumed.
+                http_result = eAzureIoTHTTPSuccess;
+                break;
+            }
+
+            if (http_result != eAzureIoTHTTPSuccess)
+            {
+                break;
+            }
+
+            request_offset = range_end + 1;
+            in_flight++;
+        }
+
+        if (http_result == eAzureIoTHTTPSuccess)
+        {
+            http_result = azure_http_receive_response(context, data_buffer, data_buffer_length, &buffered_length, &response);
+        }
+
+        if (http_result == eAzureIoTHTTPSuccess)
+        {
+            if (response.status_code != 206 || response.range_start != current_offset || response.content_length == 0)
+            {
+                CMP_LOGE(TAG_AZ_HTTP_EXT,
+                         "unexpected response: status %d, range start %lu",
+                         response.status_code,
+                         (unsigned long)response.range_start);
+                return eAzureIoTHTTPInvalidResponse;
+            }
+
+            if (callback != NULL && !callback((uint8_t *)data_buffer + response.headers_length,
+                                              response.content_length,
+                                              current_offset,
+                                              resource_size,
+                                              callback_context))
+            {
+                CMP_LOGE(TAG_AZ_HTTP_EXT, "failure calling donwload callback");
+                return eAzureIoTHTTPError;
+            }
+
+            current_offset += response.content_length;
+            in_flight--;
+
+            // Keep what was received of the next responses.
+            buffered_length -= response.headers_length + response.content_length;
+
+            memmove(data_buffer, data_buffer + response.headers_length + response.content_length, buffered_length);
+
+            if (response.connection_close && in_flight > 0)
+            {
+                CMP_LOGW(TAG_AZ_HTTP_EXT, "server closed the connection: resending %d requests", in_flight);
+
+                in_flight = 0;
+                request_offset = current_offset;
+                buffered_length = 0;
+            }
+        }
+        else if (http_result == eAzureIoTHTTPPartialResponse || http_result == eAzureIoTHTTPNoResponse || http_result == eAzureIoTHTTPNetworkError)
+        {
+            CMP_LOGW(TAG_AZ_HTTP_EXT, "reconnecting");
+
+            azure_http_disconnect(context);
+
+            if ((http_result = azure_http_connect(context)) != eAzureIoTHTTPSuccess)
+            {
+                CMP_LOGE(TAG_AZ_HTTP_EXT, "failure reconnecting");
+                return http_result;
+            }
+
+            // Requests in flight were lost with the connection.
+            in_flight = 0;
+            request_offset = current_offset;
+            buffered_length = 0;
+        }
+        else
+        {
+            CMP_LOGE(TAG_AZ_HTTP_EXT, "failure receiving response: %d", http_result);
+            return http_result;
+        }
+    }
+
+    return http_result;
+}
+
+AzureIoTHTTPResult_t azure_http_download_resource_streamed(azure_http_context_t *context,
+                                                           char *data_buffer,
+                                                           uint32_t data_buffer_length,
+                                                           uint16_t chunk_size,
+                                                           azure_http_download_callback_t callback,
+                                                           void *callback_context,
+                                                           uint32_t start_offset,
+                                                           uint32_t resource_size)
+{
+    AzureIoTHTTPResult_t http_result = eAzureIoTHTTPSuccess;
+    azure_http_response_t response;
+    uint32_t current_offset = start_offset;
+
+    if (data_buffer_length < chunk_size)
+    {
+        CMP_LOGE(TAG_AZ_HTTP_EXT, "buffer smaller than the chunk size");
+        return eAzureIoTHTTPInsufficientMemory;
+    }
+
+    while (current_offset < resource_size)
+    {
+        uint32_t buffered_length = 0;
+
+        // One request for the whole resource; after a broken
+        // connection, one for what is left of it.
+        if ((http_result = azure_http_send_get_request(context,
+                                                      data_buffer,
+                                                      data_buffer_length,
+                                                      current_offset)) == eAzureIoTHTTPSuccess &&
+            (http_result = azure_http_receive_response_headers(context,
+                                                               data_buffer,
+                                                               data_buffer_length,
+                                                               &buffered_length,
+                                                               &response)) == eAzureIoTHTTPSuccess)
+        {
+            uint16_t expected_status = current_offset == 0 ? 200 : 206;
+
+            if (response.status_code != expected_status ||
+                response.range_start != current_offset ||
+                response.content_length != resource_size - current_offset)
+            {
+                CMP_LOGE(TAG_AZ_HTTP_EXT,
+                         "unexpected response: status %d, range start %lu, length %lu",
+                         response.status_code,
+                         (unsigned long)response.range_start,
+                         (unsigned long)response.content_length);
+                return eAzureIoTHTTPInvalidResponse;
+            }
+
+            // Only the body from now on.
+            buffered_length -= response.headers_length;
+
+            memmove(data_buffer, data_buffer + response.headers_length, buffered_length);
+
+            while (http_result == eAzureIoTHTTPSuccess && current_offset < resource_size)
+            {
+                uint32_t slice_length = resource_size - current_offset > chunk_size ? chunk_size : resource_size - current_offset;
+
+                // Reads never go past the slice: what is left
+                // on the connection stays on the socket.
+                while (http_result == eAzureIoTHTTPSuccess && buffered_length < slice_length)
+                {
+                    http_result = azure_http_receive_data(context, data_buffer, slice_length, &buffered_length);
+                }
+
+                if (http_result != eAzureIoTHTTPSuccess)
+                {
+                    break;
+                }
+
+                if (callback != NULL && !callback((uint8_t *)data_buffer,
+                                                  slice_length,
+                                                  current_offset,
+                                                  resource_size,
+                                                  callback_context))
+                {
+                    CMP_LOGE(TAG_AZ_HTTP_EXT, "failure calling donwload callback");
+                    return eAzureIoTHTTPError;
+                }
+
+                current_offset += slice_length;
+                buffered_length -= slice_length;
+
+                memmove(data_buffer, data_buffer + slice_length, buffered_length);
+            }
+        }
+
+        if (http_result == eAzureIoTHTTPPartialResponse || http_result == eAzureIoTHTTPNoResponse || http_result == eAzureIoTHTTPNetworkError)
+        {
+            CMP_LOGW(TAG_AZ_HTTP_EXT, "reconnecting: resuming from %lu", (unsigned long)current_offset);
+
+            azure_http_disconnect(context);
+
+            if ((http_result = azure_http_connect(context)) != eAzureIoTHTTPSuccess)
+            {
+                CMP_LOGE(TAG_AZ_HTTP_EXT, "failure reconnecting");
+                return http_result;
+            }
+        }
+        else if (http_result != eAzureIoTHTTPSuccess)
+        {
+            CMP_LOGE(TAG_AZ_HTTP_EXT, "failure receiving response: %d", http_result);
+            return http_result;
+        }
+    }
+
     return http_result;
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 struct NetworkContext
 {
     transport_t *transport;
+    uint16_t receive_timeout_ms;
 };
 
 static int32_t azure_transport_send(struct NetworkContext *pxNetworkContext,
@@ -25,7 +26,7 @@ static int32_t azure_transport_receive(struct NetworkContext *pxNetworkContext,
     return transport_read(pxNetworkContext->transport,
                           (uint8_t *)pvBuffer,
                           xBytesToRecv,
-                          CONFIG_ESP32_IOT_AZURE_TRANSPORT_RECEIVE_TIMEOUT_MS);
+                          pxNetworkContext->receive_timeout_ms);
 }
 
 void azure_transport_interface_init(transport_t *transport,
@@ -33,10 +34,17 @@ void azure_transport_interface_init(transport_t *transport,
 {
     interface->pxNetworkContext = (struct NetworkContext *)malloc(sizeof(struct NetworkContext));
     interface->pxNetworkContext->transport = transport;
+    interface->pxNetworkContext->receive_timeout_ms = CONFIG_ESP32_IOT_AZURE_TRANSPORT_RECEIVE_TIMEOUT_MS;
     interface->xSend = azure_transport_send;
     interface->xRecv = azure_transport_receive;
 }
 
+void azure_transport_interface_set_receive_timeout(AzureIoTTransportInterface_t *interface,
+                                                   uint16_t timeout_ms)
+{
+    interface->pxNetworkContext->receive_timeout_ms = timeout_ms;
+}
+
 void azure_transport_interface_free(AzureIoTTransportInterface_t *interface)
 {
     free(interface->pxNetworkContext);
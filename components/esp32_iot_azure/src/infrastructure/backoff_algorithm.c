@@ -29,7 +29,15 @@
 #include "infrastructure/backoff_algorithm.h"
 #include <assert.h>
 #include <stddef.h>
+#include "config.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <stdlib.h>
+#define backoff_random() ((uint32_t)random())
+#else
 #include "esp_random.h"
+#define backoff_random() esp_random()
+#endif
 
 void backoff_algorithm_initialize(backoff_algorithm_context_t *context,
                                   uint16_t backoff_base,
@@ -55,7 +63,7 @@ backoff_algorithm_status_t backoff_algorithm_get_next(backoff_algorithm_context_
         /* The next backoff value is a random value between 0 and the maximum jitter value
          * for the retry attempt. */
 
-        uint32_t random_value = esp_random();
+        uint32_t random_value = backoff_random();
 
         /* Choose a random value for back-off time between 0 and the max jitter value. */
         *next_backoff = (uint16_t)(random_value % (context->next_jitter_max + 1U));
@@ -84,3 +92,19 @@ backoff_algorithm_status_t backoff_algorithm_get_next(backoff_algorithm_context_
 
     return status;
 }
+
+uint32_t backoff_algorithm_get_decorrelated(uint32_t backoff_base,
+                                            uint32_t max_back_off,
+                                            uint32_t previous)
+{
+    uint32_t upper = previous > backoff_base ? previous : backoff_base;
+
+    upper = upper > max_back_off / 3U ? max_back_off : upper * 3U;
+
+    if (upper <= backoff_base)
+    {
+        return upper;
+    }
+
+    return backoff_base + backoff_random() % (upper - backoff_base + 1U);
+}
@@ -1,9 +1,105 @@
+#include <string.h>
 #include "infrastructure/crypto.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "mbedtls/md.h"
+#include "mbedtls/sha256.h"
+#include "sdkconfig.h"
 #include "assertion.h"
+#include "log.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_cpu.h"
+#endif
+
+#define CRYPTO_SHA_256_SIZE 32U
+#define CRYPTO_SHA_256_BLOCK_SIZE 64U
+#define CRYPTO_HMAC_IPAD 0x36U
+#define CRYPTO_HMAC_OPAD 0x5CU
+
+// The ESP32 SHA engine holds the state of a single context: mbedTLS hashes clones of it,
+// like the pre-keyed states of the cache, in software. There, the HMAC is left to
+// mbedtls_md, which hashes on one context, on the peripheral.
+#define CRYPTO_HMAC_KEY_CACHE (!CONFIG_IDF_TARGET_ESP32 || !CONFIG_MBEDTLS_HARDWARE_SHA)
 
 static const char TAG_CRYPTO[] = "AZ_CRYPTO";
 
+/**
+ * @brief SHA-256 states after hashing the HMAC key pads.
+ */
+typedef struct
+{
+    mbedtls_sha256_context inner; /** @brief State after the inner pad (key ^ ipad). */
+    mbedtls_sha256_context outer; /** @brief State after the outer pad (key ^ opad). */
+} crypto_hmac_key_t;
+
+/**
+ * @brief Pre-keyed state of the last key used.
+ */
+typedef struct
+{
+    SemaphoreHandle_t lock;
+    crypto_hmac_key_t key_state;
+    uint8_t key[CRYPTO_SHA_256_BLOCK_SIZE];
+    uint32_t key_length;
+    bool keyed;
+    crypto_statistics_t statistics;
+} crypto_cache_t;
+
+static crypto_cache_t CACHE = {0};
+
+#if CRYPTO_HMAC_KEY_CACHE
+static int crypto_hmac_key_init(crypto_hmac_key_t *key_state, const uint8_t *key, uint32_t key_length);
+static int crypto_hmac_pad_hash(mbedtls_sha256_context *state, const uint8_t *key_block, uint8_t pad_byte);
+static int crypto_hmac_compute(const crypto_hmac_key_t *key_state, const uint8_t *data, uint32_t data_length, uint8_t *output_buffer);
+static void crypto_hmac_key_free(crypto_hmac_key_t *key_state);
+static int crypto_hmac_cached(const uint8_t *key, uint32_t key_length, const uint8_t *data, uint32_t data_length, uint8_t *output_buffer);
+#else
+static int crypto_hmac_md(const uint8_t *key, uint32_t key_length, const uint8_t *data, uint32_t data_length, uint8_t *output_buffer);
+#endif
+static void crypto_count_hmac(uint32_t cycles);
+static uint32_t crypto_get_cycles();
+
+bool crypto_init()
+{
+    if (CACHE.lock == NULL)
+    {
+        CACHE.lock = xSemaphoreCreateMutex();
+    }
+
+    CMP_CHECK(TAG_CRYPTO, (CACHE.lock != NULL), "failure creating lock", false)
+
+    memset(&CACHE.statistics, 0, sizeof(crypto_statistics_t));
+
+#if !CONFIG_IDF_TARGET_LINUX && CONFIG_MBEDTLS_HARDWARE_SHA
+    CACHE.statistics.hardware = true;
+#endif
+
+    return true;
+}
+
+void crypto_deinit()
+{
+    if (CACHE.lock == NULL)
+    {
+        return;
+    }
+
+#if CRYPTO_HMAC_KEY_CACHE
+    if (CACHE.keyed)
+    {
+        crypto_hmac_key_free(&CACHE.key_state);
+    }
+#endif
+
+    vSemaphoreDelete(CACHE.lock);
+
+    // Wipes the key, and the states derived from it.
+    memset(&CACHE, 0, sizeof(crypto_cache_t));
+}
+
 uint32_t crypto_hash_hmac_256(const uint8_t *key,
                               uint32_t key_length,
                               const uint8_t *data,
@@ -14,14 +110,32 @@ uint32_t crypto_hash_hmac_256(const uint8_t *key,
 {
     CMP_CHECK(TAG_CRYPTO, (output_buffer_length > 32), "invalid output buffer length", 1)
 
-    mbedtls_md_context_t context;
+    uint32_t started_at = crypto_get_cycles();
+    int mbedtls_result;
 
-    mbedtls_md_init(&context);
+#if CRYPTO_HMAC_KEY_CACHE
+    if (CACHE.lock != NULL && key_length <= CRYPTO_SHA_256_BLOCK_SIZE)
+    {
+        mbedtls_result = crypto_hmac_cached(key, key_length, data, data_length, output_buffer);
+    }
+    else
+    {
+        crypto_hmac_key_t key_state;
+
+        mbedtls_result = crypto_hmac_key_init(&key_state, key, key_length)
+                         || crypto_hmac_compute(&key_state, data, data_length, output_buffer);
+
+        crypto_hmac_key_free(&key_state);
+    }
+#else
+    mbedtls_result = crypto_hmac_md(key, key_length, data, data_length, output_buffer);
+#endif
 
-    int mbedtls_result = mbedtls_md_setup(&context, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1)
-                         || mbedtls_md_hmac_starts(&context, key, key_length)
-                         || mbedtls_md_hmac_update(&context, data, data_length)
-                         || mbedtls_md_hmac_finish(&context, output_buffer);
+    uint32_t cycles = crypto_get_cycles() - started_at;
+
+    crypto_count_hmac(cycles);
+
+    CMP_LOGD(TAG_CRYPTO, "hmac: %lu bytes in %lu cycles", (unsigned long)data_length, (unsigned long)cycles);
 
     uint32_t result;
 
@@ -38,7 +152,205 @@ uint32_t crypto_hash_hmac_256(const uint8_t *key,
         *bytes_copied = 32U;
     }
 
+    return result;
+}
+
+void crypto_get_statistics(crypto_statistics_t *statistics)
+{
+    if (CACHE.lock == NULL)
+    {
+        memset(statistics, 0, sizeof(crypto_statistics_t));
+        return;
+    }
+
+    xSemaphoreTake(CACHE.lock, portMAX_DELAY);
+
+    *statistics = CACHE.statistics;
+
+    xSemaphoreGive(CACHE.lock);
+}
+
+//
+// PRIVATE
+//
+
+#if CRYPTO_HMAC_KEY_CACHE
+static int crypto_hmac_key_init(crypto_hmac_key_t *key_state, const uint8_t *key, uint32_t key_length)
+{
+    uint8_t key_block[CRYPTO_SHA_256_BLOCK_SIZE] = {0};
+    int result = 0;
+
+    mbedtls_sha256_init(&key_state->inner);
+    mbedtls_sha256_init(&key_state->outer);
+
+    if (key_length > CRYPTO_SHA_256_BLOCK_SIZE)
+    {
+        result = mbedtls_sha256(key, key_length, key_block, 0);
+    }
+    else
+    {
+        memcpy(key_block, key, key_length);
+    }
+
+    result = result
+             || crypto_hmac_pad_hash(&key_state->inner, key_block, CRYPTO_HMAC_IPAD)
+             || crypto_hmac_pad_hash(&key_state->outer, key_block, CRYPTO_HMAC_OPAD);
+
+    memset(key_block, 0, sizeof(key_block));
+
+    return result;
+}
+
+static int crypto_hmac_pad_hash(mbedtls_sha256_context *state, const uint8_t *key_block, uint8_t pad_byte)
+{
+    mbedtls_sha256_context context;
+    uint8_t pad[CRYPTO_SHA_256_BLOCK_SIZE];
+    int result;
+
+    for (uint32_t i = 0; i < CRYPTO_SHA_256_BLOCK_SIZE; i++)
+    {
+        pad[i] = key_block[i] ^ pad_byte;
+    }
+
+    // Hashed on a temporary context and cloned: on chips where a context
+    // owns the SHA peripheral until finished, the clone releases it.
+    mbedtls_sha256_init(&context);
+
+    result = mbedtls_sha256_starts(&context, 0)
+             || mbedtls_sha256_update(&context, pad, CRYPTO_SHA_256_BLOCK_SIZE);
+
+    if (result == 0)
+    {
+        mbedtls_sha256_clone(state, &context);
+    }
+
+    mbedtls_sha256_free(&context);
+    memset(pad, 0, sizeof(pad));
+
+    return result;
+}
+
+static int crypto_hmac_compute(const crypto_hmac_key_t *key_state, const uint8_t *data, uint32_t data_length, uint8_t *output_buffer)
+{
+    mbedtls_sha256_context context;
+    uint8_t inner_hash[CRYPTO_SHA_256_SIZE];
+    int result;
+
+    // Clones: the pre-keyed states are kept untouched for the next call.
+    mbedtls_sha256_init(&context);
+    mbedtls_sha256_clone(&context, &key_state->inner);
+
+    result = mbedtls_sha256_update(&context, data, data_length)
+             || mbedtls_sha256_finish(&context, inner_hash);
+
+    mbedtls_sha256_free(&context);
+
+    if (result == 0)
+    {
+        mbedtls_sha256_init(&context);
+        mbedtls_sha256_clone(&context, &key_state->outer);
+
+        result = mbedtls_sha256_update(&context, inner_hash, CRYPTO_SHA_256_SIZE)
+                 || mbedtls_sha256_finish(&context, output_buffer);
+
+        mbedtls_sha256_free(&context);
+    }
+
+    memset(inner_hash, 0, sizeof(inner_hash));
+
+    return result;
+}
+
+static void crypto_hmac_key_free(crypto_hmac_key_t *key_state)
+{
+    mbedtls_sha256_free(&key_state->inner);
+    mbedtls_sha256_free(&key_state->outer);
+}
+
+static int crypto_hmac_cached(const uint8_t *key, uint32_t key_length, const uint8_t *data, uint32_t data_length, uint8_t *output_buffer)
+{
+    int result = 0;
+
+    xSemaphoreTake(CACHE.lock, portMAX_DELAY);
+
+    if (CACHE.keyed && CACHE.key_length == key_length && memcmp(CACHE.key, key, key_length) == 0)
+    {
+        CACHE.statistics.hmac_key_hits++;
+    }
+    else
+    {
+        if (CACHE.keyed)
+        {
+            crypto_hmac_key_free(&CACHE.key_state);
+        }
+
+        result = crypto_hmac_key_init(&CACHE.key_state, key, key_length);
+
+        if (result == 0)
+        {
+            memcpy(CACHE.key, key, key_length);
+            CACHE.key_length = key_length;
+        }
+        else
+        {
+            crypto_hmac_key_free(&CACHE.key_state);
+        }
+
+        CACHE.keyed = result == 0;
+    }
+
+    if (result == 0)
+    {
+        result = crypto_hmac_compute(&CACHE.key_state, data, data_length, output_buffer);
+    }
+
+    xSemaphoreGive(CACHE.lock);
+
+    return result;
+}
+#else
+static int crypto_hmac_md(const uint8_t *key, uint32_t key_length, const uint8_t *data, uint32_t data_length, uint8_t *output_buffer)
+{
+    mbedtls_md_context_t context;
+
+    mbedtls_md_init(&context);
+
+    int result = mbedtls_md_setup(&context, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1)
+                 || mbedtls_md_hmac_starts(&context, key, key_length)
+                 || mbedtls_md_hmac_update(&context, data, data_length)
+                 || mbedtls_md_hmac_finish(&context, output_buffer);
+
     mbedtls_md_free(&context);
 
     return result;
-}
\ No newline at end of file
+}
+#endif
+
+static void crypto_count_hmac(uint32_t cycles)
+{
+    if (CACHE.lock == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(CACHE.lock, portMAX_DELAY);
+
+    CACHE.statistics.hmac_calls++;
+    CACHE.statistics.hmac_last_cycles = cycles;
+    CACHE.statistics.hmac_cycles += cycles;
+
+    xSemaphoreGive(CACHE.lock);
+}
+
+static uint32_t crypto_get_cycles()
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint32_t)((uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec);
+#else
+    return (uint32_t)esp_cpu_get_cycle_count();
+#endif
+}
@@ -0,0 +1,107 @@
+#include <string.h>
+#include "infrastructure/download_checkpoint.h"
+#include "sdkconfig.h"
+#include "assertion.h"
+#include "log.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "nvs.h"
+
+#define CHECKPOINT_NVS_NAMESPACE "az_adu"
+#define CHECKPOINT_NVS_KEY "checkpoint"
+#endif
+
+static const char TAG_CHECKPOINT[] = "AZ_CHECKPOINT";
+
+#if CONFIG_IDF_TARGET_LINUX
+// Stands in for NVS; kept for the process lifetime.
+static download_checkpoint_t HOST_CHECKPOINT;
+static bool HOST_HAS_CHECKPOINT = false;
+
+bool download_checkpoint_load(download_checkpoint_t *checkpoint)
+{
+    if (HOST_HAS_CHECKPOINT)
+    {
+        *checkpoint = HOST_CHECKPOINT;
+    }
+
+    return HOST_HAS_CHECKPOINT;
+}
+
+bool download_checkpoint_save(const download_checkpoint_t *checkpoint)
+{
+    HOST_CHECKPOINT = *checkpoint;
+    HOST_HAS_CHECKPOINT = true;
+
+    return true;
+}
+
+void download_checkpoint_clear()
+{
+    HOST_HAS_CHECKPOINT = false;
+}
+#else
+bool download_checkpoint_load(download_checkpoint_t *checkpoint)
+{
+    nvs_handle_t handle;
+    size_t length = sizeof(download_checkpoint_t);
+
+    if (nvs_open(CHECKPOINT_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+    {
+        return false;
+    }
+
+    esp_err_t result = nvs_get_blob(handle, CHECKPOINT_NVS_KEY, checkpoint, &length);
+
+    nvs_close(handle);
+
+    // A different length is a checkpoint saved by a firmware
+    // with another layout, like another mbedTLS version.
+    if (result != ESP_OK || length != sizeof(download_checkpoint_t))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool download_checkpoint_save(const download_checkpoint_t *checkpoint)
+{
+    nvs_handle_t handle;
+    esp_err_t result;
+
+    if ((result = nvs_open(CHECKPOINT_NVS_NAMESPACE, NVS_READWRITE, &handle)) != ESP_OK)
+    {
+        CMP_LOGE(TAG_CHECKPOINT, "failure opening nvs: %d", result);
+        return false;
+    }
+
+    if ((result = nvs_set_blob(handle, CHECKPOINT_NVS_KEY, checkpoint, sizeof(download_checkpoint_t))) == ESP_OK)
+    {
+        result = nvs_commit(handle);
+    }
+
+    nvs_close(handle);
+
+    CMP_CHECK(TAG_CHECKPOINT, (result == ESP_OK), "failure saving checkpoint", false)
+
+    return true;
+}
+
+void download_checkpoint_clear()
+{
+    nvs_handle_t handle;
+
+    if (nvs_open(CHECKPOINT_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK)
+    {
+        return;
+    }
+
+    if (nvs_erase_key(handle, CHECKPOINT_NVS_KEY) == ESP_OK)
+    {
+        nvs_commit(handle);
+    }
+
+    nvs_close(handle);
+}
+#endif
@@ -0,0 +1,216 @@
+#include <stdlib.h>
+#include <string.h>
+#include "infrastructure/flash_writer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "assertion.h"
+#include "log.h"
+#include "config.h"
+
+static const char TAG_FLASH_WRITER[] = "AZ_FLASH_WRITER";
+
+typedef struct
+{
+    uint32_t offset; /** @brief Image offset where the block will be written. */
+    uint32_t length; /** @brief Block length; 0 stops the task. */
+    uint8_t buffer;  /** @brief Index of the buffer holding the block. */
+} flash_writer_block_t;
+
+struct flash_writer_t
+{
+    AzureADUImage_t *image;
+    uint8_t *buffers;
+    uint32_t block_size;
+    uint8_t buffers_count;
+    QueueHandle_t free_buffers;  /** @brief Indexes of the buffers not in use. */
+    QueueHandle_t queued_blocks; /** @brief Blocks waiting for the task. */
+    SemaphoreHandle_t stopped;   /** @brief Given by the task when exiting. */
+    TaskHandle_t task;
+    flash_writer_statistics_t statistics;
+    volatile bool failed;
+    volatile bool stopping;
+};
+
+static void flash_writer_task(void *arg);
+static void flash_writer_release(flash_writer_t *writer);
+
+flash_writer_t *flash_writer_create(AzureADUImage_t *image, uint32_t block_size, uint8_t buffers_count)
+{
+    CMP_CHECK(TAG_FLASH_WRITER, (buffers_count > 0), "no buffers", NULL)
+
+    flash_writer_t *writer = (flash_writer_t *)malloc(sizeof(flash_writer_t));
+
+    CMP_CHECK(TAG_FLASH_WRITER, (writer != NULL), "failure allocating writer", NULL)
+
+    memset(writer, 0, sizeof(flash_writer_t));
+
+    writer->image = image;
+    writer->block_size = block_size;
+    writer->buffers_count = buffers_count;
+    writer->buffers = (uint8_t *)malloc(block_size * buffers_count);
+    writer->free_buffers = xQueueCreate(buffers_count, sizeof(uint8_t));
+    writer->queued_blocks = xQueueCreate(buffers_count + 1, sizeof(flash_writer_block_t));
+    writer->stopped = xSemaphoreCreateBinary();
+
+    if (writer->buffers == NULL || writer->free_buffers == NULL || writer->queued_blocks == NULL || writer->stopped == NULL)
+    {
+        CMP_LOGE(TAG_FLASH_WRITER, "failure allocating %lu bytes", (unsigned long)(block_size * buffers_count));
+        flash_writer_release(writer);
+        return NULL;
+    }
+
+    for (uint8_t i = 0; i < buffers_count; i++)
+    {
+        xQueueSend(writer->free_buffers, &i, 0);
+    }
+
+    if (xTaskCreatePinnedToCore(flash_writer_task,
+                                "az_flash_writer",
+                                CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_TASK_STACK_SIZE,
+                                writer,
+                                CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_TASK_PRIORITY,
+                                &writer->task,
+                                CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_TASK_CORE < 0 ? tskNO_AFFINITY : CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_TASK_CORE) != pdPASS)
+    {
+        CMP_LOGE(TAG_FLASH_WRITER, "failure creating task");
+        flash_writer_release(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+bool flash_writer_write(flash_writer_t *writer, uint32_t offset, const uint8_t *block, uint32_t block_length)
+{
+    flash_writer_block_t queued_block = {
+        .offset = offset,
+        .length = block_length};
+
+    if (writer->failed)
+    {
+        return false;
+    }
+
+    if (block_length == 0 || block_length > writer->block_size)
+    {
+        CMP_LOGE(TAG_FLASH_WRITER, "invalid block length: %lu", (unsigned long)block_length);
+        return false;
+    }
+
+    if (xQueueReceive(writer->free_buffers, &queued_block.buffer, 0) != pdTRUE)
+    {
+        // Flash is slower than the network: wait for the task.
+        TickType_t started_at = xTaskGetTickCount();
+
+        xQueueReceive(writer->free_buffers, &queued_block.buffer, portMAX_DELAY);
+
+        writer->statistics.stalls++;
+        writer->statistics.stalled_ms += (uint32_t)((xTaskGetTickCount() - started_at) * portTICK_PERIOD_MS);
+    }
+
+    memcpy(writer->buffers + (queued_block.buffer * writer->block_size), block, block_length);
+
+    xQueueSend(writer->queued_blocks, &queued_block, portMAX_DELAY);
+
+    return true;
+}
+
+bool flash_writer_flush(flash_writer_t *writer)
+{
+    uint8_t buffer;
+
+    // All buffers are free once every block is written.
+    for (uint8_t i = 0; i < writer->buffers_count; i++)
+    {
+        xQueueReceive(writer->free_buffers, &buffer, portMAX_DELAY);
+    }
+
+    for (uint8_t i = 0; i < writer->buffers_count; i++)
+    {
+        xQueueSend(writer->free_buffers, &i, 0);
+    }
+
+    return !writer->failed;
+}
+
+const flash_writer_statistics_t *flash_writer_get_statistics(const flash_writer_t *writer)
+{
+    return &writer->statistics;
+}
+
+void flash_writer_free(flash_writer_t *writer)
+{
+    flash_writer_block_t stop = {
+        .offset = 0,
+        .length = 0,
+        .buffer = 0};
+
+    writer->stopping = true;
+
+    xQueueSend(writer->queued_blocks, &stop, portMAX_DELAY);
+    xSemaphoreTake(writer->stopped, portMAX_DELAY);
+
+    flash_writer_release(writer);
+}
+
+//
+// PRIVATE
+//
+
+static void flash_writer_task(void *arg)
+{
+    flash_writer_t *writer = (flash_writer_t *)arg;
+    flash_writer_block_t block;
+
+    while (xQueueReceive(writer->queued_blocks, &block, portMAX_DELAY) == pdTRUE && block.length > 0)
+    {
+        if (!writer->failed && !writer->stopping)
+        {
+            TickType_t started_at = xTaskGetTickCount();
+
+            if (AzureIoTPlatform_WriteBlock(writer->image,
+                                            block.offset,
+                                            writer->buffers + (block.buffer * writer->block_size),
+                                            block.length) != eAzureIoTSuccess)
+            {
+                CMP_LOGE(TAG_FLASH_WRITER, "failure writing block at %lu", (unsigned long)block.offset);
+
+                writer->failed = true;
+            }
+            else
+            {
+                writer->statistics.blocks++;
+                writer->statistics.flash_write_ms += (uint32_t)((xTaskGetTickCount() - started_at) * portTICK_PERIOD_MS);
+            }
+        }
+
+        xQueueSend(writer->free_buffers, &block.buffer, portMAX_DELAY);
+    }
+
+    xSemaphoreGive(writer->stopped);
+
+    vTaskDelete(NULL);
+}
+
+static void flash_writer_release(flash_writer_t *writer)
+{
+    if (writer->stopped != NULL)
+    {
+        vSemaphoreDelete(writer->stopped);
+    }
+
+    if (writer->queued_blocks != NULL)
+    {
+        vQueueDelete(writer->queued_blocks);
+    }
+
+    if (writer->free_buffers != NULL)
+    {
+        vQueueDelete(writer->free_buffers);
+    }
+
+    free(writer->buffers);
+    free(writer);
+}
@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <string.h>
+#include "infrastructure/image_decompressor.h"
+#include "assertion.h"
+#include "log.h"
+
+#define DECOMPRESSOR_WINDOW_BITS_MIN 8U
+#define DECOMPRESSOR_WINDOW_BITS_MAX 15U
+#define DECOMPRESSOR_LOOKAHEAD_BITS_MIN 3U
+#define DECOMPRESSOR_LITERAL_BITS 8U
+
+static const char TAG_DECOMPRESSOR[] = "AZ_DECOMPRESSOR";
+
+/**
+ * @brief What the next bits of the stream are.
+ */
+typedef enum
+{
+    DECOMPRESSOR_STATE_TAG,     /** @brief One bit: 1 for a literal, 0 for a back-reference. */
+    DECOMPRESSOR_STATE_LITERAL, /** @brief A byte to output as is. */
+    DECOMPRESSOR_STATE_INDEX,   /** @brief How far back, minus one, the back-reference starts. */
+    DECOMPRESSOR_STATE_COUNT    /** @brief How many bytes, minus one, the back-reference copies. */
+} decompressor_state_t;
+
+struct image_decompressor_t
+{
+    uint8_t *window;
+    uint32_t window_mask;
+    uint32_t head;
+    uint8_t *block;
+    uint32_t block_size;
+    uint32_t block_length;
+    uint32_t offset;
+    uint32_t bits;
+    uint8_t bits_count;
+    uint8_t window_bits;
+    uint8_t lookahead_bits;
+    uint32_t index;
+    decompressor_state_t state;
+    image_decompressor_output_t callback;
+    void *callback_context;
+};
+
+static uint32_t decompressor_take_bits(image_decompressor_t *decompressor, uint8_t count);
+static bool decompressor_output(image_decompressor_t *decompressor, uint8_t byte);
+static bool decompressor_flush(image_decompressor_t *decompressor);
+
+image_decompressor_t *image_decompressor_create(uint8_t window_bits,
+                                                uint8_t lookahead_bits,
+                                                uint32_t block_size,
+                                                image_decompressor_output_t callback,
+                                                void *callback_context)
+{
+    CMP_CHECK(TAG_DECOMPRESSOR, (window_bits >= DECOMPRESSOR_WINDOW_BITS_MIN && window_bits <= DECOMPRESSOR_WINDOW_BITS_MAX), "invalid window bits", NULL)
+    CMP_CHECK(TAG_DECOMPRESSOR, (lookahead_bits >= DECOMPRESSOR_LOOKAHEAD_BITS_MIN && lookahead_bits < window_bits), "invalid lookahead bits", NULL)
+    CMP_CHECK(TAG_DECOMPRESSOR, (block_size > 0 && callback != NULL), "invalid block", NULL)
+
+    image_decompressor_t *decompressor = (image_decompressor_t *)malloc(sizeof(image_decompressor_t));
+
+    CMP_CHECK(TAG_DECOMPRESSOR, (decompressor != NULL), "failure allocating decompressor", NULL)
+
+    memset(decompressor, 0, sizeof(image_decompressor_t));
+
+    // Zeroed: back-references before the image start read zeros, as heatshrink does.
+    decompressor->window = (uint8_t *)calloc(1U << window_bits, 1);
+    decompressor->block = (uint8_t *)malloc(block_size);
+
+    if (decompressor->window == NULL || decompressor->block == NULL)
+    {
+        CMP_LOGE(TAG_DECOMPRESSOR, "failure allocating buffers");
+        image_decompressor_free(decompressor);
+        return NULL;
+    }
+
+    decompressor->window_mask = (1U << window_bits) - 1U;
+    decompressor->block_size = block_size;
+    decompressor->window_bits = window_bits;
+    decompressor->lookahead_bits = lookahead_bits;
+    decompressor->state = DECOMPRESSOR_STATE_TAG;
+    decompressor->callback = callback;
+    decompressor->callback_context = callback_context;
+
+    return decompressor;
+}
+
+bool image_decompressor_write(image_decompressor_t *decompressor, const uint8_t *data, uint32_t data_length)
+{
+    for (uint32_t i = 0; i < data_length; i++)
+    {
+        decompressor->bits = (decompressor->bits << 8) | data[i];
+        decompressor->bits_count += 8;
+
+        // Consumes every complete field: at most a tag and an index are left pending.
+        bool has_bits = true;
+
+        while (has_bits)
+        {
+            switch (decompressor->state)
+            {
+            case DECOMPRESSOR_STATE_TAG:
+                if ((has_bits = decompressor->bits_count >= 1))
+                {
+                    decompressor->state = decompressor_take_bits(decompressor, 1) ? DECOMPRESSOR_STATE_LITERAL : DECOMPRESSOR_STATE_INDEX;
+                }
+                break;
+
+            case DECOMPRESSOR_STATE_LITERAL:
+                if ((has_bits = decompressor->bits_count >= DECOMPRESSOR_LITERAL_BITS))
+                {
+                    if (!decompressor_output(decompressor, (uint8_t)decompressor_take_bits(decompressor, DECOMPRESSOR_LITERAL_BITS)))
+                    {
+                        return false;
+                    }
+
+                    decompressor->state = DECOMPRESSOR_STATE_TAG;
+                }
+                break;
+
+            case DECOMPRESSOR_STATE_INDEX:
+                if ((has_bits = decompressor->bits_count >= decompressor->window_bits))
+                {
+                    decompressor->index = decompressor_take_bits(decompressor, decompressor->window_bits) + 1U;
+                    decompressor->state = DECOMPRESSOR_STATE_COUNT;
+                }
+                break;
+
+            case DECOMPRESSOR_STATE_COUNT:
+                if ((has_bits = decompressor->bits_count >= decompressor->lookahead_bits))
+                {
+                    uint32_t count = decompressor_take_bits(decompressor, decompressor->lookahead_bits) + 1U;
+
+                    // Byte by byte: the copy may overlap the bytes it outputs.
+                    for (uint32_t j = 0; j < count; j++)
+                    {
+                        uint8_t byte = decompressor->window[(decompressor->head - decompressor->index) & decompressor->window_mask];
+
+                        if (!decompressor_output(decompressor, byte))
+                        {
+                            return false;
+                        }
+                    }
+
+                    decompressor->state = DECOMPRESSOR_STATE_TAG;
+                }
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool image_decompressor_finish(image_decompressor_t *decompressor)
+{
+    // The stream is padded with zero bits to a whole byte: a padding
+    // bit taken as a back-reference tag leaves an incomplete index.
+    bool ended = decompressor->state == DECOMPRESSOR_STATE_TAG ||
+                 (decompressor->state == DECOMPRESSOR_STATE_INDEX && decompressor->bits_count < DECOMPRESSOR_LITERAL_BITS - 1U && decompressor->bits == 0);
+
+    CMP_CHECK(TAG_DECOMPRESSOR, ended, "compressed stream truncated", false)
+
+    return decompressor_flush(decompressor);
+}
+
+uint32_t image_decompressor_get_size(const image_decompressor_t *decompressor)
+{
+    return decompressor->head;
+}
+
+void image_decompressor_free(image_decompressor_t *decompressor)
+{
+    if (decompressor == NULL)
+    {
+        return;
+    }
+
+    free(decompressor->window);
+    free(decompressor->block);
+    free(decompressor);
+}
+
+//
+// PRIVATE
+//
+
+static uint32_t decompressor_take_bits(image_decompressor_t *decompressor, uint8_t count)
+{
+    decompressor->bits_count -= count;
+
+    uint32_t value = decompressor->bits >> decompressor->bits_count;
+
+    decompressor->bits &= (1U << decompressor->bits_count) - 1U;
+
+    return value;
+}
+
+static bool decompressor_output(image_decompressor_t *decompressor, uint8_t byte)
+{
+    decompressor->window[decompressor->head & decompressor->window_mask] = byte;
+    decompressor->head++;
+
+    decompressor->block[decompressor->block_length++] = byte;
+
+    if (decompressor->block_length == decompressor->block_size)
+    {
+        return decompressor_flush(decompressor);
+    }
+
+    return true;
+}
+
+static bool decompressor_flush(image_decompressor_t *decompressor)
+{
+    if (decompressor->block_length == 0)
+    {
+        return true;
+    }
+
+    if (!decompressor->callback(decompressor->block, decompressor->block_length, decompressor->offset, decompressor->callback_context))
+    {
+        return false;
+    }
+
+    decompressor->offset += decompressor->block_length;
+    decompressor->block_length = 0;
+
+    return true;
+}
@@ -0,0 +1,279 @@
+#include <stdlib.h>
+#include <string.h>
+#include "infrastructure/image_patcher.h"
+#include "assertion.h"
+#include "log.h"
+
+#define PATCHER_MAGIC_SIZE (sizeof(IMAGE_PATCHER_MAGIC) - 1U)
+#define PATCHER_HEADER_SIZE (PATCHER_MAGIC_SIZE + 4U)
+#define PATCHER_FIELD_SIZE 4U
+
+static const char TAG_PATCHER[] = "AZ_PATCHER";
+
+/**
+ * @brief What the next bytes of the patch are.
+ */
+typedef enum
+{
+    PATCHER_STATE_HEADER,       /** @brief Magic and new image size. */
+    PATCHER_STATE_DIFF_LENGTH,  /** @brief Length of the diff bytes. */
+    PATCHER_STATE_DIFF,         /** @brief Bytes to add to the old image bytes. */
+    PATCHER_STATE_EXTRA_LENGTH, /** @brief Length of the extra bytes. */
+    PATCHER_STATE_EXTRA,        /** @brief Bytes to copy as is. */
+    PATCHER_STATE_ADJUSTMENT    /** @brief How much to move the old image offset. */
+} patcher_state_t;
+
+struct image_patcher_t
+{
+    uint8_t *block;
+    uint32_t block_size;
+    uint32_t block_length;
+    uint32_t offset;
+    uint32_t image_size;
+    uint32_t old_offset;
+    uint32_t remaining;
+    uint8_t field[PATCHER_HEADER_SIZE];
+    uint8_t field_length;
+    patcher_state_t state;
+    image_patcher_read_t read;
+    image_patcher_output_t output;
+    void *callback_context;
+};
+
+static uint32_t patcher_take_field(image_patcher_t *patcher, const uint8_t *data, uint32_t data_length, uint8_t field_size);
+static bool patcher_parse_field(image_patcher_t *patcher);
+static uint32_t patcher_copy(image_patcher_t *patcher, const uint8_t *data, uint32_t data_length);
+static bool patcher_flush(image_patcher_t *patcher);
+
+image_patcher_t *image_patcher_create(uint32_t block_size,
+                                      image_patcher_read_t read,
+                                      image_patcher_output_t output,
+                                      void *callback_context)
+{
+    CMP_CHECK(TAG_PATCHER, (block_size > 0 && read != NULL && output != NULL), "invalid arguments", NULL)
+
+    image_patcher_t *patcher = (image_patcher_t *)malloc(sizeof(image_patcher_t));
+
+    CMP_CHECK(TAG_PATCHER, (patcher != NULL), "failure allocating patcher", NULL)
+
+    memset(patcher, 0, sizeof(image_patcher_t));
+
+    if ((patcher->block = (uint8_t *)malloc(block_size)) == NULL)
+    {
+        CMP_LOGE(TAG_PATCHER, "failure allocating block");
+        free(patcher);
+        return NULL;
+    }
+
+    patcher->block_size = block_size;
+    patcher->state = PATCHER_STATE_HEADER;
+    patcher->read = read;
+    patcher->output = output;
+    patcher->callback_context = callback_context;
+
+    return patcher;
+}
+
+bool image_patcher_write(image_patcher_t *patcher, const uint8_t *data, uint32_t data_length)
+{
+    while (data_length > 0)
+    {
+        uint32_t taken;
+
+        switch (patcher->state)
+        {
+        case PATCHER_STATE_DIFF:
+        case PATCHER_STATE_EXTRA:
+            if ((taken = patcher_copy(patcher, data, data_length)) == 0)
+            {
+                return false;
+            }
+            break;
+
+        default:
+        {
+            uint8_t field_size = patcher->state == PATCHER_STATE_HEADER ? PATCHER_HEADER_SIZE : PATCHER_FIELD_SIZE;
+
+            // Fields may be split between writes: gathered until complete.
+            taken = patcher_take_field(patcher, data, data_length, field_size);
+
+            if (patcher->field_length == field_size)
+            {
+                patcher->field_length = 0;
+
+                if (!patcher_parse_field(patcher))
+                {
+                    return false;
+                }
+            }
+            break;
+        }
+        }
+
+        data += taken;
+        data_length -= taken;
+    }
+
+    return true;
+}
+
+bool image_patcher_finish(image_patcher_t *patcher)
+{
+    uint32_t size = patcher->offset + patcher->block_length;
+
+    if (patcher->state == PATCHER_STATE_HEADER || patcher->field_length != 0 || size != patcher->image_size)
+    {
+        CMP_LOGE(TAG_PATCHER, "patch truncated: %lu of %lu bytes rebuilt", (unsigned long)size, (unsigned long)patcher->image_size);
+        return false;
+    }
+
+    return patcher_flush(patcher);
+}
+
+uint32_t image_patcher_get_size(const image_patcher_t *patcher)
+{
+    return patcher->offset + patcher->block_length;
+}
+
+void image_patcher_free(image_patcher_t *patcher)
+{
+    if (patcher == NULL)
+    {
+        return;
+    }
+
+    free(patcher->block);
+    free(patcher);
+}
+
+//
+// PRIVATE
+//
+
+static uint32_t patcher_take_field(image_patcher_t *patcher, const uint8_t *data, uint32_t data_length, uint8_t field_size)
+{
+    uint32_t taken = field_size - patcher->field_length;
+
+    if (taken > data_length)
+    {
+        taken = data_length;
+    }
+
+    memcpy(patcher->field + patcher->field_length, data, taken);
+
+    patcher->field_length += taken;
+
+    return taken;
+}
+
+static bool patcher_parse_field(image_patcher_t *patcher)
+{
+    const uint8_t *field = patcher->state == PATCHER_STATE_HEADER ? patcher->field + PATCHER_MAGIC_SIZE : patcher->field;
+    uint32_t value = (uint32_t)field[0] | ((uint32_t)field[1] << 8) | ((uint32_t)field[2] << 16) | ((uint32_t)field[3] << 24);
+    uint32_t size = patcher->offset + patcher->block_length;
+
+    switch (patcher->state)
+    {
+    case PATCHER_STATE_HEADER:
+        CMP_CHECK(TAG_PATCHER, (memcmp(patcher->field, IMAGE_PATCHER_MAGIC, PATCHER_MAGIC_SIZE) == 0), "invalid patch: bad magic", false)
+
+        patcher->image_size = value;
+        patcher->state = PATCHER_STATE_DIFF_LENGTH;
+        break;
+
+    case PATCHER_STATE_DIFF_LENGTH:
+    case PATCHER_STATE_EXTRA_LENGTH:
+        CMP_CHECK(TAG_PATCHER, (value <= patcher->image_size - size), "invalid patch: bigger than the new image", false)
+
+        patcher->remaining = value;
+        patcher->state = patcher->state == PATCHER_STATE_DIFF_LENGTH ? PATCHER_STATE_DIFF : PATCHER_STATE_EXTRA;
+
+        if (value == 0)
+        {
+            patcher->state = patcher->state == PATCHER_STATE_DIFF ? PATCHER_STATE_EXTRA_LENGTH : PATCHER_STATE_ADJUSTMENT;
+        }
+        break;
+
+    case PATCHER_STATE_ADJUSTMENT:
+        // Two's complement: wraps around to move the old offset back.
+        patcher->old_offset += value;
+        patcher->state = PATCHER_STATE_DIFF_LENGTH;
+        break;
+
+    default:
+        break;
+    }
+
+    return true;
+}
+
+static uint32_t patcher_copy(image_patcher_t *patcher, const uint8_t *data, uint32_t data_length)
+{
+    uint32_t length = patcher->remaining;
+
+    if (length > data_length)
+    {
+        length = data_length;
+    }
+
+    if (length > patcher->block_size - patcher->block_length)
+    {
+        length = patcher->block_size - patcher->block_length;
+    }
+
+    uint8_t *target = patcher->block + patcher->block_length;
+
+    if (patcher->state == PATCHER_STATE_DIFF)
+    {
+        // Old bytes read straight into the block, the diff added in place.
+        if (!patcher->read(patcher->old_offset, target, length, patcher->callback_context))
+        {
+            CMP_LOGE(TAG_PATCHER, "failure reading old image at: %lu", (unsigned long)patcher->old_offset);
+            return 0;
+        }
+
+        for (uint32_t i = 0; i < length; i++)
+        {
+            target[i] += data[i];
+        }
+
+        patcher->old_offset += length;
+    }
+    else
+    {
+        memcpy(target, data, length);
+    }
+
+    patcher->block_length += length;
+    patcher->remaining -= length;
+
+    if (patcher->remaining == 0)
+    {
+        patcher->state = patcher->state == PATCHER_STATE_DIFF ? PATCHER_STATE_EXTRA_LENGTH : PATCHER_STATE_ADJUSTMENT;
+    }
+
+    if (patcher->block_length == patcher->block_size && !patcher_flush(patcher))
+    {
+        return 0;
+    }
+
+    return length;
+}
+
+static bool patcher_flush(image_patcher_t *patcher)
+{
+    if (patcher->block_length == 0)
+    {
+        return true;
+    }
+
+    if (!patcher->output(patcher->block, patcher->block_length, patcher->offset, patcher->callback_context))
+    {
+        return false;
+    }
+
+    patcher->offset += patcher->block_length;
+    patcher->block_length = 0;
+
+    return true;
+}
@@ -0,0 +1,198 @@
+#include <string.h>
+#include "infrastructure/metrics.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "assertion.h"
+#include "config.h"
+#include "log.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_timer.h"
+#endif
+
+static const char TAG_METRICS[] = "AZ_METRICS";
+
+typedef struct
+{
+    SemaphoreHandle_t lock;
+    azure_iot_metric_histogram_t histograms[AZURE_IOT_METRIC_COUNT];
+    uint64_t reset_at_us;
+} metrics_registry_t;
+
+static const uint32_t METRICS_BUCKET_BOUNDS_US[AZURE_IOT_METRICS_BUCKET_COUNT] = {
+    500U, 1000U, 2500U, 5000U, 10000U, 25000U, 50000U,
+    100000U, 250000U, 500000U, 1000000U, 2500000U, 5000000U, UINT32_MAX};
+
+static const char *const METRICS_NAMES[AZURE_IOT_METRIC_COUNT] = {
+    "tcp_connect",
+    "tls_connect",
+    "transport_write",
+    "transport_read",
+    "hub_connect",
+    "hub_subscribe",
+    "hub_puback",
+    "http_request"};
+
+static metrics_registry_t REGISTRY = {0};
+
+bool metrics_init()
+{
+    if (REGISTRY.lock == NULL)
+    {
+        REGISTRY.lock = xSemaphoreCreateMutex();
+    }
+
+    CMP_CHECK(TAG_METRICS, (REGISTRY.lock != NULL), "failure creating lock", false)
+
+    azure_iot_metrics_reset();
+
+    return true;
+}
+
+void metrics_deinit()
+{
+    if (REGISTRY.lock == NULL)
+    {
+        return;
+    }
+
+    vSemaphoreDelete(REGISTRY.lock);
+
+    memset(&REGISTRY, 0, sizeof(metrics_registry_t));
+}
+
+uint64_t metrics_get_time_us()
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000ULL + (uint64_t)now.tv_nsec / 1000ULL;
+#else
+    return (uint64_t)esp_timer_get_time();
+#endif
+}
+
+void metrics_record(azure_iot_metric_t metric, uint64_t started_at_us, bool failed)
+{
+    if (REGISTRY.lock == NULL || metric >= AZURE_IOT_METRIC_COUNT)
+    {
+        return;
+    }
+
+    uint64_t elapsed_us = metrics_get_time_us() - started_at_us;
+    uint32_t latency_us = elapsed_us > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed_us;
+    uint32_t bucket = 0;
+
+    while (latency_us > METRICS_BUCKET_BOUNDS_US[bucket])
+    {
+        bucket++;
+    }
+
+    xSemaphoreTake(REGISTRY.lock, portMAX_DELAY);
+
+    azure_iot_metric_histogram_t *histogram = &REGISTRY.histograms[metric];
+
+    histogram->count++;
+    histogram->errors += failed ? 1U : 0U;
+    histogram->max_us = latency_us > histogram->max_us ? latency_us : histogram->max_us;
+    histogram->total_us += latency_us;
+    histogram->buckets[bucket]++;
+
+    xSemaphoreGive(REGISTRY.lock);
+}
+
+void azure_iot_metrics_snapshot(azure_iot_metrics_snapshot_t *snapshot, bool reset)
+{
+    if (REGISTRY.lock == NULL)
+    {
+        memset(snapshot, 0, sizeof(azure_iot_metrics_snapshot_t));
+        return;
+    }
+
+    xSemaphoreTake(REGISTRY.lock, portMAX_DELAY);
+
+    uint64_t now_us = metrics_get_time_us();
+
+    memcpy(snapshot->histograms, REGISTRY.histograms, sizeof(REGISTRY.histograms));
+
+    snapshot->period_ms = (uint32_t)((now_us - REGISTRY.reset_at_us) / 1000ULL);
+
+    if (reset)
+    {
+        memset(REGISTRY.histograms, 0, sizeof(REGISTRY.histograms));
+
+        REGISTRY.reset_at_us = now_us;
+    }
+
+    xSemaphoreGive(REGISTRY.lock);
+}
+
+void azure_iot_metrics_reset()
+{
+    if (REGISTRY.lock == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(REGISTRY.lock, portMAX_DELAY);
+
+    memset(REGISTRY.histograms, 0, sizeof(REGISTRY.histograms));
+
+    REGISTRY.reset_at_us = metrics_get_time_us();
+
+    xSemaphoreGive(REGISTRY.lock);
+}
+
+void azure_iot_metrics_get_histogram(azure_iot_metric_t metric, azure_iot_metric_histogram_t *histogram)
+{
+    if (REGISTRY.lock == NULL || metric >= AZURE_IOT_METRIC_COUNT)
+    {
+        memset(histogram, 0, sizeof(azure_iot_metric_histogram_t));
+        return;
+    }
+
+    xSemaphoreTake(REGISTRY.lock, portMAX_DELAY);
+
+    *histogram = REGISTRY.histograms[metric];
+
+    xSemaphoreGive(REGISTRY.lock);
+}
+
+uint32_t azure_iot_metrics_get_percentile_us(const azure_iot_metric_histogram_t *histogram, uint32_t percentile)
+{
+    if (histogram->count == 0)
+    {
+        return 0;
+    }
+
+    // Rank of the operation at the percentile, rounded up.
+    uint64_t rank = ((uint64_t)histogram->count * (percentile > 100U ? 100U : percentile) + 99U) / 100U;
+    uint64_t seen = 0;
+    uint32_t bucket = 0;
+
+    for (; bucket < AZURE_IOT_METRICS_BUCKET_COUNT - 1U; bucket++)
+    {
+        seen += histogram->buckets[bucket];
+
+        if (seen >= rank)
+        {
+            break;
+        }
+    }
+
+    return METRICS_BUCKET_BOUNDS_US[bucket] < histogram->max_us ? METRICS_BUCKET_BOUNDS_US[bucket] : histogram->max_us;
+}
+
+const char *azure_iot_metrics_get_name(azure_iot_metric_t metric)
+{
+    return metric < AZURE_IOT_METRIC_COUNT ? METRICS_NAMES[metric] : "unknown";
+}
+
+uint32_t azure_iot_metrics_get_bucket_bound_us(uint32_t bucket)
+{
+    return bucket < AZURE_IOT_METRICS_BUCKET_COUNT ? METRICS_BUCKET_BOUNDS_US[bucket] : UINT32_MAX;
+}
@@ -0,0 +1,106 @@
+#include <string.h>
+#include "infrastructure/provisioning_cache.h"
+#include "sdkconfig.h"
+#include "assertion.h"
+#include "log.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "nvs.h"
+
+#define PROVISIONING_CACHE_NVS_NAMESPACE "az_dps"
+#define PROVISIONING_CACHE_NVS_KEY "registration"
+#endif
+
+static const char TAG_PROVISIONING_CACHE[] = "AZ_DPS_CACHE";
+
+#if CONFIG_IDF_TARGET_LINUX
+// Stands in for NVS; kept for the process lifetime.
+static provisioning_cache_t HOST_CACHE;
+static bool HOST_HAS_CACHE = false;
+
+bool provisioning_cache_load(provisioning_cache_t *cache)
+{
+    if (HOST_HAS_CACHE)
+    {
+        *cache = HOST_CACHE;
+    }
+
+    return HOST_HAS_CACHE;
+}
+
+bool provisioning_cache_save(const provisioning_cache_t *cache)
+{
+    HOST_CACHE = *cache;
+    HOST_HAS_CACHE = true;
+
+    return true;
+}
+
+void provisioning_cache_clear()
+{
+    HOST_HAS_CACHE = false;
+}
+#else
+bool provisioning_cache_load(provisioning_cache_t *cache)
+{
+    nvs_handle_t handle;
+    size_t length = sizeof(provisioning_cache_t);
+
+    if (nvs_open(PROVISIONING_CACHE_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+    {
+        return false;
+    }
+
+    esp_err_t result = nvs_get_blob(handle, PROVISIONING_CACHE_NVS_KEY, cache, &length);
+
+    nvs_close(handle);
+
+    // A different length is a registration saved by a firmware with other limits.
+    if (result != ESP_OK || length != sizeof(provisioning_cache_t))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool provisioning_cache_save(const provisioning_cache_t *cache)
+{
+    nvs_handle_t handle;
+    esp_err_t result;
+
+    if ((result = nvs_open(PROVISIONING_CACHE_NVS_NAMESPACE, NVS_READWRITE, &handle)) != ESP_OK)
+    {
+        CMP_LOGE(TAG_PROVISIONING_CACHE, "failure opening nvs: %d", result);
+        return false;
+    }
+
+    if ((result = nvs_set_blob(handle, PROVISIONING_CACHE_NVS_KEY, cache, sizeof(provisioning_cache_t))) == ESP_OK)
+    {
+        result = nvs_commit(handle);
+    }
+
+    nvs_close(handle);
+
+    CMP_CHECK(TAG_PROVISIONING_CACHE, (result == ESP_OK), "failure saving registration", false)
+
+    return true;
+}
+
+void provisioning_cache_clear()
+{
+    nvs_handle_t handle;
+
+    if (nvs_open(PROVISIONING_CACHE_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK)
+    {
+        return;
+    }
+
+    if (nvs_erase_key(handle, PROVISIONING_CACHE_NVS_KEY) == ESP_OK)
+    {
+        nvs_commit(handle);
+    }
+
+    nvs_close(handle);
+}
+#endif
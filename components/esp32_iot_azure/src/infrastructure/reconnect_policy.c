@@ -0,0 +1,249 @@
+#include <string.h>
+#include "infrastructure/reconnect_policy.h"
+#include "infrastructure/backoff_algorithm.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "assertion.h"
+#include "config.h"
+#include "log.h"
+
+#define RECONNECT_POLICY_HOSTNAME_SIZE 128U
+
+static const char TAG_RECONNECT_POLICY[] = "AZ_RECONNECT";
+
+typedef enum
+{
+    RECONNECT_CIRCUIT_CLOSED = 0, /** @brief Attempts allowed. */
+    RECONNECT_CIRCUIT_OPEN,       /** @brief Attempts refused until the open time elapses. */
+    RECONNECT_CIRCUIT_HALF_OPEN   /** @brief A single probe in progress. */
+} reconnect_circuit_state_t;
+
+/**
+ * @brief State of a server.
+ */
+typedef struct
+{
+    char hostname[RECONNECT_POLICY_HOSTNAME_SIZE]; /** @brief Server address; empty if the entry is free. */
+    uint16_t port;                                 /** @brief Server port. */
+    reconnect_circuit_state_t state;               /** @brief Circuit breaker state. */
+    uint32_t failures;                             /** @brief Consecutive failures. */
+    uint32_t delay_ms;                             /** @brief Last delay returned, the next one is drawn from. */
+    TickType_t opened_at;                          /** @brief When the circuit was opened. */
+    uint32_t used_at;                              /** @brief When the entry was last used, in policy uses. */
+} reconnect_endpoint_t;
+
+typedef struct
+{
+    SemaphoreHandle_t lock;
+    reconnect_endpoint_t endpoints[CONFIG_ESP32_IOT_AZURE_TRANSPORT_RECONNECT_SERVERS];
+    uint32_t uses;
+    reconnect_policy_statistics_t statistics;
+} reconnect_policy_t;
+
+static reconnect_policy_t POLICY = {0};
+
+static reconnect_endpoint_t *reconnect_policy_get(const char *hostname, uint16_t port);
+
+bool reconnect_policy_init()
+{
+    if (POLICY.lock == NULL)
+    {
+        POLICY.lock = xSemaphoreCreateMutex();
+    }
+
+    CMP_CHECK(TAG_RECONNECT_POLICY, (POLICY.lock != NULL), "failure creating lock", false)
+
+    memset(&POLICY.statistics, 0, sizeof(reconnect_policy_statistics_t));
+
+    return true;
+}
+
+void reconnect_policy_deinit()
+{
+    if (POLICY.lock == NULL)
+    {
+        return;
+    }
+
+    vSemaphoreDelete(POLICY.lock);
+
+    memset(&POLICY, 0, sizeof(reconnect_policy_t));
+}
+
+reconnect_policy_decision_t reconnect_policy_acquire(const char *hostname, uint16_t port, uint32_t *wait_ms)
+{
+    reconnect_policy_decision_t decision = RECONNECT_POLICY_ATTEMPT;
+
+    if (POLICY.lock == NULL)
+    {
+        return RECONNECT_POLICY_ATTEMPT;
+    }
+
+    xSemaphoreTake(POLICY.lock, portMAX_DELAY);
+
+    reconnect_endpoint_t *endpoint = reconnect_policy_get(hostname, port);
+
+    if (endpoint != NULL && endpoint->state == RECONNECT_CIRCUIT_OPEN)
+    {
+        uint32_t open_ms = pdTICKS_TO_MS(xTaskGetTickCount() - endpoint->opened_at);
+
+        if (open_ms >= CONFIG_ESP32_IOT_AZURE_TRANSPORT_CIRCUIT_BREAKER_OPEN_MS)
+        {
+            CMP_LOGI(TAG_RECONNECT_POLICY, "probing '%s' on %d", hostname, port);
+
+            endpoint->state = RECONNECT_CIRCUIT_HALF_OPEN;
+        }
+        else
+        {
+            *wait_ms = CONFIG_ESP32_IOT_AZURE_TRANSPORT_CIRCUIT_BREAKER_OPEN_MS - open_ms;
+            decision = RECONNECT_POLICY_WAIT;
+        }
+    }
+    else if (endpoint != NULL && endpoint->state == RECONNECT_CIRCUIT_HALF_OPEN)
+    {
+        // Another transport is probing the server: its result opens or closes the circuit.
+        *wait_ms = CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_BASE_MS;
+        decision = RECONNECT_POLICY_WAIT;
+    }
+
+    if (decision == RECONNECT_POLICY_ATTEMPT)
+    {
+        POLICY.statistics.attempts++;
+    }
+    else
+    {
+        POLICY.statistics.rejected++;
+    }
+
+    xSemaphoreGive(POLICY.lock);
+
+    return decision;
+}
+
+uint32_t reconnect_policy_failed(const char *hostname, uint16_t port)
+{
+    if (POLICY.lock == NULL)
+    {
+        return backoff_algorithm_get_decorrelated(CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_BASE_MS,
+                                                  CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_MAX_DELAY_MS,
+                                                  0U);
+    }
+
+    xSemaphoreTake(POLICY.lock, portMAX_DELAY);
+
+    reconnect_endpoint_t *endpoint = reconnect_policy_get(hostname, port);
+    uint32_t delay_ms = backoff_algorithm_get_decorrelated(CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_BASE_MS,
+                                                           CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_MAX_DELAY_MS,
+                                                           endpoint != NULL ? endpoint->delay_ms : 0U);
+
+    POLICY.statistics.failures++;
+
+    if (endpoint != NULL)
+    {
+        endpoint->delay_ms = delay_ms;
+        endpoint->failures++;
+
+        if (endpoint->state == RECONNECT_CIRCUIT_HALF_OPEN ||
+            (CONFIG_ESP32_IOT_AZURE_TRANSPORT_CIRCUIT_BREAKER_THRESHOLD > 0 &&
+             endpoint->failures >= CONFIG_ESP32_IOT_AZURE_TRANSPORT_CIRCUIT_BREAKER_THRESHOLD))
+        {
+            CMP_LOGW(TAG_RECONNECT_POLICY, "circuit of '%s' on %d open, after %lu failures", hostname, port, (unsigned long)endpoint->failures);
+
+            endpoint->state = RECONNECT_CIRCUIT_OPEN;
+            endpoint->opened_at = xTaskGetTickCount();
+
+            POLICY.statistics.circuit_opens++;
+        }
+    }
+
+    xSemaphoreGive(POLICY.lock);
+
+    return delay_ms;
+}
+
+void reconnect_policy_succeeded(const char *hostname, uint16_t port)
+{
+    if (POLICY.lock == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(POLICY.lock, portMAX_DELAY);
+
+    reconnect_endpoint_t *endpoint = reconnect_policy_get(hostname, port);
+
+    if (endpoint != NULL)
+    {
+        if (endpoint->state != RECONNECT_CIRCUIT_CLOSED)
+        {
+            CMP_LOGI(TAG_RECONNECT_POLICY, "circuit of '%s' on %d closed", hostname, port);
+        }
+
+        endpoint->state = RECONNECT_CIRCUIT_CLOSED;
+        endpoint->failures = 0;
+        endpoint->delay_ms = 0;
+    }
+
+    xSemaphoreGive(POLICY.lock);
+}
+
+void reconnect_policy_count_network_down()
+{
+    if (POLICY.lock == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(POLICY.lock, portMAX_DELAY);
+
+    POLICY.statistics.network_down++;
+
+    xSemaphoreGive(POLICY.lock);
+}
+
+void reconnect_policy_get_statistics(reconnect_policy_statistics_t *statistics)
+{
+    *statistics = POLICY.statistics;
+}
+
+//
+// PRIVATE
+//
+
+static reconnect_endpoint_t *reconnect_policy_get(const char *hostname, uint16_t port)
+{
+    if (strlen(hostname) >= RECONNECT_POLICY_HOSTNAME_SIZE)
+    {
+        return NULL;
+    }
+
+    reconnect_endpoint_t *endpoint = &POLICY.endpoints[0];
+
+    for (size_t i = 0; i < CONFIG_ESP32_IOT_AZURE_TRANSPORT_RECONNECT_SERVERS; i++)
+    {
+        reconnect_endpoint_t *candidate = &POLICY.endpoints[i];
+
+        if (candidate->port == port && strcmp(candidate->hostname, hostname) == 0)
+        {
+            candidate->used_at = ++POLICY.uses;
+
+            return candidate;
+        }
+
+        // A free entry, or the least recently used one.
+        if (endpoint->hostname[0] != '\0' && (candidate->hostname[0] == '\0' || candidate->used_at < endpoint->used_at))
+        {
+            endpoint = candidate;
+        }
+    }
+
+    memset(endpoint, 0, sizeof(reconnect_endpoint_t));
+
+    strcpy(endpoint->hostname, hostname);
+
+    endpoint->port = port;
+    endpoint->used_at = ++POLICY.uses;
+
+    return endpoint;
+}
@@ -0,0 +1,541 @@
+#include <stdlib.h>
+#include <string.h>
+#include "infrastructure/telemetry_log.h"
+#include "sdkconfig.h"
+#include "config.h"
+#include "assertion.h"
+#include "log.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_partition.h"
+#endif
+
+#define TELEMETRY_LOG_SECTOR_SIZE 4096U
+#define TELEMETRY_LOG_SECTOR_MAGIC 0x51545A41U // "AZTQ"
+#define TELEMETRY_LOG_SEQUENCE_NONE 0xFFFFFFFFU
+#define TELEMETRY_LOG_LENGTH_NONE 0xFFFFU
+#define TELEMETRY_LOG_ALIGN(length) (((length) + 3U) & ~3U)
+
+// States only clear bits: written in place without erasing.
+#define TELEMETRY_LOG_STATE_WRITING 0xFFU
+#define TELEMETRY_LOG_STATE_COMMITTED 0xFEU
+#define TELEMETRY_LOG_STATE_CONSUMED 0xFCU
+
+#if CONFIG_IDF_TARGET_LINUX
+#define TELEMETRY_LOG_HOST_SECTOR_COUNT 8U
+#endif
+
+static const char TAG_TELEMETRY_LOG[] = "AZ_TELEMETRY_LOG";
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t sequence; /** @brief Incremented on each sector erase: the order sectors were written. */
+} telemetry_log_sector_header_t;
+
+typedef struct
+{
+    uint8_t state;
+    uint8_t qos;
+    uint16_t properties_length;
+    uint16_t payload_length;
+    uint16_t reserved;
+    uint32_t expires_at;
+    uint32_t crc; /** @brief CRC-32 of the fields from \p qos to \p expires_at, properties and payload. */
+} telemetry_log_record_header_t;
+
+struct telemetry_log_t
+{
+#if !CONFIG_IDF_TARGET_LINUX
+    const esp_partition_t *partition;
+#endif
+    uint16_t sector_count;
+    uint32_t *sequences; /** @brief Sequence of each sector; @ref TELEMETRY_LOG_SEQUENCE_NONE if not written. */
+    uint16_t *pending;   /** @brief Pending records of each sector. */
+    uint16_t write_sector;
+    uint16_t write_offset;
+    telemetry_log_statistics_t statistics;
+};
+
+#if CONFIG_IDF_TARGET_LINUX
+// Stands in for the partition; kept for the process lifetime.
+static uint8_t HOST_PARTITION[TELEMETRY_LOG_HOST_SECTOR_COUNT * TELEMETRY_LOG_SECTOR_SIZE];
+static bool HOST_PARTITION_ERASED = false;
+#endif
+
+static bool telemetry_log_storage_open(telemetry_log_t *log);
+static bool telemetry_log_storage_read(const telemetry_log_t *log, uint16_t sector, uint16_t offset, void *data, size_t length);
+static bool telemetry_log_storage_write(const telemetry_log_t *log, uint16_t sector, uint16_t offset, const void *data, size_t length);
+static bool telemetry_log_storage_erase(const telemetry_log_t *log, uint16_t sector);
+static void telemetry_log_scan_sector(telemetry_log_t *log, uint16_t sector, uint16_t *end, uint16_t *pending);
+static bool telemetry_log_read_header(const telemetry_log_t *log, uint16_t sector, uint16_t offset, telemetry_log_record_header_t *header, uint16_t *size);
+static bool telemetry_log_start_sector(telemetry_log_t *log);
+static void telemetry_log_set_state(telemetry_log_t *log, uint16_t sector, uint16_t offset, uint8_t state);
+static uint32_t telemetry_log_crc(uint32_t crc, const uint8_t *data, size_t length);
+static uint32_t telemetry_log_record_crc(const telemetry_log_record_header_t *header);
+
+telemetry_log_t *telemetry_log_open()
+{
+    telemetry_log_t *log = (telemetry_log_t *)malloc(sizeof(telemetry_log_t));
+
+    CMP_CHECK(TAG_TELEMETRY_LOG, (log != NULL), "failure allocating log", NULL)
+
+    memset(log, 0, sizeof(telemetry_log_t));
+
+    if (!telemetry_log_storage_open(log))
+    {
+        free(log);
+        return NULL;
+    }
+
+    log->sequences = (uint32_t *)malloc(log->sector_count * sizeof(uint32_t));
+    log->pending = (uint16_t *)malloc(log->sector_count * sizeof(uint16_t));
+
+    if (log->sequences == NULL || log->pending == NULL)
+    {
+        CMP_LOGE(TAG_TELEMETRY_LOG, "failure allocating sectors");
+
+        telemetry_log_close(log);
+        return NULL;
+    }
+
+    uint32_t last_sequence = 0;
+    bool has_sector = false;
+
+    // The sector written last holds the highest sequence:
+    // records are appended to it, and the one after it is the oldest.
+    for (uint16_t sector = 0; sector < log->sector_count; sector++)
+    {
+        telemetry_log_sector_header_t header;
+        uint16_t end = 0;
+
+        log->sequences[sector] = TELEMETRY_LOG_SEQUENCE_NONE;
+        log->pending[sector] = 0;
+
+        if (!telemetry_log_storage_read(log, sector, 0, &header, sizeof(header)) ||
+            header.magic != TELEMETRY_LOG_SECTOR_MAGIC ||
+            header.sequence == TELEMETRY_LOG_SEQUENCE_NONE)
+        {
+            continue;
+        }
+
+        log->sequences[sector] = header.sequence;
+
+        telemetry_log_scan_sector(log, sector, &end, &log->pending[sector]);
+
+        log->statistics.pending += log->pending[sector];
+
+        if (!has_sector || header.sequence > last_sequence)
+        {
+            has_sector = true;
+            last_sequence = header.sequence;
+            log->write_sector = sector;
+            log->write_offset = end;
+        }
+    }
+
+    if (!has_sector)
+    {
+        log->write_sector = log->sector_count - 1;
+
+        if (!telemetry_log_start_sector(log))
+        {
+            telemetry_log_close(log);
+            return NULL;
+        }
+    }
+
+    if (log->statistics.pending > 0)
+    {
+        CMP_LOGI(TAG_TELEMETRY_LOG, "recovered messages: %lu", (unsigned long)log->statistics.pending);
+    }
+
+    return log;
+}
+
+size_t telemetry_log_get_record_max_length()
+{
+    return TELEMETRY_LOG_SECTOR_SIZE - sizeof(telemetry_log_sector_header_t) - sizeof(telemetry_log_record_header_t);
+}
+
+bool telemetry_log_append(telemetry_log_t *log,
+                          uint8_t qos,
+                          uint32_t expires_at,
+                          const uint8_t *properties,
+                          uint16_t properties_length,
+                          const uint8_t *payload,
+                          uint16_t payload_length)
+{
+    size_t length = (size_t)properties_length + payload_length;
+    uint32_t size = TELEMETRY_LOG_ALIGN(sizeof(telemetry_log_record_header_t) + length);
+
+    CMP_CHECK(TAG_TELEMETRY_LOG, (length <= telemetry_log_get_record_max_length()), "message too long", false)
+
+    if (log->write_offset + size > TELEMETRY_LOG_SECTOR_SIZE && !telemetry_log_start_sector(log))
+    {
+        return false;
+    }
+
+    telemetry_log_record_header_t header = {
+        .state = TELEMETRY_LOG_STATE_WRITING,
+        .qos = qos,
+        .properties_length = properties_length,
+        .payload_length = payload_length,
+        .reserved = TELEMETRY_LOG_LENGTH_NONE,
+        .expires_at = expires_at,
+        .crc = 0};
+
+    header.crc = telemetry_log_crc(telemetry_log_crc(telemetry_log_record_crc(&header),
+                                                     properties,
+                                                     properties_length),
+                                   payload,
+                                   payload_length);
+
+    uint16_t offset = log->write_offset;
+
+    // Taken even if the writes fail: a partial record is skipped when reading.
+    log->write_offset += size;
+
+    if (!telemetry_log_storage_write(log, log->write_sector, offset, &header, sizeof(header)) ||
+        !telemetry_log_storage_write(log, log->write_sector, offset + sizeof(header), properties, properties_length) ||
+        !telemetry_log_storage_write(log, log->write_sector, offset + sizeof(header) + properties_length, payload, payload_length))
+    {
+        CMP_LOGE(TAG_TELEMETRY_LOG, "failure writing message");
+        return false;
+    }
+
+    // Committed last: a record cut by a power loss is never read.
+    telemetry_log_set_state(log, log->write_sector, offset, TELEMETRY_LOG_STATE_COMMITTED);
+
+    log->pending[log->write_sector]++;
+    log->statistics.pending++;
+
+    return true;
+}
+
+void telemetry_log_rewind(telemetry_log_t *log, telemetry_log_cursor_t *cursor)
+{
+    // Oldest sector with pending records; the write position if none.
+    for (uint16_t i = 1; i <= log->sector_count; i++)
+    {
+        uint16_t sector = (log->write_sector + i) % log->sector_count;
+
+        if (log->pending[sector] > 0)
+        {
+            cursor->sequence = log->sequences[sector];
+            cursor->sector = sector;
+            cursor->offset = sizeof(telemetry_log_sector_header_t);
+            return;
+        }
+    }
+
+    cursor->sequence = log->sequences[log->write_sector];
+    cursor->sector = log->write_sector;
+    cursor->offset = log->write_offset;
+}
+
+bool telemetry_log_read(telemetry_log_t *log,
+                        telemetry_log_cursor_t *cursor,
+                        telemetry_log_record_t *record,
+                        uint8_t *data)
+{
+    telemetry_log_record_header_t header;
+    uint16_t size = 0;
+
+    if (log->sequences[cursor->sector] != cursor->sequence)
+    {
+        telemetry_log_rewind(log, cursor);
+    }
+
+    while (true)
+    {
+        bool is_write_sector = cursor->sector == log->write_sector;
+
+        if (is_write_sector && cursor->offset >= log->write_offset)
+        {
+            return false;
+        }
+
+        if (!telemetry_log_read_header(log, cursor->sector, cursor->offset, &header, &size))
+        {
+            if (is_write_sector)
+            {
+                return false;
+            }
+
+            // Sector end: on to the next written one.
+            do
+            {
+                cursor->sector = (cursor->sector + 1) % log->sector_count;
+            } while (log->sequences[cursor->sector] == TELEMETRY_LOG_SEQUENCE_NONE);
+
+            cursor->sequence = log->sequences[cursor->sector];
+            cursor->offset = sizeof(telemetry_log_sector_header_t);
+            continue;
+        }
+
+        record->position = *cursor;
+        cursor->offset += size;
+
+        if (header.state != TELEMETRY_LOG_STATE_COMMITTED)
+        {
+            continue;
+        }
+
+        uint16_t length = header.properties_length + header.payload_length;
+
+        if (!telemetry_log_storage_read(log, record->position.sector, record->position.offset + sizeof(header), data, length) ||
+            telemetry_log_crc(telemetry_log_record_crc(&header), data, length) != header.crc)
+        {
+            CMP_LOGW(TAG_TELEMETRY_LOG, "dropping corrupted message");
+
+            log->statistics.dropped++;
+
+            telemetry_log_consume(log, record);
+            continue;
+        }
+
+        record->qos = header.qos;
+        record->expires_at = header.expires_at;
+        record->properties_length = header.properties_length;
+        record->payload_length = header.payload_length;
+
+        return true;
+    }
+}
+
+void telemetry_log_consume(telemetry_log_t *log, const telemetry_log_record_t *record)
+{
+    const telemetry_log_cursor_t *position = &record->position;
+
+    if (log->sequences[position->sector] != position->sequence || log->pending[position->sector] == 0)
+    {
+        return;
+    }
+
+    telemetry_log_set_state(log, position->sector, position->offset, TELEMETRY_LOG_STATE_CONSUMED);
+
+    log->pending[position->sector]--;
+    log->statistics.pending--;
+}
+
+void telemetry_log_get_statistics(const telemetry_log_t *log, telemetry_log_statistics_t *statistics)
+{
+    *statistics = log->statistics;
+}
+
+void telemetry_log_close(telemetry_log_t *log)
+{
+    if (log == NULL)
+    {
+        return;
+    }
+
+    free(log->sequences);
+    free(log->pending);
+    free(log);
+}
+
+//
+// PRIVATE
+//
+
+#if CONFIG_IDF_TARGET_LINUX
+static bool telemetry_log_storage_open(telemetry_log_t *log)
+{
+    if (!HOST_PARTITION_ERASED)
+    {
+        memset(HOST_PARTITION, 0xFF, sizeof(HOST_PARTITION));
+        HOST_PARTITION_ERASED = true;
+    }
+
+    log->sector_count = TELEMETRY_LOG_HOST_SECTOR_COUNT;
+
+    return true;
+}
+
+static bool telemetry_log_storage_read(const telemetry_log_t *log, uint16_t sector, uint16_t offset, void *data, size_t length)
+{
+    memcpy(data, &HOST_PARTITION[sector * TELEMETRY_LOG_SECTOR_SIZE + offset], length);
+
+    return true;
+}
+
+static bool telemetry_log_storage_write(const telemetry_log_t *log, uint16_t sector, uint16_t offset, const void *data, size_t length)
+{
+    uint8_t *destination = &HOST_PARTITION[sector * TELEMETRY_LOG_SECTOR_SIZE + offset];
+
+    // Like NOR flash: writes only clear bits.
+    for (size_t i = 0; i < length; i++)
+    {
+        destination[i] &= ((const uint8_t *)data)[i];
+    }
+
+    return true;
+}
+
+static bool telemetry_log_storage_erase(const telemetry_log_t *log, uint16_t sector)
+{
+    memset(&HOST_PARTITION[sector * TELEMETRY_LOG_SECTOR_SIZE], 0xFF, TELEMETRY_LOG_SECTOR_SIZE);
+
+    return true;
+}
+#else
+static bool telemetry_log_storage_open(telemetry_log_t *log)
+{
+    log->partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                              ESP_PARTITION_SUBTYPE_ANY,
+                                              CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_PARTITION_LABEL);
+
+    CMP_CHECK(TAG_TELEMETRY_LOG, (log->partition != NULL), "partition not found", false)
+
+    // Encrypted flash is written in 16 bytes blocks:
+    // records could not be committed and consumed in place.
+    CMP_CHECK(TAG_TELEMETRY_LOG, (!log->partition->encrypted), "encrypted partition not supported", false)
+
+    uint32_t sector_count = log->partition->size / TELEMETRY_LOG_SECTOR_SIZE;
+
+    CMP_CHECK(TAG_TELEMETRY_LOG, (sector_count >= 2 && sector_count <= UINT16_MAX), "partition must have from 2 to 65535 sectors", false)
+
+    log->sector_count = (uint16_t)sector_count;
+
+    return true;
+}
+
+static bool telemetry_log_storage_read(const telemetry_log_t *log, uint16_t sector, uint16_t offset, void *data, size_t length)
+{
+    return esp_partition_read(log->partition, (size_t)sector * TELEMETRY_LOG_SECTOR_SIZE + offset, data, length) == ESP_OK;
+}
+
+static bool telemetry_log_storage_write(const telemetry_log_t *log, uint16_t sector, uint16_t offset, const void *data, size_t length)
+{
+    if (length == 0)
+    {
+        return true;
+    }
+
+    return esp_partition_write(log->partition, (size_t)sector * TELEMETRY_LOG_SECTOR_SIZE + offset, data, length) == ESP_OK;
+}
+
+static bool telemetry_log_storage_erase(const telemetry_log_t *log, uint16_t sector)
+{
+    return esp_partition_erase_range(log->partition, (size_t)sector * TELEMETRY_LOG_SECTOR_SIZE, TELEMETRY_LOG_SECTOR_SIZE) == ESP_OK;
+}
+#endif
+
+static void telemetry_log_scan_sector(telemetry_log_t *log, uint16_t sector, uint16_t *end, uint16_t *pending)
+{
+    telemetry_log_record_header_t header;
+    uint16_t offset = sizeof(telemetry_log_sector_header_t);
+    uint16_t size = 0;
+
+    *pending = 0;
+
+    // Checksums are checked when reading: a record is read once, scanned on every boot.
+    while (telemetry_log_read_header(log, sector, offset, &header, &size))
+    {
+        if (header.state == TELEMETRY_LOG_STATE_COMMITTED)
+        {
+            (*pending)++;
+        }
+
+        offset += size;
+    }
+
+    // The space after an unreadable header is not written again.
+    *end = header.properties_length == TELEMETRY_LOG_LENGTH_NONE ? offset : TELEMETRY_LOG_SECTOR_SIZE;
+}
+
+static bool telemetry_log_read_header(const telemetry_log_t *log, uint16_t sector, uint16_t offset, telemetry_log_record_header_t *header, uint16_t *size)
+{
+    header->properties_length = TELEMETRY_LOG_LENGTH_NONE;
+
+    if (offset + sizeof(telemetry_log_record_header_t) > TELEMETRY_LOG_SECTOR_SIZE ||
+        !telemetry_log_storage_read(log, sector, offset, header, sizeof(telemetry_log_record_header_t)))
+    {
+        return false;
+    }
+
+    if (header->properties_length == TELEMETRY_LOG_LENGTH_NONE && header->payload_length == TELEMETRY_LOG_LENGTH_NONE)
+    {
+        return false;
+    }
+
+    uint32_t record_size = TELEMETRY_LOG_ALIGN(sizeof(telemetry_log_record_header_t) + header->properties_length + header->payload_length);
+
+    if (offset + record_size > TELEMETRY_LOG_SECTOR_SIZE)
+    {
+        // Garbage, from a write cut by a power loss.
+        header->properties_length = 0;
+        return false;
+    }
+
+    *size = (uint16_t)record_size;
+
+    return true;
+}
+
+static bool telemetry_log_start_sector(telemetry_log_t *log)
+{
+    uint16_t sector = (log->write_sector + 1) % log->sector_count;
+    uint32_t sequence = log->sequences[log->write_sector] == TELEMETRY_LOG_SEQUENCE_NONE
+                            ? 0
+                            : log->sequences[log->write_sector] + 1;
+
+    if (log->pending[sector] > 0)
+    {
+        CMP_LOGW(TAG_TELEMETRY_LOG, "log full, dropping messages: %u", log->pending[sector]);
+
+        log->statistics.dropped += log->pending[sector];
+        log->statistics.pending -= log->pending[sector];
+    }
+
+    log->pending[sector] = 0;
+    log->sequences[sector] = TELEMETRY_LOG_SEQUENCE_NONE;
+
+    telemetry_log_sector_header_t header = {
+        .magic = TELEMETRY_LOG_SECTOR_MAGIC,
+        .sequence = sequence};
+
+    CMP_CHECK(TAG_TELEMETRY_LOG, telemetry_log_storage_erase(log, sector), "failure erasing sector", false)
+    CMP_CHECK(TAG_TELEMETRY_LOG, telemetry_log_storage_write(log, sector, 0, &header, sizeof(header)), "failure writing sector", false)
+
+    log->sequences[sector] = sequence;
+    log->write_sector = sector;
+    log->write_offset = sizeof(telemetry_log_sector_header_t);
+
+    return true;
+}
+
+static void telemetry_log_set_state(telemetry_log_t *log, uint16_t sector, uint16_t offset, uint8_t state)
+{
+    if (!telemetry_log_storage_write(log, sector, offset, &state, sizeof(state)))
+    {
+        CMP_LOGE(TAG_TELEMETRY_LOG, "failure writing message state");
+    }
+}
+
+static uint32_t telemetry_log_crc(uint32_t crc, const uint8_t *data, size_t length)
+{
+    crc = ~crc;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= data[i];
+
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+        }
+    }
+
+    return ~crc;
+}
+
+static uint32_t telemetry_log_record_crc(const telemetry_log_record_header_t *header)
+{
+    // Not the state: it changes after the record is written.
+    return telemetry_log_crc(0,
+                             &header->qos,
+                             offsetof(telemetry_log_record_header_t, crc) - offsetof(telemetry_log_record_header_t, qos));
+}
@@ -0,0 +1,203 @@
+#include <string.h>
+#include "infrastructure/tls_session_cache.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "assertion.h"
+#include "config.h"
+#include "log.h"
+
+#define TLS_SESSION_CACHE_HOSTNAME_SIZE 128U
+
+static const char TAG_TLS_SESSION_CACHE[] = "AZ_TLS_SESSION";
+
+/**
+ * @brief Session of a server.
+ */
+typedef struct
+{
+    const transport_driver_t *driver;               /** @brief Driver that created, and frees, the session. */
+    char hostname[TLS_SESSION_CACHE_HOSTNAME_SIZE]; /** @brief Server address. */
+    uint16_t port;                                  /** @brief Server port. */
+    void *session;                                  /** @brief Driver session; `NULL` if the entry is free. */
+    uint32_t used_at;                               /** @brief When the entry was last used, in cache uses. */
+} tls_session_entry_t;
+
+typedef struct
+{
+    SemaphoreHandle_t lock;
+    tls_session_entry_t entries[CONFIG_ESP32_IOT_AZURE_TRANSPORT_TLS_SESSION_CACHE_SIZE];
+    uint32_t uses;
+    tls_session_statistics_t statistics;
+} tls_session_cache_t;
+
+static tls_session_cache_t CACHE = {0};
+
+static tls_session_entry_t *tls_session_cache_find(const transport_driver_t *driver, const char *hostname, uint16_t port);
+static void tls_session_entry_free(tls_session_entry_t *entry);
+
+bool tls_session_cache_init()
+{
+    if (CACHE.lock == NULL)
+    {
+        CACHE.lock = xSemaphoreCreateMutex();
+    }
+
+    CMP_CHECK(TAG_TLS_SESSION_CACHE, (CACHE.lock != NULL), "failure creating lock", false)
+
+    memset(&CACHE.statistics, 0, sizeof(tls_session_statistics_t));
+
+    return true;
+}
+
+void tls_session_cache_deinit()
+{
+    if (CACHE.lock == NULL)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < CONFIG_ESP32_IOT_AZURE_TRANSPORT_TLS_SESSION_CACHE_SIZE; i++)
+    {
+        tls_session_entry_free(&CACHE.entries[i]);
+    }
+
+    vSemaphoreDelete(CACHE.lock);
+
+    memset(&CACHE, 0, sizeof(tls_session_cache_t));
+}
+
+void *tls_session_cache_take(const transport_driver_t *driver, const char *hostname, uint16_t port)
+{
+    void *session = NULL;
+
+    if (CACHE.lock == NULL)
+    {
+        return NULL;
+    }
+
+    xSemaphoreTake(CACHE.lock, portMAX_DELAY);
+
+    tls_session_entry_t *entry = tls_session_cache_find(driver, hostname, port);
+
+    if (entry != NULL)
+    {
+        session = entry->session;
+        entry->session = NULL;
+    }
+
+    xSemaphoreGive(CACHE.lock);
+
+    return session;
+}
+
+void tls_session_cache_put(const transport_driver_t *driver, const char *hostname, uint16_t port, void *session)
+{
+    if (session == NULL)
+    {
+        return;
+    }
+
+    if (CACHE.lock == NULL || strlen(hostname) >= TLS_SESSION_CACHE_HOSTNAME_SIZE)
+    {
+        driver->session_free(session);
+        return;
+    }
+
+    xSemaphoreTake(CACHE.lock, portMAX_DELAY);
+
+    tls_session_entry_t *entry = tls_session_cache_find(driver, hostname, port);
+
+    if (entry == NULL)
+    {
+        entry = &CACHE.entries[0];
+
+        // A free entry, or the least recently used one.
+        for (size_t i = 0; i < CONFIG_ESP32_IOT_AZURE_TRANSPORT_TLS_SESSION_CACHE_SIZE && entry->session != NULL; i++)
+        {
+            if (CACHE.entries[i].session == NULL || CACHE.entries[i].used_at < entry->used_at)
+            {
+                entry = &CACHE.entries[i];
+            }
+        }
+
+        if (entry->session != NULL)
+        {
+            CMP_LOGD(TAG_TLS_SESSION_CACHE, "evicting session of: %s", entry->hostname);
+
+            CACHE.statistics.evictions++;
+
+            tls_session_entry_free(entry);
+        }
+
+        entry->driver = driver;
+        entry->port = port;
+
+        strcpy(entry->hostname, hostname);
+    }
+    else
+    {
+        tls_session_entry_free(entry);
+    }
+
+    entry->session = session;
+    entry->used_at = ++CACHE.uses;
+
+    xSemaphoreGive(CACHE.lock);
+}
+
+void tls_session_cache_count_handshake(bool resumed)
+{
+    if (CACHE.lock == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(CACHE.lock, portMAX_DELAY);
+
+    if (resumed)
+    {
+        CACHE.statistics.resumed_handshakes++;
+    }
+    else
+    {
+        CACHE.statistics.full_handshakes++;
+    }
+
+    xSemaphoreGive(CACHE.lock);
+}
+
+void tls_session_cache_get_statistics(tls_session_statistics_t *statistics)
+{
+    *statistics = CACHE.statistics;
+}
+
+//
+// PRIVATE
+//
+
+static tls_session_entry_t *tls_session_cache_find(const transport_driver_t *driver, const char *hostname, uint16_t port)
+{
+    for (size_t i = 0; i < CONFIG_ESP32_IOT_AZURE_TRANSPORT_TLS_SESSION_CACHE_SIZE; i++)
+    {
+        tls_session_entry_t *entry = &CACHE.entries[i];
+
+        // Entries keep their server once taken: the session comes back after the connection.
+        if (entry->driver == driver && entry->port == port && strcmp(entry->hostname, hostname) == 0)
+        {
+            entry->used_at = ++CACHE.uses;
+
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static void tls_session_entry_free(tls_session_entry_t *entry)
+{
+    if (entry->session != NULL)
+    {
+        entry->driver->session_free(entry->session);
+        entry->session = NULL;
+    }
+}
@@ -1,100 +1,99 @@
+#include <errno.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include "infrastructure/transport.h"
-#include "infrastructure/backoff_algorithm.h"
 #include "infrastructure/azure_iot_certificate.h"
+#include "infrastructure/tls_session_cache.h"
+#include "infrastructure/reconnect_policy.h"
+#include "infrastructure/metrics.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "esp_transport.h"
-#include "esp_transport_tcp.h"
-#include "esp_transport_ssl.h"
+#include "assertion.h"
 #include "log.h"
 #include "config.h"
 
 static const char TAG_TRANSPORT[] = "AZ_TRANSPORT";
 
+static transport_t *transport_create(const tls_certificate_t *certificate);
 static transport_status_t transport_reconnect(transport_t *transport);
+static transport_status_t transport_driver_connect(transport_t *transport);
 static bool should_try_reconnection(int error_num);
 
+static const transport_driver_t *TRANSPORT_DRIVER = NULL;
+
 struct transport_t
 {
-    esp_transport_handle_t handle; /** @brief ESP transport handle. */
-    const char *hostname;          /** @brief Server address. Must be null-terminated. */
-    uint16_t port;                 /** @brief Server port. */
-    uint16_t timeout_ms;           /** @brief Connection timeout in milliseconds. */
+    const transport_driver_t *driver; /** @brief Driver backing the transport. */
+    void *handle;                     /** @brief Driver handle. */
+    const char *hostname;             /** @brief Server address. Must be null-terminated. */
+    uint16_t port;                    /** @brief Server port. */
+    uint16_t timeout_ms;              /** @brief Connection timeout in milliseconds. */
+    bool tls;                         /** @brief Whether the transport is a TLS one. */
+    bool session_reuse;               /** @brief Whether TLS sessions are cached and resumed. */
+    bool trust_store;                 /** @brief Whether the Azure IoT trust store was taken. */
+    TickType_t written_at;            /** @brief When bytes were last written. */
 };
 
-transport_t *transport_create_tcp()
+void transport_set_driver(const transport_driver_t *driver)
 {
-    transport_t *transport = (transport_t *)malloc(sizeof(transport_t));
-    transport->handle = esp_transport_tcp_init();
+    TRANSPORT_DRIVER = driver;
+}
 
-    return transport;
+transport_t *transport_create_tcp()
+{
+    return transport_create(NULL);
 }
 
 transport_t *transport_create_tls(const tls_certificate_t *certificate)
 {
-    transport_t *transport = (transport_t *)malloc(sizeof(transport_t));
-    transport->handle = esp_transport_ssl_init();
+    return transport_create(certificate);
+}
 
-    switch (certificate->format)
-    {
-    case TLS_CERT_FORMAT_PEM:
-        esp_transport_ssl_set_cert_data(transport->handle,
-                                        (const char *)certificate->data,
-                                        certificate->length);
-        break;
+transport_t *transport_create_azure()
+{
+    const tls_certificate_t *certificate = azure_iot_certificate_take();
 
-    case TLS_CERT_FORMAT_DER:
-        esp_transport_ssl_set_cert_data_der(transport->handle,
-                                            (const char *)certificate->data,
-                                            certificate->length);
-        break;
+    CMP_CHECK(TAG_TRANSPORT, (certificate != NULL), "failure taking the Azure IoT trust store", NULL)
 
-    default:
-        CMP_LOGE(TAG_TRANSPORT, "invalid certificate format: %d", certificate->format);
-        break;
+    transport_t *transport = transport_create(certificate);
+
+    if (transport == NULL)
+    {
+        azure_iot_certificate_release();
+        return NULL;
     }
 
-    return transport;
-}
+    transport->trust_store = true;
 
-transport_t *transport_create_azure()
-{
-    return transport_create_tls(azure_iot_certificate_get());
+    return transport;
 }
 
 transport_status_t transport_set_client_certificate(transport_t *transport,
                                                     const client_certificate_t *certificate)
 {
-    transport_status_t result = TRANSPORT_STATUS_SUCCESS;
-
-    switch (certificate->format)
+    if (transport->driver->set_client_certificate == NULL)
     {
-    case CLIENT_CERT_FORMAT_PEM:
-        esp_transport_ssl_set_client_cert_data(transport->handle,
-                                               (const char *)certificate->data,
-                                               certificate->data_length);
-        esp_transport_ssl_set_client_key_data(transport->handle,
-                                              (const char *)certificate->private_key,
-                                              certificate->private_key_length);
-        break;
+        CMP_LOGE(TAG_TRANSPORT, "client certificate not supported by the driver");
+        return TRANSPORT_STATUS_FAILURE;
+    }
 
-    case CLIENT_CERT_FORMAT_DER:
-        esp_transport_ssl_set_client_cert_data_der(transport->handle,
-                                                   (const char *)certificate->data,
-                                                   certificate->data_length);
-        esp_transport_ssl_set_client_key_data_der(transport->handle,
-                                                  (const char *)certificate->private_key,
-                                                  certificate->private_key_length);
-        break;
+    return transport->driver->set_client_certificate(transport->handle, certificate);
+}
 
-    default:
-        result = TRANSPORT_STATUS_FAILURE;
-        CMP_LOGE(TAG_TRANSPORT, "invalid certificate format: %d", certificate->format);
-        break;
+transport_status_t transport_enable_session_reuse(transport_t *transport)
+{
+    CMP_CHECK(TAG_TRANSPORT, (transport->tls), "session reuse needs a TLS transport", TRANSPORT_STATUS_FAILURE)
+
+    if (transport->driver->session_get == NULL || transport->driver->session_set == NULL || transport->driver->session_free == NULL)
+    {
+        CMP_LOGW(TAG_TRANSPORT, "session reuse not supported by the driver");
+        return TRANSPORT_STATUS_FAILURE;
     }
 
-    return result;
+    transport->session_reuse = true;
+
+    return TRANSPORT_STATUS_SUCCESS;
 }
 
 transport_status_t transport_connect(transport_t *transport,
@@ -114,23 +113,33 @@ int32_t transport_write(transport_t *transport,
                         size_t length,
                         uint16_t timeout_ms)
 {
-    int result = esp_transport_write(transport->handle, (const char *)buffer, length, timeout_ms);
+    uint64_t started_at_us = metrics_get_time_us();
+    int32_t result = transport->driver->write(transport->handle, buffer, length, timeout_ms);
 
     if (result > -1)
     {
+        if (result > 0)
+        {
+            transport->written_at = xTaskGetTickCount();
+
+            metrics_record(AZURE_IOT_METRIC_TRANSPORT_WRITE, started_at_us, false);
+        }
+
         return result;
     }
 
-    if (should_try_reconnection(esp_transport_get_errno(transport->handle)))
+    metrics_record(AZURE_IOT_METRIC_TRANSPORT_WRITE, started_at_us, true);
+
+    if (should_try_reconnection(transport->driver->get_errno(transport->handle)))
     {
         transport_reconnect(transport);
 
-        result = esp_transport_write(transport->handle, (const char *)buffer, length, timeout_ms);
+        result = transport->driver->write(transport->handle, buffer, length, timeout_ms);
     }
 
     if (result < 0)
     {
-        CMP_LOGE(TAG_TRANSPORT, "failure writing: %d", esp_transport_get_errno(transport->handle));
+        CMP_LOGE(TAG_TRANSPORT, "failure writing: %d", transport->driver->get_errno(transport->handle));
     }
 
     return result;
@@ -141,84 +150,224 @@ int32_t transport_read(transport_t *transport,
                        size_t expected_length,
                        uint16_t timeout_ms)
 {
-    int result = esp_transport_read(transport->handle, (char *)buffer, expected_length, timeout_ms);
+    uint64_t started_at_us = metrics_get_time_us();
+    int32_t result = transport->driver->read(transport->handle, buffer, expected_length, timeout_ms);
 
     if (result > -1)
     {
+        // A timeout measures the read timeout, not the network.
+        if (result > 0)
+        {
+            metrics_record(AZURE_IOT_METRIC_TRANSPORT_READ, started_at_us, false);
+        }
+
         return result;
     }
 
-    if (should_try_reconnection(esp_transport_get_errno(transport->handle)))
+    metrics_record(AZURE_IOT_METRIC_TRANSPORT_READ, started_at_us, true);
+
+    if (should_try_reconnection(transport->driver->get_errno(transport->handle)))
     {
         transport_reconnect(transport);
 
-        result = esp_transport_read(transport->handle, (char *)buffer, expected_length, timeout_ms);
+        result = transport->driver->read(transport->handle, buffer, expected_length, timeout_ms);
     }
 
     if (result < 0)
     {
-        CMP_LOGE(TAG_TRANSPORT, "failure reading: %d", esp_transport_get_errno(transport->handle));
+        CMP_LOGE(TAG_TRANSPORT, "failure reading: %d", transport->driver->get_errno(transport->handle));
     }
 
     return result;
 }
 
+transport_wait_result_t transport_wait(transport_t *transport, uint32_t timeout_ms)
+{
+    if (transport->driver->wait == NULL)
+    {
+        return TRANSPORT_WAIT_UNSUPPORTED;
+    }
+
+    transport_wait_result_t result = transport->driver->wait(transport->handle, timeout_ms);
+
+    if (result == TRANSPORT_WAIT_FAILURE)
+    {
+        CMP_LOGE(TAG_TRANSPORT, "failure waiting: %d", transport->driver->get_errno(transport->handle));
+    }
+
+    return result;
+}
+
+void transport_wake(transport_t *transport)
+{
+    if (transport->driver->wake != NULL)
+    {
+        transport->driver->wake(transport->handle);
+    }
+}
+
+uint32_t transport_get_idle_ms(const transport_t *transport)
+{
+    return pdTICKS_TO_MS(xTaskGetTickCount() - transport->written_at);
+}
+
 void transport_disconnect(transport_t *transport)
 {
-    if (esp_transport_close(transport->handle) < 0)
+    if (transport->driver->close(transport->handle) != TRANSPORT_STATUS_SUCCESS)
     {
-        CMP_LOGE(TAG_TRANSPORT, "failure disconnecting: %d", esp_transport_get_errno(transport->handle));
+        CMP_LOGE(TAG_TRANSPORT, "failure disconnecting: %d", transport->driver->get_errno(transport->handle));
     }
 }
 
 void transport_free(transport_t *transport)
 {
-    esp_transport_destroy(transport->handle);
+    transport->driver->destroy(transport->handle);
+
+    if (transport->trust_store)
+    {
+        azure_iot_certificate_release();
+    }
 
     free(transport);
 }
 
+static transport_t *transport_create(const tls_certificate_t *certificate)
+{
+    const transport_driver_t *driver = TRANSPORT_DRIVER != NULL ? TRANSPORT_DRIVER : transport_driver_get_default();
+    void *handle = driver->create(certificate, driver->context);
+
+    CMP_CHECK(TAG_TRANSPORT, (handle != NULL), "failure creating driver handle", NULL)
+
+    transport_t *transport = (transport_t *)malloc(sizeof(transport_t));
+
+    if (transport == NULL)
+    {
+        CMP_LOGE(TAG_TRANSPORT, "failure allocating transport");
+        driver->destroy(handle);
+        return NULL;
+    }
+
+    memset(transport, 0, sizeof(transport_t));
+
+    transport->driver = driver;
+    transport->handle = handle;
+    transport->tls = certificate != NULL;
+
+    return transport;
+}
+
 static transport_status_t transport_reconnect(transport_t *transport)
 {
-    uint16_t next_backoff_ms = 0U;
+    uint32_t wait_ms = 0U;
     transport_status_t transport_status = TRANSPORT_STATUS_FAILURE;
-    backoff_algorithm_status_t backoff_status = BACKOFF_ALGORITHM_SUCCESS;
-    backoff_algorithm_context_t backoff_context;
 
     transport_disconnect(transport);
 
-    backoff_algorithm_initialize(&backoff_context,
-                                 CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_BASE_MS,
-                                 CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_MAX_DELAY_MS,
-                                 CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_RETRY_MAX_ATTEMPTS);
-    do
+    for (uint32_t attempt = 0; attempt < CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_RETRY_MAX_ATTEMPTS; attempt++)
     {
-        CMP_LOGI(TAG_TRANSPORT, "connecting to '%s' on %d", transport->hostname, transport->port);
-
-        if (esp_transport_connect(transport->handle, transport->hostname, transport->port, transport->timeout_ms) != 0)
+        // Not the server failing: its circuit is left as is.
+        if (transport->driver->is_network_up != NULL && !transport->driver->is_network_up(transport->driver->context))
         {
-            CMP_LOGW(TAG_TRANSPORT, "failure connecting: %d", esp_transport_get_errno(transport->handle));
+            CMP_LOGW(TAG_TRANSPORT, "network down, not connecting to '%s'", transport->hostname);
+
+            reconnect_policy_count_network_down();
 
-            backoff_status = backoff_algorithm_get_next(&backoff_context, &next_backoff_ms);
+            vTaskDelay(pdMS_TO_TICKS(CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_MAX_DELAY_MS));
+            break;
+        }
 
-            if (backoff_status == BACKOFF_ALGORITHM_SUCCESS)
-            {
-                CMP_LOGW(TAG_TRANSPORT, "will retry in %d ms", next_backoff_ms);
+        // Fails fast, but still waits: callers retrying right away do not spin.
+        if (reconnect_policy_acquire(transport->hostname, transport->port, &wait_ms) == RECONNECT_POLICY_WAIT)
+        {
+            CMP_LOGW(TAG_TRANSPORT, "circuit of '%s' open for %lu ms", transport->hostname, (unsigned long)wait_ms);
 
-                vTaskDelay(pdMS_TO_TICKS(next_backoff_ms));
-            }
+            vTaskDelay(pdMS_TO_TICKS(wait_ms < CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_MAX_DELAY_MS ? wait_ms : CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_MAX_DELAY_MS));
+            break;
         }
-        else
+
+        CMP_LOGI(TAG_TRANSPORT, "connecting to '%s' on %d", transport->hostname, transport->port);
+
+        if (transport_driver_connect(transport) == TRANSPORT_STATUS_SUCCESS)
         {
             CMP_LOGI(TAG_TRANSPORT, "connected");
 
+            reconnect_policy_succeeded(transport->hostname, transport->port);
+
+            transport->written_at = xTaskGetTickCount();
             transport_status = TRANSPORT_STATUS_SUCCESS;
+            break;
         }
-    } while (transport_status != TRANSPORT_STATUS_SUCCESS && backoff_status == BACKOFF_ALGORITHM_SUCCESS);
+
+        CMP_LOGW(TAG_TRANSPORT, "failure connecting: %d", transport->driver->get_errno(transport->handle));
+
+        wait_ms = reconnect_policy_failed(transport->hostname, transport->port);
+
+        if (attempt + 1U < CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_RETRY_MAX_ATTEMPTS)
+        {
+            CMP_LOGW(TAG_TRANSPORT, "will retry in %lu ms", (unsigned long)wait_ms);
+
+            vTaskDelay(pdMS_TO_TICKS(wait_ms));
+        }
+    }
 
     return transport_status;
 }
 
+static transport_status_t transport_driver_connect(transport_t *transport)
+{
+    const transport_driver_t *driver = transport->driver;
+    void *session = transport->session_reuse
+                        ? tls_session_cache_take(driver, transport->hostname, transport->port)
+                        : NULL;
+
+    if (session != NULL)
+    {
+        driver->session_set(transport->handle, session);
+    }
+
+    uint64_t started_at_us = metrics_get_time_us();
+    transport_status_t status = driver->connect(transport->handle, transport->hostname, transport->port, transport->timeout_ms);
+
+    metrics_record(transport->tls ? AZURE_IOT_METRIC_TLS_CONNECT : AZURE_IOT_METRIC_TCP_CONNECT,
+                   started_at_us,
+                   status != TRANSPORT_STATUS_SUCCESS);
+
+    if (status == TRANSPORT_STATUS_SUCCESS && transport->tls)
+    {
+        // Drivers that cannot tell leave the handshakes offering a session uncounted.
+        if (session == NULL)
+        {
+            tls_session_cache_count_handshake(false);
+        }
+        else if (driver->session_resumed != NULL)
+        {
+            tls_session_cache_count_handshake(driver->session_resumed(transport->handle));
+        }
+    }
+
+    if (session != NULL)
+    {
+        driver->session_set(transport->handle, NULL);
+
+        // Still good when the connection failed: kept for the next attempt.
+        if (status == TRANSPORT_STATUS_SUCCESS)
+        {
+            driver->session_free(session);
+        }
+        else
+        {
+            tls_session_cache_put(driver, transport->hostname, transport->port, session);
+        }
+    }
+
+    if (status == TRANSPORT_STATUS_SUCCESS && transport->session_reuse)
+    {
+        tls_session_cache_put(driver, transport->hostname, transport->port, driver->session_get(transport->handle));
+    }
+
+    return status;
+}
+
 static bool should_try_reconnection(int error_num)
 {
     switch (error_num)
@@ -0,0 +1,582 @@
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/poll.h>
+#include "infrastructure/transport.h"
+#include "esp_tls.h"
+#include "esp_transport.h"
+#include "esp_transport_tcp.h"
+#include "esp_vfs_eventfd.h"
+#include "esp_netif.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+#include "sdkconfig.h"
+#include "log.h"
+
+static const char TAG_TRANSPORT_ESP[] = "AZ_TRANSPORT_ESP";
+
+/**
+ * @brief Driver handle.
+ * @details Raw TCP handles use the ESP transport; TLS ones use ESP-TLS
+ * directly, as only it gives access to the client session.
+ */
+typedef struct
+{
+    esp_transport_handle_t transport; /** @brief TCP transport; `NULL` for TLS handles. */
+    esp_tls_t *tls;                   /** @brief TLS connection; `NULL` while closed. */
+    esp_tls_cfg_t tls_config;         /** @brief TLS configuration: certificates and session to offer. */
+    const mbedtls_x509_crt *ca_chain; /** @brief Parsed chain of @ref TLS_CERT_FORMAT_X509 handles; owned by the transport. */
+    int wake_fd;                      /** @brief Event woken by `wake`; -1 if it could not be created. */
+    int last_errno;                   /** @brief Last TLS error. */
+} esp_handle_t;
+
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+/**
+ * @brief Chain of the handle connecting, for @ref esp_driver_ca_chain_attach.
+ * @details ESP-TLS has no context parameter for the attach hook, called from the
+ * connecting task: the chain is set under @ref ESP_CA_ATTACH_LOCK, which the hook
+ * gives back once attached, so the handshakes still run concurrently.
+ */
+static const mbedtls_x509_crt *ESP_CA_ATTACHING = NULL;
+static _Atomic(SemaphoreHandle_t) ESP_CA_ATTACH_LOCK = NULL;
+
+static bool esp_driver_ca_attach_lock_init();
+static int esp_driver_tls_conn_new_x509(esp_handle_t *esp, const char *hostname, uint16_t port);
+static esp_err_t esp_driver_ca_chain_attach(void *conf);
+#endif
+static int esp_driver_tls_wait(esp_handle_t *esp, short events, uint16_t timeout_ms);
+static void esp_driver_tls_set_errno(esp_handle_t *esp, int fallback_errno);
+static int esp_driver_wake_fd_create();
+static void esp_driver_destroy(void *handle);
+
+static void *esp_driver_create(const tls_certificate_t *certificate, void *driver_context)
+{
+    esp_handle_t *esp = (esp_handle_t *)malloc(sizeof(esp_handle_t));
+
+    if (esp == NULL)
+    {
+        CMP_LOGE(TAG_TRANSPORT_ESP, "failure allocating handle");
+        return NULL;
+    }
+
+    memset(esp, 0, sizeof(esp_handle_t));
+
+    esp->wake_fd = esp_driver_wake_fd_create();
+
+    if (certificate == NULL)
+    {
+        if ((esp->transport = esp_transport_tcp_init()) == NULL)
+        {
+            esp_driver_destroy(esp);
+            return NULL;
+        }
+
+        return esp;
+    }
+
+    switch (certificate->format)
+    {
+    case TLS_CERT_FORMAT_PEM:
+        // ESP-TLS takes the PEM null-terminator in the length.
+        esp->tls_config.cacert_pem_buf = certificate->data;
+        esp->tls_config.cacert_pem_bytes = certificate->length + 1;
+        break;
+
+    case TLS_CERT_FORMAT_DER:
+        esp->tls_config.cacert_buf = certificate->data;
+        esp->tls_config.cacert_bytes = certificate->length;
+        break;
+
+    case TLS_CERT_FORMAT_X509:
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+        if (!esp_driver_ca_attach_lock_init())
+        {
+            esp_driver_destroy(esp);
+            return NULL;
+        }
+
+        // Attached in place of the bundle, leaving the ESP-TLS global CA store alone.
+        esp->ca_chain = (const mbedtls_x509_crt *)certificate->data;
+        esp->tls_config.crt_bundle_attach = esp_driver_ca_chain_attach;
+        break;
+#else
+        CMP_LOGE(TAG_TRANSPORT_ESP, "X509 chains require CONFIG_MBEDTLS_CERTIFICATE_BUNDLE");
+        esp_driver_destroy(esp);
+        return NULL;
+#endif
+
+    default:
+        CMP_LOGE(TAG_TRANSPORT_ESP, "invalid certificate format: %d", certificate->format);
+        break;
+    }
+
+    return esp;
+}
+
+static transport_status_t esp_driver_set_client_certificate(void *handle, const client_certificate_t *certificate)
+{
+    esp_handle_t *esp = (esp_handle_t *)handle;
+    transport_status_t result = TRANSPORT_STATUS_SUCCESS;
+
+    switch (certificate->format)
+    {
+    case CLIENT_CERT_FORMAT_PEM:
+        esp->tls_config.clientcert_pem_buf = certificate->data;
+        esp->tls_config.clientcert_pem_bytes = certificate->data_length + 1;
+        esp->tls_config.clientkey_pem_buf = certificate->private_key;
+        esp->tls_config.clientkey_pem_bytes = certificate->private_key_length + 1;
+        break;
+
+    case CLIENT_CERT_FORMAT_DER:
+        esp->tls_config.clientcert_buf = certificate->data;
+        esp->tls_config.clientcert_bytes = certificate->data_length;
+        esp->tls_config.clientkey_buf = certificate->private_key;
+        esp->tls_config.clientkey_bytes = certificate->private_key_length;
+        break;
+
+    default:
+        result = TRANSPORT_STATUS_FAILURE;
+        CMP_LOGE(TAG_TRANSPORT_ESP, "invalid certificate format: %d", certificate->format);
+        break;
+    }
+
+    return result;
+}
+
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+static void *esp_driver_session_get(void *handle)
+{
+    esp_handle_t *esp = (esp_handle_t *)handle;
+
+    return esp->tls != NULL ? esp_tls_get_client_session(esp->tls) : NULL;
+}
+
+static void esp_driver_session_set(void *handle, void *session)
+{
+    ((esp_handle_t *)handle)->tls_config.client_session = (esp_tls_client_session_t *)session;
+}
+
+static void esp_driver_session_free(void *session)
+{
+    esp_tls_free_client_session((esp_tls_client_session_t *)session);
+}
+#endif
+
+static transport_status_t esp_driver_connect(void *handle, const char *hostname, uint16_t port, uint16_t timeout_ms)
+{
+    esp_handle_t *esp = (esp_handle_t *)handle;
+
+    if (esp->transport != NULL)
+    {
+        return esp_transport_connect(esp->transport, hostname, port, timeout_ms) == 0
+                   ? TRANSPORT_STATUS_SUCCESS
+                   : TRANSPORT_STATUS_FAILURE;
+    }
+
+    if ((esp->tls = esp_tls_init()) == NULL)
+    {
+        esp->last_errno = ENOMEM;
+        return TRANSPORT_STATUS_FAILURE;
+    }
+
+    esp->tls_config.timeout_ms = timeout_ms;
+
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+    int result = esp->ca_chain != NULL
+                     ? esp_driver_tls_conn_new_x509(esp, hostname, port)
+                     : esp_tls_conn_new_sync(hostname, strlen(hostname), port, &esp->tls_config, esp->tls);
+#else
+    int result = esp_tls_conn_new_sync(hostname, strlen(hostname), port, &esp->tls_config, esp->tls);
+#endif
+
+    if (result != 1)
+    {
+        esp_driver_tls_set_errno(esp, ECONNREFUSED);
+        esp_tls_conn_destroy(esp->tls);
+        esp->tls = NULL;
+
+        return TRANSPORT_STATUS_FAILURE;
+    }
+
+    return TRANSPORT_STATUS_SUCCESS;
+}
+
+static int32_t esp_driver_write(void *handle, const uint8_t *buffer, size_t length, uint16_t timeout_ms)
+{
+    esp_handle_t *esp = (esp_handle_t *)handle;
+
+    if (esp->transport != NULL)
+    {
+        return esp_transport_write(esp->transport, (const char *)buffer, length, timeout_ms);
+    }
+
+    if (esp->tls == NULL)
+    {
+        esp->last_errno = ENOTCONN;
+        return -1;
+    }
+
+    int wait_result = esp_driver_tls_wait(esp, POLLOUT, timeout_ms);
+
+    if (wait_result <= 0)
+    {
+        return wait_result < 0 ? -1 : 0;
+    }
+
+    ssize_t written = esp_tls_conn_write(esp->tls, buffer, length);
+
+    if (written == ESP_TLS_ERR_SSL_WANT_READ || written == ESP_TLS_ERR_SSL_WANT_WRITE)
+    {
+        return 0;
+    }
+
+    if (written < 0)
+    {
+        esp_driver_tls_set_errno(esp, ECONNRESET);
+        return -1;
+    }
+
+    return (int32_t)written;
+}
+
+static int32_t esp_driver_read(void *handle, uint8_t *buffer, size_t length, uint16_t timeout_ms)
+{
+    esp_handle_t *esp = (esp_handle_t *)handle;
+
+    if (esp->transport != NULL)
+    {
+        return esp_transport_read(esp->transport, (char *)buffer, length, timeout_ms);
+    }
+
+    if (esp->tls == NULL)
+    {
+        esp->last_errno = ENOTCONN;
+        return -1;
+    }
+
+    // Bytes already decrypted are not seen by the socket.
+    if (esp_tls_get_bytes_avail(esp->tls) <= 0)
+    {
+        int wait_result = esp_driver_tls_wait(esp, POLLIN, timeout_ms);
+
+        if (wait_result <= 0)
+        {
+            return wait_result < 0 ? -1 : 0;
+        }
+    }
+
+    ssize_t received = esp_tls_conn_read(esp->tls, buffer, length);
+
+    if (received == ESP_TLS_ERR_SSL_WANT_READ || received == ESP_TLS_ERR_SSL_WANT_WRITE)
+    {
+        return 0;
+    }
+
+    if (received == 0)
+    {
+        // Closed by the server.
+        esp->last_errno = ENOTCONN;
+        return -1;
+    }
+
+    if (received < 0)
+    {
+        esp_driver_tls_set_errno(esp, ECONNRESET);
+        return -1;
+    }
+
+    return (int32_t)received;
+}
+
+static transport_wait_result_t esp_driver_wait(void *handle, uint32_t timeout_ms)
+{
+    esp_handle_t *esp = (esp_handle_t *)handle;
+    uint64_t wakes = 0;
+    int socket = -1;
+
+    if (esp->transport != NULL)
+    {
+        socket = esp_transport_get_socket(esp->transport);
+    }
+    else if (esp->tls != NULL)
+    {
+        // Bytes already decrypted are not seen by the socket.
+        if (esp_tls_get_bytes_avail(esp->tls) > 0)
+        {
+            return TRANSPORT_WAIT_READABLE;
+        }
+
+        esp_tls_get_conn_sockfd(esp->tls, &socket);
+    }
+
+    if (socket < 0)
+    {
+        esp->last_errno = ENOTCONN;
+        return TRANSPORT_WAIT_FAILURE;
+    }
+
+    struct pollfd poll_fds[2] = {
+        {.fd = socket, .events = POLLIN, .revents = 0},
+        {.fd = esp->wake_fd, .events = POLLIN, .revents = 0}};
+
+    int result = poll(poll_fds, esp->wake_fd < 0 ? 1 : 2, timeout_ms > INT_MAX ? INT_MAX : (int)timeout_ms);
+
+    if (result < 0)
+    {
+        esp->last_errno = errno;
+        return TRANSPORT_WAIT_FAILURE;
+    }
+
+    // Errors and hang ups are reported by the read.
+    if (poll_fds[0].revents != 0)
+    {
+        return TRANSPORT_WAIT_READABLE;
+    }
+
+    if (poll_fds[1].revents & POLLIN)
+    {
+        // Clears the event: wakes since the last wait count as one.
+        read(esp->wake_fd, &wakes, sizeof(wakes));
+
+        return TRANSPORT_WAIT_WOKEN;
+    }
+
+    return TRANSPORT_WAIT_TIMEOUT;
+}
+
+static void esp_driver_wake(void *handle)
+{
+    esp_handle_t *esp = (esp_handle_t *)handle;
+    uint64_t wake = 1;
+
+    if (esp->wake_fd >= 0)
+    {
+        write(esp->wake_fd, &wake, sizeof(wake));
+    }
+}
+
+static transport_status_t esp_driver_close(void *handle)
+{
+    esp_handle_t *esp = (esp_handle_t *)handle;
+
+    if (esp->transport != NULL)
+    {
+        return esp_transport_close(esp->transport) < 0
+                   ? TRANSPORT_STATUS_FAILURE
+                   : TRANSPORT_STATUS_SUCCESS;
+    }
+
+    if (esp->tls != NULL)
+    {
+        esp_tls_conn_destroy(esp->tls);
+        esp->tls = NULL;
+    }
+
+    return TRANSPORT_STATUS_SUCCESS;
+}
+
+static int esp_driver_get_errno(void *handle)
+{
+    esp_handle_t *esp = (esp_handle_t *)handle;
+
+    return esp->transport != NULL ? esp_transport_get_errno(esp->transport) : esp->last_errno;
+}
+
+static void esp_driver_destroy(void *handle)
+{
+    esp_handle_t *esp = (esp_handle_t *)handle;
+
+    if (esp->transport != NULL)
+    {
+        esp_transport_destroy(esp->transport);
+    }
+    else
+    {
+        esp_driver_close(esp);
+    }
+
+    if (esp->wake_fd >= 0)
+    {
+        close(esp->wake_fd);
+    }
+
+    free(esp);
+}
+
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+static bool esp_driver_ca_attach_lock_init()
+{
+    if (atomic_load(&ESP_CA_ATTACH_LOCK) != NULL)
+    {
+        return true;
+    }
+
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    SemaphoreHandle_t expected = NULL;
+
+    if (lock == NULL)
+    {
+        CMP_LOGE(TAG_TRANSPORT_ESP, "failure creating chain attach lock");
+        return false;
+    }
+
+    // Handles may race to create it: the first one wins.
+    if (!atomic_compare_exchange_strong(&ESP_CA_ATTACH_LOCK, &expected, lock))
+    {
+        vSemaphoreDelete(lock);
+    }
+
+    return true;
+}
+
+static int esp_driver_tls_conn_new_x509(esp_handle_t *esp, const char *hostname, uint16_t port)
+{
+    SemaphoreHandle_t lock = atomic_load(&ESP_CA_ATTACH_LOCK);
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    ESP_CA_ATTACHING = esp->ca_chain;
+
+    int result = esp_tls_conn_new_sync(hostname, strlen(hostname), port, &esp->tls_config, esp->tls);
+
+    // Still held when the connection failed before the TLS configuration.
+    if (xSemaphoreGetMutexHolder(lock) == xTaskGetCurrentTaskHandle())
+    {
+        ESP_CA_ATTACHING = NULL;
+        xSemaphoreGive(lock);
+    }
+
+    return result;
+}
+
+static esp_err_t esp_driver_ca_chain_attach(void *conf)
+{
+    mbedtls_ssl_conf_ca_chain((mbedtls_ssl_config *)conf, (mbedtls_x509_crt *)ESP_CA_ATTACHING, NULL);
+
+    // Called by the task holding the lock, in esp_driver_tls_conn_new_x509.
+    ESP_CA_ATTACHING = NULL;
+    xSemaphoreGive(atomic_load(&ESP_CA_ATTACH_LOCK));
+
+    return ESP_OK;
+}
+#endif
+
+static int esp_driver_tls_wait(esp_handle_t *esp, short events, uint16_t timeout_ms)
+{
+    int socket = -1;
+
+    if (esp_tls_get_conn_sockfd(esp->tls, &socket) != ESP_OK || socket < 0)
+    {
+        esp->last_errno = ENOTCONN;
+        return -1;
+    }
+
+    struct pollfd poll_fd = {
+        .fd = socket,
+        .events = events,
+        .revents = 0};
+
+    int result = poll(&poll_fd, 1, timeout_ms);
+
+    if (result < 0)
+    {
+        esp->last_errno = errno;
+    }
+
+    return result;
+}
+
+static void esp_driver_tls_set_errno(esp_handle_t *esp, int fallback_errno)
+{
+    esp_tls_error_handle_t error_handle = NULL;
+    int socket_errno = 0;
+
+    // The socket error, when the failure came from the socket.
+    if (esp_tls_get_error_handle(esp->tls, &error_handle) == ESP_OK)
+    {
+        esp_tls_get_and_clear_error_type(error_handle, ESP_TLS_ERR_TYPE_SYSTEM, &socket_errno);
+    }
+
+    esp->last_errno = socket_errno != 0 ? socket_errno : fallback_errno;
+}
+
+static int esp_driver_wake_fd_create()
+{
+    static bool registered = false;
+
+    // Once for every handle: fails with ESP_ERR_INVALID_STATE if the application registered it.
+    if (!registered)
+    {
+        esp_vfs_eventfd_config_t config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+        esp_err_t result = esp_vfs_eventfd_register(&config);
+
+        registered = result == ESP_OK || result == ESP_ERR_INVALID_STATE;
+    }
+
+    int wake_fd = registered ? eventfd(0, 0) : -1;
+
+    if (wake_fd < 0)
+    {
+        CMP_LOGW(TAG_TRANSPORT_ESP, "failure creating wake event: waits are only ended by the socket");
+    }
+
+    return wake_fd;
+}
+
+static bool esp_driver_is_network_up(void *driver_context)
+{
+    esp_netif_ip_info_t ip_info;
+    esp_netif_t *netif = esp_netif_get_default_netif();
+
+    (void)driver_context;
+
+    // No default interface, as with a network stack of the application's own:
+    // unknown, so the connection is attempted.
+    if (netif == NULL)
+    {
+        return true;
+    }
+
+    // Up, but without an address yet, is still down for connecting.
+    return esp_netif_is_netif_up(netif) &&
+           esp_netif_get_ip_info(netif, &ip_info) == ESP_OK &&
+           ip_info.ip.addr != 0;
+}
+
+static const transport_driver_t ESP_TRANSPORT_DRIVER = {
+    .create = esp_driver_create,
+    .set_client_certificate = esp_driver_set_client_certificate,
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    .session_get = esp_driver_session_get,
+    .session_set = esp_driver_session_set,
+    .session_free = esp_driver_session_free,
+#else
+    .session_get = NULL,
+    .session_set = NULL,
+    .session_free = NULL,
+#endif
+    // ESP-TLS does not tell whether the server accepted the offered session, and
+    // the session id cannot: the client replaces it by a random one to offer a ticket.
+    .session_resumed = NULL,
+    .connect = esp_driver_connect,
+    .write = esp_driver_write,
+    .read = esp_driver_read,
+    .wait = esp_driver_wait,
+    .wake = esp_driver_wake,
+    .close = esp_driver_close,
+    .get_errno = esp_driver_get_errno,
+    .destroy = esp_driver_destroy,
+    .is_network_up = esp_driver_is_network_up,
+    .context = NULL};
+
+const transport_driver_t *transport_driver_get_default()
+{
+    return &ESP_TRANSPORT_DRIVER;
+}
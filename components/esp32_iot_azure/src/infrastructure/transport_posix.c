@@ -0,0 +1,306 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include "infrastructure/transport.h"
+#include "assertion.h"
+#include "log.h"
+
+static const char TAG_TRANSPORT_POSIX[] = "AZ_TRANSPORT_POSIX";
+
+typedef struct
+{
+    int socket;     /** @brief Socket file descriptor; -1 when closed. */
+    int wake_fd;    /** @brief Event woken by `wake`; -1 if it could not be created. */
+    int last_errno; /** @brief Last socket error. */
+} posix_handle_t;
+
+static int posix_wait(posix_handle_t *posix, short events, uint16_t timeout_ms)
+{
+    struct pollfd poll_fd = {
+        .fd = posix->socket,
+        .events = events,
+        .revents = 0};
+
+    int result = poll(&poll_fd, 1, timeout_ms);
+
+    if (result < 0)
+    {
+        posix->last_errno = errno;
+    }
+
+    return result;
+}
+
+static void *posix_driver_create(const tls_certificate_t *certificate, void *driver_context)
+{
+    if (certificate != NULL)
+    {
+        CMP_LOGE(TAG_TRANSPORT_POSIX, "TLS not available on the host: set a driver with transport_set_driver");
+        return NULL;
+    }
+
+    posix_handle_t *posix = (posix_handle_t *)malloc(sizeof(posix_handle_t));
+
+    CMP_CHECK(TAG_TRANSPORT_POSIX, (posix != NULL), "failure allocating handle", NULL)
+
+    posix->socket = -1;
+    posix->wake_fd = eventfd(0, 0);
+    posix->last_errno = 0;
+
+    if (posix->wake_fd < 0)
+    {
+        CMP_LOGW(TAG_TRANSPORT_POSIX, "failure creating wake event: %d", errno);
+    }
+
+    return posix;
+}
+
+static transport_status_t posix_driver_connect(void *handle, const char *hostname, uint16_t port, uint16_t timeout_ms)
+{
+    posix_handle_t *posix = (posix_handle_t *)handle;
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM};
+    struct addrinfo *address = NULL;
+    char port_text[6];
+    int flags;
+    int socket_error = 0;
+    socklen_t socket_error_length = sizeof(socket_error);
+
+    snprintf(port_text, sizeof(port_text), "%u", port);
+
+    if (getaddrinfo(hostname, port_text, &hints, &address) != 0 || address == NULL)
+    {
+        posix->last_errno = EHOSTUNREACH;
+        return TRANSPORT_STATUS_FAILURE;
+    }
+
+    posix->socket = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+
+    if (posix->socket < 0)
+    {
+        posix->last_errno = errno;
+        freeaddrinfo(address);
+        return TRANSPORT_STATUS_FAILURE;
+    }
+
+    flags = fcntl(posix->socket, F_GETFL, 0);
+    fcntl(posix->socket, F_SETFL, flags | O_NONBLOCK);
+
+    if (connect(posix->socket, address->ai_addr, address->ai_addrlen) < 0 && errno != EINPROGRESS)
+    {
+        socket_error = errno;
+    }
+    else if (posix_wait(posix, POLLOUT, timeout_ms) <= 0)
+    {
+        socket_error = ETIMEDOUT;
+    }
+    else
+    {
+        getsockopt(posix->socket, SOL_SOCKET, SO_ERROR, &socket_error, &socket_error_length);
+    }
+
+    freeaddrinfo(address);
+
+    if (socket_error != 0)
+    {
+        posix->last_errno = socket_error;
+        close(posix->socket);
+        posix->socket = -1;
+        return TRANSPORT_STATUS_FAILURE;
+    }
+
+    int no_delay = 1;
+
+    fcntl(posix->socket, F_SETFL, flags);
+    setsockopt(posix->socket, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+    return TRANSPORT_STATUS_SUCCESS;
+}
+
+static int32_t posix_driver_write(void *handle, const uint8_t *buffer, size_t length, uint16_t timeout_ms)
+{
+    posix_handle_t *posix = (posix_handle_t *)handle;
+
+    if (posix->socket < 0)
+    {
+        posix->last_errno = ENOTCONN;
+        return -1;
+    }
+
+    int wait_result = posix_wait(posix, POLLOUT, timeout_ms);
+
+    if (wait_result <= 0)
+    {
+        return wait_result < 0 ? -1 : 0;
+    }
+
+    ssize_t written = send(posix->socket, buffer, length, MSG_NOSIGNAL);
+
+    if (written < 0)
+    {
+        posix->last_errno = errno;
+        return -1;
+    }
+
+    return (int32_t)written;
+}
+
+static int32_t posix_driver_read(void *handle, uint8_t *buffer, size_t length, uint16_t timeout_ms)
+{
+    posix_handle_t *posix = (posix_handle_t *)handle;
+
+    if (posix->socket < 0)
+    {
+        posix->last_errno = ENOTCONN;
+        return -1;
+    }
+
+    int wait_result = posix_wait(posix, POLLIN, timeout_ms);
+
+    if (wait_result <= 0)
+    {
+        return wait_result < 0 ? -1 : 0;
+    }
+
+    ssize_t received = recv(posix->socket, buffer, length, 0);
+
+    if (received == 0)
+    {
+        // Orderly shutdown by the peer.
+        posix->last_errno = ENOTCONN;
+        return -1;
+    }
+
+    if (received < 0)
+    {
+        posix->last_errno = errno;
+        return -1;
+    }
+
+    return (int32_t)received;
+}
+
+static transport_wait_result_t posix_driver_wait(void *handle, uint32_t timeout_ms)
+{
+    posix_handle_t *posix = (posix_handle_t *)handle;
+    uint64_t wakes = 0;
+
+    if (posix->socket < 0)
+    {
+        posix->last_errno = ENOTCONN;
+        return TRANSPORT_WAIT_FAILURE;
+    }
+
+    struct pollfd poll_fds[2] = {
+        {.fd = posix->socket, .events = POLLIN, .revents = 0},
+        {.fd = posix->wake_fd, .events = POLLIN, .revents = 0}};
+
+    int result = poll(poll_fds, posix->wake_fd < 0 ? 1 : 2, timeout_ms > INT_MAX ? INT_MAX : (int)timeout_ms);
+
+    if (result < 0)
+    {
+        if (errno == EINTR)
+        {
+            return TRANSPORT_WAIT_TIMEOUT;
+        }
+
+        posix->last_errno = errno;
+        return TRANSPORT_WAIT_FAILURE;
+    }
+
+    // Errors and hang ups are reported by the read.
+    if (poll_fds[0].revents != 0)
+    {
+        return TRANSPORT_WAIT_READABLE;
+    }
+
+    if (poll_fds[1].revents & POLLIN)
+    {
+        // Clears the event: wakes since the last wait count as one.
+        if (read(posix->wake_fd, &wakes, sizeof(wakes)) < 0)
+        {
+            posix->last_errno = errno;
+        }
+
+        return TRANSPORT_WAIT_WOKEN;
+    }
+
+    return TRANSPORT_WAIT_TIMEOUT;
+}
+
+static void posix_driver_wake(void *handle)
+{
+    posix_handle_t *posix = (posix_handle_t *)handle;
+    uint64_t wake = 1;
+
+    if (posix->wake_fd >= 0 && write(posix->wake_fd, &wake, sizeof(wake)) < 0)
+    {
+        CMP_LOGW(TAG_TRANSPORT_POSIX, "failure waking: %d", errno);
+    }
+}
+
+static transport_status_t posix_driver_close(void *handle)
+{
+    posix_handle_t *posix = (posix_handle_t *)handle;
+
+    if (posix->socket >= 0)
+    {
+        close(posix->socket);
+        posix->socket = -1;
+    }
+
+    return TRANSPORT_STATUS_SUCCESS;
+}
+
+static int posix_driver_get_errno(void *handle)
+{
+    return ((posix_handle_t *)handle)->last_errno;
+}
+
+static void posix_driver_destroy(void *handle)
+{
+    posix_handle_t *posix = (posix_handle_t *)handle;
+
+    posix_driver_close(posix);
+
+    if (posix->wake_fd >= 0)
+    {
+        close(posix->wake_fd);
+    }
+
+    free(posix);
+}
+
+static const transport_driver_t POSIX_TRANSPORT_DRIVER = {
+    .create = posix_driver_create,
+    .set_client_certificate = NULL,
+    .session_get = NULL,
+    .session_set = NULL,
+    .session_free = NULL,
+    .session_resumed = NULL,
+    .connect = posix_driver_connect,
+    .write = posix_driver_write,
+    .read = posix_driver_read,
+    .wait = posix_driver_wait,
+    .wake = posix_driver_wake,
+    .close = posix_driver_close,
+    .get_errno = posix_driver_get_errno,
+    .destroy = posix_driver_destroy,
+    .is_network_up = NULL,
+    .context = NULL};
+
+const transport_driver_t *transport_driver_get_default()
+{
+    return &POSIX_TRANSPORT_DRIVER;
+}
@@ -1,18 +1,24 @@
+#include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include "azure_iot_flash_platform.h"
 #include "esp_system.h"
 #include "mbedtls/base64.h"
-#include "mbedtls/md.h"
 #include "assertion.h"
 #include "log.h"
+#include "config.h"
 
 #define AZURE_IOT_SHA_256_SIZE 32
 
+// One flash sector: reads are aligned to the sectors.
+#define IMAGE_READ_BUFFER_SIZE 4096U
+
 static const char TAG_FLASH_PORT[] = "AZ_FLASH_PORT";
 
+static AzureIoTResult_t image_erase(AzureADUImage_t *adu_image, uint32_t end);
 static AzureIoTResult_t base64_decode(const uint8_t *encoded, size_t encoded_length, uint8_t *output_buffer, size_t output_buffer_length, size_t *bytes_written);
-static AzureIoTResult_t image_calculate_hmac_256(const AzureADUImage_t *adu_image, uint8_t *output_buffer);
-static AzureIoTResult_t image_verify(const AzureADUImage_t *adu_image, const uint8_t *encoded_hash, uint32_t encoded_hash_length);
+static AzureIoTResult_t image_calculate_sha_256(const AzureADUImage_t *adu_image, uint8_t *output_buffer);
+static AzureIoTResult_t image_verify(AzureADUImage_t *adu_image, const uint8_t *encoded_hash, uint32_t encoded_hash_length);
 
 int64_t AzureIoTPlatform_GetSingleFlashBootBankSize()
 {
@@ -35,10 +41,43 @@ AzureIoTResult_t AzureIoTPlatform_Init(AzureADUImage_t *const pxAduImage)
 
     pxAduImage->partition = esp_ota_get_next_update_partition(current_partition);
     pxAduImage->image_size = 0;
+    pxAduImage->hashed_size = 0;
+    pxAduImage->erased_size = 0;
+    pxAduImage->hashes_download = false;
 
     CMP_CHECK(TAG_FLASH_PORT, (pxAduImage->partition != NULL), "failure getting next OTA partition", eAzureIoTErrorFailed)
 
-    CMP_CHECK(TAG_FLASH_PORT, (esp_ota_begin(pxAduImage->partition, OTA_SIZE_UNKNOWN, &pxAduImage->ota) == ESP_OK), "failure starting OTA", eAzureIoTErrorFailed)
+    // Erased as written, by AzureIoTPlatform_WriteBlock: keeps
+    // what an interrupted download already wrote.
+    CMP_CHECK(TAG_FLASH_PORT, (esp_ota_begin(pxAduImage->partition, OTA_WITH_SEQUENTIAL_WRITES, &pxAduImage->ota) == ESP_OK), "failure starting OTA", eAzureIoTErrorFailed)
+
+    // Started last: nothing to release when the initialization fails.
+    mbedtls_sha256_init(&pxAduImage->sha256);
+    mbedtls_sha256_starts(&pxAduImage->sha256, 0);
+
+    return eAzureIoTSuccess;
+}
+
+AzureIoTResult_t AzureIoTPlatform_ResumeImage(AzureADUImage_t *const pxAduImage,
+                                              uint32_t offset,
+                                              const mbedtls_sha256_context *hash_state)
+{
+    uint32_t erase_size = pxAduImage->partition->erase_size;
+
+    CMP_CHECK(TAG_FLASH_PORT, (offset <= pxAduImage->partition->size), "failure resuming: offset out of partition bounds", eAzureIoTErrorFailed)
+
+    // The sector holding the offset was erased before being written. The sectors
+    // after it may hold blocks written after the offset was saved: erased again.
+    pxAduImage->erased_size = (offset + erase_size - 1) / erase_size * erase_size;
+
+    if (hash_state != NULL)
+    {
+        mbedtls_sha256_clone(&pxAduImage->sha256, hash_state);
+
+        pxAduImage->hashed_size = offset;
+    }
+
+    CMP_LOGI(TAG_FLASH_PORT, "resuming image at: %lu", (unsigned long)offset);
 
     return eAzureIoTSuccess;
 }
@@ -48,6 +87,11 @@ AzureIoTResult_t AzureIoTPlatform_WriteBlock(AzureADUImage_t *const pxAduImage,
                                              uint8_t *const pData,
                                              uint32_t ulBlockSize)
 {
+    if (image_erase(pxAduImage, offset + ulBlockSize) != eAzureIoTSuccess)
+    {
+        return eAzureIoTErrorFailed;
+    }
+
     esp_err_t result = esp_ota_write_with_offset(pxAduImage->ota, pData, (size_t)ulBlockSize, offset);
 
     if (result != ESP_OK)
@@ -56,6 +100,14 @@ AzureIoTResult_t AzureIoTPlatform_WriteBlock(AzureADUImage_t *const pxAduImage,
         return eAzureIoTErrorFailed;
     }
 
+    // Hashed while still in memory: saves reading the partition back on verification.
+    if (!pxAduImage->hashes_download && offset == pxAduImage->hashed_size)
+    {
+        mbedtls_sha256_update(&pxAduImage->sha256, pData, ulBlockSize);
+
+        pxAduImage->hashed_size += ulBlockSize;
+    }
+
     return eAzureIoTSuccess;
 }
 
@@ -75,6 +127,26 @@ AzureIoTResult_t AzureIoTPlatform_VerifyImage(AzureADUImage_t *const pxAduImage,
     return result;
 }
 
+AzureIoTResult_t AzureIoTPlatform_ReadRunningImage(AzureADUImage_t *const pxAduImage,
+                                                   uint32_t offset,
+                                                   uint8_t *pData,
+                                                   uint32_t ulBlockSize)
+{
+    const esp_partition_t *running_partition = esp_ota_get_running_partition();
+
+    CMP_CHECK(TAG_FLASH_PORT, (running_partition != NULL), "failure getting current OTA partition", eAzureIoTErrorFailed)
+
+    esp_err_t result = esp_partition_read(running_partition, offset, pData, ulBlockSize);
+
+    if (result != ESP_OK)
+    {
+        CMP_LOGE(TAG_FLASH_PORT, "failure reading running image: %d", result);
+        return eAzureIoTErrorFailed;
+    }
+
+    return eAzureIoTSuccess;
+}
+
 AzureIoTResult_t AzureIoTPlatform_EnableImage(AzureADUImage_t *const pxAduImage)
 {
     esp_err_t result = esp_ota_set_boot_partition(pxAduImage->partition);
@@ -88,12 +160,73 @@ AzureIoTResult_t AzureIoTPlatform_EnableImage(AzureADUImage_t *const pxAduImage)
     return eAzureIoTSuccess;
 }
 
+void AzureIoTPlatform_AbortImage(AzureADUImage_t *const pxAduImage)
+{
+    mbedtls_sha256_free(&pxAduImage->sha256);
+
+    // Only releases the OTA handle: the partition is not erased.
+    esp_err_t result = esp_ota_abort(pxAduImage->ota);
+
+    if (result != ESP_OK)
+    {
+        CMP_LOGW(TAG_FLASH_PORT, "failure aborting OTA: %d", result);
+    }
+}
+
+uint32_t AzureIoTPlatform_GetImageLocation(const AzureADUImage_t *const pxAduImage)
+{
+    return pxAduImage->partition->address;
+}
+
+void AzureIoTPlatform_HashDownloadBlock(AzureADUImage_t *const pxAduImage,
+                                        uint32_t offset,
+                                        const uint8_t *pData,
+                                        uint32_t ulBlockSize)
+{
+    pxAduImage->hashes_download = true;
+
+    if (offset == pxAduImage->hashed_size)
+    {
+        mbedtls_sha256_update(&pxAduImage->sha256, pData, ulBlockSize);
+
+        pxAduImage->hashed_size += ulBlockSize;
+    }
+}
+
 __attribute__((noreturn)) AzureIoTResult_t AzureIoTPlatform_ResetDevice(AzureADUImage_t *const)
 {
     // This functions restart the device, therefore never returning.
     esp_restart();
 }
 
+static AzureIoTResult_t image_erase(AzureADUImage_t *adu_image, uint32_t end)
+{
+    if (end <= adu_image->erased_size)
+    {
+        return eAzureIoTSuccess;
+    }
+
+    uint32_t erase_size = adu_image->partition->erase_size;
+    uint32_t erase_end = (end + erase_size - 1) / erase_size * erase_size;
+
+    if (erase_end > adu_image->partition->size)
+    {
+        erase_end = adu_image->partition->size;
+    }
+
+    esp_err_t result = esp_partition_erase_range(adu_image->partition, adu_image->erased_size, erase_end - adu_image->erased_size);
+
+    if (result != ESP_OK)
+    {
+        CMP_LOGE(TAG_FLASH_PORT, "failure erasing: %d", result);
+        return eAzureIoTErrorFailed;
+    }
+
+    adu_image->erased_size = erase_end;
+
+    return eAzureIoTSuccess;
+}
+
 static AzureIoTResult_t base64_decode(const uint8_t *encoded,
                                       size_t encoded_length,
                                       uint8_t *output_buffer,
@@ -111,29 +244,30 @@ static AzureIoTResult_t base64_decode(const uint8_t *encoded,
     return eAzureIoTSuccess;
 }
 
-static AzureIoTResult_t image_calculate_hmac_256(const AzureADUImage_t *adu_image, uint8_t *output_buffer)
+static AzureIoTResult_t image_calculate_sha_256(const AzureADUImage_t *adu_image, uint8_t *output_buffer)
 {
     AzureIoTResult_t result = eAzureIoTSuccess;
-    mbedtls_md_context_t context;
-    uint8_t read_buffer[32];
+    mbedtls_sha256_context context;
+    uint8_t *read_buffer = (uint8_t *)malloc(IMAGE_READ_BUFFER_SIZE);
     uint32_t size_read;
     esp_err_t read_partition_result;
 
-    mbedtls_md_init(&context);
-    mbedtls_md_setup(&context, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0);
-    mbedtls_md_starts(&context);
+    CMP_CHECK(TAG_FLASH_PORT, (read_buffer != NULL), "failure allocating read buffer", eAzureIoTErrorOutOfMemory)
+
+    mbedtls_sha256_init(&context);
+    mbedtls_sha256_starts(&context, 0);
 
-    CMP_LOGD(TAG_FLASH_PORT, "calculating hash for image with size: %lu", adu_image->image_size);
+    CMP_LOGD(TAG_FLASH_PORT, "reading back image with size: %lu", adu_image->image_size);
 
-    for (size_t offset = 0; offset < adu_image->image_size; offset += sizeof(read_buffer))
+    for (uint32_t offset = 0; offset < adu_image->image_size; offset += IMAGE_READ_BUFFER_SIZE)
     {
-        if (adu_image->image_size - offset < sizeof(read_buffer))
+        if (adu_image->image_size - offset < IMAGE_READ_BUFFER_SIZE)
         {
             size_read = adu_image->image_size - offset;
         }
         else
         {
-            size_read = sizeof(read_buffer);
+            size_read = IMAGE_READ_BUFFER_SIZE;
         }
 
         if ((read_partition_result = esp_partition_read(adu_image->partition, offset, read_buffer, (size_t)size_read)) != ESP_OK)
@@ -145,24 +279,31 @@ static AzureIoTResult_t image_calculate_hmac_256(const AzureADUImage_t *adu_imag
             break;
         }
 
-        mbedtls_md_update(&context, (const unsigned char *)read_buffer, (size_t)size_read);
+        mbedtls_sha256_update(&context, read_buffer, (size_t)size_read);
     }
 
-    mbedtls_md_finish(&context, output_buffer);
-    mbedtls_md_free(&context);
+    mbedtls_sha256_finish(&context, output_buffer);
+    mbedtls_sha256_free(&context);
+
+    free(read_buffer);
 
     CMP_LOGD(TAG_FLASH_PORT, "image hash calculated");
 
     return result;
 }
 
-static AzureIoTResult_t image_verify(const AzureADUImage_t *adu_image,
+static AzureIoTResult_t image_verify(AzureADUImage_t *adu_image,
                                      const uint8_t *encoded_hash,
                                      uint32_t encoded_hash_length)
 {
     uint8_t decoded_hash[AZURE_IOT_SHA_256_SIZE];
     uint8_t calculated_hash[AZURE_IOT_SHA_256_SIZE];
     size_t base64_decoded_length;
+    bool hashed = adu_image->hashed_size == adu_image->image_size;
+
+    // Finished up front: releases the context on every path.
+    mbedtls_sha256_finish(&adu_image->sha256, calculated_hash);
+    mbedtls_sha256_free(&adu_image->sha256);
 
     if (adu_image->image_size == 0)
     {
@@ -176,10 +317,37 @@ static AzureIoTResult_t image_verify(const AzureADUImage_t *adu_image,
         return eAzureIoTErrorFailed;
     }
 
-    if (image_calculate_hmac_256(adu_image, calculated_hash) != eAzureIoTSuccess)
+    if (adu_image->hashes_download)
     {
-        CMP_LOGE(TAG_FLASH_PORT, "failure calculating image hash");
-        return eAzureIoTErrorFailed;
+        // What was written is not what was downloaded: nothing to read back.
+        if (!hashed)
+        {
+            CMP_LOGE(TAG_FLASH_PORT, "invalid image: downloaded file not fully hashed");
+            return eAzureIoTErrorFailed;
+        }
+    }
+    else if (!hashed)
+    {
+        CMP_LOGW(TAG_FLASH_PORT, "blocks written out of order: reading back the image");
+    }
+
+    if (!adu_image->hashes_download && (!hashed || CONFIG_ESP32_IOT_AZURE_DU_VERIFY_READ_BACK))
+    {
+        uint8_t read_back_hash[AZURE_IOT_SHA_256_SIZE];
+
+        if (image_calculate_sha_256(adu_image, read_back_hash) != eAzureIoTSuccess)
+        {
+            CMP_LOGE(TAG_FLASH_PORT, "failure calculating image hash");
+            return eAzureIoTErrorFailed;
+        }
+
+        if (hashed && memcmp(calculated_hash, read_back_hash, AZURE_IOT_SHA_256_SIZE) != 0)
+        {
+            CMP_LOGE(TAG_FLASH_PORT, "image read back differs from the image written");
+            return eAzureIoTErrorFailed;
+        }
+
+        memcpy(calculated_hash, read_back_hash, AZURE_IOT_SHA_256_SIZE);
     }
 
     if (memcmp(decoded_hash, calculated_hash, AZURE_IOT_SHA_256_SIZE) != 0)
@@ -0,0 +1,282 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "azure_iot_flash_platform.h"
+#include "mbedtls/base64.h"
+#include "assertion.h"
+#include "log.h"
+#include "config.h"
+
+#define AZURE_IOT_SHA_256_SIZE 32
+#define HOST_FLASH_SECTOR_SIZE 4096U
+
+static const char TAG_FLASH_PORT[] = "AZ_FLASH_PORT";
+
+// Simulates the next OTA partition; allocated once and kept for the process lifetime.
+static uint8_t *HOST_FLASH_BANK = NULL;
+
+// Simulates the running OTA partition: the last image enabled, erased until then.
+static uint8_t *HOST_RUNNING_BANK = NULL;
+
+static AzureIoTResult_t base64_decode(const uint8_t *encoded, size_t encoded_length, uint8_t *output_buffer, size_t output_buffer_length, size_t *bytes_written);
+static AzureIoTResult_t image_calculate_sha_256(const AzureADUImage_t *adu_image, uint8_t *output_buffer);
+static AzureIoTResult_t image_verify(AzureADUImage_t *adu_image, const uint8_t *encoded_hash, uint32_t encoded_hash_length);
+
+int64_t AzureIoTPlatform_GetSingleFlashBootBankSize()
+{
+    return CONFIG_ESP32_IOT_AZURE_HOST_FLASH_BANK_SIZE;
+}
+
+AzureIoTResult_t AzureIoTPlatform_Init(AzureADUImage_t *const pxAduImage)
+{
+    if (HOST_FLASH_BANK == NULL)
+    {
+        HOST_FLASH_BANK = (uint8_t *)malloc(CONFIG_ESP32_IOT_AZURE_HOST_FLASH_BANK_SIZE);
+    }
+
+    if (HOST_RUNNING_BANK == NULL && (HOST_RUNNING_BANK = (uint8_t *)malloc(CONFIG_ESP32_IOT_AZURE_HOST_FLASH_BANK_SIZE)) != NULL)
+    {
+        memset(HOST_RUNNING_BANK, 0xFF, CONFIG_ESP32_IOT_AZURE_HOST_FLASH_BANK_SIZE);
+    }
+
+    pxAduImage->partition = HOST_FLASH_BANK;
+    pxAduImage->partition_size = CONFIG_ESP32_IOT_AZURE_HOST_FLASH_BANK_SIZE;
+    pxAduImage->image_size = 0;
+    pxAduImage->hashed_size = 0;
+    pxAduImage->erased_size = 0;
+    pxAduImage->hashes_download = false;
+
+    CMP_CHECK(TAG_FLASH_PORT, (pxAduImage->partition != NULL && HOST_RUNNING_BANK != NULL), "failure allocating in-memory partition", eAzureIoTErrorFailed)
+
+    mbedtls_sha256_init(&pxAduImage->sha256);
+    mbedtls_sha256_starts(&pxAduImage->sha256, 0);
+
+    // Same as the device: erased as written, keeping what
+    // an interrupted download already wrote.
+    return eAzureIoTSuccess;
+}
+
+AzureIoTResult_t AzureIoTPlatform_ResumeImage(AzureADUImage_t *const pxAduImage,
+                                              uint32_t offset,
+                                              const mbedtls_sha256_context *hash_state)
+{
+    CMP_CHECK(TAG_FLASH_PORT, (offset <= pxAduImage->partition_size), "failure resuming: offset out of partition bounds", eAzureIoTErrorFailed)
+
+    pxAduImage->erased_size = (offset + HOST_FLASH_SECTOR_SIZE - 1) / HOST_FLASH_SECTOR_SIZE * HOST_FLASH_SECTOR_SIZE;
+
+    if (hash_state != NULL)
+    {
+        mbedtls_sha256_clone(&pxAduImage->sha256, hash_state);
+
+        pxAduImage->hashed_size = offset;
+    }
+
+    CMP_LOGI(TAG_FLASH_PORT, "resuming image at: %lu", (unsigned long)offset);
+
+    return eAzureIoTSuccess;
+}
+
+AzureIoTResult_t AzureIoTPlatform_WriteBlock(AzureADUImage_t *const pxAduImage,
+                                             uint32_t offset,
+                                             uint8_t *const pData,
+                                             uint32_t ulBlockSize)
+{
+    if (pxAduImage->partition == NULL || offset > pxAduImage->partition_size || ulBlockSize > pxAduImage->partition_size - offset)
+    {
+        CMP_LOGE(TAG_FLASH_PORT, "failure writing: block out of partition bounds");
+        return eAzureIoTErrorFailed;
+    }
+
+    if (offset + ulBlockSize > pxAduImage->erased_size)
+    {
+        uint32_t erase_end = (offset + ulBlockSize + HOST_FLASH_SECTOR_SIZE - 1) / HOST_FLASH_SECTOR_SIZE * HOST_FLASH_SECTOR_SIZE;
+
+        if (erase_end > pxAduImage->partition_size)
+        {
+            erase_end = pxAduImage->partition_size;
+        }
+
+        // Erased flash reads as 0xFF.
+        memset(pxAduImage->partition + pxAduImage->erased_size, 0xFF, erase_end - pxAduImage->erased_size);
+
+        pxAduImage->erased_size = erase_end;
+    }
+
+    memcpy(pxAduImage->partition + offset, pData, ulBlockSize);
+
+    // Same as the device: hashed while written, in order.
+    if (!pxAduImage->hashes_download && offset == pxAduImage->hashed_size)
+    {
+        mbedtls_sha256_update(&pxAduImage->sha256, pData, ulBlockSize);
+
+        pxAduImage->hashed_size += ulBlockSize;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+AzureIoTResult_t AzureIoTPlatform_VerifyImage(AzureADUImage_t *const pxAduImage,
+                                              uint8_t *pucSHA256Hash,
+                                              uint32_t ulSHA256HashLength)
+{
+    CMP_LOGI(TAG_FLASH_PORT, "base64 encoded hash from ADU: %.*s", (int)ulSHA256HashLength, pucSHA256Hash);
+
+    return image_verify(pxAduImage, pucSHA256Hash, ulSHA256HashLength);
+}
+
+void AzureIoTPlatform_AbortImage(AzureADUImage_t *const pxAduImage)
+{
+    // Nothing else to release: the in-memory partition is kept for the process lifetime.
+    mbedtls_sha256_free(&pxAduImage->sha256);
+}
+
+uint32_t AzureIoTPlatform_GetImageLocation(const AzureADUImage_t *const pxAduImage)
+{
+    return 0;
+}
+
+void AzureIoTPlatform_HashDownloadBlock(AzureADUImage_t *const pxAduImage,
+                                        uint32_t offset,
+                                        const uint8_t *pData,
+                                        uint32_t ulBlockSize)
+{
+    pxAduImage->hashes_download = true;
+
+    if (offset == pxAduImage->hashed_size)
+    {
+        mbedtls_sha256_update(&pxAduImage->sha256, pData, ulBlockSize);
+
+        pxAduImage->hashed_size += ulBlockSize;
+    }
+}
+
+AzureIoTResult_t AzureIoTPlatform_ReadRunningImage(AzureADUImage_t *const pxAduImage,
+                                                   uint32_t offset,
+                                                   uint8_t *pData,
+                                                   uint32_t ulBlockSize)
+{
+    if (HOST_RUNNING_BANK == NULL || offset > CONFIG_ESP32_IOT_AZURE_HOST_FLASH_BANK_SIZE || ulBlockSize > CONFIG_ESP32_IOT_AZURE_HOST_FLASH_BANK_SIZE - offset)
+    {
+        CMP_LOGE(TAG_FLASH_PORT, "failure reading running image: out of partition bounds");
+        return eAzureIoTErrorFailed;
+    }
+
+    memcpy(pData, HOST_RUNNING_BANK + offset, ulBlockSize);
+
+    return eAzureIoTSuccess;
+}
+
+AzureIoTResult_t AzureIoTPlatform_EnableImage(AzureADUImage_t *const pxAduImage)
+{
+    // As if booted: the next delta update is based on it.
+    memcpy(HOST_RUNNING_BANK, pxAduImage->partition, pxAduImage->partition_size);
+
+    CMP_LOGI(TAG_FLASH_PORT, "image enabled: %lu bytes", (unsigned long)pxAduImage->image_size);
+
+    return eAzureIoTSuccess;
+}
+
+__attribute__((noreturn)) AzureIoTResult_t AzureIoTPlatform_ResetDevice(AzureADUImage_t *const)
+{
+    // There is no device to restart on the host: end the process.
+    exit(0);
+}
+
+static AzureIoTResult_t base64_decode(const uint8_t *encoded,
+                                      size_t encoded_length,
+                                      uint8_t *output_buffer,
+                                      size_t output_buffer_length,
+                                      size_t *bytes_written)
+{
+    int result = mbedtls_base64_decode(output_buffer, output_buffer_length, bytes_written, encoded, encoded_length);
+
+    if (result != 0)
+    {
+        CMP_LOGE(TAG_FLASH_PORT, "failed decoding base64: %d", result);
+        return eAzureIoTErrorFailed;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+static AzureIoTResult_t image_calculate_sha_256(const AzureADUImage_t *adu_image, uint8_t *output_buffer)
+{
+    if (mbedtls_sha256(adu_image->partition, adu_image->image_size, output_buffer, 0) != 0)
+    {
+        CMP_LOGE(TAG_FLASH_PORT, "failure hashing partition");
+        return eAzureIoTErrorFailed;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+static AzureIoTResult_t image_verify(AzureADUImage_t *adu_image,
+                                     const uint8_t *encoded_hash,
+                                     uint32_t encoded_hash_length)
+{
+    uint8_t decoded_hash[AZURE_IOT_SHA_256_SIZE];
+    uint8_t calculated_hash[AZURE_IOT_SHA_256_SIZE];
+    size_t base64_decoded_length;
+    bool hashed = adu_image->hashed_size == adu_image->image_size;
+
+    // Finished up front: releases the context on every path.
+    mbedtls_sha256_finish(&adu_image->sha256, calculated_hash);
+    mbedtls_sha256_free(&adu_image->sha256);
+
+    if (adu_image->partition == NULL || adu_image->image_size == 0 || adu_image->image_size > adu_image->partition_size)
+    {
+        CMP_LOGE(TAG_FLASH_PORT, "invalid image: no content");
+        return eAzureIoTErrorFailed;
+    }
+
+    if (base64_decode(encoded_hash, (unsigned int)encoded_hash_length, decoded_hash, sizeof(decoded_hash), &base64_decoded_length) != eAzureIoTSuccess)
+    {
+        CMP_LOGE(TAG_FLASH_PORT, "failure decoding base64 SHA256");
+        return eAzureIoTErrorFailed;
+    }
+
+    if (adu_image->hashes_download)
+    {
+        // What was written is not what was downloaded: nothing to read back.
+        if (!hashed)
+        {
+            CMP_LOGE(TAG_FLASH_PORT, "invalid image: downloaded file not fully hashed");
+            return eAzureIoTErrorFailed;
+        }
+    }
+    else if (!hashed)
+    {
+        CMP_LOGW(TAG_FLASH_PORT, "blocks written out of order: reading back the image");
+    }
+
+    if (!adu_image->hashes_download && (!hashed || CONFIG_ESP32_IOT_AZURE_DU_VERIFY_READ_BACK))
+    {
+        uint8_t read_back_hash[AZURE_IOT_SHA_256_SIZE];
+
+        if (image_calculate_sha_256(adu_image, read_back_hash) != eAzureIoTSuccess)
+        {
+            CMP_LOGE(TAG_FLASH_PORT, "failure calculating image hash");
+            return eAzureIoTErrorFailed;
+        }
+
+        if (hashed && memcmp(calculated_hash, read_back_hash, AZURE_IOT_SHA_256_SIZE) != 0)
+        {
+            CMP_LOGE(TAG_FLASH_PORT, "image read back differs from the image written");
+            return eAzureIoTErrorFailed;
+        }
+
+        memcpy(calculated_hash, read_back_hash, AZURE_IOT_SHA_256_SIZE);
+    }
+
+    if (memcmp(decoded_hash, calculated_hash, AZURE_IOT_SHA_256_SIZE) != 0)
+    {
+        CMP_LOGE(TAG_FLASH_PORT, "hashes does not match");
+        CMP_LOGE(TAG_FLASH_PORT, "hash wanted: ");
+        CMP_LOG_BUFFER_HEX(TAG_FLASH_PORT, decoded_hash, sizeof(decoded_hash));
+        CMP_LOGE(TAG_FLASH_PORT, "hash calculated: ");
+        CMP_LOG_BUFFER_HEX(TAG_FLASH_PORT, calculated_hash, sizeof(calculated_hash));
+        return eAzureIoTErrorFailed;
+    }
+
+    return eAzureIoTSuccess;
+}
@@ -0,0 +1,94 @@
+#include "config.h"
+
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DU_ENABLED
+
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "mbedtls/base64.h"
+#include "mbedtls/sha256.h"
+#include "adu_fixture.h"
+
+uint8_t *adu_fixture_image_create(char *hash_base64, size_t hash_base64_size)
+{
+    uint8_t hash[32];
+    size_t hash_base64_length = 0;
+    uint8_t *image = (uint8_t *)malloc(ADU_FIXTURE_IMAGE_SIZE);
+
+    if (image == NULL)
+    {
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < ADU_FIXTURE_IMAGE_SIZE; i++)
+    {
+        image[i] = (uint8_t)((i * 31U) ^ (i >> 8));
+    }
+
+    mbedtls_sha256(image, ADU_FIXTURE_IMAGE_SIZE, hash, 0);
+    mbedtls_base64_encode((unsigned char *)hash_base64, hash_base64_size - 1, &hash_base64_length, hash, sizeof(hash));
+
+    hash_base64[hash_base64_length] = '\0';
+
+    return image;
+}
+
+http_server_stub_config_t adu_fixture_server_config(const uint8_t *resource, uint32_t seed)
+{
+    http_server_stub_config_t config = {
+        .resource = resource,
+        .resource_size = ADU_FIXTURE_IMAGE_SIZE,
+        .latency_us = 0,
+        .bandwidth_bytes_per_s = 0,
+        .loss_percent = 0,
+        .loss_penalty_us = 200000,
+        .reset_every_requests = 0,
+        .close_every_requests = 0,
+        .seed = seed};
+
+    return config;
+}
+
+void adu_fixture_parse_url(const char *url, uint8_t *parse_buffer, parsed_file_url_t *parsed_url)
+{
+    AzureIoTADUUpdateManifestFileUrl_t file_url = {
+        .pucFileID = (uint8_t *)"bench",
+        .ulFileIDLength = sizeof("bench") - 1,
+        .pucUrl = (uint8_t *)url,
+        .ulUrlLength = strlen(url)};
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_adu_file_parse_url(&file_url, parse_buffer, parsed_url));
+}
+
+bool adu_fixture_write_to_flash(uint8_t *chunk,
+                                uint32_t chunk_length,
+                                uint32_t start_offset,
+                                uint32_t resource_size,
+                                void *callback_context)
+{
+    adu_fixture_download_context_t *context = (adu_fixture_download_context_t *)callback_context;
+
+    if (context->stop_at != 0 && start_offset >= context->stop_at)
+    {
+        // Power loss.
+        return false;
+    }
+
+    if (context->writer != NULL)
+    {
+        if (!flash_writer_write(context->writer, start_offset, chunk, chunk_length))
+        {
+            context->write_failed = true;
+            return false;
+        }
+    }
+    else if (AzureIoTPlatform_WriteBlock(context->image, start_offset, chunk, chunk_length) != eAzureIoTSuccess)
+    {
+        context->write_failed = true;
+        return false;
+    }
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef __ESP32_IOT_AZURE_TEST_ADU_FIXTURE_H__
+#define __ESP32_IOT_AZURE_TEST_ADU_FIXTURE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp32_iot_azure/extension/azure_iot_adu_extension.h"
+#include "infrastructure/flash_writer.h"
+#include "azure_iot_flash_platform.h"
+#include "http_server_stub.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define ADU_FIXTURE_FILE_URL "http://updates.bench.local/firmware.bin"
+#define ADU_FIXTURE_FILE_HOSTNAME "updates.bench.local"
+#define ADU_FIXTURE_FILE_PATH "/firmware.bin"
+
+#if CONFIG_IDF_TARGET_LINUX
+#define ADU_FIXTURE_IMAGE_SIZE (256U * 1024U)
+#else
+#define ADU_FIXTURE_IMAGE_SIZE (64U * 1024U)
+#endif
+
+    /**
+     * @brief Context of @ref adu_fixture_write_to_flash.
+     */
+    typedef struct
+    {
+        AzureADUImage_t *image; /** @brief Image written, when not through the writer. */
+        flash_writer_t *writer; /** @brief Flash writer to write through. Can be `NULL`. */
+        uint32_t stop_at;       /** @brief Offset to fail the download at, like a power loss; 0 to never fail. */
+        bool write_failed;      /** @brief Set if a write failed. */
+    } adu_fixture_download_context_t;
+
+    /**
+     * @brief Create a synthetic image of @ref ADU_FIXTURE_IMAGE_SIZE bytes.
+     * @note The image must be released with `free`.
+     * @param[out] hash_base64 Base64 SHA-256 of the image, as in an update manifest.
+     * @param[in] hash_base64_size Size of \p hash_base64.
+     * @return The image or null on failure.
+     */
+    uint8_t *adu_fixture_image_create(char *hash_base64, size_t hash_base64_size);
+
+    /**
+     * @brief Server configuration serving \p resource on a local network.
+     * @param[in] resource Image of @ref ADU_FIXTURE_IMAGE_SIZE bytes.
+     * @param[in] seed Seed of the simulated losses.
+     */
+    http_server_stub_config_t adu_fixture_server_config(const uint8_t *resource, uint32_t seed);
+
+    /**
+     * @brief Parse a file url, asserting it is valid.
+     * @param[in] url Null terminated url.
+     * @param[in] parse_buffer Buffer of at least `strlen(url) + 2` bytes.
+     * @param[out] parsed_url Url parsed.
+     */
+    void adu_fixture_parse_url(const char *url, uint8_t *parse_buffer, parsed_file_url_t *parsed_url);
+
+    /**
+     * @brief Download callback writing the image, see @ref adu_fixture_download_context_t.
+     */
+    bool adu_fixture_write_to_flash(uint8_t *chunk,
+                                    uint32_t chunk_length,
+                                    uint32_t start_offset,
+                                    uint32_t resource_size,
+                                    void *callback_context);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
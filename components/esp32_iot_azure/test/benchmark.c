@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "sdkconfig.h"
+#include "benchmark.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <malloc.h>
+
+static size_t HEAP_BASE = 0;
+static size_t HEAP_PEAK = 0;
+#else
+#include "esp_heap_caps.h"
+
+static size_t HEAP_BASE = 0;
+#endif
+
+static int compare_uint32(const void *a, const void *b);
+
+int64_t benchmark_time_us()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+void benchmark_samples_init(benchmark_samples_t *samples, size_t capacity)
+{
+    samples->values = (uint32_t *)malloc(capacity * sizeof(uint32_t));
+    samples->count = 0;
+    samples->capacity = capacity;
+}
+
+void benchmark_samples_add(benchmark_samples_t *samples, uint32_t value)
+{
+    if (samples->count < samples->capacity)
+    {
+        samples->values[samples->count++] = value;
+    }
+}
+
+uint32_t benchmark_samples_percentile(benchmark_samples_t *samples, uint8_t percentile)
+{
+    if (samples->count == 0)
+    {
+        return 0;
+    }
+
+    qsort(samples->values, samples->count, sizeof(uint32_t), compare_uint32);
+
+    size_t index = ((samples->count - 1) * percentile) / 100;
+
+    return samples->values[index];
+}
+
+void benchmark_samples_free(benchmark_samples_t *samples)
+{
+    free(samples->values);
+
+    samples->values = NULL;
+    samples->count = 0;
+    samples->capacity = 0;
+}
+
+#if CONFIG_IDF_TARGET_LINUX
+
+void benchmark_heap_start()
+{
+    HEAP_BASE = mallinfo2().uordblks;
+    HEAP_PEAK = HEAP_BASE;
+}
+
+void benchmark_heap_sample()
+{
+    size_t used = mallinfo2().uordblks;
+
+    if (used > HEAP_PEAK)
+    {
+        HEAP_PEAK = used;
+    }
+}
+
+size_t benchmark_heap_stop()
+{
+    benchmark_heap_sample();
+
+    return HEAP_PEAK - HEAP_BASE;
+}
+
+#else
+
+void benchmark_heap_start()
+{
+    HEAP_BASE = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+
+    heap_caps_monitor_local_minimum_free_size_start();
+}
+
+void benchmark_heap_sample()
+{
+}
+
+size_t benchmark_heap_stop()
+{
+    size_t minimum_free = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+
+    heap_caps_monitor_local_minimum_free_size_stop();
+
+    return minimum_free < HEAP_BASE ? HEAP_BASE - minimum_free : 0;
+}
+
+#endif
+
+void benchmark_report(const char *suite, const char *scenario, const char *metric, double value, const char *unit)
+{
+    printf("BENCH|%s|%s|%s|%.2f|%s\n", suite, scenario, metric, value, unit);
+}
+
+static int compare_uint32(const void *a, const void *b)
+{
+    uint32_t left = *(const uint32_t *)a;
+    uint32_t right = *(const uint32_t *)b;
+
+    return (left > right) - (left < right);
+}
@@ -0,0 +1,76 @@
+#ifndef __ESP32_IOT_AZURE_TEST_BENCHMARK_H__
+#define __ESP32_IOT_AZURE_TEST_BENCHMARK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Latency samples, in microseconds.
+     */
+    typedef struct
+    {
+        uint32_t *values; /** @brief Sample values. */
+        size_t count;     /** @brief Number of samples added. */
+        size_t capacity;  /** @brief Maximum number of samples. */
+    } benchmark_samples_t;
+
+    /**
+     * @brief Monotonic time, in microseconds.
+     */
+    int64_t benchmark_time_us();
+
+    /**
+     * @brief Allocate room for \p capacity samples.
+     * @note Must be released by @ref benchmark_samples_free.
+     */
+    void benchmark_samples_init(benchmark_samples_t *samples, size_t capacity);
+
+    /**
+     * @brief Add a sample. Samples beyond the capacity are dropped.
+     */
+    void benchmark_samples_add(benchmark_samples_t *samples, uint32_t value);
+
+    /**
+     * @brief Get the \p percentile (0-100) of the samples.
+     * @note Sorts the samples in place.
+     * @return The percentile value or 0 if there are no samples.
+     */
+    uint32_t benchmark_samples_percentile(benchmark_samples_t *samples, uint8_t percentile);
+
+    /**
+     * @brief Release the samples.
+     */
+    void benchmark_samples_free(benchmark_samples_t *samples);
+
+    /**
+     * @brief Start tracking the heap high-water mark.
+     */
+    void benchmark_heap_start();
+
+    /**
+     * @brief Sample the heap usage.
+     * @note Only needed on the Linux host: the device tracks the high-water mark by itself.
+     */
+    void benchmark_heap_sample();
+
+    /**
+     * @brief Stop tracking the heap high-water mark.
+     * @return Peak bytes allocated since @ref benchmark_heap_start.
+     */
+    size_t benchmark_heap_stop();
+
+    /**
+     * @brief Print a result in a machine friendly format:
+     * `BENCH|<suite>|<scenario>|<metric>|<value>|<unit>`
+     */
+    void benchmark_report(const char *suite, const char *scenario, const char *metric, double value, const char *unit);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
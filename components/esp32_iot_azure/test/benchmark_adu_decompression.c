@@ -0,0 +1,73 @@
+#include "config.h"
+
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DU_ENABLED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "infrastructure/image_decompressor.h"
+#include "benchmark.h"
+#include "image_fixture.h"
+
+#define BENCH_SUITE "adu_decompression"
+
+static const uint16_t BENCH_BLOCK_SIZES[] = {1024, 4096};
+
+TEST_CASE("Benchmark image decompression", "[benchmark][adu]")
+{
+    uint8_t *image = image_fixture_firmware_create();
+    uint32_t compressed_size;
+
+    TEST_ASSERT_NOT_NULL(image);
+
+    uint8_t *compressed = image_fixture_compress(image, IMAGE_FIXTURE_FIRMWARE_SIZE, &compressed_size);
+
+    TEST_ASSERT_NOT_NULL(compressed);
+
+    benchmark_report(BENCH_SUITE, "image", "ratio", (double)IMAGE_FIXTURE_FIRMWARE_SIZE / compressed_size, "x");
+    benchmark_report(BENCH_SUITE, "image", "window", 1U << IMAGE_FIXTURE_WINDOW_BITS, "bytes");
+
+    for (size_t b = 0; b < sizeof(BENCH_BLOCK_SIZES) / sizeof(BENCH_BLOCK_SIZES[0]); b++)
+    {
+        image_fixture_decompression_context_t context = {.expected = image, .next_offset = 0, .block_size = BENCH_BLOCK_SIZES[b], .mismatch = false};
+        char scenario[32];
+
+        snprintf(scenario, sizeof(scenario), "block_%u", BENCH_BLOCK_SIZES[b]);
+
+        benchmark_heap_start();
+
+        int64_t started_at = benchmark_time_us();
+        image_decompressor_t *decompressor = image_decompressor_create(IMAGE_FIXTURE_WINDOW_BITS, IMAGE_FIXTURE_LOOKAHEAD_BITS, context.block_size, &image_fixture_decompression_compare, &context);
+
+        TEST_ASSERT_NOT_NULL(decompressor);
+
+        // Fed as a download would: one chunk of the block size at a time.
+        for (uint32_t offset = 0; offset < compressed_size; offset += context.block_size)
+        {
+            uint32_t length = compressed_size - offset < context.block_size ? compressed_size - offset : context.block_size;
+
+            TEST_ASSERT_TRUE(image_decompressor_write(decompressor, compressed + offset, length));
+            benchmark_heap_sample();
+        }
+
+        TEST_ASSERT_TRUE(image_decompressor_finish(decompressor));
+
+        double elapsed_s = (double)(benchmark_time_us() - started_at) / 1000000.0;
+
+        image_decompressor_free(decompressor);
+
+        size_t heap_peak = benchmark_heap_stop();
+
+        TEST_ASSERT_FALSE(context.mismatch);
+        TEST_ASSERT_EQUAL_UINT32(IMAGE_FIXTURE_FIRMWARE_SIZE, context.next_offset);
+
+        benchmark_report(BENCH_SUITE, scenario, "throughput", IMAGE_FIXTURE_FIRMWARE_SIZE / elapsed_s / 1024.0, "KiB/s");
+        benchmark_report(BENCH_SUITE, scenario, "heap_peak", heap_peak, "bytes");
+    }
+
+    free(compressed);
+    free(image);
+}
+
+#endif
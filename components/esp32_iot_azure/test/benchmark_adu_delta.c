@@ -0,0 +1,69 @@
+#include "config.h"
+
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DU_ENABLED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "infrastructure/image_patcher.h"
+#include "benchmark.h"
+#include "image_fixture.h"
+
+#define BENCH_SUITE "adu_delta"
+
+static const uint16_t BENCH_BLOCK_SIZES[] = {1024, 4096};
+
+TEST_CASE("Benchmark delta image rebuild", "[benchmark][adu]")
+{
+    uint8_t *old_image;
+    uint8_t *new_image;
+
+    image_fixture_delta_create(&old_image, &new_image);
+
+    TEST_ASSERT_NOT_NULL(old_image);
+    TEST_ASSERT_NOT_NULL(new_image);
+
+    image_fixture_patch_t patch = image_fixture_patch_create(old_image, new_image);
+
+    TEST_ASSERT_NOT_NULL(patch.buffer);
+
+    for (size_t b = 0; b < sizeof(BENCH_BLOCK_SIZES) / sizeof(BENCH_BLOCK_SIZES[0]); b++)
+    {
+        image_fixture_patch_context_t context = {.old_image = old_image, .expected = new_image, .next_offset = 0, .mismatch = false};
+        uint32_t block_size = BENCH_BLOCK_SIZES[b];
+        char scenario[32];
+
+        snprintf(scenario, sizeof(scenario), "block_%lu", (unsigned long)block_size);
+
+        int64_t started_at = benchmark_time_us();
+        image_patcher_t *patcher = image_patcher_create(block_size, &image_fixture_patch_read, &image_fixture_patch_compare, &context);
+
+        TEST_ASSERT_NOT_NULL(patcher);
+
+        // Fed as a download would: one chunk of the block size at a time.
+        for (uint32_t offset = 0; offset < patch.length; offset += block_size)
+        {
+            uint32_t length = patch.length - offset < block_size ? patch.length - offset : block_size;
+
+            TEST_ASSERT_TRUE(image_patcher_write(patcher, patch.buffer + offset, length));
+        }
+
+        TEST_ASSERT_TRUE(image_patcher_finish(patcher));
+
+        double elapsed_s = (double)(benchmark_time_us() - started_at) / 1000000.0;
+
+        image_patcher_free(patcher);
+
+        TEST_ASSERT_FALSE(context.mismatch);
+        TEST_ASSERT_EQUAL_UINT32(IMAGE_FIXTURE_DELTA_NEW_SIZE, context.next_offset);
+
+        benchmark_report(BENCH_SUITE, scenario, "throughput", IMAGE_FIXTURE_DELTA_NEW_SIZE / elapsed_s / 1024.0, "KiB/s");
+    }
+
+    free(patch.buffer);
+    free(new_image);
+    free(old_image);
+}
+
+#endif
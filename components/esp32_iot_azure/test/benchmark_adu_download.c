@@ -0,0 +1,487 @@
+#include "config.h"
+
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DU_ENABLED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_adu_workflow.h"
+#include "esp32_iot_azure/azure_iot_sdk.h"
+#include "esp32_iot_azure/extension/azure_iot_adu_extension.h"
+#include "infrastructure/transport.h"
+#include "infrastructure/flash_writer.h"
+#include "azure_iot_flash_platform.h"
+#include "benchmark.h"
+#include "adu_fixture.h"
+#include "http_server_stub.h"
+
+#define BENCH_SUITE "adu_download"
+#define BENCH_PIPELINE_CHUNK_SIZE 4096U
+#define BENCH_HANDSHAKE_US 150000U
+#define BENCH_RESUMED_HANDSHAKE_US 15000U
+
+// Pipeline depth standing for the single request streaming.
+#define BENCH_STREAMED 0U
+
+typedef struct
+{
+    const char *name;
+    uint32_t latency_us;
+    uint32_t bandwidth_bytes_per_s;
+    uint8_t loss_percent;
+    uint32_t reset_every_requests;
+    uint32_t close_every_requests;
+} bench_network_t;
+
+typedef struct
+{
+    const uint8_t *resource;
+    uint32_t next_offset;
+    bool mismatch;
+} bench_pipeline_context_t;
+
+static const uint16_t BENCH_CHUNK_SIZES[] = {1024, 4096, 16384};
+static const uint8_t BENCH_PIPELINE_DEPTHS[] = {1, 2, 4, 8};
+
+static const bench_network_t BENCH_NETWORKS[] = {
+    {.name = "local", .latency_us = 0, .bandwidth_bytes_per_s = 0, .loss_percent = 0, .reset_every_requests = 0, .close_every_requests = 0},
+    {.name = "wifi", .latency_us = 5000, .bandwidth_bytes_per_s = 2 * 1024 * 1024, .loss_percent = 0, .reset_every_requests = 0, .close_every_requests = 0},
+    {.name = "cellular", .latency_us = 60000, .bandwidth_bytes_per_s = 256 * 1024, .loss_percent = 2, .reset_every_requests = 0, .close_every_requests = 0},
+    {.name = "flaky", .latency_us = 5000, .bandwidth_bytes_per_s = 2 * 1024 * 1024, .loss_percent = 0, .reset_every_requests = 25, .close_every_requests = 0},
+    {.name = "closing", .latency_us = 5000, .bandwidth_bytes_per_s = 2 * 1024 * 1024, .loss_percent = 0, .reset_every_requests = 0, .close_every_requests = 8},
+};
+
+static http_server_stub_config_t bench_server_config(const bench_network_t *network, const uint8_t *resource, uint32_t seed);
+static void bench_download_run(const bench_network_t *network, uint16_t chunk_size, bool use_writer, const uint8_t *resource, const char *hash_base64);
+static void bench_pipeline_run(const bench_network_t *network, uint8_t pipeline_depth, const uint8_t *resource);
+static void bench_tls_run(const bench_network_t *network, bool session_tickets, const uint8_t *resource);
+static bool bench_download_write_to_flash(uint8_t *chunk, uint32_t chunk_length, uint32_t start_offset, uint32_t resource_size, void *callback_context);
+static bool bench_pipeline_compare(uint8_t *chunk, uint32_t chunk_length, uint32_t start_offset, uint32_t resource_size, void *callback_context);
+
+TEST_CASE("Benchmark ADU download and enable", "[benchmark][adu][http]")
+{
+    char hash_base64[64];
+    uint8_t *image = adu_fixture_image_create(hash_base64, sizeof(hash_base64));
+
+    TEST_ASSERT_NOT_NULL(image);
+
+    for (size_t n = 0; n < sizeof(BENCH_NETWORKS) / sizeof(BENCH_NETWORKS[0]); n++)
+    {
+        for (size_t c = 0; c < sizeof(BENCH_CHUNK_SIZES) / sizeof(BENCH_CHUNK_SIZES[0]); c++)
+        {
+            bench_download_run(&BENCH_NETWORKS[n], BENCH_CHUNK_SIZES[c], false, image, hash_base64);
+        }
+    }
+
+    free(image);
+}
+
+TEST_CASE("Benchmark ADU download and enable through the flash writer", "[benchmark][adu][http]")
+{
+    char hash_base64[64];
+    uint8_t *image = adu_fixture_image_create(hash_base64, sizeof(hash_base64));
+
+    TEST_ASSERT_NOT_NULL(image);
+
+    for (size_t n = 0; n < sizeof(BENCH_NETWORKS) / sizeof(BENCH_NETWORKS[0]); n++)
+    {
+        for (size_t c = 0; c < sizeof(BENCH_CHUNK_SIZES) / sizeof(BENCH_CHUNK_SIZES[0]); c++)
+        {
+            bench_download_run(&BENCH_NETWORKS[n], BENCH_CHUNK_SIZES[c], true, image, hash_base64);
+        }
+    }
+
+    free(image);
+}
+
+TEST_CASE("Benchmark pipelined range download", "[benchmark][adu][http]")
+{
+    char hash_base64[64];
+    uint8_t *image = adu_fixture_image_create(hash_base64, sizeof(hash_base64));
+
+    TEST_ASSERT_NOT_NULL(image);
+
+    for (size_t n = 0; n < sizeof(BENCH_NETWORKS) / sizeof(BENCH_NETWORKS[0]); n++)
+    {
+        for (size_t d = 0; d < sizeof(BENCH_PIPELINE_DEPTHS) / sizeof(BENCH_PIPELINE_DEPTHS[0]); d++)
+        {
+            bench_pipeline_run(&BENCH_NETWORKS[n], BENCH_PIPELINE_DEPTHS[d], image);
+        }
+    }
+
+    free(image);
+}
+
+TEST_CASE("Benchmark streamed download", "[benchmark][adu][http]")
+{
+    char hash_base64[64];
+    uint8_t *image = adu_fixture_image_create(hash_base64, sizeof(hash_base64));
+
+    TEST_ASSERT_NOT_NULL(image);
+
+    for (size_t n = 0; n < sizeof(BENCH_NETWORKS) / sizeof(BENCH_NETWORKS[0]); n++)
+    {
+        bench_pipeline_run(&BENCH_NETWORKS[n], BENCH_STREAMED, image);
+    }
+
+    free(image);
+}
+
+TEST_CASE("Benchmark HTTPS download with TLS session resumption", "[benchmark][adu][http]")
+{
+    char hash_base64[64];
+    uint8_t *image = adu_fixture_image_create(hash_base64, sizeof(hash_base64));
+
+    TEST_ASSERT_NOT_NULL(image);
+
+    for (size_t n = 0; n < sizeof(BENCH_NETWORKS) / sizeof(BENCH_NETWORKS[0]); n++)
+    {
+        // Only the networks with reconnections tell the difference.
+        if (BENCH_NETWORKS[n].reset_every_requests == 0 && BENCH_NETWORKS[n].close_every_requests == 0)
+        {
+            continue;
+        }
+
+        bench_tls_run(&BENCH_NETWORKS[n], false, image);
+        bench_tls_run(&BENCH_NETWORKS[n], true, image);
+    }
+
+    free(image);
+}
+
+static http_server_stub_config_t bench_server_config(const bench_network_t *network, const uint8_t *resource, uint32_t seed)
+{
+    http_server_stub_config_t config = adu_fixture_server_config(resource, seed);
+
+    config.latency_us = network->latency_us;
+    config.bandwidth_bytes_per_s = network->bandwidth_bytes_per_s;
+    config.loss_percent = network->loss_percent;
+    config.reset_every_requests = network->reset_every_requests;
+    config.close_every_requests = network->close_every_requests;
+
+    return config;
+}
+
+// Same steps as azure_adu_workflow_accept_update once the update is accepted:
+// the workflow itself needs a manifest signed by the Device Update root keys.
+static void bench_download_run(const bench_network_t *network, uint16_t chunk_size, bool use_writer, const uint8_t *resource, const char *hash_base64)
+{
+    char scenario[48];
+    uint8_t parse_buffer[sizeof(ADU_FIXTURE_FILE_URL) + 2];
+    uint32_t download_buffer_length = chunk_size + ADU_WORKFLOW_DOWNLOAD_BUFFER_EXTRA_BYTES;
+    uint8_t *download_buffer = (uint8_t *)malloc(download_buffer_length);
+    AzureADUImage_t image;
+    parsed_file_url_t parsed_url;
+    azure_http_statistics_t http_statistics;
+    AzureIoTADUUpdateManifestFileUrl_t file_url = {
+        .pucFileID = (uint8_t *)"bench",
+        .ulFileIDLength = sizeof("bench") - 1,
+        .pucUrl = (uint8_t *)ADU_FIXTURE_FILE_URL,
+        .ulUrlLength = sizeof(ADU_FIXTURE_FILE_URL) - 1};
+    http_server_stub_config_t config = bench_server_config(network, resource, chunk_size);
+
+    memset(&image, 0, sizeof(image));
+    snprintf(scenario, sizeof(scenario), "%s_%ub%s", network->name, chunk_size, use_writer ? "_writer" : "");
+
+    TEST_ASSERT_NOT_NULL(download_buffer);
+
+    if (AzureIoTPlatform_Init(&image) != eAzureIoTSuccess)
+    {
+        free(download_buffer);
+        TEST_IGNORE_MESSAGE("needs an OTA partition table");
+    }
+
+    http_server_stub_t *server = http_server_stub_create(&config);
+    adu_fixture_download_context_t download_context = {
+        .image = &image,
+        .writer = NULL,
+        .stop_at = 0,
+        .write_failed = false};
+
+    transport_set_driver(http_server_stub_get_driver(server));
+
+    benchmark_heap_start();
+
+    int64_t started_at = benchmark_time_us();
+
+    if (use_writer)
+    {
+        download_context.writer = flash_writer_create(&image, chunk_size, CONFIG_ESP32_IOT_AZURE_DU_FLASH_WRITER_BUFFERS);
+
+        TEST_ASSERT_NOT_NULL(download_context.writer);
+    }
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_adu_file_parse_url(&file_url, parse_buffer, &parsed_url));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_adu_file_download(&parsed_url,
+                                                                download_buffer,
+                                                                download_buffer_length,
+                                                                chunk_size,
+                                                                bench_download_write_to_flash,
+                                                                &download_context,
+                                                                0,
+                                                                &image.image_size,
+                                                                &http_statistics));
+
+    flash_writer_statistics_t writer_statistics = {0};
+
+    if (download_context.writer != NULL)
+    {
+        TEST_ASSERT_TRUE(flash_writer_flush(download_context.writer));
+
+        writer_statistics = *flash_writer_get_statistics(download_context.writer);
+
+        flash_writer_free(download_context.writer);
+    }
+
+    int64_t downloaded_at = benchmark_time_us();
+
+    TEST_ASSERT_FALSE(download_context.write_failed);
+    TEST_ASSERT_EQUAL_UINT32(ADU_FIXTURE_IMAGE_SIZE, image.image_size);
+#if CONFIG_IDF_TARGET_LINUX
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, AzureIoTPlatform_VerifyImage(&image, (uint8_t *)hash_base64, strlen(hash_base64)));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, AzureIoTPlatform_EnableImage(&image));
+#else
+    // The synthetic image is not a valid application: the device
+    // would reject it on verification, so only the download is measured.
+    esp_ota_abort(image.ota);
+#endif
+
+    int64_t enabled_at = benchmark_time_us();
+    size_t heap_peak = benchmark_heap_stop();
+
+    const http_server_stub_stats_t *stats = http_server_stub_get_stats(server);
+
+    benchmark_report(BENCH_SUITE, scenario, "throughput", ADU_FIXTURE_IMAGE_SIZE / ((double)(downloaded_at - started_at) / 1000000.0), "B/s");
+    TEST_ASSERT_EQUAL_UINT32(stats->requests, http_statistics.requests);
+
+    // The server count includes the reconnections done by the transport itself.
+    benchmark_report(BENCH_SUITE, scenario, "requests", http_statistics.requests, "req");
+    benchmark_report(BENCH_SUITE, scenario, "reconnects", stats->connections - 1, "conn");
+    benchmark_report(BENCH_SUITE, scenario, "resets", stats->resets, "conn");
+    benchmark_report(BENCH_SUITE, scenario, "losses", stats->losses, "resp");
+    benchmark_report(BENCH_SUITE, scenario, "download", (double)(downloaded_at - started_at) / 1000.0, "ms");
+    benchmark_report(BENCH_SUITE, scenario, "verify_and_enable", (double)(enabled_at - downloaded_at) / 1000.0, "ms");
+    benchmark_report(BENCH_SUITE, scenario, "time_to_enable", (double)(enabled_at - started_at) / 1000.0, "ms");
+    benchmark_report(BENCH_SUITE, scenario, "heap_peak", (double)heap_peak, "B");
+
+    if (use_writer)
+    {
+        benchmark_report(BENCH_SUITE, scenario, "flash_write", writer_statistics.flash_write_ms, "ms");
+        benchmark_report(BENCH_SUITE, scenario, "writer_stalled", writer_statistics.stalled_ms, "ms");
+    }
+
+    transport_set_driver(NULL);
+
+    http_server_stub_free(server);
+    free(download_buffer);
+}
+
+static void bench_pipeline_run(const bench_network_t *network, uint8_t pipeline_depth, const uint8_t *resource)
+{
+    char scenario[48];
+    uint32_t resource_size = 0;
+    uint32_t download_buffer_length = BENCH_PIPELINE_CHUNK_SIZE + ADU_WORKFLOW_DOWNLOAD_BUFFER_EXTRA_BYTES;
+    char *download_buffer = (char *)malloc(download_buffer_length);
+    http_server_stub_config_t config = bench_server_config(network, resource, pipeline_depth);
+    bench_pipeline_context_t pipeline_context = {
+        .resource = resource,
+        .next_offset = 0,
+        .mismatch = false};
+
+    if (pipeline_depth == BENCH_STREAMED)
+    {
+        snprintf(scenario, sizeof(scenario), "%s_streamed", network->name);
+    }
+    else
+    {
+        snprintf(scenario, sizeof(scenario), "%s_depth%u", network->name, pipeline_depth);
+    }
+
+    TEST_ASSERT_NOT_NULL(download_buffer);
+
+    http_server_stub_t *server = http_server_stub_create(&config);
+
+    transport_set_driver(http_server_stub_get_driver(server));
+
+    azure_http_context_t *http = azure_http_create(ADU_FIXTURE_FILE_HOSTNAME,
+                                                   sizeof(ADU_FIXTURE_FILE_HOSTNAME) - 1,
+                                                   ADU_FIXTURE_FILE_PATH,
+                                                   sizeof(ADU_FIXTURE_FILE_PATH) - 1,
+                                                   80,
+                                                   false);
+
+    TEST_ASSERT_NOT_NULL(http);
+    TEST_ASSERT_EQUAL(eAzureIoTHTTPSuccess, azure_http_connect(http));
+    TEST_ASSERT_EQUAL(eAzureIoTHTTPSuccess, azure_http_get_resource_size(http, download_buffer, download_buffer_length, &resource_size));
+    TEST_ASSERT_EQUAL_UINT32(ADU_FIXTURE_IMAGE_SIZE, resource_size);
+
+    benchmark_heap_start();
+
+    int64_t started_at = benchmark_time_us();
+
+    if (pipeline_depth == BENCH_STREAMED)
+    {
+        TEST_ASSERT_EQUAL(eAzureIoTHTTPSuccess, azure_http_download_resource_streamed(http,
+                                                                                      download_buffer,
+                                                                                      download_buffer_length,
+                                                                                      BENCH_PIPELINE_CHUNK_SIZE,
+                                                                                      bench_pipeline_compare,
+                                                                                      &pipeline_context,
+                                                                                      0,
+                                                                                      resource_size));
+    }
+    else
+    {
+        TEST_ASSERT_EQUAL(eAzureIoTHTTPSuccess, azure_http_download_resource_pipelined(http,
+                                                                                       download_buffer,
+                                                                                       download_buffer_length,
+                                                                                       BENCH_PIPELINE_CHUNK_SIZE,
+                                                                                       pipeline_depth,
+                                                                                       bench_pipeline_compare,
+                                                                                       &pipeline_context,
+                                                                                       0,
+                                                                                       resource_size));
+    }
+
+    int64_t downloaded_at = benchmark_time_us();
+    size_t heap_peak = benchmark_heap_stop();
+
+    TEST_ASSERT_FALSE(pipeline_context.mismatch);
+    TEST_ASSERT_EQUAL_UINT32(ADU_FIXTURE_IMAGE_SIZE, pipeline_context.next_offset);
+
+    const http_server_stub_stats_t *stats = http_server_stub_get_stats(server);
+
+    benchmark_report(BENCH_SUITE, scenario, "throughput", ADU_FIXTURE_IMAGE_SIZE / ((double)(downloaded_at - started_at) / 1000000.0), "B/s");
+    benchmark_report(BENCH_SUITE, scenario, "requests", azure_http_get_statistics(http)->requests, "req");
+    benchmark_report(BENCH_SUITE, scenario, "reconnects", stats->connections - 1, "conn");
+    benchmark_report(BENCH_SUITE, scenario, "download", (double)(downloaded_at - started_at) / 1000.0, "ms");
+    benchmark_report(BENCH_SUITE, scenario, "heap_peak", (double)heap_peak, "B");
+
+    azure_http_disconnect(http);
+    azure_http_free(http);
+
+    transport_set_driver(NULL);
+
+    http_server_stub_free(server);
+    free(download_buffer);
+}
+
+// Same steps as azure_adu_file_download over HTTPS, with the server
+// issuing session tickets or not: every reconnection pays a handshake.
+static void bench_tls_run(const bench_network_t *network, bool session_tickets, const uint8_t *resource)
+{
+    char scenario[48];
+    uint32_t resource_size = 0;
+    uint32_t download_buffer_length = BENCH_PIPELINE_CHUNK_SIZE + ADU_WORKFLOW_DOWNLOAD_BUFFER_EXTRA_BYTES;
+    char *download_buffer = (char *)malloc(download_buffer_length);
+    http_server_stub_config_t config = bench_server_config(network, resource, 0);
+    bench_pipeline_context_t pipeline_context = {
+        .resource = resource,
+        .next_offset = 0,
+        .mismatch = false};
+
+    config.handshake_us = BENCH_HANDSHAKE_US;
+    config.resumed_handshake_us = BENCH_RESUMED_HANDSHAKE_US;
+    config.session_tickets = session_tickets;
+
+    snprintf(scenario, sizeof(scenario), "%s_tls_%s", network->name, session_tickets ? "resumed" : "full");
+
+    TEST_ASSERT_NOT_NULL(download_buffer);
+
+    http_server_stub_t *server = http_server_stub_create(&config);
+
+    transport_set_driver(http_server_stub_get_driver(server));
+
+    // The trust store and the TLS session cache.
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_sdk_init());
+
+    int64_t started_at = benchmark_time_us();
+    azure_http_context_t *http = azure_http_create(ADU_FIXTURE_FILE_HOSTNAME,
+                                                   sizeof(ADU_FIXTURE_FILE_HOSTNAME) - 1,
+                                                   ADU_FIXTURE_FILE_PATH,
+                                                   sizeof(ADU_FIXTURE_FILE_PATH) - 1,
+                                                   443,
+                                                   true);
+
+    TEST_ASSERT_NOT_NULL(http);
+    TEST_ASSERT_EQUAL(eAzureIoTHTTPSuccess, azure_http_connect(http));
+    TEST_ASSERT_EQUAL(eAzureIoTHTTPSuccess, azure_http_get_resource_size(http, download_buffer, download_buffer_length, &resource_size));
+    TEST_ASSERT_EQUAL(eAzureIoTHTTPSuccess, azure_http_download_resource(http,
+                                                                         download_buffer,
+                                                                         download_buffer_length,
+                                                                         BENCH_PIPELINE_CHUNK_SIZE,
+                                                                         bench_pipeline_compare,
+                                                                         &pipeline_context,
+                                                                         0,
+                                                                         resource_size));
+
+    int64_t downloaded_at = benchmark_time_us();
+    const http_server_stub_stats_t *stats = http_server_stub_get_stats(server);
+    azure_iot_tls_statistics_t tls_statistics;
+
+    azure_iot_sdk_get_tls_statistics(&tls_statistics);
+
+    TEST_ASSERT_FALSE(pipeline_context.mismatch);
+    TEST_ASSERT_EQUAL_UINT32(ADU_FIXTURE_IMAGE_SIZE, pipeline_context.next_offset);
+    TEST_ASSERT_TRUE(stats->connections > 1);
+    TEST_ASSERT_EQUAL_UINT32(stats->connections, stats->handshakes + stats->resumptions);
+    TEST_ASSERT_EQUAL_UINT32(stats->handshakes, tls_statistics.full_handshakes);
+    TEST_ASSERT_EQUAL_UINT32(stats->resumptions, tls_statistics.resumed_handshakes);
+
+    if (session_tickets && CONFIG_ESP32_IOT_AZURE_TRANSPORT_TLS_SESSION_REUSE)
+    {
+        // Only the first connection pays the full handshake.
+        TEST_ASSERT_EQUAL_UINT32(1, stats->handshakes);
+    }
+
+    benchmark_report(BENCH_SUITE, scenario, "throughput", ADU_FIXTURE_IMAGE_SIZE / ((double)(downloaded_at - started_at) / 1000000.0), "B/s");
+    benchmark_report(BENCH_SUITE, scenario, "reconnects", stats->connections - 1, "conn");
+    benchmark_report(BENCH_SUITE, scenario, "handshakes", stats->handshakes, "conn");
+    benchmark_report(BENCH_SUITE, scenario, "resumptions", stats->resumptions, "conn");
+    benchmark_report(BENCH_SUITE, scenario, "download", (double)(downloaded_at - started_at) / 1000.0, "ms");
+
+    azure_http_disconnect(http);
+    azure_http_free(http);
+    azure_iot_sdk_deinit();
+
+    transport_set_driver(NULL);
+
+    http_server_stub_free(server);
+    free(download_buffer);
+}
+
+static bool bench_download_write_to_flash(uint8_t *chunk,
+                                          uint32_t chunk_length,
+                                          uint32_t start_offset,
+                                          uint32_t resource_size,
+                                          void *callback_context)
+{
+    benchmark_heap_sample();
+
+    return adu_fixture_write_to_flash(chunk, chunk_length, start_offset, resource_size, callback_context);
+}
+
+static bool bench_pipeline_compare(uint8_t *chunk,
+                                   uint32_t chunk_length,
+                                   uint32_t start_offset,
+                                   uint32_t resource_size,
+                                   void *callback_context)
+{
+    bench_pipeline_context_t *context = (bench_pipeline_context_t *)callback_context;
+
+    benchmark_heap_sample();
+
+    // Chunks must arrive in order, whatever the pipeline depth.
+    if (start_offset != context->next_offset || memcmp(chunk, context->resource + start_offset, chunk_length) != 0)
+    {
+        context->mismatch = true;
+        return false;
+    }
+
+    context->next_offset += chunk_length;
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_sdk.h"
+#include "infrastructure/transport.h"
+#include "benchmark.h"
+#include "mqtt_broker_stub.h"
+
+#define BENCH_SUITE "certificate"
+#define BENCH_TRANSPORT_COUNT 50U
+
+TEST_CASE("Benchmark Azure transport creation with the shared trust store", "[benchmark][certificate]")
+{
+    mqtt_broker_stub_t *broker = mqtt_broker_stub_create(0);
+    transport_t *transports[BENCH_TRANSPORT_COUNT];
+    benchmark_samples_t latencies;
+
+    transport_set_driver(mqtt_broker_stub_get_driver(broker));
+    benchmark_samples_init(&latencies, BENCH_TRANSPORT_COUNT);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_sdk_init());
+
+    // The first transport parses the roots; the next ones share them.
+    for (size_t i = 0; i < BENCH_TRANSPORT_COUNT; i++)
+    {
+        int64_t started_at = benchmark_time_us();
+
+        transports[i] = transport_create_azure();
+
+        benchmark_samples_add(&latencies, (uint32_t)(benchmark_time_us() - started_at));
+
+        TEST_ASSERT_NOT_NULL(transports[i]);
+    }
+
+    benchmark_report(BENCH_SUITE, "azure_transport", "first", latencies.values[0], "us");
+    benchmark_report(BENCH_SUITE, "azure_transport", "p50", benchmark_samples_percentile(&latencies, 50), "us");
+    benchmark_report(BENCH_SUITE, "azure_transport", "p99", benchmark_samples_percentile(&latencies, 99), "us");
+
+    for (size_t i = 0; i < BENCH_TRANSPORT_COUNT; i++)
+    {
+        transport_free(transports[i]);
+    }
+
+    azure_iot_sdk_deinit();
+
+    transport_set_driver(NULL);
+
+    benchmark_samples_free(&latencies);
+    mqtt_broker_stub_free(broker);
+}
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_sdk.h"
+#include "infrastructure/crypto.h"
+#include "benchmark.h"
+
+#define BENCH_SUITE "crypto"
+#define BENCH_SIGN_COUNT 500U
+
+// Shape of a SAS token string to sign: "<resource uri>\n<expiry>".
+#define BENCH_SAS_STRING "bench.azure-devices.net%2Fdevices%2Fbench-device\n1700000000"
+
+static const uint8_t BENCH_DEVICE_KEY[32] = {
+    0x1f, 0x2e, 0x3d, 0x4c, 0x5b, 0x6a, 0x79, 0x88, 0x97, 0xa6, 0xb5, 0xc4, 0xd3, 0xe2, 0xf1, 0x00,
+    0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78, 0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0};
+
+static void bench_sign_run(const char *scenario, bool cached);
+
+TEST_CASE("Benchmark SAS token signing", "[benchmark][crypto]")
+{
+    bench_sign_run("uncached", false);
+    bench_sign_run("cached", true);
+}
+
+static void bench_sign_run(const char *scenario, bool cached)
+{
+    benchmark_samples_t cycles;
+    crypto_statistics_t statistics;
+    uint8_t output[33];
+    uint32_t bytes_copied;
+
+    benchmark_samples_init(&cycles, BENCH_SIGN_COUNT);
+
+    if (cached)
+    {
+        TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_sdk_init());
+    }
+
+    int64_t started_at = benchmark_time_us();
+
+    for (uint32_t i = 0; i < BENCH_SIGN_COUNT; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(0, crypto_hash_hmac_256(BENCH_DEVICE_KEY,
+                                                         sizeof(BENCH_DEVICE_KEY),
+                                                         (const uint8_t *)BENCH_SAS_STRING,
+                                                         sizeof(BENCH_SAS_STRING) - 1,
+                                                         output,
+                                                         sizeof(output),
+                                                         &bytes_copied));
+
+        crypto_get_statistics(&statistics);
+        benchmark_samples_add(&cycles, statistics.hmac_last_cycles);
+    }
+
+    double elapsed_s = (double)(benchmark_time_us() - started_at) / 1000000.0;
+
+    benchmark_report(BENCH_SUITE, scenario, "signs_per_s", BENCH_SIGN_COUNT / elapsed_s, "op/s");
+    benchmark_report(BENCH_SUITE, scenario, "cycles_p50", benchmark_samples_percentile(&cycles, 50), "cycles");
+    benchmark_report(BENCH_SUITE, scenario, "cycles_p99", benchmark_samples_percentile(&cycles, 99), "cycles");
+    benchmark_report(BENCH_SUITE, scenario, "hardware", statistics.hardware ? 1 : 0, "bool");
+
+    if (cached)
+    {
+        azure_iot_sdk_deinit();
+    }
+
+    benchmark_samples_free(&cycles);
+}
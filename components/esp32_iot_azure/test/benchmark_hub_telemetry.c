@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_hub.h"
+#include "esp32_iot_azure/azure_iot_sdk.h"
+#include "esp32_iot_azure/azure_iot_hub_task.h"
+#include "esp32_iot_azure/azure_iot_telemetry_batch.h"
+#include "esp32_iot_azure/extension/azure_iot_hub_extension.h"
+#include "infrastructure/transport.h"
+#include "benchmark.h"
+#include "hub_fixture.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "config.h"
+
+#define BENCH_SUITE "hub_telemetry"
+#define BENCH_MESSAGE_COUNT 200U
+#define BENCH_BROKER_RESPONSE_DELAY_US 0U
+#define BENCH_SAMPLE "{\"temperature\":21.5,\"humidity\":40}"
+#define BENCH_EVENTS_MAX_WAIT_MS 5000U
+#define BENCH_COMMAND_COUNT 50U
+
+// Leaves room on the MQTT state array for twin and command packets.
+#define BENCH_QOS1_WINDOW (CONFIG_ESP32_IOT_AZURE_TRANSPORT_MQTT_STATE_ARRAY_MAX_COUNT - 2U)
+
+typedef struct
+{
+    uint16_t packet_id;
+    int64_t sent_at_us;
+} bench_in_flight_t;
+
+typedef struct
+{
+    azure_iot_hub_context_t *hub;
+    int64_t invoked_at_us;
+    uint32_t latency_us;
+    uint32_t received;
+} bench_command_t;
+
+static const uint32_t BENCH_PAYLOAD_SIZES[] = {32, 256, 1024, 4096};
+// 0: one message per sample, without batching.
+static const uint32_t BENCH_BATCH_SIZES[] = {0, 512, 4096};
+
+static bench_in_flight_t IN_FLIGHT[CONFIG_ESP32_IOT_AZURE_TRANSPORT_MQTT_STATE_ARRAY_MAX_COUNT];
+static size_t IN_FLIGHT_COUNT = 0;
+static benchmark_samples_t PUBACK_LATENCIES;
+
+static void bench_telemetry_run(AzureIoTHubMessageQoS_t qos, uint32_t payload_size);
+static void bench_telemetry_batch_run(uint32_t batch_size);
+static void bench_telemetry_window_run(uint32_t payload_size);
+static void bench_drain_in_flight(hub_fixture_t *bench, size_t max_in_flight);
+static void on_telemetry_ack(uint16_t packet_id);
+static void bench_hub_task_wait_sent(azure_iot_hub_task_t *task, uint32_t sent);
+static void on_command_timed(AzureIoTHubClientCommandRequest_t *request, void *context);
+
+TEST_CASE("Benchmark telemetry throughput with QoS 0", "[benchmark][hub][mqtt]")
+{
+    for (size_t i = 0; i < sizeof(BENCH_PAYLOAD_SIZES) / sizeof(BENCH_PAYLOAD_SIZES[0]); i++)
+    {
+        bench_telemetry_run(eAzureIoTHubMessageQoS0, BENCH_PAYLOAD_SIZES[i]);
+    }
+}
+
+TEST_CASE("Benchmark telemetry throughput with QoS 1", "[benchmark][hub][mqtt]")
+{
+    for (size_t i = 0; i < sizeof(BENCH_PAYLOAD_SIZES) / sizeof(BENCH_PAYLOAD_SIZES[0]); i++)
+    {
+        bench_telemetry_run(eAzureIoTHubMessageQoS1, BENCH_PAYLOAD_SIZES[i]);
+    }
+}
+
+TEST_CASE("Benchmark batched telemetry", "[benchmark][hub][mqtt][telemetry]")
+{
+    for (size_t i = 0; i < sizeof(BENCH_BATCH_SIZES) / sizeof(BENCH_BATCH_SIZES[0]); i++)
+    {
+        bench_telemetry_batch_run(BENCH_BATCH_SIZES[i]);
+    }
+}
+
+TEST_CASE("Benchmark telemetry enqueued on the hub task", "[benchmark][hub][mqtt]")
+{
+    hub_fixture_t bench;
+    benchmark_samples_t enqueue_latencies;
+
+    hub_fixture_setup(&bench, BENCH_BROKER_RESPONSE_DELAY_US, on_telemetry_ack);
+    benchmark_samples_init(&enqueue_latencies, BENCH_MESSAGE_COUNT);
+
+    azure_iot_hub_task_t *task = azure_iot_hub_task_create(bench.hub);
+
+    TEST_ASSERT_NOT_NULL(task);
+
+    int64_t started_at = benchmark_time_us();
+
+    for (uint32_t i = 0; i < BENCH_MESSAGE_COUNT; i++)
+    {
+        int64_t enqueued_at = benchmark_time_us();
+
+        // A sensor task drops the sample when the queue is full; retried to count them all.
+        while (azure_iot_hub_task_send_telemetry(task, (const uint8_t *)BENCH_SAMPLE, sizeof(BENCH_SAMPLE) - 1, NULL, 0, eAzureIoTHubMessageQoS1) != eAzureIoTSuccess)
+        {
+            vTaskDelay(1);
+
+            enqueued_at = benchmark_time_us();
+        }
+
+        benchmark_samples_add(&enqueue_latencies, (uint32_t)(benchmark_time_us() - enqueued_at));
+    }
+
+    bench_hub_task_wait_sent(task, BENCH_MESSAGE_COUNT);
+
+    double elapsed_s = (double)(benchmark_time_us() - started_at) / 1000000.0;
+    azure_iot_hub_task_statistics_t statistics;
+
+    azure_iot_hub_task_get_statistics(task, &statistics);
+    azure_iot_hub_task_free(task);
+
+    benchmark_report(BENCH_SUITE, "task_qos1", "messages_per_s", BENCH_MESSAGE_COUNT / elapsed_s, "msg/s");
+    benchmark_report(BENCH_SUITE, "task_qos1", "enqueue_p50", benchmark_samples_percentile(&enqueue_latencies, 50), "us");
+    benchmark_report(BENCH_SUITE, "task_qos1", "enqueue_p99", benchmark_samples_percentile(&enqueue_latencies, 99), "us");
+    benchmark_report(BENCH_SUITE, "task_qos1", "queue_full", (double)statistics.dropped, "times");
+
+    benchmark_samples_free(&enqueue_latencies);
+    hub_fixture_teardown(&bench);
+}
+
+TEST_CASE("Benchmark command latency", "[benchmark][hub][mqtt]")
+{
+    hub_fixture_t bench;
+    benchmark_samples_t latencies;
+    bench_command_t command = {0};
+
+    hub_fixture_setup(&bench, BENCH_BROKER_RESPONSE_DELAY_US, on_telemetry_ack);
+    benchmark_samples_init(&latencies, BENCH_COMMAND_COUNT);
+
+    command.hub = bench.hub;
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_subscribe_command(bench.hub, on_command_timed, &command));
+
+    for (uint32_t i = 0; i < BENCH_COMMAND_COUNT; i++)
+    {
+        uint32_t received = command.received;
+
+        command.invoked_at_us = benchmark_time_us();
+
+        TEST_ASSERT_TRUE(mqtt_broker_stub_invoke_command(bench.broker, "reboot", "{}"));
+
+        while (command.received == received)
+        {
+            TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_process_events(bench.hub, BENCH_EVENTS_MAX_WAIT_MS));
+        }
+
+        benchmark_samples_add(&latencies, command.latency_us);
+    }
+
+    benchmark_report(BENCH_SUITE, "process_events", "command_latency_p50", benchmark_samples_percentile(&latencies, 50), "us");
+    benchmark_report(BENCH_SUITE, "process_events", "command_latency_p99", benchmark_samples_percentile(&latencies, 99), "us");
+
+    benchmark_samples_free(&latencies);
+    hub_fixture_teardown(&bench);
+}
+
+TEST_CASE("Benchmark telemetry throughput with the publish window", "[benchmark][hub][mqtt]")
+{
+    for (size_t i = 0; i < sizeof(BENCH_PAYLOAD_SIZES) / sizeof(BENCH_PAYLOAD_SIZES[0]); i++)
+    {
+        bench_telemetry_window_run(BENCH_PAYLOAD_SIZES[i]);
+    }
+}
+
+static void bench_telemetry_run(AzureIoTHubMessageQoS_t qos, uint32_t payload_size)
+{
+    hub_fixture_t bench;
+    benchmark_samples_t send_latencies;
+    char scenario[32];
+    uint16_t packet_id = 0;
+    uint8_t *payload = (uint8_t *)malloc(payload_size);
+
+    memset(payload, 'x', payload_size);
+    snprintf(scenario, sizeof(scenario), "qos%d_%lub", qos == eAzureIoTHubMessageQoS1 ? 1 : 0, (unsigned long)payload_size);
+
+    hub_fixture_setup(&bench, BENCH_BROKER_RESPONSE_DELAY_US, on_telemetry_ack);
+    benchmark_samples_init(&send_latencies, BENCH_MESSAGE_COUNT);
+    benchmark_samples_init(&PUBACK_LATENCIES, BENCH_MESSAGE_COUNT);
+
+    IN_FLIGHT_COUNT = 0;
+
+    benchmark_heap_start();
+
+    int64_t started_at = benchmark_time_us();
+
+    for (uint32_t i = 0; i < BENCH_MESSAGE_COUNT; i++)
+    {
+        if (qos == eAzureIoTHubMessageQoS1)
+        {
+            bench_drain_in_flight(&bench, BENCH_QOS1_WINDOW - 1);
+        }
+
+        int64_t sent_at = benchmark_time_us();
+
+        TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_send_telemetry(bench.hub, payload, payload_size, NULL, qos, &packet_id));
+
+        benchmark_samples_add(&send_latencies, (uint32_t)(benchmark_time_us() - sent_at));
+        benchmark_heap_sample();
+
+        if (qos == eAzureIoTHubMessageQoS1)
+        {
+            IN_FLIGHT[IN_FLIGHT_COUNT].packet_id = packet_id;
+            IN_FLIGHT[IN_FLIGHT_COUNT].sent_at_us = sent_at;
+            IN_FLIGHT_COUNT++;
+        }
+    }
+
+    bench_drain_in_flight(&bench, 0);
+
+    double elapsed_s = (double)(benchmark_time_us() - started_at) / 1000000.0;
+    size_t heap_peak = benchmark_heap_stop();
+
+    // A full process loop, as applications call it, blocking for CONFIG_ESP32_IOT_AZURE_HUB_LOOP_TIMEOUT_MS.
+    int64_t loop_started_at = benchmark_time_us();
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_process_loop(bench.hub));
+
+    int64_t loop_elapsed_us = benchmark_time_us() - loop_started_at;
+
+    const mqtt_broker_stub_stats_t *stats = mqtt_broker_stub_get_stats(bench.broker);
+
+    TEST_ASSERT_EQUAL_UINT32(BENCH_MESSAGE_COUNT, stats->telemetry_messages);
+
+    benchmark_report(BENCH_SUITE, scenario, "messages_per_s", BENCH_MESSAGE_COUNT / elapsed_s, "msg/s");
+    benchmark_report(BENCH_SUITE, scenario, "bytes_per_s", (double)stats->telemetry_bytes / elapsed_s, "B/s");
+    benchmark_report(BENCH_SUITE, scenario, "send_p50", benchmark_samples_percentile(&send_latencies, 50), "us");
+    benchmark_report(BENCH_SUITE, scenario, "send_p99", benchmark_samples_percentile(&send_latencies, 99), "us");
+
+    if (qos == eAzureIoTHubMessageQoS1)
+    {
+        TEST_ASSERT_EQUAL_UINT32(BENCH_MESSAGE_COUNT, PUBACK_LATENCIES.count);
+
+        benchmark_report(BENCH_SUITE, scenario, "puback_p50", benchmark_samples_percentile(&PUBACK_LATENCIES, 50), "us");
+        benchmark_report(BENCH_SUITE, scenario, "puback_p90", benchmark_samples_percentile(&PUBACK_LATENCIES, 90), "us");
+        benchmark_report(BENCH_SUITE, scenario, "puback_p99", benchmark_samples_percentile(&PUBACK_LATENCIES, 99), "us");
+        benchmark_report(BENCH_SUITE, scenario, "puback_max", benchmark_samples_percentile(&PUBACK_LATENCIES, 100), "us");
+    }
+
+    benchmark_report(BENCH_SUITE, scenario, "process_loop", (double)loop_elapsed_us, "us");
+    benchmark_report(BENCH_SUITE, scenario, "heap_peak", (double)heap_peak, "B");
+
+    benchmark_samples_free(&send_latencies);
+    benchmark_samples_free(&PUBACK_LATENCIES);
+    hub_fixture_teardown(&bench);
+    free(payload);
+}
+
+static void bench_telemetry_batch_run(uint32_t batch_size)
+{
+    hub_fixture_t bench;
+    char scenario[32];
+    azure_iot_telemetry_batch_t *batch = NULL;
+    buffer_t batch_buffer = {
+        .buffer = NULL,
+        .length = batch_size};
+
+    snprintf(scenario, sizeof(scenario), "batch_%lub", (unsigned long)batch_size);
+
+    hub_fixture_setup(&bench, BENCH_BROKER_RESPONSE_DELAY_US, on_telemetry_ack);
+
+    if (batch_size > 0)
+    {
+        batch_buffer.buffer = (uint8_t *)malloc(batch_size);
+        batch = azure_iot_telemetry_batch_create(bench.hub,
+                                                 (const uint8_t *)HUB_FIXTURE_COMPONENT_NAME,
+                                                 sizeof(HUB_FIXTURE_COMPONENT_NAME) - 1,
+                                                 &batch_buffer,
+                                                 0,
+                                                 eAzureIoTHubMessageQoS0);
+        TEST_ASSERT_NOT_NULL(batch);
+    }
+
+    int64_t started_at = benchmark_time_us();
+
+    for (uint32_t i = 0; i < BENCH_MESSAGE_COUNT; i++)
+    {
+        if (batch == NULL)
+        {
+            TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_send_json_telemetry_from_component(bench.hub,
+                                                                                                 (const uint8_t *)HUB_FIXTURE_COMPONENT_NAME,
+                                                                                                 sizeof(HUB_FIXTURE_COMPONENT_NAME) - 1,
+                                                                                                 (const uint8_t *)BENCH_SAMPLE,
+                                                                                                 sizeof(BENCH_SAMPLE) - 1,
+                                                                                                 eAzureIoTHubMessageQoS0,
+                                                                                                 NULL));
+        }
+        else
+        {
+            TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_telemetry_batch_add(batch, (const uint8_t *)BENCH_SAMPLE, sizeof(BENCH_SAMPLE) - 1));
+        }
+    }
+
+    if (batch != NULL)
+    {
+        TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_telemetry_batch_flush(batch));
+    }
+
+    double elapsed_s = (double)(benchmark_time_us() - started_at) / 1000000.0;
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_process_loop(bench.hub));
+
+    const mqtt_broker_stub_stats_t *stats = mqtt_broker_stub_get_stats(bench.broker);
+
+    benchmark_report(BENCH_SUITE, scenario, "samples_per_s", BENCH_MESSAGE_COUNT / elapsed_s, "samples/s");
+    benchmark_report(BENCH_SUITE, scenario, "messages", (double)stats->telemetry_messages, "msg");
+    benchmark_report(BENCH_SUITE, scenario, "payload_bytes", (double)stats->telemetry_bytes, "B");
+
+    azure_iot_telemetry_batch_free(batch);
+    free(batch_buffer.buffer);
+    hub_fixture_teardown(&bench);
+}
+
+static void bench_telemetry_window_run(uint32_t payload_size)
+{
+    hub_fixture_t bench;
+    char scenario[32];
+    uint32_t completed = 0;
+    uint32_t window_full = 0;
+    uint8_t *payload = (uint8_t *)malloc(payload_size);
+
+    memset(payload, 'x', payload_size);
+    snprintf(scenario, sizeof(scenario), "qos1_window_%lub", (unsigned long)payload_size);
+
+    hub_fixture_setup(&bench, BENCH_BROKER_RESPONSE_DELAY_US, on_telemetry_ack);
+    benchmark_heap_start();
+
+    int64_t started_at = benchmark_time_us();
+
+    for (uint32_t i = 0; i < BENCH_MESSAGE_COUNT; i++)
+    {
+        AzureIoTResult_t result;
+
+        while ((result = azure_iot_hub_send_telemetry_async(bench.hub, payload, payload_size, NULL, 0, hub_fixture_on_telemetry_completed, &completed)) == eAzureIoTErrorPending)
+        {
+            window_full++;
+
+            TEST_ASSERT_EQUAL(eAzureIoTSuccess, AzureIoTHubClient_ProcessLoop(azure_iot_hub_get_iot_client(bench.hub), 0));
+        }
+
+        TEST_ASSERT_EQUAL(eAzureIoTSuccess, result);
+
+        benchmark_heap_sample();
+    }
+
+    while (azure_iot_hub_get_telemetry_in_flight(bench.hub) > 0)
+    {
+        TEST_ASSERT_EQUAL(eAzureIoTSuccess, AzureIoTHubClient_ProcessLoop(azure_iot_hub_get_iot_client(bench.hub), 0));
+    }
+
+    double elapsed_s = (double)(benchmark_time_us() - started_at) / 1000000.0;
+    size_t heap_peak = benchmark_heap_stop();
+
+    TEST_ASSERT_EQUAL_UINT32(BENCH_MESSAGE_COUNT, completed);
+
+    benchmark_report(BENCH_SUITE, scenario, "messages_per_s", BENCH_MESSAGE_COUNT / elapsed_s, "msg/s");
+    benchmark_report(BENCH_SUITE, scenario, "window_full", (double)window_full, "times");
+    benchmark_report(BENCH_SUITE, scenario, "heap_peak", (double)heap_peak, "B");
+
+    hub_fixture_teardown(&bench);
+    free(payload);
+}
+
+static void bench_drain_in_flight(hub_fixture_t *bench, size_t max_in_flight)
+{
+    // Zero timeout: runs the MQTT loop once, so the drain
+    // measures the library and not the loop timeout.
+    while (IN_FLIGHT_COUNT > max_in_flight)
+    {
+        TEST_ASSERT_EQUAL(eAzureIoTSuccess, AzureIoTHubClient_ProcessLoop(azure_iot_hub_get_iot_client(bench->hub), 0));
+    }
+}
+
+static void on_telemetry_ack(uint16_t packet_id)
+{
+    int64_t now = benchmark_time_us();
+
+    for (size_t i = 0; i < IN_FLIGHT_COUNT; i++)
+    {
+        if (IN_FLIGHT[i].packet_id == packet_id)
+        {
+            benchmark_samples_add(&PUBACK_LATENCIES, (uint32_t)(now - IN_FLIGHT[i].sent_at_us));
+
+            IN_FLIGHT[i] = IN_FLIGHT[--IN_FLIGHT_COUNT];
+            break;
+        }
+    }
+}
+
+static void bench_hub_task_wait_sent(azure_iot_hub_task_t *task, uint32_t sent)
+{
+    azure_iot_hub_task_statistics_t statistics;
+    int64_t started_at = benchmark_time_us();
+
+    do
+    {
+        vTaskDelay(pdMS_TO_TICKS(10));
+
+        azure_iot_hub_task_get_statistics(task, &statistics);
+    } while (statistics.sent + statistics.failed < sent && benchmark_time_us() - started_at < 10000000);
+
+    TEST_ASSERT_EQUAL_UINT32(sent, statistics.sent);
+}
+
+static void on_command_timed(AzureIoTHubClientCommandRequest_t *request, void *context)
+{
+    bench_command_t *command = (bench_command_t *)context;
+
+    command->latency_us = (uint32_t)(benchmark_time_us() - command->invoked_at_us);
+    command->received++;
+
+    azure_iot_hub_send_command_response(command->hub, request, NULL, 0, 200);
+}
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "infrastructure/telemetry_log.h"
+#include "benchmark.h"
+
+#define BENCH_SUITE "telemetry_queue"
+#define BENCH_RECORD_COUNT 100U
+
+static const uint32_t BENCH_PAYLOAD_SIZES[] = {32, 256, 1024};
+
+TEST_CASE("Benchmark telemetry log store and drain", "[benchmark][telemetry]")
+{
+    uint8_t *data = (uint8_t *)malloc(telemetry_log_get_record_max_length());
+    telemetry_log_t *log = telemetry_log_open();
+    telemetry_log_record_t record;
+    telemetry_log_cursor_t cursor;
+
+    if (log == NULL)
+    {
+        free(data);
+        TEST_IGNORE_MESSAGE("needs a telemetry queue partition");
+    }
+
+    for (size_t i = 0; i < sizeof(BENCH_PAYLOAD_SIZES) / sizeof(BENCH_PAYLOAD_SIZES[0]); i++)
+    {
+        benchmark_samples_t append_latencies;
+        char scenario[16];
+        uint32_t drained = 0;
+
+        snprintf(scenario, sizeof(scenario), "%lub", (unsigned long)BENCH_PAYLOAD_SIZES[i]);
+        memset(data, 'x', BENCH_PAYLOAD_SIZES[i]);
+        benchmark_samples_init(&append_latencies, BENCH_RECORD_COUNT);
+
+        for (uint32_t j = 0; j < BENCH_RECORD_COUNT; j++)
+        {
+            int64_t started_at = benchmark_time_us();
+
+            TEST_ASSERT_TRUE(telemetry_log_append(log, 1, 0, NULL, 0, data, BENCH_PAYLOAD_SIZES[i]));
+
+            benchmark_samples_add(&append_latencies, (uint32_t)(benchmark_time_us() - started_at));
+        }
+
+        int64_t started_at = benchmark_time_us();
+
+        telemetry_log_rewind(log, &cursor);
+
+        while (telemetry_log_read(log, &cursor, &record, data))
+        {
+            telemetry_log_consume(log, &record);
+            drained++;
+        }
+
+        int64_t elapsed_us = benchmark_time_us() - started_at;
+
+        benchmark_report(BENCH_SUITE, scenario, "append_p50", benchmark_samples_percentile(&append_latencies, 50), "us");
+        benchmark_report(BENCH_SUITE, scenario, "append_p99", benchmark_samples_percentile(&append_latencies, 99), "us");
+        benchmark_report(BENCH_SUITE, scenario, "drain", drained > 0 ? (double)elapsed_us / drained : 0, "us/msg");
+
+        benchmark_samples_free(&append_latencies);
+    }
+
+    telemetry_log_close(log);
+    free(data);
+}
@@ -0,0 +1,71 @@
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_sdk.h"
+#include "infrastructure/backoff_algorithm.h"
+#include "benchmark.h"
+#include "config.h"
+
+#define BENCH_SUITE "transport_reconnect"
+#define BENCH_FLEET_SIZE 1000U
+#define BENCH_FLEET_ATTEMPTS 8U
+#define BENCH_FLEET_SLOT_MS 100U
+#define BENCH_FLEET_BASE_MS 500U
+#define BENCH_FLEET_MAX_DELAY_MS 30000U
+
+static uint32_t bench_fleet_peak(bool decorrelated);
+
+TEST_CASE("Benchmark fleet reconnection spread", "[benchmark][transport]")
+{
+    // Devices losing the server at once: the fewer attempts landing on the same slot, the
+    // less the server is hit by synchronised retries when it comes back.
+    benchmark_report(BENCH_SUITE, "full_jitter", "peak_attempts_per_slot", bench_fleet_peak(false), "attempts");
+    benchmark_report(BENCH_SUITE, "decorrelated_jitter", "peak_attempts_per_slot", bench_fleet_peak(true), "attempts");
+}
+
+static uint32_t bench_fleet_peak(bool decorrelated)
+{
+    uint32_t slot_count = BENCH_FLEET_ATTEMPTS * BENCH_FLEET_MAX_DELAY_MS / BENCH_FLEET_SLOT_MS + 1U;
+    uint32_t *slots = (uint32_t *)calloc(slot_count, sizeof(uint32_t));
+    uint32_t peak = 0;
+
+    TEST_ASSERT_NOT_NULL(slots);
+
+    for (uint32_t device = 0; device < BENCH_FLEET_SIZE; device++)
+    {
+        backoff_algorithm_context_t backoff_context;
+        uint32_t at_ms = 0;
+        uint32_t delay_ms = 0;
+
+        backoff_algorithm_initialize(&backoff_context, BENCH_FLEET_BASE_MS, BENCH_FLEET_MAX_DELAY_MS, BENCH_FLEET_ATTEMPTS);
+
+        for (uint32_t attempt = 0; attempt < BENCH_FLEET_ATTEMPTS; attempt++)
+        {
+            if (decorrelated)
+            {
+                delay_ms = backoff_algorithm_get_decorrelated(BENCH_FLEET_BASE_MS, BENCH_FLEET_MAX_DELAY_MS, delay_ms);
+            }
+            else
+            {
+                uint16_t next_backoff_ms = 0;
+
+                backoff_algorithm_get_next(&backoff_context, &next_backoff_ms);
+
+                delay_ms = next_backoff_ms;
+            }
+
+            at_ms += delay_ms;
+
+            slots[at_ms / BENCH_FLEET_SLOT_MS]++;
+        }
+    }
+
+    for (uint32_t i = 0; i < slot_count; i++)
+    {
+        peak = slots[i] > peak ? slots[i] : peak;
+    }
+
+    free(slots);
+
+    return peak;
+}
@@ -0,0 +1,483 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "http_server_stub.h"
+#include "benchmark.h"
+
+#define STUB_REQUEST_BUFFER_SIZE 2048U
+#define STUB_MAX_RESPONSES 16U
+#define STUB_RESPONSE_HEADER_SIZE 256U
+#define STUB_SEGMENT_SIZE 1460U
+
+typedef struct
+{
+    char header[STUB_RESPONSE_HEADER_SIZE]; /** @brief Status line and headers. */
+    size_t header_length;                   /** @brief Header length. */
+    uint32_t body_offset;                   /** @brief Body start on the resource. */
+    uint32_t body_length;                   /** @brief Body length. */
+    size_t sent;                            /** @brief Bytes, header included, already read by the client. */
+    int64_t ready_at_us;                    /** @brief When the response starts arriving. */
+    bool reset_midway;                      /** @brief Reset the connection after half of the body. */
+    bool close;                             /** @brief Close the connection after the response. */
+} stub_response_t;
+
+struct http_server_stub_t
+{
+    transport_driver_t driver;
+    http_server_stub_config_t config;
+    http_server_stub_stats_t stats;
+    uint32_t random_state;
+    int last_errno;
+    int connection_error;    /** @brief Error returned once the connection is reset or closed; 0 while open. */
+    int64_t link_free_at_us; /** @brief When the link finishes sending the responses in flight. */
+    uint32_t connection_requests;
+    bool tls;              /** @brief Whether the transport was created with a certificate. */
+    void *offered_session; /** @brief Session the client offers on the next connection. */
+    bool resumed;          /** @brief Whether the last connection resumed a session. */
+    char request[STUB_REQUEST_BUFFER_SIZE];
+    size_t request_length;
+    stub_response_t responses[STUB_MAX_RESPONSES];
+    size_t responses_count;
+};
+
+static void *stub_driver_create(const tls_certificate_t *certificate, void *driver_context);
+static void *stub_driver_session_get(void *handle);
+static void stub_driver_session_set(void *handle, void *session);
+static void stub_driver_session_free(void *session);
+static bool stub_driver_session_resumed(void *handle);
+static transport_status_t stub_driver_connect(void *handle, const char *hostname, uint16_t port, uint16_t timeout_ms);
+static int32_t stub_driver_write(void *handle, const uint8_t *buffer, size_t length, uint16_t timeout_ms);
+static int32_t stub_driver_read(void *handle, uint8_t *buffer, size_t length, uint16_t timeout_ms);
+static transport_status_t stub_driver_close(void *handle);
+static int stub_driver_get_errno(void *handle);
+static void stub_driver_destroy(void *handle);
+
+static void stub_process_requests(http_server_stub_t *stub);
+static void stub_handle_request(http_server_stub_t *stub, const char *request);
+static size_t stub_response_readable(http_server_stub_t *stub, const stub_response_t *response, int64_t now);
+static uint32_t stub_random(http_server_stub_t *stub);
+
+http_server_stub_t *http_server_stub_create(const http_server_stub_config_t *config)
+{
+    http_server_stub_t *stub = (http_server_stub_t *)malloc(sizeof(http_server_stub_t));
+
+    memset(stub, 0, sizeof(http_server_stub_t));
+
+    stub->config = *config;
+    stub->random_state = config->seed != 0 ? config->seed : 0x2545F491U;
+    stub->driver.create = stub_driver_create;
+    stub->driver.set_client_certificate = NULL;
+    stub->driver.session_get = stub_driver_session_get;
+    stub->driver.session_set = stub_driver_session_set;
+    stub->driver.session_free = stub_driver_session_free;
+    stub->driver.session_resumed = stub_driver_session_resumed;
+    stub->driver.connect = stub_driver_connect;
+    stub->driver.write = stub_driver_write;
+    stub->driver.read = stub_driver_read;
+    stub->driver.wait = NULL;
+    stub->driver.wake = NULL;
+    stub->driver.close = stub_driver_close;
+    stub->driver.get_errno = stub_driver_get_errno;
+    stub->driver.destroy = stub_driver_destroy;
+    stub->driver.is_network_up = NULL;
+    stub->driver.context = stub;
+
+    return stub;
+}
+
+const transport_driver_t *http_server_stub_get_driver(http_server_stub_t *stub)
+{
+    return &stub->driver;
+}
+
+const http_server_stub_stats_t *http_server_stub_get_stats(http_server_stub_t *stub)
+{
+    return &stub->stats;
+}
+
+void http_server_stub_free(http_server_stub_t *stub)
+{
+    free(stub);
+}
+
+// ======
+// DRIVER
+// ======
+
+static void *stub_driver_create(const tls_certificate_t *certificate, void *driver_context)
+{
+    http_server_stub_t *stub = (http_server_stub_t *)driver_context;
+
+    stub->tls = certificate != NULL;
+    stub->offered_session = NULL;
+    stub->resumed = false;
+
+    return stub;
+}
+
+static void *stub_driver_session_get(void *handle)
+{
+    http_server_stub_t *stub = (http_server_stub_t *)handle;
+
+    if (!stub->tls || !stub->config.session_tickets)
+    {
+        return NULL;
+    }
+
+    // The ticket content is meaningless: any ticket resumes.
+    return malloc(sizeof(uint32_t));
+}
+
+static void stub_driver_session_set(void *handle, void *session)
+{
+    ((http_server_stub_t *)handle)->offered_session = session;
+}
+
+static void stub_driver_session_free(void *session)
+{
+    free(session);
+}
+
+static bool stub_driver_session_resumed(void *handle)
+{
+    return ((http_server_stub_t *)handle)->resumed;
+}
+
+static transport_status_t stub_driver_connect(void *handle, const char *hostname, uint16_t port, uint16_t timeout_ms)
+{
+    http_server_stub_t *stub = (http_server_stub_t *)handle;
+
+    stub->stats.connections++;
+    stub->connection_error = 0;
+    stub->link_free_at_us = 0;
+    stub->connection_requests = 0;
+    stub->request_length = 0;
+    stub->responses_count = 0;
+
+    if (stub->tls)
+    {
+        stub->resumed = stub->offered_session != NULL && stub->config.session_tickets;
+
+        if (stub->resumed)
+        {
+            stub->stats.resumptions++;
+            usleep(stub->config.resumed_handshake_us);
+        }
+        else
+        {
+            stub->stats.handshakes++;
+            usleep(stub->config.handshake_us);
+        }
+    }
+
+    return TRANSPORT_STATUS_SUCCESS;
+}
+
+static int32_t stub_driver_write(void *handle, const uint8_t *buffer, size_t length, uint16_t timeout_ms)
+{
+    http_server_stub_t *stub = (http_server_stub_t *)handle;
+
+    if (stub->connection_error != 0)
+    {
+        if (stub->connection_error == ENOTCONN)
+        {
+            stub->stats.closed_writes++;
+        }
+
+        stub->last_errno = stub->connection_error == ENOTCONN ? EPIPE : stub->connection_error;
+        return -1;
+    }
+
+    // Keeps room for the null-terminator.
+    if (length >= sizeof(stub->request) - stub->request_length)
+    {
+        stub->last_errno = ENOBUFS;
+        return -1;
+    }
+
+    memcpy(stub->request + stub->request_length, buffer, length);
+
+    stub->request_length += length;
+    stub->request[stub->request_length] = '\0';
+
+    stub_process_requests(stub);
+
+    return (int32_t)length;
+}
+
+static int32_t stub_driver_read(void *handle, uint8_t *buffer, size_t length, uint16_t timeout_ms)
+{
+    http_server_stub_t *stub = (http_server_stub_t *)handle;
+
+    if (stub->connection_error != 0)
+    {
+        stub->last_errno = stub->connection_error;
+        return -1;
+    }
+
+    if (stub->responses_count == 0)
+    {
+        // Nothing in flight: return right away instead of
+        // blocking for the timeout like a socket would.
+        return 0;
+    }
+
+    stub_response_t *response = &stub->responses[0];
+    int64_t deadline = benchmark_time_us() + (int64_t)timeout_ms * 1000;
+    size_t readable;
+
+    // Block, as a socket would, until bytes arrive.
+    while ((readable = stub_response_readable(stub, response, benchmark_time_us())) == 0)
+    {
+        if (benchmark_time_us() >= deadline)
+        {
+            return 0;
+        }
+
+        usleep(1000);
+    }
+
+    if (readable > length)
+    {
+        readable = length;
+    }
+
+    for (size_t copied = 0; copied < readable;)
+    {
+        size_t part;
+
+        if (response->sent < response->header_length)
+        {
+            part = response->header_length - response->sent;
+            part = part > readable - copied ? readable - copied : part;
+
+            memcpy(buffer + copied, response->header + response->sent, part);
+        }
+        else
+        {
+            size_t body_sent = response->sent - response->header_length;
+
+            part = readable - copied;
+
+            memcpy(buffer + copied, stub->config.resource + response->body_offset + body_sent, part);
+
+            stub->stats.body_bytes += part;
+        }
+
+        response->sent += part;
+        copied += part;
+    }
+
+    size_t total = response->header_length + (response->reset_midway ? response->body_length / 2 : response->body_length);
+
+    if (response->sent == total)
+    {
+        if (response->reset_midway)
+        {
+            stub->stats.resets++;
+            stub->connection_error = ECONNRESET;
+        }
+        else if (response->close)
+        {
+            stub->stats.closes++;
+            stub->connection_error = ENOTCONN;
+        }
+
+        stub->responses_count--;
+
+        memmove(stub->responses, stub->responses + 1, stub->responses_count * sizeof(stub_response_t));
+    }
+
+    return (int32_t)readable;
+}
+
+static transport_status_t stub_driver_close(void *handle)
+{
+    return TRANSPORT_STATUS_SUCCESS;
+}
+
+static int stub_driver_get_errno(void *handle)
+{
+    return ((http_server_stub_t *)handle)->last_errno;
+}
+
+static void stub_driver_destroy(void *handle)
+{
+    // The server is owned by the test: see http_server_stub_free.
+}
+
+// ========
+// REQUESTS
+// ========
+
+static void stub_process_requests(http_server_stub_t *stub)
+{
+    char *end;
+
+    while ((end = strstr(stub->request, "\r\n\r\n")) != NULL)
+    {
+        size_t request_length = (size_t)(end - stub->request) + 4;
+
+        // Requests have no body: the headers end the request.
+        end[2] = '\0';
+
+        stub_handle_request(stub, stub->request);
+
+        stub->request_length -= request_length;
+
+        memmove(stub->request, stub->request + request_length, stub->request_length + 1);
+    }
+}
+
+static void stub_handle_request(http_server_stub_t *stub, const char *request)
+{
+    if (stub->responses_count == STUB_MAX_RESPONSES)
+    {
+        printf("http server stub: too many requests in flight, resetting\n");
+        stub->connection_error = ECONNRESET;
+        return;
+    }
+
+    stub_response_t *response = &stub->responses[stub->responses_count];
+    bool is_head = strncmp(request, "HEAD ", sizeof("HEAD ") - 1) == 0;
+    // Range is only defined for GET: servers ignore it on HEAD.
+    const char *range = is_head ? NULL : strstr(request, "Range: bytes=");
+    const char *host = strstr(request, "Host: ");
+    uint32_t size = stub->config.resource_size;
+
+    memset(response, 0, sizeof(stub_response_t));
+
+    if (host != NULL)
+    {
+        host += sizeof("Host: ") - 1;
+
+        snprintf(stub->stats.host, sizeof(stub->stats.host), "%.*s", (int)strcspn(host, "\r"), host);
+    }
+
+    stub->stats.requests++;
+    stub->connection_requests++;
+
+    // Like a keep-alive limit: counted per connection.
+    response->close = stub->config.close_every_requests > 0 && stub->connection_requests % stub->config.close_every_requests == 0;
+
+    const char *connection = response->close ? "close" : "keep-alive";
+
+    if (range == NULL)
+    {
+        response->body_length = size;
+        response->header_length = snprintf(response->header,
+                                           sizeof(response->header),
+                                           "HTTP/1.1 200 OK\r\n"
+                                           "Content-Length: %lu\r\n"
+                                           "Connection: %s\r\n\r\n",
+                                           (unsigned long)size,
+                                           connection);
+    }
+    else
+    {
+        unsigned long start = strtoul(range + sizeof("Range: bytes=") - 1, NULL, 10);
+        const char *dash = strchr(range, '-');
+        unsigned long end = dash != NULL && dash[1] >= '0' && dash[1] <= '9' ? strtoul(dash + 1, NULL, 10) : size - 1;
+
+        if (start >= size || end < start)
+        {
+            response->header_length = snprintf(response->header,
+                                               sizeof(response->header),
+                                               "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                                               "Content-Range: bytes */%lu\r\n"
+                                               "Content-Length: 0\r\n"
+                                               "Connection: %s\r\n\r\n",
+                                               (unsigned long)size,
+                                               connection);
+        }
+        else
+        {
+            end = end >= size ? size - 1 : end;
+
+            response->body_offset = (uint32_t)start;
+            response->body_length = (uint32_t)(end - start + 1);
+            response->header_length = snprintf(response->header,
+                                               sizeof(response->header),
+                                               "HTTP/1.1 206 Partial Content\r\n"
+                                               "Content-Length: %lu\r\n"
+                                               "Content-Range: bytes %lu-%lu/%lu\r\n"
+                                               "Connection: %s\r\n\r\n",
+                                               (unsigned long)response->body_length,
+                                               start,
+                                               end,
+                                               (unsigned long)size,
+                                               connection);
+        }
+    }
+
+    if (is_head)
+    {
+        response->body_length = 0;
+    }
+
+    response->ready_at_us = benchmark_time_us() + stub->config.latency_us;
+
+    if (stub->config.loss_percent > 0 && stub_random(stub) % 100 < stub->config.loss_percent)
+    {
+        stub->stats.losses++;
+        response->ready_at_us += stub->config.loss_penalty_us;
+    }
+
+    if (stub->config.reset_every_requests > 0 && stub->stats.requests % stub->config.reset_every_requests == 0)
+    {
+        response->reset_midway = true;
+    }
+
+    // Pipelined responses share the link: one starts
+    // arriving once the previous one has been sent.
+    if (stub->config.bandwidth_bytes_per_s > 0)
+    {
+        size_t total = response->header_length + response->body_length;
+
+        if (response->ready_at_us < stub->link_free_at_us)
+        {
+            response->ready_at_us = stub->link_free_at_us;
+        }
+
+        stub->link_free_at_us = response->ready_at_us + (int64_t)(((uint64_t)total * 1000000U) / stub->config.bandwidth_bytes_per_s);
+    }
+
+    stub->responses_count++;
+}
+
+static size_t stub_response_readable(http_server_stub_t *stub, const stub_response_t *response, int64_t now)
+{
+    if (now < response->ready_at_us)
+    {
+        return 0;
+    }
+
+    size_t total = response->header_length + (response->reset_midway ? response->body_length / 2 : response->body_length);
+    size_t arrived = total;
+
+    if (stub->config.bandwidth_bytes_per_s > 0)
+    {
+        uint64_t elapsed_us = (uint64_t)(now - response->ready_at_us);
+        uint64_t bandwidth_bytes = (elapsed_us * stub->config.bandwidth_bytes_per_s) / 1000000U;
+
+        // The first segment arrives with the latency.
+        arrived = (size_t)(bandwidth_bytes + STUB_SEGMENT_SIZE);
+        arrived = arrived > total ? total : arrived;
+    }
+
+    size_t readable = arrived > response->sent ? arrived - response->sent : 0;
+
+    return readable > STUB_SEGMENT_SIZE ? STUB_SEGMENT_SIZE : readable;
+}
+
+static uint32_t stub_random(http_server_stub_t *stub)
+{
+    // xorshift32: deterministic and cheap.
+    stub->random_state ^= stub->random_state << 13;
+    stub->random_state ^= stub->random_state >> 17;
+    stub->random_state ^= stub->random_state << 5;
+
+    return stub->random_state;
+}
@@ -0,0 +1,86 @@
+#ifndef __ESP32_IOT_AZURE_TEST_HTTP_SERVER_STUB_H__
+#define __ESP32_IOT_AZURE_TEST_HTTP_SERVER_STUB_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "infrastructure/transport.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @typedef http_server_stub_t
+     * @brief In-memory HTTP/1.1 server serving a single resource, honouring `Range` requests.
+     * @details Plugged into the component through @ref transport_set_driver.
+     * Network conditions are emulated on the responses: latency, bandwidth,
+     * packet loss (as retransmission stalls) and connection resets.
+     * TLS transports pay a handshake on every connection, shortened when
+     * the client offers the session ticket of a previous one.
+     * Supports a single connection.
+     */
+    typedef struct http_server_stub_t http_server_stub_t;
+
+    /**
+     * @brief Server configuration.
+     */
+    typedef struct
+    {
+        const uint8_t *resource;        /** @brief Resource served for any path. */
+        uint32_t resource_size;         /** @brief Resource size. */
+        uint32_t latency_us;            /** @brief Delay, in microseconds, before a response starts. */
+        uint32_t bandwidth_bytes_per_s; /** @brief Response bandwidth; 0 for unlimited. */
+        uint8_t loss_percent;           /** @brief Chance, 0-100, of a response stalling for a retransmission. */
+        uint32_t loss_penalty_us;       /** @brief Retransmission stall, in microseconds. */
+        uint32_t reset_every_requests;  /** @brief Reset the connection mid-response every N requests; 0 for never. */
+        uint32_t close_every_requests;  /** @brief Answer with `Connection: close`, and close, every N requests on a connection; 0 for never. */
+        uint32_t seed;                  /** @brief Seed for the loss injection, so runs are reproducible. */
+        uint32_t handshake_us;          /** @brief TLS full handshake duration, in microseconds. */
+        uint32_t resumed_handshake_us;  /** @brief TLS resumed handshake duration, in microseconds. */
+        bool session_tickets;           /** @brief Whether the server issues TLS session tickets, allowing resumption. */
+    } http_server_stub_config_t;
+
+    /**
+     * @brief Server counters.
+     */
+    typedef struct
+    {
+        uint32_t connections;   /** @brief Connections accepted. */
+        uint32_t requests;      /** @brief Requests received. */
+        uint32_t resets;        /** @brief Connections reset by the server. */
+        uint32_t closes;        /** @brief Connections closed by the server after a `Connection: close` response. */
+        uint32_t closed_writes; /** @brief Writes refused because the server had closed the connection. */
+        uint32_t losses;        /** @brief Responses stalled by a packet loss. */
+        uint64_t body_bytes;    /** @brief Response body bytes read by the client. */
+        uint32_t handshakes;    /** @brief TLS full handshakes. */
+        uint32_t resumptions;   /** @brief TLS handshakes resuming a previous session. */
+        char host[64];          /** @brief `Host` header of the last request. */
+    } http_server_stub_stats_t;
+
+    /**
+     * @brief Create a server.
+     * @note Must be released by @ref http_server_stub_free.
+     * @param[in] config Server configuration. Copied.
+     */
+    http_server_stub_t *http_server_stub_create(const http_server_stub_config_t *config);
+
+    /**
+     * @brief Get the transport driver backed by the server.
+     */
+    const transport_driver_t *http_server_stub_get_driver(http_server_stub_t *stub);
+
+    /**
+     * @brief Get the server counters.
+     */
+    const http_server_stub_stats_t *http_server_stub_get_stats(http_server_stub_t *stub);
+
+    /**
+     * @brief Release the server.
+     */
+    void http_server_stub_free(http_server_stub_t *stub);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
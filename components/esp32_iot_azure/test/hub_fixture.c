@@ -0,0 +1,81 @@
+#include <stdlib.h>
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_sdk.h"
+#include "infrastructure/transport.h"
+#include "hub_fixture.h"
+
+#define HUB_FIXTURE_MQTT_BUFFER_SIZE 5120U
+
+void hub_fixture_init(hub_fixture_t *fixture,
+                      uint32_t response_delay_us,
+                      AzureIoTHubClientTelemetryCallback_t on_telemetry_ack)
+{
+    AzureIoTHubClientOptions_t *options = NULL;
+
+    fixture->broker = mqtt_broker_stub_create(response_delay_us);
+    fixture->mqtt_buffer.length = HUB_FIXTURE_MQTT_BUFFER_SIZE;
+    fixture->mqtt_buffer.buffer = (uint8_t *)malloc(HUB_FIXTURE_MQTT_BUFFER_SIZE);
+
+    TEST_ASSERT_NOT_NULL(fixture->broker);
+    TEST_ASSERT_NOT_NULL(fixture->mqtt_buffer.buffer);
+
+    transport_set_driver(mqtt_broker_stub_get_driver(fixture->broker));
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_sdk_init());
+
+    fixture->hub = azure_iot_hub_create(&fixture->mqtt_buffer);
+
+    TEST_ASSERT_NOT_NULL(fixture->hub);
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_options_init(fixture->hub, &options));
+
+    options->xTelemetryCallback = on_telemetry_ack;
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_init(fixture->hub,
+                                                           (const uint8_t *)HUB_FIXTURE_HOSTNAME,
+                                                           sizeof(HUB_FIXTURE_HOSTNAME) - 1,
+                                                           (const uint8_t *)HUB_FIXTURE_DEVICE_ID,
+                                                           sizeof(HUB_FIXTURE_DEVICE_ID) - 1));
+}
+
+void hub_fixture_setup(hub_fixture_t *fixture,
+                       uint32_t response_delay_us,
+                       AzureIoTHubClientTelemetryCallback_t on_telemetry_ack)
+{
+    hub_fixture_init(fixture, response_delay_us, on_telemetry_ack);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_connect(fixture->hub));
+}
+
+void hub_fixture_teardown(hub_fixture_t *fixture)
+{
+    azure_iot_hub_disconnect(fixture->hub);
+    azure_iot_hub_deinit(fixture->hub);
+    azure_iot_hub_free(fixture->hub);
+    azure_iot_sdk_deinit();
+
+    transport_set_driver(NULL);
+
+    mqtt_broker_stub_free(fixture->broker);
+    free(fixture->mqtt_buffer.buffer);
+}
+
+void hub_fixture_on_command(AzureIoTHubClientCommandRequest_t *request, void *context)
+{
+    azure_iot_hub_send_command_response((azure_iot_hub_context_t *)context, request, NULL, 0, 200);
+}
+
+void hub_fixture_on_properties(AzureIoTHubClientPropertiesResponse_t *response, void *context)
+{
+    if (response->xMessageType == eAzureIoTHubPropertiesRequestedMessage)
+    {
+        (*(uint32_t *)context)++;
+    }
+}
+
+void hub_fixture_on_telemetry_completed(AzureIoTResult_t result, void *context)
+{
+    if (result == eAzureIoTSuccess)
+    {
+        (*(uint32_t *)context)++;
+    }
+}
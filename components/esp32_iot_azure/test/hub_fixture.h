@@ -0,0 +1,70 @@
+#ifndef __ESP32_IOT_AZURE_TEST_HUB_FIXTURE_H__
+#define __ESP32_IOT_AZURE_TEST_HUB_FIXTURE_H__
+
+#include "esp32_iot_azure/azure_iot_hub.h"
+#include "mqtt_broker_stub.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define HUB_FIXTURE_HOSTNAME "bench.azure-devices.net"
+#define HUB_FIXTURE_DEVICE_ID "bench-device"
+#define HUB_FIXTURE_COMPONENT_NAME "thermostat"
+
+    /**
+     * @brief Hub client talking to an in-memory broker.
+     */
+    typedef struct
+    {
+        mqtt_broker_stub_t *broker;   /** @brief Broker the transports are plugged into. */
+        azure_iot_hub_context_t *hub; /** @brief Hub client, initialized. */
+        buffer_t mqtt_buffer;         /** @brief MQTT buffer of the hub client. */
+    } hub_fixture_t;
+
+    /**
+     * @brief Create the broker, initialize the SDK and a hub client on it, without connecting.
+     * @note Must be released by @ref hub_fixture_teardown.
+     * @param[in] fixture Fixture to set up.
+     * @param[in] response_delay_us Broker response delay, see @ref mqtt_broker_stub_create.
+     * @param[in] on_telemetry_ack PUBACK callback of the hub client. Can be `NULL`.
+     */
+    void hub_fixture_init(hub_fixture_t *fixture,
+                          uint32_t response_delay_us,
+                          AzureIoTHubClientTelemetryCallback_t on_telemetry_ack);
+
+    /**
+     * @brief Like @ref hub_fixture_init, connecting the hub client.
+     */
+    void hub_fixture_setup(hub_fixture_t *fixture,
+                           uint32_t response_delay_us,
+                           AzureIoTHubClientTelemetryCallback_t on_telemetry_ack);
+
+    /**
+     * @brief Release the hub client, the SDK and the broker.
+     */
+    void hub_fixture_teardown(hub_fixture_t *fixture);
+
+    /**
+     * @brief Command callback responding 200 to every command.
+     * @param[in] context Hub context.
+     */
+    void hub_fixture_on_command(AzureIoTHubClientCommandRequest_t *request, void *context);
+
+    /**
+     * @brief Properties callback counting the twin documents received.
+     * @param[in] context `uint32_t` counter.
+     */
+    void hub_fixture_on_properties(AzureIoTHubClientPropertiesResponse_t *response, void *context);
+
+    /**
+     * @brief Publish window callback counting the messages acknowledged.
+     * @param[in] context `uint32_t` counter.
+     */
+    void hub_fixture_on_telemetry_completed(AzureIoTResult_t result, void *context);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,287 @@
+#include "config.h"
+
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DU_ENABLED
+
+#include <stdlib.h>
+#include <string.h>
+#include "infrastructure/image_patcher.h"
+#include "image_fixture.h"
+
+// Shortest match worth a back-reference: a literal costs 9 bits.
+#define IMAGE_FIXTURE_MIN_MATCH 3U
+
+typedef struct
+{
+    uint8_t *buffer;
+    uint32_t length;
+    uint8_t bits;
+    uint8_t bits_count;
+} image_fixture_bit_writer_t;
+
+static void image_fixture_bits_write(image_fixture_bit_writer_t *writer, uint32_t value, uint8_t count);
+static void image_fixture_patch_add_record(image_fixture_patch_t *patch, const uint8_t *old_image, uint32_t old_offset, const uint8_t *new_image, uint32_t new_offset, uint32_t diff_length, uint32_t extra_length, int32_t adjustment);
+static void image_fixture_patch_add_uint32(image_fixture_patch_t *patch, uint32_t value);
+
+uint8_t *image_fixture_firmware_create(void)
+{
+    uint8_t *image = (uint8_t *)malloc(IMAGE_FIXTURE_FIRMWARE_SIZE);
+
+    if (image == NULL)
+    {
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < IMAGE_FIXTURE_FIRMWARE_SIZE; i++)
+    {
+        if (i % 4096U >= 3584U)
+        {
+            image[i] = 0xFF;
+        }
+        else
+        {
+            image[i] = (uint8_t)(((i / 16U) % 97U) * 7U + (i % 16U == 0 ? i >> 10 : i % 5U));
+        }
+    }
+
+    return image;
+}
+
+// Greedy encoder, tests only: searches the whole window on each byte.
+uint8_t *image_fixture_compress(const uint8_t *image, uint32_t image_size, uint32_t *compressed_size)
+{
+    uint32_t window_size = 1U << IMAGE_FIXTURE_WINDOW_BITS;
+    uint32_t max_match = 1U << IMAGE_FIXTURE_LOOKAHEAD_BITS;
+
+    // Worst case: every byte a literal, 9 bits each.
+    image_fixture_bit_writer_t writer = {.buffer = (uint8_t *)malloc(image_size + image_size / 8U + 1U), .length = 0, .bits = 0, .bits_count = 0};
+
+    if (writer.buffer == NULL)
+    {
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < image_size;)
+    {
+        uint32_t best_length = 0;
+        uint32_t best_distance = 0;
+        uint32_t max_length = image_size - i < max_match ? image_size - i : max_match;
+
+        for (uint32_t distance = 1; distance <= window_size && distance <= i; distance++)
+        {
+            uint32_t length = 0;
+
+            while (length < max_length && image[i - distance + length] == image[i + length])
+            {
+                length++;
+            }
+
+            if (length > best_length)
+            {
+                best_length = length;
+                best_distance = distance;
+
+                if (length == max_length)
+                {
+                    break;
+                }
+            }
+        }
+
+        if (best_length >= IMAGE_FIXTURE_MIN_MATCH)
+        {
+            image_fixture_bits_write(&writer, 0, 1);
+            image_fixture_bits_write(&writer, best_distance - 1U, IMAGE_FIXTURE_WINDOW_BITS);
+            image_fixture_bits_write(&writer, best_length - 1U, IMAGE_FIXTURE_LOOKAHEAD_BITS);
+
+            i += best_length;
+        }
+        else
+        {
+            image_fixture_bits_write(&writer, 1, 1);
+            image_fixture_bits_write(&writer, image[i], 8);
+
+            i++;
+        }
+    }
+
+    // Padded with zero bits to a whole byte.
+    if (writer.bits_count > 0)
+    {
+        image_fixture_bits_write(&writer, 0, 8 - writer.bits_count);
+    }
+
+    *compressed_size = writer.length;
+
+    return writer.buffer;
+}
+
+static void image_fixture_bits_write(image_fixture_bit_writer_t *writer, uint32_t value, uint8_t count)
+{
+    while (count > 0)
+    {
+        count--;
+
+        writer->bits = (uint8_t)((writer->bits << 1) | ((value >> count) & 1U));
+        writer->bits_count++;
+
+        if (writer->bits_count == 8)
+        {
+            writer->buffer[writer->length++] = writer->bits;
+            writer->bits = 0;
+            writer->bits_count = 0;
+        }
+    }
+}
+
+bool image_fixture_decompression_compare(uint8_t *block, uint32_t block_length, uint32_t offset, void *callback_context)
+{
+    image_fixture_decompression_context_t *context = (image_fixture_decompression_context_t *)callback_context;
+
+    // Full blocks, but the last, handed over in order.
+    if (offset != context->next_offset ||
+        block_length > context->block_size ||
+        offset + block_length > IMAGE_FIXTURE_FIRMWARE_SIZE ||
+        memcmp(block, context->expected + offset, block_length) != 0)
+    {
+        context->mismatch = true;
+        return false;
+    }
+
+    context->next_offset += block_length;
+
+    return true;
+}
+
+void image_fixture_delta_create(uint8_t **old_image, uint8_t **new_image)
+{
+    *old_image = (uint8_t *)malloc(IMAGE_FIXTURE_DELTA_OLD_SIZE);
+    *new_image = (uint8_t *)malloc(IMAGE_FIXTURE_DELTA_NEW_SIZE);
+
+    if (*old_image == NULL || *new_image == NULL)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < IMAGE_FIXTURE_DELTA_OLD_SIZE; i++)
+    {
+        (*old_image)[i] = (uint8_t)((i * 31U) ^ (i >> 8));
+    }
+
+    uint8_t *next = *new_image;
+
+    memcpy(next, *old_image, IMAGE_FIXTURE_DELTA_SPLIT_AT);
+    next += IMAGE_FIXTURE_DELTA_SPLIT_AT;
+
+    for (uint32_t i = 0; i < IMAGE_FIXTURE_DELTA_INSERTED; i++)
+    {
+        *next++ = (uint8_t)(i * 7U);
+    }
+
+    memcpy(next, *old_image + IMAGE_FIXTURE_DELTA_SPLIT_AT + IMAGE_FIXTURE_DELTA_REMOVED, IMAGE_FIXTURE_DELTA_OLD_SIZE - IMAGE_FIXTURE_DELTA_SPLIT_AT - IMAGE_FIXTURE_DELTA_REMOVED);
+    next += IMAGE_FIXTURE_DELTA_OLD_SIZE - IMAGE_FIXTURE_DELTA_SPLIT_AT - IMAGE_FIXTURE_DELTA_REMOVED;
+
+    memcpy(next, *old_image, IMAGE_FIXTURE_DELTA_APPENDED);
+
+    for (uint32_t i = 0; i < IMAGE_FIXTURE_DELTA_NEW_SIZE; i += 1024U)
+    {
+        (*new_image)[i]++;
+    }
+}
+
+image_fixture_patch_t image_fixture_patch_create(const uint8_t *old_image, const uint8_t *new_image)
+{
+    image_fixture_patch_t patch = {.buffer = (uint8_t *)malloc(IMAGE_FIXTURE_DELTA_NEW_SIZE + 64U), .length = 0};
+    uint32_t tail_length = IMAGE_FIXTURE_DELTA_OLD_SIZE - IMAGE_FIXTURE_DELTA_SPLIT_AT - IMAGE_FIXTURE_DELTA_REMOVED;
+
+    if (patch.buffer == NULL)
+    {
+        return patch;
+    }
+
+    memcpy(patch.buffer, IMAGE_PATCHER_MAGIC, sizeof(IMAGE_PATCHER_MAGIC) - 1);
+    patch.length = sizeof(IMAGE_PATCHER_MAGIC) - 1;
+
+    image_fixture_patch_add_uint32(&patch, IMAGE_FIXTURE_DELTA_NEW_SIZE);
+
+    // Head, then the inserted bytes; the removed ones skipped.
+    image_fixture_patch_add_record(&patch, old_image, 0, new_image, 0, IMAGE_FIXTURE_DELTA_SPLIT_AT, IMAGE_FIXTURE_DELTA_INSERTED, IMAGE_FIXTURE_DELTA_REMOVED);
+
+    // Tail; then back to the old image start.
+    image_fixture_patch_add_record(&patch,
+                                   old_image,
+                                   IMAGE_FIXTURE_DELTA_SPLIT_AT + IMAGE_FIXTURE_DELTA_REMOVED,
+                                   new_image,
+                                   IMAGE_FIXTURE_DELTA_SPLIT_AT + IMAGE_FIXTURE_DELTA_INSERTED,
+                                   tail_length,
+                                   0,
+                                   -(int32_t)IMAGE_FIXTURE_DELTA_OLD_SIZE);
+
+    image_fixture_patch_add_record(&patch, old_image, 0, new_image, IMAGE_FIXTURE_DELTA_NEW_SIZE - IMAGE_FIXTURE_DELTA_APPENDED, IMAGE_FIXTURE_DELTA_APPENDED, 0, 0);
+
+    return patch;
+}
+
+static void image_fixture_patch_add_record(image_fixture_patch_t *patch,
+                                           const uint8_t *old_image,
+                                           uint32_t old_offset,
+                                           const uint8_t *new_image,
+                                           uint32_t new_offset,
+                                           uint32_t diff_length,
+                                           uint32_t extra_length,
+                                           int32_t adjustment)
+{
+    image_fixture_patch_add_uint32(patch, diff_length);
+
+    for (uint32_t i = 0; i < diff_length; i++)
+    {
+        patch->buffer[patch->length++] = (uint8_t)(new_image[new_offset + i] - old_image[old_offset + i]);
+    }
+
+    image_fixture_patch_add_uint32(patch, extra_length);
+
+    memcpy(patch->buffer + patch->length, new_image + new_offset + diff_length, extra_length);
+    patch->length += extra_length;
+
+    image_fixture_patch_add_uint32(patch, (uint32_t)adjustment);
+}
+
+static void image_fixture_patch_add_uint32(image_fixture_patch_t *patch, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        patch->buffer[patch->length++] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+bool image_fixture_patch_read(uint32_t offset, uint8_t *buffer, uint32_t length, void *callback_context)
+{
+    image_fixture_patch_context_t *context = (image_fixture_patch_context_t *)callback_context;
+
+    if (offset > IMAGE_FIXTURE_DELTA_OLD_SIZE || length > IMAGE_FIXTURE_DELTA_OLD_SIZE - offset)
+    {
+        return false;
+    }
+
+    memcpy(buffer, context->old_image + offset, length);
+
+    return true;
+}
+
+bool image_fixture_patch_compare(uint8_t *block, uint32_t block_length, uint32_t offset, void *callback_context)
+{
+    image_fixture_patch_context_t *context = (image_fixture_patch_context_t *)callback_context;
+
+    if (offset != context->next_offset ||
+        offset + block_length > IMAGE_FIXTURE_DELTA_NEW_SIZE ||
+        memcmp(block, context->expected + offset, block_length) != 0)
+    {
+        context->mismatch = true;
+        return false;
+    }
+
+    context->next_offset += block_length;
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef __ESP32_IOT_AZURE_TEST_IMAGE_FIXTURE_H__
+#define __ESP32_IOT_AZURE_TEST_IMAGE_FIXTURE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "config.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define IMAGE_FIXTURE_WINDOW_BITS CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_WINDOW_BITS
+#define IMAGE_FIXTURE_LOOKAHEAD_BITS CONFIG_ESP32_IOT_AZURE_DU_COMPRESSION_LOOKAHEAD_BITS
+
+#if CONFIG_IDF_TARGET_LINUX
+#define IMAGE_FIXTURE_FIRMWARE_SIZE (256U * 1024U)
+#else
+#define IMAGE_FIXTURE_FIRMWARE_SIZE (32U * 1024U)
+#endif
+
+#if CONFIG_IDF_TARGET_LINUX
+#define IMAGE_FIXTURE_DELTA_OLD_SIZE (256U * 1024U)
+#else
+#define IMAGE_FIXTURE_DELTA_OLD_SIZE (64U * 1024U)
+#endif
+
+// New image of a delta: the old one with a byte changed every kilobyte, bytes inserted
+// and removed in the middle, and the old image start appended at the end.
+#define IMAGE_FIXTURE_DELTA_SPLIT_AT 20000U
+#define IMAGE_FIXTURE_DELTA_INSERTED 300U
+#define IMAGE_FIXTURE_DELTA_REMOVED 500U
+#define IMAGE_FIXTURE_DELTA_APPENDED 1000U
+#define IMAGE_FIXTURE_DELTA_NEW_SIZE (IMAGE_FIXTURE_DELTA_OLD_SIZE + IMAGE_FIXTURE_DELTA_INSERTED - IMAGE_FIXTURE_DELTA_REMOVED + IMAGE_FIXTURE_DELTA_APPENDED)
+
+    /**
+     * @brief Context of @ref image_fixture_decompression_compare.
+     */
+    typedef struct
+    {
+        const uint8_t *expected; /** @brief Image expected, of @ref IMAGE_FIXTURE_FIRMWARE_SIZE bytes. */
+        uint32_t next_offset;    /** @brief Offset of the next block expected. */
+        uint32_t block_size;     /** @brief Block size of the decompressor. */
+        bool mismatch;           /** @brief Set if a block was not the one expected. */
+    } image_fixture_decompression_context_t;
+
+    /**
+     * @brief Patch built by @ref image_fixture_patch_create.
+     */
+    typedef struct
+    {
+        uint8_t *buffer; /** @brief Patch, to release with `free`. */
+        uint32_t length; /** @brief Length of the patch. */
+    } image_fixture_patch_t;
+
+    /**
+     * @brief Context of @ref image_fixture_patch_read and @ref image_fixture_patch_compare.
+     */
+    typedef struct
+    {
+        const uint8_t *old_image; /** @brief Old image, of @ref IMAGE_FIXTURE_DELTA_OLD_SIZE bytes. */
+        const uint8_t *expected;  /** @brief New image expected, of @ref IMAGE_FIXTURE_DELTA_NEW_SIZE bytes. */
+        uint32_t next_offset;     /** @brief Offset of the next block expected. */
+        bool mismatch;            /** @brief Set if a block was not the one expected. */
+    } image_fixture_patch_context_t;
+
+    /**
+     * @brief Create a firmware like image of @ref IMAGE_FIXTURE_FIRMWARE_SIZE bytes:
+     * runs of erased bytes between repetitive, not identical, code.
+     * @note The image must be released with `free`.
+     * @return The image or null on failure.
+     */
+    uint8_t *image_fixture_firmware_create(void);
+
+    /**
+     * @brief Compress an image as `heatshrink -e -w <window bits> -l <lookahead bits>` would,
+     * if not as compact.
+     * @note The result must be released with `free`.
+     * @param[in] image Image to compress.
+     * @param[in] image_size Size of \p image.
+     * @param[out] compressed_size Size of the result.
+     * @return The compressed image or null on failure.
+     */
+    uint8_t *image_fixture_compress(const uint8_t *image, uint32_t image_size, uint32_t *compressed_size);
+
+    /**
+     * @brief Decompressor callback checking the blocks, see @ref image_fixture_decompression_context_t.
+     */
+    bool image_fixture_decompression_compare(uint8_t *block, uint32_t block_length, uint32_t offset, void *callback_context);
+
+    /**
+     * @brief Create the old and new images of a delta update.
+     * @note Both images must be released with `free`; left null on failure.
+     * @param[out] old_image Old image, of @ref IMAGE_FIXTURE_DELTA_OLD_SIZE bytes.
+     * @param[out] new_image New image, of @ref IMAGE_FIXTURE_DELTA_NEW_SIZE bytes.
+     */
+    void image_fixture_delta_create(uint8_t **old_image, uint8_t **new_image);
+
+    /**
+     * @brief Build the patch from the old to the new image.
+     * @param[in] old_image Old image from @ref image_fixture_delta_create.
+     * @param[in] new_image New image from @ref image_fixture_delta_create.
+     * @return The patch; its buffer null on failure.
+     */
+    image_fixture_patch_t image_fixture_patch_create(const uint8_t *old_image, const uint8_t *new_image);
+
+    /**
+     * @brief Patcher callback reading the old image, see @ref image_fixture_patch_context_t.
+     */
+    bool image_fixture_patch_read(uint32_t offset, uint8_t *buffer, uint32_t length, void *callback_context);
+
+    /**
+     * @brief Patcher callback checking the blocks, see @ref image_fixture_patch_context_t.
+     */
+    bool image_fixture_patch_compare(uint8_t *block, uint32_t block_length, uint32_t offset, void *callback_context);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
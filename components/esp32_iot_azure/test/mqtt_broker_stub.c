@@ -0,0 +1,721 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mqtt_broker_stub.h"
+#include "benchmark.h"
+
+#define STUB_BUFFER_SIZE 16384U
+#define STUB_MAX_RESPONSES 64U
+#define STUB_TOPIC_MAX_LENGTH 256U
+#define STUB_WAIT_SLICE_US 200U
+#define STUB_DPS_OPERATION_ID "4.stub.operation"
+#define STUB_DPS_ASSIGNING "{\"operationId\":\"" STUB_DPS_OPERATION_ID "\",\"status\":\"assigning\"}"
+#define STUB_DPS_ASSIGNED "{\"operationId\":\"" STUB_DPS_OPERATION_ID "\",\"status\":\"assigned\",\"registrationState\":{" \
+                          "\"registrationId\":\"" MQTT_BROKER_STUB_DPS_DEVICE_ID "\",\"assignedHub\":\"" MQTT_BROKER_STUB_DPS_ASSIGNED_HUB "\"," \
+                          "\"deviceId\":\"" MQTT_BROKER_STUB_DPS_DEVICE_ID "\",\"status\":\"assigned\",\"substatus\":\"initialAssignment\"}}"
+
+#define MQTT_PACKET_CONNECT 0x10U
+#define MQTT_PACKET_CONNACK 0x20U
+#define MQTT_PACKET_PUBLISH 0x30U
+#define MQTT_PACKET_PUBACK 0x40U
+#define MQTT_PACKET_SUBSCRIBE 0x80U
+#define MQTT_PACKET_SUBACK 0x90U
+#define MQTT_PACKET_UNSUBSCRIBE 0xA0U
+#define MQTT_PACKET_UNSUBACK 0xB0U
+#define MQTT_PACKET_PINGREQ 0xC0U
+#define MQTT_PACKET_PINGRESP 0xD0U
+#define MQTT_PACKET_DISCONNECT 0xE0U
+
+typedef struct
+{
+    size_t end;          /** @brief Offset, on the response buffer, where the response ends. */
+    int64_t ready_at_us; /** @brief When the response becomes readable. */
+} stub_response_t;
+
+struct mqtt_broker_stub_t
+{
+    transport_driver_t driver;
+    mqtt_broker_stub_stats_t stats;
+    uint32_t response_delay_us;
+    uint32_t next_request_id;
+    int last_errno;
+    bool connected;        /** @brief Between the driver `connect` and `close`. */
+    bool tls;              /** @brief Whether the transport was created with a certificate. */
+    void *offered_session; /** @brief Session the client offers on the next connection. */
+    bool resumed;          /** @brief Whether the last connection resumed a session. */
+    bool commands_subscribed;
+    bool properties_subscribed;
+    uint32_t dps_assigning_polls;
+    uint32_t dps_retry_after_s;
+    uint32_t dps_polls_left;     /** @brief Operation status requests to answer "assigning". */
+    int64_t dps_responded_at_us; /** @brief When the last assigning response became readable. */
+    bool woken;                  /** @brief Set by the driver `wake`, from any thread. */
+    bool publishes_unacknowledged;
+    uint8_t received[STUB_BUFFER_SIZE];
+    size_t received_length;
+    uint8_t responses_buffer[STUB_BUFFER_SIZE];
+    size_t responses_head;
+    size_t responses_tail;
+    stub_response_t responses[STUB_MAX_RESPONSES];
+    size_t responses_count;
+};
+
+static void *stub_driver_create(const tls_certificate_t *certificate, void *driver_context);
+static void *stub_driver_session_get(void *handle);
+static void stub_driver_session_set(void *handle, void *session);
+static void stub_driver_session_free(void *session);
+static bool stub_driver_session_resumed(void *handle);
+static transport_status_t stub_driver_connect(void *handle, const char *hostname, uint16_t port, uint16_t timeout_ms);
+static int32_t stub_driver_write(void *handle, const uint8_t *buffer, size_t length, uint16_t timeout_ms);
+static int32_t stub_driver_read(void *handle, uint8_t *buffer, size_t length, uint16_t timeout_ms);
+static transport_wait_result_t stub_driver_wait(void *handle, uint32_t timeout_ms);
+static void stub_driver_wake(void *handle);
+static transport_status_t stub_driver_close(void *handle);
+static int stub_driver_get_errno(void *handle);
+static void stub_driver_destroy(void *handle);
+
+static bool stub_queue_packet(mqtt_broker_stub_t *stub, uint8_t header, const uint8_t *variable, size_t variable_length, const uint8_t *payload, size_t payload_length);
+static bool stub_queue_publish(mqtt_broker_stub_t *stub, const char *topic, const char *payload);
+static void stub_process_received(mqtt_broker_stub_t *stub);
+static void stub_handle_packet(mqtt_broker_stub_t *stub, uint8_t header, const uint8_t *body, size_t body_length);
+static void stub_handle_publish(mqtt_broker_stub_t *stub, const char *topic, const uint8_t *payload, size_t payload_length);
+static void stub_handle_subscribe(mqtt_broker_stub_t *stub, const uint8_t *body, size_t body_length);
+static bool stub_queue_dps_response(mqtt_broker_stub_t *stub, const char *topic, bool assigned);
+static void stub_get_request_id(const char *topic, char *request_id, size_t request_id_size);
+
+mqtt_broker_stub_t *mqtt_broker_stub_create(uint32_t response_delay_us)
+{
+    mqtt_broker_stub_t *stub = (mqtt_broker_stub_t *)malloc(sizeof(mqtt_broker_stub_t));
+
+    memset(stub, 0, sizeof(mqtt_broker_stub_t));
+
+    stub->response_delay_us = response_delay_us;
+    stub->dps_retry_after_s = 1U;
+    stub->stats.dps_min_poll_wait_ms = UINT32_MAX;
+    stub->driver.create = stub_driver_create;
+    stub->driver.set_client_certificate = NULL;
+    stub->driver.session_get = stub_driver_session_get;
+    stub->driver.session_set = stub_driver_session_set;
+    stub->driver.session_free = stub_driver_session_free;
+    stub->driver.session_resumed = stub_driver_session_resumed;
+    stub->driver.connect = stub_driver_connect;
+    stub->driver.write = stub_driver_write;
+    stub->driver.read = stub_driver_read;
+    stub->driver.wait = stub_driver_wait;
+    stub->driver.wake = stub_driver_wake;
+    stub->driver.close = stub_driver_close;
+    stub->driver.get_errno = stub_driver_get_errno;
+    stub->driver.destroy = stub_driver_destroy;
+    stub->driver.is_network_up = NULL;
+    stub->driver.context = stub;
+
+    return stub;
+}
+
+const transport_driver_t *mqtt_broker_stub_get_driver(mqtt_broker_stub_t *stub)
+{
+    return &stub->driver;
+}
+
+const mqtt_broker_stub_stats_t *mqtt_broker_stub_get_stats(mqtt_broker_stub_t *stub)
+{
+    return &stub->stats;
+}
+
+bool mqtt_broker_stub_invoke_command(mqtt_broker_stub_t *stub, const char *command_name, const char *payload)
+{
+    char topic[STUB_TOPIC_MAX_LENGTH];
+
+    if (!stub->commands_subscribed)
+    {
+        return false;
+    }
+
+    snprintf(topic, sizeof(topic), "$iothub/methods/POST/%s/?$rid=%lu", command_name, (unsigned long)++stub->next_request_id);
+
+    return stub_queue_publish(stub, topic, payload);
+}
+
+bool mqtt_broker_stub_update_desired_properties(mqtt_broker_stub_t *stub, const char *payload)
+{
+    if (!stub->properties_subscribed)
+    {
+        return false;
+    }
+
+    return stub_queue_publish(stub, "$iothub/twin/PATCH/properties/desired/?$version=2", payload);
+}
+
+void mqtt_broker_stub_set_dps_assignment(mqtt_broker_stub_t *stub, uint32_t assigning_polls, uint32_t retry_after_s)
+{
+    stub->dps_assigning_polls = assigning_polls;
+    stub->dps_retry_after_s = retry_after_s;
+}
+
+void mqtt_broker_stub_set_publish_acknowledged(mqtt_broker_stub_t *stub, bool acknowledged)
+{
+    stub->publishes_unacknowledged = !acknowledged;
+}
+
+void mqtt_broker_stub_free(mqtt_broker_stub_t *stub)
+{
+    free(stub);
+}
+
+// ======
+// DRIVER
+// ======
+
+static void *stub_driver_create(const tls_certificate_t *certificate, void *driver_context)
+{
+    mqtt_broker_stub_t *stub = (mqtt_broker_stub_t *)driver_context;
+
+    // Certificates are meaningless in memory: the broker accepts any transport.
+    stub->tls = certificate != NULL;
+    stub->offered_session = NULL;
+    stub->resumed = false;
+
+    return stub;
+}
+
+static void *stub_driver_session_get(void *handle)
+{
+    // The ticket content is meaningless: any ticket resumes.
+    return ((mqtt_broker_stub_t *)handle)->tls ? malloc(sizeof(uint32_t)) : NULL;
+}
+
+static void stub_driver_session_set(void *handle, void *session)
+{
+    ((mqtt_broker_stub_t *)handle)->offered_session = session;
+}
+
+static void stub_driver_session_free(void *session)
+{
+    free(session);
+}
+
+static bool stub_driver_session_resumed(void *handle)
+{
+    return ((mqtt_broker_stub_t *)handle)->resumed;
+}
+
+static transport_status_t stub_driver_connect(void *handle, const char *hostname, uint16_t port, uint16_t timeout_ms)
+{
+    mqtt_broker_stub_t *stub = (mqtt_broker_stub_t *)handle;
+
+    stub->connected = true;
+    stub->received_length = 0;
+    stub->responses_head = 0;
+    stub->responses_tail = 0;
+    stub->responses_count = 0;
+    stub->commands_subscribed = false;
+    stub->properties_subscribed = false;
+    stub->resumed = stub->tls && stub->offered_session != NULL;
+
+    if (stub->resumed)
+    {
+        stub->stats.resumptions++;
+    }
+    else if (stub->tls)
+    {
+        stub->stats.handshakes++;
+    }
+
+    return TRANSPORT_STATUS_SUCCESS;
+}
+
+static int32_t stub_driver_write(void *handle, const uint8_t *buffer, size_t length, uint16_t timeout_ms)
+{
+    mqtt_broker_stub_t *stub = (mqtt_broker_stub_t *)handle;
+
+    if (!stub->connected)
+    {
+        stub->last_errno = ENOTCONN;
+        return -1;
+    }
+
+    if (length > sizeof(stub->received) - stub->received_length)
+    {
+        stub->last_errno = ENOBUFS;
+        return -1;
+    }
+
+    memcpy(stub->received + stub->received_length, buffer, length);
+
+    stub->received_length += length;
+
+    stub_process_received(stub);
+
+    return (int32_t)length;
+}
+
+static int32_t stub_driver_read(void *handle, uint8_t *buffer, size_t length, uint16_t timeout_ms)
+{
+    mqtt_broker_stub_t *stub = (mqtt_broker_stub_t *)handle;
+    size_t readable_end = stub->responses_head;
+    int64_t now = benchmark_time_us();
+
+    if (!stub->connected)
+    {
+        stub->last_errno = ENOTCONN;
+        return -1;
+    }
+
+    if (stub->responses_count == 0)
+    {
+        // Nothing in flight: return right away instead of
+        // blocking for the timeout like a socket would.
+        return 0;
+    }
+
+    // Block, as a socket would, until the next response arrives.
+    if (stub->responses[0].ready_at_us > now)
+    {
+        int64_t wait_us = stub->responses[0].ready_at_us - now;
+
+        if (wait_us > (int64_t)timeout_ms * 1000)
+        {
+            return 0;
+        }
+
+        usleep((useconds_t)wait_us);
+
+        now = benchmark_time_us();
+    }
+
+    for (size_t i = 0; i < stub->responses_count && stub->responses[i].ready_at_us <= now; i++)
+    {
+        readable_end = stub->responses[i].end;
+    }
+
+    size_t read_length = readable_end - stub->responses_head;
+
+    if (read_length > length)
+    {
+        read_length = length;
+    }
+
+    memcpy(buffer, stub->responses_buffer + stub->responses_head, read_length);
+
+    stub->responses_head += read_length;
+
+    size_t consumed = 0;
+
+    while (consumed < stub->responses_count && stub->responses[consumed].end <= stub->responses_head)
+    {
+        consumed++;
+    }
+
+    if (consumed > 0)
+    {
+        stub->responses_count -= consumed;
+
+        memmove(stub->responses, stub->responses + consumed, stub->responses_count * sizeof(stub_response_t));
+    }
+
+    if (stub->responses_head == stub->responses_tail)
+    {
+        stub->responses_head = 0;
+        stub->responses_tail = 0;
+    }
+
+    return (int32_t)read_length;
+}
+
+static transport_wait_result_t stub_driver_wait(void *handle, uint32_t timeout_ms)
+{
+    mqtt_broker_stub_t *stub = (mqtt_broker_stub_t *)handle;
+    int64_t deadline_us = benchmark_time_us() + (int64_t)timeout_ms * 1000;
+
+    // Like a closed socket: fails right away.
+    if (!stub->connected)
+    {
+        stub->last_errno = ENOTCONN;
+        return TRANSPORT_WAIT_FAILURE;
+    }
+
+    // Sleeps in slices, as there is no socket to poll.
+    while (true)
+    {
+        int64_t now = benchmark_time_us();
+
+        if (stub->responses_count > 0 && stub->responses[0].ready_at_us <= now)
+        {
+            return TRANSPORT_WAIT_READABLE;
+        }
+
+        if (__atomic_exchange_n(&stub->woken, false, __ATOMIC_ACQ_REL))
+        {
+            return TRANSPORT_WAIT_WOKEN;
+        }
+
+        if (now >= deadline_us)
+        {
+            return TRANSPORT_WAIT_TIMEOUT;
+        }
+
+        usleep(STUB_WAIT_SLICE_US);
+    }
+}
+
+static void stub_driver_wake(void *handle)
+{
+    __atomic_store_n(&((mqtt_broker_stub_t *)handle)->woken, true, __ATOMIC_RELEASE);
+}
+
+static transport_status_t stub_driver_close(void *handle)
+{
+    ((mqtt_broker_stub_t *)handle)->connected = false;
+
+    return TRANSPORT_STATUS_SUCCESS;
+}
+
+static int stub_driver_get_errno(void *handle)
+{
+    return ((mqtt_broker_stub_t *)handle)->last_errno;
+}
+
+static void stub_driver_destroy(void *handle)
+{
+    // The broker is owned by the test: see mqtt_broker_stub_free.
+}
+
+// =======
+// PACKETS
+// =======
+
+static bool stub_queue_packet(mqtt_broker_stub_t *stub,
+                              uint8_t header,
+                              const uint8_t *variable,
+                              size_t variable_length,
+                              const uint8_t *payload,
+                              size_t payload_length)
+{
+    uint8_t remaining_length[4];
+    size_t remaining_length_size = 0;
+    size_t remaining = variable_length + payload_length;
+
+    do
+    {
+        remaining_length[remaining_length_size] = remaining % 128;
+        remaining /= 128;
+
+        if (remaining > 0)
+        {
+            remaining_length[remaining_length_size] |= 0x80;
+        }
+
+        remaining_length_size++;
+    } while (remaining > 0 && remaining_length_size < sizeof(remaining_length));
+
+    size_t packet_length = 1 + remaining_length_size + variable_length + payload_length;
+
+    if (stub->responses_tail + packet_length > sizeof(stub->responses_buffer) && stub->responses_head > 0)
+    {
+        size_t pending = stub->responses_tail - stub->responses_head;
+
+        memmove(stub->responses_buffer, stub->responses_buffer + stub->responses_head, pending);
+
+        for (size_t i = 0; i < stub->responses_count; i++)
+        {
+            stub->responses[i].end -= stub->responses_head;
+        }
+
+        stub->responses_head = 0;
+        stub->responses_tail = pending;
+    }
+
+    if (stub->responses_tail + packet_length > sizeof(stub->responses_buffer) || stub->responses_count == STUB_MAX_RESPONSES)
+    {
+        printf("mqtt broker stub: response dropped, buffer full\n");
+        return false;
+    }
+
+    uint8_t *packet = stub->responses_buffer + stub->responses_tail;
+
+    packet[0] = header;
+    memcpy(packet + 1, remaining_length, remaining_length_size);
+    memcpy(packet + 1 + remaining_length_size, variable, variable_length);
+
+    if (payload_length > 0)
+    {
+        memcpy(packet + 1 + remaining_length_size + variable_length, payload, payload_length);
+    }
+
+    stub->responses_tail += packet_length;
+    stub->responses[stub->responses_count].end = stub->responses_tail;
+    stub->responses[stub->responses_count].ready_at_us = benchmark_time_us() + stub->response_delay_us;
+    stub->responses_count++;
+
+    return true;
+}
+
+static bool stub_queue_publish(mqtt_broker_stub_t *stub, const char *topic, const char *payload)
+{
+    uint8_t variable[2 + STUB_TOPIC_MAX_LENGTH];
+    size_t topic_length = strlen(topic);
+
+    variable[0] = (uint8_t)(topic_length >> 8);
+    variable[1] = (uint8_t)(topic_length & 0xFF);
+    memcpy(variable + 2, topic, topic_length);
+
+    // QoS 0: the broker does not track acknowledgments from the device.
+    return stub_queue_packet(stub,
+                             MQTT_PACKET_PUBLISH,
+                             variable,
+                             2 + topic_length,
+                             (const uint8_t *)payload,
+                             payload == NULL ? 0 : strlen(payload));
+}
+
+static void stub_process_received(mqtt_broker_stub_t *stub)
+{
+    size_t offset = 0;
+
+    while (stub->received_length - offset >= 2)
+    {
+        size_t remaining_length = 0;
+        size_t multiplier = 1;
+        size_t header_length = 1;
+        uint8_t encoded;
+
+        do
+        {
+            if (offset + header_length >= stub->received_length)
+            {
+                goto incomplete;
+            }
+
+            encoded = stub->received[offset + header_length];
+            remaining_length += (encoded & 0x7F) * multiplier;
+            multiplier *= 128;
+            header_length++;
+        } while ((encoded & 0x80) != 0 && header_length < 5);
+
+        if (stub->received_length - offset - header_length < remaining_length)
+        {
+            break;
+        }
+
+        stub_handle_packet(stub,
+                           stub->received[offset],
+                           stub->received + offset + header_length,
+                           remaining_length);
+
+        offset += header_length + remaining_length;
+    }
+
+incomplete:
+    if (offset > 0)
+    {
+        stub->received_length -= offset;
+
+        memmove(stub->received, stub->received + offset, stub->received_length);
+    }
+}
+
+static void stub_handle_packet(mqtt_broker_stub_t *stub, uint8_t header, const uint8_t *body, size_t body_length)
+{
+    switch (header & 0xF0)
+    {
+    case MQTT_PACKET_CONNECT:
+    {
+        const uint8_t connack[2] = {0x00, 0x00};
+
+        stub->stats.connections++;
+        stub_queue_packet(stub, MQTT_PACKET_CONNACK, connack, sizeof(connack), NULL, 0);
+        break;
+    }
+
+    case MQTT_PACKET_PUBLISH:
+    {
+        uint8_t qos = (header >> 1) & 0x03;
+        size_t topic_length = ((size_t)body[0] << 8) | body[1];
+        size_t position = 2 + topic_length;
+        char topic[STUB_TOPIC_MAX_LENGTH];
+
+        snprintf(topic, sizeof(topic), "%.*s", (int)topic_length, (const char *)(body + 2));
+
+        if (qos > 0)
+        {
+            const uint8_t puback[2] = {body[position], body[position + 1]};
+
+            position += 2;
+
+            stub_handle_publish(stub, topic, body + position, body_length - position);
+
+            if (!stub->publishes_unacknowledged)
+            {
+                stub_queue_packet(stub, MQTT_PACKET_PUBACK, puback, sizeof(puback), NULL, 0);
+            }
+        }
+        else
+        {
+            stub_handle_publish(stub, topic, body + position, body_length - position);
+        }
+        break;
+    }
+
+    case MQTT_PACKET_SUBSCRIBE:
+        stub_handle_subscribe(stub, body, body_length);
+        break;
+
+    case MQTT_PACKET_UNSUBSCRIBE:
+    {
+        const uint8_t unsuback[2] = {body[0], body[1]};
+
+        stub_queue_packet(stub, MQTT_PACKET_UNSUBACK, unsuback, sizeof(unsuback), NULL, 0);
+        break;
+    }
+
+    case MQTT_PACKET_PINGREQ:
+        stub->stats.pings++;
+        stub_queue_packet(stub, MQTT_PACKET_PINGRESP, NULL, 0, NULL, 0);
+        break;
+
+    default:
+        // PUBACK for broker publishes (sent with QoS 0, never expected) and DISCONNECT.
+        break;
+    }
+}
+
+static void stub_handle_publish(mqtt_broker_stub_t *stub, const char *topic, const uint8_t *payload, size_t payload_length)
+{
+    char request_id[16];
+    char response_topic[STUB_TOPIC_MAX_LENGTH];
+
+    if (strncmp(topic, "devices/", sizeof("devices/") - 1) == 0 && strstr(topic, "/messages/events/") != NULL)
+    {
+        stub->stats.telemetry_messages++;
+        stub->stats.telemetry_bytes += payload_length;
+
+        snprintf(stub->stats.last_telemetry, sizeof(stub->stats.last_telemetry), "%.*s", (int)payload_length, (const char *)payload);
+        snprintf(stub->stats.last_properties,
+                 sizeof(stub->stats.last_properties),
+                 "%s",
+                 strstr(topic, "/messages/events/") + sizeof("/messages/events/") - 1);
+    }
+    else if (strncmp(topic, "$iothub/twin/GET/", sizeof("$iothub/twin/GET/") - 1) == 0)
+    {
+        stub->stats.twin_requests++;
+        stub_get_request_id(topic, request_id, sizeof(request_id));
+        snprintf(response_topic, sizeof(response_topic), "$iothub/twin/res/200/?$rid=%s", request_id);
+        stub_queue_publish(stub, response_topic, "{\"desired\":{\"$version\":1},\"reported\":{\"$version\":1}}");
+    }
+    else if (strncmp(topic, "$iothub/twin/PATCH/properties/reported/", sizeof("$iothub/twin/PATCH/properties/reported/") - 1) == 0)
+    {
+        stub->stats.twin_requests++;
+        stub_get_request_id(topic, request_id, sizeof(request_id));
+        snprintf(response_topic, sizeof(response_topic), "$iothub/twin/res/204/?$rid=%s&$version=2", request_id);
+        stub_queue_publish(stub, response_topic, NULL);
+    }
+    else if (strncmp(topic, "$iothub/methods/res/", sizeof("$iothub/methods/res/") - 1) == 0)
+    {
+        stub->stats.command_responses++;
+    }
+    else if (strncmp(topic, "$dps/registrations/PUT/iotdps-register/", sizeof("$dps/registrations/PUT/iotdps-register/") - 1) == 0)
+    {
+        stub->stats.dps_registrations++;
+        stub->dps_polls_left = stub->dps_assigning_polls;
+        stub_queue_dps_response(stub, topic, false);
+    }
+    else if (strncmp(topic, "$dps/registrations/GET/iotdps-get-operationstatus/", sizeof("$dps/registrations/GET/iotdps-get-operationstatus/") - 1) == 0)
+    {
+        int64_t waited_us = benchmark_time_us() - stub->dps_responded_at_us;
+
+        stub->stats.dps_polls++;
+
+        if (waited_us < (int64_t)stub->stats.dps_min_poll_wait_ms * 1000)
+        {
+            stub->stats.dps_min_poll_wait_ms = (uint32_t)(waited_us / 1000);
+        }
+
+        if (stub->dps_polls_left > 0)
+        {
+            stub->dps_polls_left--;
+            stub_queue_dps_response(stub, topic, false);
+        }
+        else
+        {
+            stub_queue_dps_response(stub, topic, true);
+        }
+    }
+}
+
+static void stub_handle_subscribe(mqtt_broker_stub_t *stub, const uint8_t *body, size_t body_length)
+{
+    uint8_t suback[2 + 8] = {body[0], body[1]};
+    size_t suback_length = 2;
+    size_t position = 2;
+
+    while (position + 2 < body_length && suback_length < sizeof(suback))
+    {
+        size_t filter_length = ((size_t)body[position] << 8) | body[position + 1];
+        const char *filter = (const char *)(body + position + 2);
+        uint8_t requested_qos = body[position + 2 + filter_length];
+
+        if (strncmp(filter, "$iothub/methods/POST/", sizeof("$iothub/methods/POST/") - 1) == 0)
+        {
+            stub->commands_subscribed = true;
+        }
+        else if (strncmp(filter, "$iothub/twin/PATCH/properties/desired/", sizeof("$iothub/twin/PATCH/properties/desired/") - 1) == 0)
+        {
+            stub->properties_subscribed = true;
+        }
+
+        suback[suback_length++] = requested_qos > 1 ? 1 : requested_qos;
+        position += 2 + filter_length + 1;
+    }
+
+    stub_queue_packet(stub, MQTT_PACKET_SUBACK, suback, suback_length, NULL, 0);
+}
+
+static bool stub_queue_dps_response(mqtt_broker_stub_t *stub, const char *topic, bool assigned)
+{
+    char request_id[16];
+    char response_topic[STUB_TOPIC_MAX_LENGTH];
+
+    stub_get_request_id(topic, request_id, sizeof(request_id));
+
+    if (assigned)
+    {
+        snprintf(response_topic, sizeof(response_topic), "$dps/registrations/res/200/?$rid=%s", request_id);
+
+        return stub_queue_publish(stub, response_topic, STUB_DPS_ASSIGNED);
+    }
+
+    snprintf(response_topic,
+             sizeof(response_topic),
+             "$dps/registrations/res/202/?$rid=%s&retry-after=%lu",
+             request_id,
+             (unsigned long)stub->dps_retry_after_s);
+
+    stub->dps_responded_at_us = benchmark_time_us() + stub->response_delay_us;
+
+    return stub_queue_publish(stub, response_topic, STUB_DPS_ASSIGNING);
+}
+
+static void stub_get_request_id(const char *topic, char *request_id, size_t request_id_size)
+{
+    const char *start = strstr(topic, "$rid=");
+    size_t length = 0;
+
+    request_id[0] = '\0';
+
+    if (start == NULL)
+    {
+        return;
+    }
+
+    start += sizeof("$rid=") - 1;
+
+    while (start[length] != '\0' && start[length] != '&' && length < request_id_size - 1)
+    {
+        request_id[length] = start[length];
+        length++;
+    }
+
+    request_id[length] = '\0';
+}
@@ -0,0 +1,99 @@
+#ifndef __ESP32_IOT_AZURE_TEST_MQTT_BROKER_STUB_H__
+#define __ESP32_IOT_AZURE_TEST_MQTT_BROKER_STUB_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "infrastructure/transport.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define MQTT_BROKER_STUB_DPS_ASSIGNED_HUB "bench.azure-devices.net"
+#define MQTT_BROKER_STUB_DPS_DEVICE_ID "bench-device"
+
+    /**
+     * @typedef mqtt_broker_stub_t
+     * @brief In-memory MQTT 3.1.1 broker speaking the Azure IoT Hub and DPS topic conventions.
+     * @details Plugged into the component through @ref transport_set_driver:
+     * bytes written by the client are parsed as MQTT packets and the
+     * responses (CONNACK, PUBACK, SUBACK, twin responses, ...) are queued
+     * to be read back. TLS transports are issued session tickets, counting
+     * the handshakes resuming them. Supports a single connection.
+     */
+    typedef struct mqtt_broker_stub_t mqtt_broker_stub_t;
+
+    /**
+     * @brief Broker counters.
+     */
+    typedef struct
+    {
+        uint32_t connections;          /** @brief CONNECT packets received. */
+        uint32_t handshakes;           /** @brief TLS full handshakes. */
+        uint32_t resumptions;          /** @brief TLS handshakes resuming a previous session. */
+        uint32_t telemetry_messages;   /** @brief PUBLISH packets on the telemetry topic. */
+        uint64_t telemetry_bytes;      /** @brief Telemetry payload bytes. */
+        char last_telemetry[32];       /** @brief Start of the last telemetry payload, null-terminated. */
+        char last_properties[64];      /** @brief Properties on the last telemetry topic, null-terminated. */
+        uint32_t twin_requests;        /** @brief Twin GET and reported properties PATCH requests. */
+        uint32_t command_responses;    /** @brief Command responses received. */
+        uint32_t pings;                /** @brief PINGREQ packets received. */
+        uint32_t dps_registrations;    /** @brief DPS register requests. */
+        uint32_t dps_polls;            /** @brief DPS operation status requests. */
+        uint32_t dps_min_poll_wait_ms; /** @brief Shortest wait between an assigning response and the next poll; `UINT32_MAX` if none. */
+    } mqtt_broker_stub_stats_t;
+
+    /**
+     * @brief Create a broker.
+     * @note Must be released by @ref mqtt_broker_stub_free.
+     * @param[in] response_delay_us Delay, in microseconds, before a response
+     * becomes readable by the client. Emulates the network round trip.
+     */
+    mqtt_broker_stub_t *mqtt_broker_stub_create(uint32_t response_delay_us);
+
+    /**
+     * @brief Get the transport driver backed by the broker.
+     */
+    const transport_driver_t *mqtt_broker_stub_get_driver(mqtt_broker_stub_t *stub);
+
+    /**
+     * @brief Get the broker counters.
+     */
+    const mqtt_broker_stub_stats_t *mqtt_broker_stub_get_stats(mqtt_broker_stub_t *stub);
+
+    /**
+     * @brief Queue a command (direct method) invocation to the device.
+     * @return true if queued, false if the device is not subscribed to commands.
+     */
+    bool mqtt_broker_stub_invoke_command(mqtt_broker_stub_t *stub, const char *command_name, const char *payload);
+
+    /**
+     * @brief Queue a desired properties update to the device.
+     * @return true if queued, false if the device is not subscribed to properties.
+     */
+    bool mqtt_broker_stub_update_desired_properties(mqtt_broker_stub_t *stub, const char *payload);
+
+    /**
+     * @brief Set how DPS answers registrations: "assigning", with the retry-after interval,
+     * to the register request and to the first \p assigning_polls operation status requests,
+     * then "assigned" to @ref MQTT_BROKER_STUB_DPS_ASSIGNED_HUB.
+     * @note Defaults to no assigning polls and a retry-after of 1 second.
+     */
+    void mqtt_broker_stub_set_dps_assignment(mqtt_broker_stub_t *stub, uint32_t assigning_polls, uint32_t retry_after_s);
+
+    /**
+     * @brief Set whether QoS 1 publishes get a PUBACK.
+     * @note Defaults to acknowledged. Unacknowledged telemetry keeps the publish window full.
+     */
+    void mqtt_broker_stub_set_publish_acknowledged(mqtt_broker_stub_t *stub, bool acknowledged);
+
+    /**
+     * @brief Release the broker.
+     */
+    void mqtt_broker_stub_free(mqtt_broker_stub_t *stub);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,171 @@
+#include "config.h"
+
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DU_ENABLED
+
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_adu_workflow.h"
+#include "infrastructure/transport.h"
+#include "mbedtls/sha256.h"
+#include "adu_fixture.h"
+#include "http_server_stub.h"
+
+static void test_download_resume_run(const uint8_t *resource, const char *hash_base64);
+
+TEST_CASE("ADU download resumes where it was interrupted", "[adu][http]")
+{
+    char hash_base64[64];
+    uint8_t *image = adu_fixture_image_create(hash_base64, sizeof(hash_base64));
+
+    TEST_ASSERT_NOT_NULL(image);
+
+    test_download_resume_run(image, hash_base64);
+
+    free(image);
+}
+
+TEST_CASE("ADU file url parsing honours the scheme and port", "[adu][http]")
+{
+    uint8_t parse_buffer[64];
+    parsed_file_url_t parsed_url;
+
+    adu_fixture_parse_url("http://updates.bench.local/firmware.bin", parse_buffer, &parsed_url);
+
+    TEST_ASSERT_FALSE(parsed_url.secure);
+    TEST_ASSERT_EQUAL_UINT16(80, parsed_url.port);
+    TEST_ASSERT_EQUAL_STRING("updates.bench.local", (const char *)parsed_url.hostname);
+    TEST_ASSERT_EQUAL_STRING("/firmware.bin", (const char *)parsed_url.path);
+
+    adu_fixture_parse_url("HTTPS://updates.bench.local/a/firmware.bin?sv=1", parse_buffer, &parsed_url);
+
+    TEST_ASSERT_TRUE(parsed_url.secure);
+    TEST_ASSERT_EQUAL_UINT16(443, parsed_url.port);
+    TEST_ASSERT_EQUAL_STRING("updates.bench.local", (const char *)parsed_url.hostname);
+    TEST_ASSERT_EQUAL_UINT32(sizeof("updates.bench.local"), parsed_url.hostname_length);
+    TEST_ASSERT_EQUAL_STRING("/a/firmware.bin?sv=1", (const char *)parsed_url.path);
+    TEST_ASSERT_EQUAL_UINT32(sizeof("/a/firmware.bin?sv=1"), parsed_url.path_length);
+
+    adu_fixture_parse_url("https://updates.bench.local:8443/firmware.bin", parse_buffer, &parsed_url);
+
+    TEST_ASSERT_TRUE(parsed_url.secure);
+    TEST_ASSERT_EQUAL_UINT16(8443, parsed_url.port);
+    TEST_ASSERT_EQUAL_STRING("updates.bench.local", (const char *)parsed_url.hostname);
+    TEST_ASSERT_EQUAL_STRING("/firmware.bin", (const char *)parsed_url.path);
+
+    static const char *const invalid[] = {
+        "ftp://updates.bench.local/firmware.bin",
+        "https://updates.bench.local",
+        "https://updates.bench.local:/firmware.bin",
+        "https://updates.bench.local:70000/firmware.bin",
+        "https://updates.bench.local:44x/firmware.bin"};
+
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        AzureIoTADUUpdateManifestFileUrl_t file_url = {
+            .pucUrl = (uint8_t *)invalid[i],
+            .ulUrlLength = strlen(invalid[i])};
+
+        TEST_ASSERT_EQUAL(eAzureIoTErrorInvalidArgument, azure_adu_file_parse_url(&file_url, parse_buffer, &parsed_url));
+    }
+}
+
+// Same steps as the workflow across a reboot: the first download stops halfway,
+// the second starts from the offset and hash state the workflow checkpoints.
+static void test_download_resume_run(const uint8_t *resource, const char *hash_base64)
+{
+    uint16_t chunk_size = 4096;
+    uint8_t parse_buffer[sizeof(ADU_FIXTURE_FILE_URL) + 2];
+    uint32_t download_buffer_length = chunk_size + ADU_WORKFLOW_DOWNLOAD_BUFFER_EXTRA_BYTES;
+    uint8_t *download_buffer = (uint8_t *)malloc(download_buffer_length);
+    AzureADUImage_t image;
+    parsed_file_url_t parsed_url;
+    mbedtls_sha256_context hash_state;
+    AzureIoTADUUpdateManifestFileUrl_t file_url = {
+        .pucFileID = (uint8_t *)"bench",
+        .ulFileIDLength = sizeof("bench") - 1,
+        .pucUrl = (uint8_t *)ADU_FIXTURE_FILE_URL,
+        .ulUrlLength = sizeof(ADU_FIXTURE_FILE_URL) - 1};
+    http_server_stub_config_t config = adu_fixture_server_config(resource, 0);
+    adu_fixture_download_context_t download_context = {
+        .image = &image,
+        .writer = NULL,
+        .stop_at = ADU_FIXTURE_IMAGE_SIZE / 2,
+        .write_failed = false};
+
+    memset(&image, 0, sizeof(image));
+
+    TEST_ASSERT_NOT_NULL(download_buffer);
+
+    if (AzureIoTPlatform_Init(&image) != eAzureIoTSuccess)
+    {
+        free(download_buffer);
+        TEST_IGNORE_MESSAGE("needs an OTA partition table");
+    }
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_adu_file_parse_url(&file_url, parse_buffer, &parsed_url));
+
+    http_server_stub_t *server = http_server_stub_create(&config);
+
+    transport_set_driver(http_server_stub_get_driver(server));
+
+    TEST_ASSERT_EQUAL(eAzureIoTErrorFailed, azure_adu_file_download(&parsed_url,
+                                                                    download_buffer,
+                                                                    download_buffer_length,
+                                                                    chunk_size,
+                                                                    adu_fixture_write_to_flash,
+                                                                    &download_context,
+                                                                    0,
+                                                                    &image.image_size,
+                                                                    NULL));
+
+    uint32_t offset = image.hashed_size;
+
+    TEST_ASSERT_EQUAL_UINT32(ADU_FIXTURE_IMAGE_SIZE / 2, offset);
+
+    mbedtls_sha256_init(&hash_state);
+    mbedtls_sha256_clone(&hash_state, &image.sha256);
+#if !CONFIG_IDF_TARGET_LINUX
+    esp_ota_abort(image.ota);
+#endif
+
+    transport_set_driver(NULL);
+    http_server_stub_free(server);
+
+    // Reboot.
+    memset(&image, 0, sizeof(image));
+
+    server = http_server_stub_create(&config);
+    download_context.stop_at = 0;
+
+    transport_set_driver(http_server_stub_get_driver(server));
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, AzureIoTPlatform_Init(&image));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, AzureIoTPlatform_ResumeImage(&image, offset, &hash_state));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_adu_file_download(&parsed_url,
+                                                                download_buffer,
+                                                                download_buffer_length,
+                                                                chunk_size,
+                                                                adu_fixture_write_to_flash,
+                                                                &download_context,
+                                                                offset,
+                                                                &image.image_size,
+                                                                NULL));
+
+    // Only what was missing was downloaded, and the hash carried on.
+    TEST_ASSERT_FALSE(download_context.write_failed);
+    TEST_ASSERT_EQUAL_UINT64(ADU_FIXTURE_IMAGE_SIZE - offset, http_server_stub_get_stats(server)->body_bytes);
+    TEST_ASSERT_EQUAL_UINT32(ADU_FIXTURE_IMAGE_SIZE, image.hashed_size);
+#if CONFIG_IDF_TARGET_LINUX
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, AzureIoTPlatform_VerifyImage(&image, (uint8_t *)hash_base64, strlen(hash_base64)));
+#else
+    esp_ota_abort(image.ota);
+#endif
+
+    mbedtls_sha256_free(&hash_state);
+    transport_set_driver(NULL);
+    http_server_stub_free(server);
+    free(download_buffer);
+}
+
+#endif
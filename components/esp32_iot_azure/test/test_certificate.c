@@ -0,0 +1,44 @@
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_sdk.h"
+#include "infrastructure/azure_iot_certificate.h"
+#include "infrastructure/transport.h"
+#include "mbedtls/x509_crt.h"
+
+TEST_CASE("Azure trust store is parsed once and shared by transports", "[certificate]")
+{
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_sdk_init());
+
+    const tls_certificate_t *first = azure_iot_certificate_take();
+    const tls_certificate_t *second = azure_iot_certificate_take();
+
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_EQUAL_PTR(first, second);
+    TEST_ASSERT_EQUAL(TLS_CERT_FORMAT_X509, first->format);
+
+    const mbedtls_x509_crt *chain = (const mbedtls_x509_crt *)first->data;
+
+    // At least one root, kept in place: not copied out of the DER table.
+    TEST_ASSERT_NOT_NULL(chain->raw.p);
+    TEST_ASSERT_TRUE(chain->raw.len > 0);
+
+    azure_iot_certificate_release();
+    azure_iot_certificate_release();
+    azure_iot_sdk_deinit();
+}
+
+TEST_CASE("Azure trust store is taken without the SDK initialization", "[certificate]")
+{
+    const tls_certificate_t *certificate = azure_iot_certificate_take();
+
+    TEST_ASSERT_NOT_NULL(certificate);
+    TEST_ASSERT_EQUAL(TLS_CERT_FORMAT_X509, certificate->format);
+    TEST_ASSERT_NOT_NULL(certificate->data);
+
+    azure_iot_certificate_release();
+
+    // Freed with the last reference, parsed again by the next taker.
+    TEST_ASSERT_NOT_NULL(azure_iot_certificate_take());
+
+    azure_iot_certificate_release();
+    azure_iot_certificate_deinit();
+}
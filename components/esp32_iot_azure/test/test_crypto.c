@@ -0,0 +1,56 @@
+#include <string.h>
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_sdk.h"
+#include "infrastructure/crypto.h"
+#include "config.h"
+
+TEST_CASE("HMAC-SHA256 matches RFC 4231 with and without the key cache", "[crypto]")
+{
+    // RFC 4231, test cases 2 and 6: short key, and key longer than a SHA-256 block.
+    static const uint8_t expected_short_key[32] = {
+        0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+        0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83, 0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43};
+    static const uint8_t expected_long_key[32] = {
+        0x60, 0xe4, 0x31, 0x59, 0x1e, 0xe0, 0xb6, 0x7f, 0x0d, 0x8a, 0x26, 0xaa, 0xcb, 0xf5, 0xb7, 0x7f,
+        0x8e, 0x0b, 0xc6, 0x21, 0x37, 0x28, 0xc5, 0x14, 0x05, 0x46, 0x04, 0x0f, 0x0e, 0xe3, 0x7f, 0x54};
+    static const char long_key_data[] = "Test Using Larger Than Block-Size Key - Hash Key First";
+    static const char short_key_data[] = "what do ya want for nothing?";
+    uint8_t long_key[131];
+    uint8_t output[33];
+    uint32_t bytes_copied;
+    crypto_statistics_t statistics;
+
+    memset(long_key, 0xAA, sizeof(long_key));
+
+    // Uncached, before the SDK initializes the crypto backend.
+    TEST_ASSERT_EQUAL_UINT32(0, crypto_hash_hmac_256((const uint8_t *)"Jefe", 4, (const uint8_t *)short_key_data, sizeof(short_key_data) - 1, output, sizeof(output), &bytes_copied));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_short_key, output, 32);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_sdk_init());
+
+    for (int i = 0; i < 2; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(0, crypto_hash_hmac_256((const uint8_t *)"Jefe", 4, (const uint8_t *)short_key_data, sizeof(short_key_data) - 1, output, sizeof(output), &bytes_copied));
+        TEST_ASSERT_EQUAL_UINT32(32, bytes_copied);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_short_key, output, 32);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0, crypto_hash_hmac_256(long_key, sizeof(long_key), (const uint8_t *)long_key_data, sizeof(long_key_data) - 1, output, sizeof(output), &bytes_copied));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_long_key, output, 32);
+
+    crypto_get_statistics(&statistics);
+
+    TEST_ASSERT_EQUAL_UINT32(3, statistics.hmac_calls);
+#if CONFIG_IDF_TARGET_ESP32 && CONFIG_MBEDTLS_HARDWARE_SHA
+    // Keyed on the peripheral on every call.
+    TEST_ASSERT_EQUAL_UINT32(0, statistics.hmac_key_hits);
+    TEST_ASSERT_TRUE(statistics.hardware);
+#else
+    TEST_ASSERT_EQUAL_UINT32(1, statistics.hmac_key_hits);
+#endif
+#if CONFIG_IDF_TARGET_LINUX
+    TEST_ASSERT_FALSE(statistics.hardware);
+#endif
+
+    azure_iot_sdk_deinit();
+}
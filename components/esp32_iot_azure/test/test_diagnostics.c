@@ -0,0 +1,60 @@
+#include "config.h"
+
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DIAGNOSTICS_ENABLED
+
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_hub.h"
+#include "esp32_iot_azure/azure_iot_diagnostics.h"
+#include "hub_fixture.h"
+
+TEST_CASE("Diagnostics reports the fields set by the twin", "[hub][mqtt][diagnostics]")
+{
+    hub_fixture_t fixture;
+    AzureIoTJSONReader_t json_reader;
+    uint8_t diagnostics_memory[512];
+    buffer_t diagnostics_buffer = {
+        .buffer = diagnostics_memory,
+        .length = sizeof(diagnostics_memory)};
+    const char desired[] = "{\"fields\":16,\"interval\":0}";
+    uint32_t properties_received = 0;
+
+    hub_fixture_setup(&fixture, 0, NULL);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_subscribe_properties(fixture.hub, hub_fixture_on_properties, &properties_received));
+
+    azure_iot_diagnostics_t *diagnostics = azure_iot_diagnostics_create(fixture.hub, &diagnostics_buffer);
+
+    TEST_ASSERT_NOT_NULL(diagnostics);
+
+    const mqtt_broker_stub_stats_t *stats = mqtt_broker_stub_get_stats(fixture.broker);
+
+    // As left by AzureIoTHubClientProperties_GetNextComponentProperty: on each property name.
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, AzureIoTJSONReader_Init(&json_reader, (const uint8_t *)desired, sizeof(desired) - 1));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, AzureIoTJSONReader_NextToken(&json_reader));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, AzureIoTJSONReader_NextToken(&json_reader));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_diagnostics_parse_property(diagnostics, &json_reader));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_diagnostics_parse_property(diagnostics, &json_reader));
+    TEST_ASSERT_EQUAL_UINT32(AZURE_IOT_DIAGNOSTICS_FIELD_ERRORS, azure_iot_diagnostics_get_fields(diagnostics));
+    TEST_ASSERT_EQUAL_UINT32(0, azure_iot_diagnostics_get_interval(diagnostics));
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_diagnostics_send_response(diagnostics, 2));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_process_loop(fixture.hub));
+    TEST_ASSERT_EQUAL_UINT32(1, stats->twin_requests);
+
+    // Interval 0: no report.
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_diagnostics_process(diagnostics));
+    TEST_ASSERT_EQUAL_UINT32(0, stats->telemetry_messages);
+
+    azure_iot_diagnostics_record_error(diagnostics, 1);
+    azure_iot_diagnostics_record_error(diagnostics, 2);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_diagnostics_send(diagnostics));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_process_loop(fixture.hub));
+    TEST_ASSERT_EQUAL_UINT32(1, stats->telemetry_messages);
+    TEST_ASSERT_EQUAL_STRING("{\"errorCount\":2,\"lastErrors\":[2", stats->last_telemetry);
+
+    azure_iot_diagnostics_free(diagnostics);
+    hub_fixture_teardown(&fixture);
+}
+
+#endif
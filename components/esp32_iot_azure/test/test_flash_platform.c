@@ -0,0 +1,129 @@
+#include "config.h"
+
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DU_ENABLED
+
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "azure_iot_flash_platform.h"
+#include "adu_fixture.h"
+
+// Not a multiple of the flash sector: blocks straddle the erased boundary.
+#define TEST_BLOCK_SIZE 1000U
+
+static void test_image_init(AzureADUImage_t *image);
+static void test_image_write(AzureADUImage_t *image, const uint8_t *data, uint32_t from, uint32_t to);
+static void test_image_verified(AzureIoTResult_t result);
+
+TEST_CASE("ADU image is hashed while its blocks are written", "[adu][flash]")
+{
+    char hash_base64[64];
+    uint8_t *data = adu_fixture_image_create(hash_base64, sizeof(hash_base64));
+    AzureADUImage_t image;
+
+    TEST_ASSERT_NOT_NULL(data);
+
+    test_image_init(&image);
+    test_image_write(&image, data, 0, ADU_FIXTURE_IMAGE_SIZE);
+
+    // Nothing left to read back on verification.
+    TEST_ASSERT_EQUAL_UINT32(ADU_FIXTURE_IMAGE_SIZE, image.hashed_size);
+
+    test_image_verified(AzureIoTPlatform_VerifyImage(&image, (uint8_t *)hash_base64, strlen(hash_base64)));
+
+    free(data);
+}
+
+TEST_CASE("ADU image verification fails on a mismatched hash", "[adu][flash]")
+{
+    char hash_base64[64];
+    uint8_t *data = adu_fixture_image_create(hash_base64, sizeof(hash_base64));
+    AzureADUImage_t image;
+
+    TEST_ASSERT_NOT_NULL(data);
+
+    // Still valid base64, of another hash.
+    hash_base64[0] = hash_base64[0] == 'A' ? 'B' : 'A';
+
+    test_image_init(&image);
+    test_image_write(&image, data, 0, ADU_FIXTURE_IMAGE_SIZE);
+
+    TEST_ASSERT_EQUAL(eAzureIoTErrorFailed, AzureIoTPlatform_VerifyImage(&image, (uint8_t *)hash_base64, strlen(hash_base64)));
+
+    free(data);
+}
+
+TEST_CASE("ADU image written out of order is verified by reading it back", "[adu][flash]")
+{
+    char hash_base64[64];
+    uint8_t *data = adu_fixture_image_create(hash_base64, sizeof(hash_base64));
+    AzureADUImage_t image;
+
+    TEST_ASSERT_NOT_NULL(data);
+
+    test_image_init(&image);
+    test_image_write(&image, data, ADU_FIXTURE_IMAGE_SIZE / 2, ADU_FIXTURE_IMAGE_SIZE);
+    test_image_write(&image, data, 0, ADU_FIXTURE_IMAGE_SIZE / 2);
+
+    // The second half came first: only the first half was hashed in order.
+    TEST_ASSERT_EQUAL_UINT32(ADU_FIXTURE_IMAGE_SIZE / 2, image.hashed_size);
+
+    test_image_verified(AzureIoTPlatform_VerifyImage(&image, (uint8_t *)hash_base64, strlen(hash_base64)));
+
+    free(data);
+}
+
+#if CONFIG_IDF_TARGET_LINUX && CONFIG_ESP32_IOT_AZURE_DU_VERIFY_READ_BACK
+TEST_CASE("ADU image read back differing from the blocks written fails the verification", "[adu][flash]")
+{
+    char hash_base64[64];
+    uint8_t *data = adu_fixture_image_create(hash_base64, sizeof(hash_base64));
+    AzureADUImage_t image;
+
+    TEST_ASSERT_NOT_NULL(data);
+
+    test_image_init(&image);
+    test_image_write(&image, data, 0, ADU_FIXTURE_IMAGE_SIZE);
+
+    // A bit flipped by the flash: the hash of what was written still matches the manifest.
+    image.partition[ADU_FIXTURE_IMAGE_SIZE / 3] ^= 0x01;
+
+    TEST_ASSERT_EQUAL(eAzureIoTErrorFailed, AzureIoTPlatform_VerifyImage(&image, (uint8_t *)hash_base64, strlen(hash_base64)));
+
+    free(data);
+}
+#endif
+
+static void test_image_init(AzureADUImage_t *image)
+{
+    memset(image, 0, sizeof(AzureADUImage_t));
+
+    if (AzureIoTPlatform_Init(image) != eAzureIoTSuccess)
+    {
+        TEST_IGNORE_MESSAGE("needs an OTA partition table");
+    }
+
+    image->image_size = ADU_FIXTURE_IMAGE_SIZE;
+}
+
+static void test_image_write(AzureADUImage_t *image, const uint8_t *data, uint32_t from, uint32_t to)
+{
+    for (uint32_t offset = from; offset < to; offset += TEST_BLOCK_SIZE)
+    {
+        uint32_t block_size = to - offset > TEST_BLOCK_SIZE ? TEST_BLOCK_SIZE : to - offset;
+
+        TEST_ASSERT_EQUAL(eAzureIoTSuccess, AzureIoTPlatform_WriteBlock(image, offset, (uint8_t *)data + offset, block_size));
+    }
+}
+
+// The synthetic image is not an app image: the device rejects it when ending the OTA.
+static void test_image_verified(AzureIoTResult_t result)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, result);
+#else
+    TEST_ASSERT_EQUAL(eAzureIoTErrorFailed, result);
+#endif
+}
+
+#endif
@@ -0,0 +1,247 @@
+#include "config.h"
+
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DU_ENABLED
+
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_adu_workflow.h"
+#include "esp32_iot_azure/azure_iot_http_client.h"
+#include "esp32_iot_azure/extension/azure_iot_http_client_extension.h"
+#include "infrastructure/transport.h"
+#include "adu_fixture.h"
+#include "http_server_stub.h"
+
+#define TEST_REQUEST_BUFFER_SIZE 1024U
+#define TEST_CHUNK_SIZE 4096U
+#define TEST_DOWNLOAD_BUFFER_SIZE (TEST_CHUNK_SIZE + ADU_WORKFLOW_DOWNLOAD_BUFFER_EXTRA_BYTES)
+#define TEST_CLOSE_EVERY_REQUESTS 4U
+
+/**
+ * @brief Context of @ref test_download_check.
+ */
+typedef struct
+{
+    const uint8_t *image; /** @brief Image served. */
+    uint32_t downloaded;  /** @brief Bytes received, in order. */
+    bool mismatch;        /** @brief Set if a chunk was out of order or differed from the image. */
+} test_download_t;
+
+static bool test_download_check(uint8_t *chunk,
+                                uint32_t chunk_length,
+                                uint32_t start_offset,
+                                uint32_t resource_size,
+                                void *callback_context);
+
+TEST_CASE("HTTP Host header names the port unless the default of the scheme", "[http]")
+{
+    static const struct
+    {
+        uint16_t port;
+        bool secure;
+        const char *host;
+    } cases[] = {
+        {.port = 80, .secure = false, .host = ADU_FIXTURE_FILE_HOSTNAME},
+        {.port = 8080, .secure = false, .host = ADU_FIXTURE_FILE_HOSTNAME ":8080"},
+        {.port = 443, .secure = true, .host = ADU_FIXTURE_FILE_HOSTNAME},
+        {.port = 8443, .secure = true, .host = ADU_FIXTURE_FILE_HOSTNAME ":8443"},
+        {.port = 443, .secure = false, .host = ADU_FIXTURE_FILE_HOSTNAME ":443"}};
+    char hash_base64[64];
+    uint8_t *image = adu_fixture_image_create(hash_base64, sizeof(hash_base64));
+    char *request_buffer = (char *)malloc(TEST_REQUEST_BUFFER_SIZE);
+    uint32_t resource_size = 0;
+
+    TEST_ASSERT_NOT_NULL(image);
+    TEST_ASSERT_NOT_NULL(request_buffer);
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        http_server_stub_config_t config = adu_fixture_server_config(image, 0);
+        http_server_stub_t *server = http_server_stub_create(&config);
+
+        TEST_ASSERT_NOT_NULL(server);
+
+        transport_set_driver(http_server_stub_get_driver(server));
+
+        azure_http_context_t *http = azure_http_create(ADU_FIXTURE_FILE_HOSTNAME,
+                                                       sizeof(ADU_FIXTURE_FILE_HOSTNAME) - 1,
+                                                       ADU_FIXTURE_FILE_PATH,
+                                                       sizeof(ADU_FIXTURE_FILE_PATH) - 1,
+                                                       cases[i].port,
+                                                       cases[i].secure);
+
+        TEST_ASSERT_NOT_NULL(http);
+        TEST_ASSERT_EQUAL(eAzureIoTHTTPSuccess, azure_http_connect(http));
+
+        // Requests of the SDK client, then of the range download.
+        TEST_ASSERT_EQUAL(eAzureIoTHTTPSuccess, azure_http_get_resource_size(http, request_buffer, TEST_REQUEST_BUFFER_SIZE, &resource_size));
+        TEST_ASSERT_EQUAL_STRING(cases[i].host, http_server_stub_get_stats(server)->host);
+
+        TEST_ASSERT_EQUAL(eAzureIoTHTTPSuccess, azure_http_send_range_request(http, request_buffer, TEST_REQUEST_BUFFER_SIZE, 0, 1023));
+        TEST_ASSERT_EQUAL_STRING(cases[i].host, http_server_stub_get_stats(server)->host);
+
+        azure_http_disconnect(http);
+        azure_http_free(http);
+
+        transport_set_driver(NULL);
+
+        http_server_stub_free(server);
+    }
+
+    free(request_buffer);
+    free(image);
+}
+
+TEST_CASE("HTTP download keeps one connection alive across the range requests", "[adu][http]")
+{
+    char hash_base64[64];
+    uint8_t *image = adu_fixture_image_create(hash_base64, sizeof(hash_base64));
+    uint8_t *download_buffer = (uint8_t *)malloc(TEST_DOWNLOAD_BUFFER_SIZE);
+    uint8_t parse_buffer[sizeof(ADU_FIXTURE_FILE_URL) + 2];
+    parsed_file_url_t parsed_url;
+    azure_http_statistics_t statistics;
+    uint32_t file_size = 0;
+
+    TEST_ASSERT_NOT_NULL(image);
+    TEST_ASSERT_NOT_NULL(download_buffer);
+
+    test_download_t download = {.image = image, .downloaded = 0, .mismatch = false};
+    http_server_stub_config_t config = adu_fixture_server_config(image, 0);
+    http_server_stub_t *server = http_server_stub_create(&config);
+
+    transport_set_driver(http_server_stub_get_driver(server));
+
+    adu_fixture_parse_url(ADU_FIXTURE_FILE_URL, parse_buffer, &parsed_url);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_adu_file_download(&parsed_url,
+                                                                download_buffer,
+                                                                TEST_DOWNLOAD_BUFFER_SIZE,
+                                                                TEST_CHUNK_SIZE,
+                                                                test_download_check,
+                                                                &download,
+                                                                0,
+                                                                &file_size,
+                                                                &statistics));
+
+    const http_server_stub_stats_t *stats = http_server_stub_get_stats(server);
+
+    TEST_ASSERT_FALSE(download.mismatch);
+    TEST_ASSERT_EQUAL_UINT32(ADU_FIXTURE_IMAGE_SIZE, file_size);
+    TEST_ASSERT_EQUAL_UINT32(ADU_FIXTURE_IMAGE_SIZE, download.downloaded);
+
+    // One connection for the size and every chunk, counted alike by both ends.
+    TEST_ASSERT_EQUAL_UINT32(1, stats->connections);
+    TEST_ASSERT_EQUAL_UINT32(1, statistics.connections);
+    TEST_ASSERT_EQUAL_UINT32(stats->requests, statistics.requests);
+#if CONFIG_ESP32_IOT_AZURE_TRANSPORT_HTTP_DOWNLOAD_STREAMED
+    TEST_ASSERT_EQUAL_UINT32(2, statistics.requests);
+#else
+    TEST_ASSERT_EQUAL_UINT32(1 + ADU_FIXTURE_IMAGE_SIZE / TEST_CHUNK_SIZE, statistics.requests);
+#endif
+
+    transport_set_driver(NULL);
+
+    http_server_stub_free(server);
+    free(download_buffer);
+    free(image);
+}
+
+TEST_CASE("HTTP download reconnects before the next request when the server sends Connection: close", "[adu][http]")
+{
+    static const uint8_t pipeline_depths[] = {1, 4};
+    char hash_base64[64];
+    uint8_t *image = adu_fixture_image_create(hash_base64, sizeof(hash_base64));
+    char *download_buffer = (char *)malloc(TEST_DOWNLOAD_BUFFER_SIZE);
+    uint32_t resource_size = 0;
+
+    TEST_ASSERT_NOT_NULL(image);
+    TEST_ASSERT_NOT_NULL(download_buffer);
+
+    for (size_t i = 0; i < sizeof(pipeline_depths) / sizeof(pipeline_depths[0]); i++)
+    {
+        test_download_t download = {.image = image, .downloaded = 0, .mismatch = false};
+        http_server_stub_config_t config = adu_fixture_server_config(image, 0);
+
+        config.close_every_requests = TEST_CLOSE_EVERY_REQUESTS;
+
+        http_server_stub_t *server = http_server_stub_create(&config);
+
+        transport_set_driver(http_server_stub_get_driver(server));
+
+        azure_http_context_t *http = azure_http_create(ADU_FIXTURE_FILE_HOSTNAME,
+                                                       sizeof(ADU_FIXTURE_FILE_HOSTNAME) - 1,
+                                                       ADU_FIXTURE_FILE_PATH,
+                                                       sizeof(ADU_FIXTURE_FILE_PATH) - 1,
+                                                       80,
+                                                       false);
+
+        TEST_ASSERT_NOT_NULL(http);
+        TEST_ASSERT_EQUAL(eAzureIoTHTTPSuccess, azure_http_connect(http));
+        TEST_ASSERT_EQUAL(eAzureIoTHTTPSuccess, azure_http_get_resource_size(http, download_buffer, TEST_DOWNLOAD_BUFFER_SIZE, &resource_size));
+        TEST_ASSERT_EQUAL(eAzureIoTHTTPSuccess, azure_http_download_resource_pipelined(http,
+                                                                                       download_buffer,
+                                                                                       TEST_DOWNLOAD_BUFFER_SIZE,
+                                                                                       TEST_CHUNK_SIZE,
+                                                                                       pipeline_depths[i],
+                                                                                       test_download_check,
+                                                                                       &download,
+                                                                                       0,
+                                                                                       resource_size));
+
+        const http_server_stub_stats_t *stats = http_server_stub_get_stats(server);
+        const azure_http_statistics_t *statistics = azure_http_get_statistics(http);
+
+        TEST_ASSERT_FALSE(download.mismatch);
+        TEST_ASSERT_EQUAL_UINT32(ADU_FIXTURE_IMAGE_SIZE, download.downloaded);
+
+        // Nothing was written to a closed connection: every connection
+        // after the first was opened because the server closed one.
+        TEST_ASSERT_GREATER_THAN_UINT32(0, stats->closes);
+        TEST_ASSERT_EQUAL_UINT32(0, stats->closed_writes);
+        TEST_ASSERT_EQUAL_UINT32(0, stats->resets);
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32(stats->closes, stats->connections);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(stats->closes + 1, stats->connections);
+        TEST_ASSERT_EQUAL_UINT32(stats->connections, statistics->connections);
+        TEST_ASSERT_EQUAL_UINT32(stats->requests, statistics->requests);
+
+        if (pipeline_depths[i] == 1)
+        {
+            // Not pipelined: no request was in flight when a connection closed.
+            TEST_ASSERT_EQUAL_UINT32(1 + ADU_FIXTURE_IMAGE_SIZE / TEST_CHUNK_SIZE, statistics->requests);
+            TEST_ASSERT_EQUAL_UINT32(statistics->requests / TEST_CLOSE_EVERY_REQUESTS, stats->closes);
+        }
+
+        azure_http_disconnect(http);
+        azure_http_free(http);
+
+        transport_set_driver(NULL);
+
+        http_server_stub_free(server);
+    }
+
+    free(download_buffer);
+    free(image);
+}
+
+static bool test_download_check(uint8_t *chunk,
+                                uint32_t chunk_length,
+                                uint32_t start_offset,
+                                uint32_t resource_size,
+                                void *callback_context)
+{
+    test_download_t *download = (test_download_t *)callback_context;
+
+    if (start_offset != download->downloaded ||
+        start_offset + chunk_length > resource_size ||
+        memcmp(chunk, download->image + start_offset, chunk_length) != 0)
+    {
+        download->mismatch = true;
+        return false;
+    }
+
+    download->downloaded += chunk_length;
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_hub.h"
+#include "esp32_iot_azure/azure_iot_sdk.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "hub_fixture.h"
+#include "config.h"
+
+#define TEST_EVENTS_MAX_WAIT_MS 5000U
+
+TEST_CASE("Hub round trips twin and commands through the broker stand-in", "[hub][mqtt]")
+{
+    hub_fixture_t fixture;
+    uint32_t properties_received = 0;
+
+    hub_fixture_setup(&fixture, 0, NULL);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_subscribe_command(fixture.hub, hub_fixture_on_command, fixture.hub));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_subscribe_properties(fixture.hub, hub_fixture_on_properties, &properties_received));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_request_properties_async(fixture.hub));
+    TEST_ASSERT_TRUE(mqtt_broker_stub_invoke_command(fixture.broker, "reboot", "{}"));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_process_loop(fixture.hub));
+
+    const mqtt_broker_stub_stats_t *stats = mqtt_broker_stub_get_stats(fixture.broker);
+
+    TEST_ASSERT_EQUAL_UINT32(1, stats->connections);
+    TEST_ASSERT_EQUAL_UINT32(1, stats->twin_requests);
+    TEST_ASSERT_EQUAL_UINT32(1, stats->command_responses);
+    TEST_ASSERT_EQUAL_UINT32(1, properties_received);
+
+    hub_fixture_teardown(&fixture);
+}
+
+TEST_CASE("Hub reconnections resume the TLS session", "[hub][mqtt]")
+{
+    hub_fixture_t fixture;
+    azure_iot_tls_statistics_t tls_statistics;
+
+    hub_fixture_setup(&fixture, 0, NULL);
+
+    azure_iot_hub_disconnect(fixture.hub);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_connect(fixture.hub));
+
+    const mqtt_broker_stub_stats_t *stats = mqtt_broker_stub_get_stats(fixture.broker);
+
+    azure_iot_sdk_get_tls_statistics(&tls_statistics);
+
+    TEST_ASSERT_EQUAL_UINT32(2, stats->connections);
+    TEST_ASSERT_EQUAL_UINT32(stats->handshakes, tls_statistics.full_handshakes);
+    TEST_ASSERT_EQUAL_UINT32(stats->resumptions, tls_statistics.resumed_handshakes);
+
+#if CONFIG_ESP32_IOT_AZURE_TRANSPORT_TLS_SESSION_REUSE
+    TEST_ASSERT_EQUAL_UINT32(1, stats->handshakes);
+    TEST_ASSERT_EQUAL_UINT32(1, stats->resumptions);
+#else
+    TEST_ASSERT_EQUAL_UINT32(2, stats->handshakes);
+#endif
+
+    hub_fixture_teardown(&fixture);
+}
+
+TEST_CASE("Hub processes events as soon as they arrive", "[hub][mqtt]")
+{
+    hub_fixture_t fixture;
+
+    hub_fixture_setup(&fixture, 0, NULL);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_subscribe_command(fixture.hub, hub_fixture_on_command, fixture.hub));
+    TEST_ASSERT_TRUE(mqtt_broker_stub_invoke_command(fixture.broker, "reboot", "{}"));
+
+    TickType_t started_at = xTaskGetTickCount();
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_process_events(fixture.hub, TEST_EVENTS_MAX_WAIT_MS));
+    TEST_ASSERT_EQUAL_UINT32(1, mqtt_broker_stub_get_stats(fixture.broker)->command_responses);
+
+    azure_iot_hub_wake(fixture.hub);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_process_events(fixture.hub, TEST_EVENTS_MAX_WAIT_MS));
+
+    // Neither the command nor the wake-up waited for the loop timeout.
+    TEST_ASSERT_LESS_THAN_UINT32(pdMS_TO_TICKS(CONFIG_ESP32_IOT_AZURE_HUB_LOOP_TIMEOUT_MS), xTaskGetTickCount() - started_at);
+
+    hub_fixture_teardown(&fixture);
+}
+
+TEST_CASE("Hub publish window completes messages when acknowledged", "[hub][mqtt]")
+{
+    hub_fixture_t fixture;
+    uint32_t completed = 0;
+
+    hub_fixture_setup(&fixture, 0, NULL);
+
+    for (uint32_t i = 0; i < CONFIG_ESP32_IOT_AZURE_HUB_PUBLISH_WINDOW_SIZE; i++)
+    {
+        TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_send_telemetry_async(fixture.hub, (const uint8_t *)"{}", 2, NULL, 0, hub_fixture_on_telemetry_completed, &completed));
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(CONFIG_ESP32_IOT_AZURE_HUB_PUBLISH_WINDOW_SIZE, azure_iot_hub_get_telemetry_in_flight(fixture.hub));
+
+#if CONFIG_ESP32_IOT_AZURE_HUB_PUBLISH_WINDOW_WAIT_MS == 0
+    TEST_ASSERT_EQUAL(eAzureIoTErrorPending, azure_iot_hub_send_telemetry_async(fixture.hub, (const uint8_t *)"{}", 2, NULL, 0, hub_fixture_on_telemetry_completed, &completed));
+#endif
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_process_loop(fixture.hub));
+    TEST_ASSERT_EQUAL_UINT32(CONFIG_ESP32_IOT_AZURE_HUB_PUBLISH_WINDOW_SIZE, completed);
+    TEST_ASSERT_EQUAL_UINT32(0, azure_iot_hub_get_telemetry_in_flight(fixture.hub));
+
+    hub_fixture_teardown(&fixture);
+}
+
+TEST_CASE("Hub publish window is sent again after a reconnection", "[hub][mqtt]")
+{
+    hub_fixture_t fixture;
+    uint32_t completed = 0;
+
+    hub_fixture_setup(&fixture, 0, NULL);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_send_telemetry_async(fixture.hub, (const uint8_t *)"1", 1, NULL, 0, hub_fixture_on_telemetry_completed, &completed));
+    // Sent again from the copy: the payload follows the properties.
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_send_telemetry_async(fixture.hub, (const uint8_t *)"2", 1, (const uint8_t *)"$.sub=thermostat", 16, hub_fixture_on_telemetry_completed, &completed));
+
+    // The broker drops the acknowledgments not read on reconnection.
+    azure_iot_hub_disconnect(fixture.hub);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_connect(fixture.hub));
+
+    const mqtt_broker_stub_stats_t *stats = mqtt_broker_stub_get_stats(fixture.broker);
+
+    TEST_ASSERT_EQUAL_UINT32(4, stats->telemetry_messages);
+    TEST_ASSERT_EQUAL_STRING("2", stats->last_telemetry);
+    TEST_ASSERT_EQUAL_UINT32(0, completed);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_process_loop(fixture.hub));
+    TEST_ASSERT_EQUAL_UINT32(2, completed);
+
+    hub_fixture_teardown(&fixture);
+}
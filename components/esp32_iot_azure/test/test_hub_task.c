@@ -0,0 +1,150 @@
+#include <string.h>
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_hub.h"
+#include "esp32_iot_azure/azure_iot_hub_task.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "hub_fixture.h"
+#include "config.h"
+
+#define TEST_SENT_MAX_WAIT_MS 10000U
+#define TEST_DISCONNECTED_MS 1000U
+
+static void test_hub_task_wait_sent(azure_iot_hub_task_t *task, uint32_t sent);
+
+TEST_CASE("Hub task sends the requests enqueued", "[hub][mqtt]")
+{
+    hub_fixture_t fixture;
+    azure_iot_hub_task_statistics_t statistics;
+    AzureIoTHubClientCommandRequest_t command_request;
+    uint32_t properties_received = 0;
+
+    memset(&command_request, 0, sizeof(AzureIoTHubClientCommandRequest_t));
+
+    command_request.pucRequestID = (const uint8_t *)"1";
+    command_request.usRequestIDLength = 1;
+
+    hub_fixture_setup(&fixture, 0, NULL);
+
+    // Reported properties need the subscription.
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_subscribe_properties(fixture.hub, hub_fixture_on_properties, &properties_received));
+
+    azure_iot_hub_task_t *task = azure_iot_hub_task_create(fixture.hub);
+
+    TEST_ASSERT_NOT_NULL(task);
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_task_send_telemetry(task, (const uint8_t *)"{}", 2, NULL, 0, eAzureIoTHubMessageQoS1));
+    }
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_task_send_properties_reported(task, (const uint8_t *)"{}", 2));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_task_send_command_response(task, &command_request, NULL, 0, 200));
+
+    test_hub_task_wait_sent(task, 6);
+
+    azure_iot_hub_task_get_statistics(task, &statistics);
+    azure_iot_hub_task_free(task);
+
+    const mqtt_broker_stub_stats_t *stats = mqtt_broker_stub_get_stats(fixture.broker);
+
+    TEST_ASSERT_EQUAL_UINT32(0, statistics.failed);
+    TEST_ASSERT_EQUAL_UINT32(0, statistics.dropped);
+    TEST_ASSERT_EQUAL_UINT32(4, stats->telemetry_messages);
+    TEST_ASSERT_EQUAL_UINT32(1, stats->twin_requests);
+    TEST_ASSERT_EQUAL_UINT32(1, stats->command_responses);
+
+    hub_fixture_teardown(&fixture);
+}
+
+TEST_CASE("Hub task backs off while the hub is disconnected", "[hub][mqtt]")
+{
+    hub_fixture_t fixture;
+    azure_iot_hub_task_statistics_t statistics;
+
+    // Never connected: processing the events fails right away.
+    hub_fixture_init(&fixture, 0, NULL);
+
+    azure_iot_hub_task_t *task = azure_iot_hub_task_create(fixture.hub);
+
+    TEST_ASSERT_NOT_NULL(task);
+
+    vTaskDelay(pdMS_TO_TICKS(TEST_DISCONNECTED_MS));
+
+    azure_iot_hub_task_get_statistics(task, &statistics);
+
+    // At least the base delay between failures, instead of spinning.
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(1, statistics.process_failures);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(TEST_DISCONNECTED_MS / CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_BASE_MS + 1, statistics.process_failures);
+
+    // A request ends the back-off: it fails to be sent, not waiting for the delay.
+    TickType_t started_at = xTaskGetTickCount();
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_task_send_properties_reported(task, (const uint8_t *)"{}", 2));
+
+    do
+    {
+        vTaskDelay(pdMS_TO_TICKS(10));
+
+        azure_iot_hub_task_get_statistics(task, &statistics);
+    } while (statistics.failed == 0 && xTaskGetTickCount() - started_at < pdMS_TO_TICKS(TEST_SENT_MAX_WAIT_MS));
+
+    TEST_ASSERT_EQUAL_UINT32(1, statistics.failed);
+    TEST_ASSERT_EQUAL_UINT32(0, statistics.sent);
+    TEST_ASSERT_LESS_THAN_UINT32(pdMS_TO_TICKS(CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_BASE_MS), xTaskGetTickCount() - started_at);
+
+    // Stopping does not wait for the delay either.
+    started_at = xTaskGetTickCount();
+
+    azure_iot_hub_task_free(task);
+
+    TEST_ASSERT_LESS_THAN_UINT32(pdMS_TO_TICKS(CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_BASE_MS), xTaskGetTickCount() - started_at);
+
+    hub_fixture_teardown(&fixture);
+}
+
+TEST_CASE("Hub task stops while a request waits for room on the publish window", "[hub][mqtt]")
+{
+    hub_fixture_t fixture;
+
+    hub_fixture_setup(&fixture, 0, NULL);
+
+    // Never acknowledged: the window stays full.
+    mqtt_broker_stub_set_publish_acknowledged(fixture.broker, false);
+
+    azure_iot_hub_task_t *task = azure_iot_hub_task_create(fixture.hub);
+
+    TEST_ASSERT_NOT_NULL(task);
+
+    for (uint32_t i = 0; i < CONFIG_ESP32_IOT_AZURE_HUB_PUBLISH_WINDOW_SIZE + 2; i++)
+    {
+        TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_task_send_telemetry(task, (const uint8_t *)"{}", 2, NULL, 0, eAzureIoTHubMessageQoS1));
+    }
+
+    test_hub_task_wait_sent(task, CONFIG_ESP32_IOT_AZURE_HUB_PUBLISH_WINDOW_SIZE);
+
+    // Retried on every wake: stopping must not wait for an acknowledgment.
+    TickType_t started_at = xTaskGetTickCount();
+
+    azure_iot_hub_task_free(task);
+
+    TEST_ASSERT_LESS_THAN_UINT32(pdMS_TO_TICKS(TEST_SENT_MAX_WAIT_MS), xTaskGetTickCount() - started_at);
+    TEST_ASSERT_EQUAL_UINT32(CONFIG_ESP32_IOT_AZURE_HUB_PUBLISH_WINDOW_SIZE, mqtt_broker_stub_get_stats(fixture.broker)->telemetry_messages);
+
+    hub_fixture_teardown(&fixture);
+}
+
+static void test_hub_task_wait_sent(azure_iot_hub_task_t *task, uint32_t sent)
+{
+    azure_iot_hub_task_statistics_t statistics;
+    TickType_t started_at = xTaskGetTickCount();
+
+    do
+    {
+        vTaskDelay(pdMS_TO_TICKS(10));
+
+        azure_iot_hub_task_get_statistics(task, &statistics);
+    } while (statistics.sent + statistics.failed < sent && xTaskGetTickCount() - started_at < pdMS_TO_TICKS(TEST_SENT_MAX_WAIT_MS));
+
+    TEST_ASSERT_EQUAL_UINT32(sent, statistics.sent);
+}
@@ -0,0 +1,49 @@
+#include "config.h"
+
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DU_ENABLED
+
+#include <stdlib.h>
+#include "unity.h"
+#include "infrastructure/image_decompressor.h"
+#include "image_fixture.h"
+
+TEST_CASE("Decompressor restores a heatshrink image fed in any split", "[adu]")
+{
+    static const uint32_t splits[] = {1, 7, 333, 4096};
+    uint8_t *image = image_fixture_firmware_create();
+    uint32_t compressed_size;
+
+    TEST_ASSERT_NOT_NULL(image);
+
+    uint8_t *compressed = image_fixture_compress(image, IMAGE_FIXTURE_FIRMWARE_SIZE, &compressed_size);
+
+    TEST_ASSERT_NOT_NULL(compressed);
+    TEST_ASSERT_LESS_THAN_UINT32(IMAGE_FIXTURE_FIRMWARE_SIZE, compressed_size);
+
+    for (size_t s = 0; s < sizeof(splits) / sizeof(splits[0]); s++)
+    {
+        image_fixture_decompression_context_t context = {.expected = image, .next_offset = 0, .block_size = 1024, .mismatch = false};
+        image_decompressor_t *decompressor = image_decompressor_create(IMAGE_FIXTURE_WINDOW_BITS, IMAGE_FIXTURE_LOOKAHEAD_BITS, context.block_size, &image_fixture_decompression_compare, &context);
+
+        TEST_ASSERT_NOT_NULL(decompressor);
+
+        for (uint32_t offset = 0; offset < compressed_size; offset += splits[s])
+        {
+            uint32_t length = compressed_size - offset < splits[s] ? compressed_size - offset : splits[s];
+
+            TEST_ASSERT_TRUE(image_decompressor_write(decompressor, compressed + offset, length));
+        }
+
+        TEST_ASSERT_TRUE(image_decompressor_finish(decompressor));
+        TEST_ASSERT_FALSE(context.mismatch);
+        TEST_ASSERT_EQUAL_UINT32(IMAGE_FIXTURE_FIRMWARE_SIZE, context.next_offset);
+        TEST_ASSERT_EQUAL_UINT32(IMAGE_FIXTURE_FIRMWARE_SIZE, image_decompressor_get_size(decompressor));
+
+        image_decompressor_free(decompressor);
+    }
+
+    free(compressed);
+    free(image);
+}
+
+#endif
@@ -0,0 +1,88 @@
+#include "config.h"
+
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DU_ENABLED
+
+#include <stdlib.h>
+#include "unity.h"
+#include "infrastructure/image_patcher.h"
+#include "image_fixture.h"
+
+TEST_CASE("Patcher rebuilds the new image from the old one fed in any split", "[adu]")
+{
+    static const uint32_t splits[] = {1, 5, 333, 4096};
+    uint8_t *old_image;
+    uint8_t *new_image;
+
+    image_fixture_delta_create(&old_image, &new_image);
+
+    TEST_ASSERT_NOT_NULL(old_image);
+    TEST_ASSERT_NOT_NULL(new_image);
+
+    image_fixture_patch_t patch = image_fixture_patch_create(old_image, new_image);
+
+    TEST_ASSERT_NOT_NULL(patch.buffer);
+
+    for (size_t s = 0; s < sizeof(splits) / sizeof(splits[0]); s++)
+    {
+        image_fixture_patch_context_t context = {.old_image = old_image, .expected = new_image, .next_offset = 0, .mismatch = false};
+        image_patcher_t *patcher = image_patcher_create(1024, &image_fixture_patch_read, &image_fixture_patch_compare, &context);
+
+        TEST_ASSERT_NOT_NULL(patcher);
+
+        for (uint32_t offset = 0; offset < patch.length; offset += splits[s])
+        {
+            uint32_t length = patch.length - offset < splits[s] ? patch.length - offset : splits[s];
+
+            TEST_ASSERT_TRUE(image_patcher_write(patcher, patch.buffer + offset, length));
+        }
+
+        TEST_ASSERT_TRUE(image_patcher_finish(patcher));
+        TEST_ASSERT_FALSE(context.mismatch);
+        TEST_ASSERT_EQUAL_UINT32(IMAGE_FIXTURE_DELTA_NEW_SIZE, context.next_offset);
+
+        image_patcher_free(patcher);
+    }
+
+    free(patch.buffer);
+    free(new_image);
+    free(old_image);
+}
+
+TEST_CASE("Patcher rejects invalid and truncated patches", "[adu]")
+{
+    uint8_t *old_image;
+    uint8_t *new_image;
+
+    image_fixture_delta_create(&old_image, &new_image);
+
+    TEST_ASSERT_NOT_NULL(old_image);
+    TEST_ASSERT_NOT_NULL(new_image);
+
+    image_fixture_patch_t patch = image_fixture_patch_create(old_image, new_image);
+    image_fixture_patch_context_t context = {.old_image = old_image, .expected = new_image, .next_offset = 0, .mismatch = false};
+
+    TEST_ASSERT_NOT_NULL(patch.buffer);
+
+    image_patcher_t *patcher = image_patcher_create(1024, &image_fixture_patch_read, &image_fixture_patch_compare, &context);
+
+    TEST_ASSERT_NOT_NULL(patcher);
+    TEST_ASSERT_TRUE(image_patcher_write(patcher, patch.buffer, patch.length / 2));
+    TEST_ASSERT_FALSE(image_patcher_finish(patcher));
+
+    image_patcher_free(patcher);
+
+    patch.buffer[0] = 'X';
+
+    patcher = image_patcher_create(1024, &image_fixture_patch_read, &image_fixture_patch_compare, &context);
+
+    TEST_ASSERT_NOT_NULL(patcher);
+    TEST_ASSERT_FALSE(image_patcher_write(patcher, patch.buffer, patch.length));
+
+    image_patcher_free(patcher);
+
+    free(patch.buffer);
+    free(new_image);
+    free(old_image);
+}
+
+#endif
@@ -0,0 +1,50 @@
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_hub.h"
+#include "esp32_iot_azure/azure_iot_metrics.h"
+#include "hub_fixture.h"
+
+TEST_CASE("Metrics measure the hub connection, subscriptions and acknowledgments", "[hub][mqtt][metrics]")
+{
+    hub_fixture_t fixture;
+    uint32_t completed = 0;
+    azure_iot_metrics_snapshot_t snapshot;
+
+    hub_fixture_setup(&fixture, 0, NULL);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_subscribe_command(fixture.hub, hub_fixture_on_command, fixture.hub));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_send_telemetry_async(fixture.hub, (const uint8_t *)"{}", 2, NULL, 0, hub_fixture_on_telemetry_completed, &completed));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_process_loop(fixture.hub));
+    TEST_ASSERT_EQUAL_UINT32(1, completed);
+
+    azure_iot_metrics_snapshot(&snapshot, true);
+
+    TEST_ASSERT_EQUAL_UINT32(1, snapshot.histograms[AZURE_IOT_METRIC_TLS_CONNECT].count);
+    TEST_ASSERT_EQUAL_UINT32(1, snapshot.histograms[AZURE_IOT_METRIC_HUB_CONNECT].count);
+    TEST_ASSERT_EQUAL_UINT32(1, snapshot.histograms[AZURE_IOT_METRIC_HUB_SUBSCRIBE].count);
+    TEST_ASSERT_EQUAL_UINT32(1, snapshot.histograms[AZURE_IOT_METRIC_HUB_PUBACK].count);
+    TEST_ASSERT_EQUAL_UINT32(0, snapshot.histograms[AZURE_IOT_METRIC_HUB_PUBACK].errors);
+    TEST_ASSERT_TRUE(azure_iot_metrics_get_percentile_us(&snapshot.histograms[AZURE_IOT_METRIC_HUB_PUBACK], 99) > 0);
+    TEST_ASSERT_TRUE(azure_iot_metrics_get_percentile_us(&snapshot.histograms[AZURE_IOT_METRIC_HUB_PUBACK], 99) <=
+                     snapshot.histograms[AZURE_IOT_METRIC_HUB_PUBACK].max_us);
+    TEST_ASSERT_TRUE(snapshot.histograms[AZURE_IOT_METRIC_TRANSPORT_WRITE].count >= 3);
+    TEST_ASSERT_TRUE(snapshot.histograms[AZURE_IOT_METRIC_TRANSPORT_READ].count >= 3);
+
+    // Every operation lands in one bucket.
+    for (uint32_t metric = 0; metric < AZURE_IOT_METRIC_COUNT; metric++)
+    {
+        uint32_t bucketed = 0;
+
+        for (uint32_t bucket = 0; bucket < AZURE_IOT_METRICS_BUCKET_COUNT; bucket++)
+        {
+            bucketed += snapshot.histograms[metric].buckets[bucket];
+        }
+
+        TEST_ASSERT_EQUAL_UINT32(snapshot.histograms[metric].count, bucketed);
+    }
+
+    azure_iot_metrics_snapshot(&snapshot, false);
+
+    TEST_ASSERT_EQUAL_UINT32(0, snapshot.histograms[AZURE_IOT_METRIC_HUB_CONNECT].count);
+
+    hub_fixture_teardown(&fixture);
+}
@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_provisioning.h"
+#include "esp32_iot_azure/azure_iot_sdk.h"
+#include "infrastructure/transport.h"
+#include "mqtt_broker_stub.h"
+#include "config.h"
+
+#define TEST_DPS_HOSTNAME "global.azure-devices-provisioning.net"
+#define TEST_DPS_SCOPE_ID "0ne00000000"
+#define TEST_DPS_OTHER_SCOPE_ID "0ne00000001"
+// Any key: the broker stand-in does not check the signature.
+#define TEST_DPS_SYMMETRIC_KEY "c3R1Yi1zeW1tZXRyaWMta2V5"
+#define TEST_DPS_MQTT_BUFFER_SIZE 2048U
+#define TEST_DPS_ASSIGNING_POLLS 2U
+#define TEST_DPS_RETRY_AFTER_S 1U
+
+typedef struct
+{
+    mqtt_broker_stub_t *broker;
+    azure_dps_context_t *dps;
+    buffer_t mqtt_buffer;
+} test_dps_t;
+
+static void test_dps_setup(test_dps_t *fixture);
+static void test_dps_init(test_dps_t *fixture, const char *scope_id);
+static void test_dps_teardown(test_dps_t *fixture);
+
+TEST_CASE("DPS polls the operation status no sooner than the retry-after", "[dps][mqtt]")
+{
+    test_dps_t fixture;
+    azure_dps_statistics_t statistics;
+    uint8_t hostname[AZURE_CONST_HOSTNAME_MAX_LENGTH];
+    uint32_t hostname_length = sizeof(hostname);
+    uint8_t device_id[AZURE_CONST_DEVICE_ID_MAX_LENGTH];
+    uint32_t device_id_length = sizeof(device_id);
+
+    test_dps_setup(&fixture);
+
+    mqtt_broker_stub_set_dps_assignment(fixture.broker, TEST_DPS_ASSIGNING_POLLS, TEST_DPS_RETRY_AFTER_S);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_dps_register(fixture.dps));
+
+    const mqtt_broker_stub_stats_t *stats = mqtt_broker_stub_get_stats(fixture.broker);
+
+    // "Assigning" to the register request and to the first polls, then assigned.
+    TEST_ASSERT_EQUAL_UINT32(1, stats->dps_registrations);
+    TEST_ASSERT_EQUAL_UINT32(TEST_DPS_ASSIGNING_POLLS + 1, stats->dps_polls);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(TEST_DPS_RETRY_AFTER_S * 1000U, stats->dps_min_poll_wait_ms);
+
+    azure_dps_get_statistics(fixture.dps, &statistics);
+
+    // A wait per assigning response at most: each one waited for once, retry-after plus jitter.
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(1, statistics.polls);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(TEST_DPS_ASSIGNING_POLLS + 1, statistics.polls);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(statistics.polls * TEST_DPS_RETRY_AFTER_S * 1000U, statistics.waited_ms);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(statistics.polls * (TEST_DPS_RETRY_AFTER_S * 1000U + CONFIG_ESP32_IOT_AZURE_DPS_POLL_BACKOFF_MAX_DELAY_MS),
+                                     statistics.waited_ms);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_dps_get_device_and_hub(fixture.dps, hostname, &hostname_length, device_id, &device_id_length));
+    TEST_ASSERT_EQUAL_UINT32(sizeof(MQTT_BROKER_STUB_DPS_ASSIGNED_HUB) - 1, hostname_length);
+    TEST_ASSERT_EQUAL_STRING_LEN(MQTT_BROKER_STUB_DPS_ASSIGNED_HUB, (const char *)hostname, hostname_length);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(MQTT_BROKER_STUB_DPS_DEVICE_ID) - 1, device_id_length);
+    TEST_ASSERT_EQUAL_STRING_LEN(MQTT_BROKER_STUB_DPS_DEVICE_ID, (const char *)device_id, device_id_length);
+
+    test_dps_teardown(&fixture);
+}
+
+#if CONFIG_ESP32_IOT_AZURE_DPS_CACHE_ENABLED
+TEST_CASE("DPS registration is cached per scope and registration id until cleared", "[dps][mqtt]")
+{
+    test_dps_t fixture;
+    uint8_t hostname[AZURE_CONST_HOSTNAME_MAX_LENGTH];
+    uint32_t hostname_length = sizeof(hostname);
+    uint8_t device_id[AZURE_CONST_DEVICE_ID_MAX_LENGTH];
+    uint32_t device_id_length = sizeof(device_id);
+
+    test_dps_setup(&fixture);
+
+    const mqtt_broker_stub_stats_t *stats = mqtt_broker_stub_get_stats(fixture.broker);
+
+    // Miss: registers with DPS, caching the assignment.
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_dps_register(fixture.dps));
+    TEST_ASSERT_FALSE(azure_dps_is_registration_cached(fixture.dps));
+    TEST_ASSERT_EQUAL_UINT32(1, stats->connections);
+    TEST_ASSERT_EQUAL_UINT32(1, stats->dps_registrations);
+
+    // Hit: the assignment without connecting to DPS.
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_dps_register(fixture.dps));
+    TEST_ASSERT_TRUE(azure_dps_is_registration_cached(fixture.dps));
+    TEST_ASSERT_EQUAL_UINT32(1, stats->connections);
+    TEST_ASSERT_EQUAL_UINT32(1, stats->dps_registrations);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_dps_get_device_and_hub(fixture.dps, hostname, &hostname_length, device_id, &device_id_length));
+    TEST_ASSERT_EQUAL_UINT32(sizeof(MQTT_BROKER_STUB_DPS_ASSIGNED_HUB) - 1, hostname_length);
+    TEST_ASSERT_EQUAL_STRING_LEN(MQTT_BROKER_STUB_DPS_ASSIGNED_HUB, (const char *)hostname, hostname_length);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(MQTT_BROKER_STUB_DPS_DEVICE_ID) - 1, device_id_length);
+    TEST_ASSERT_EQUAL_STRING_LEN(MQTT_BROKER_STUB_DPS_DEVICE_ID, (const char *)device_id, device_id_length);
+
+    // Another scope: not this registration.
+    azure_dps_deinit(fixture.dps);
+    test_dps_init(&fixture, TEST_DPS_OTHER_SCOPE_ID);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_dps_register(fixture.dps));
+    TEST_ASSERT_FALSE(azure_dps_is_registration_cached(fixture.dps));
+    TEST_ASSERT_EQUAL_UINT32(2, stats->dps_registrations);
+
+    // Cleared: registers again, even after a hit on the same context.
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_dps_register(fixture.dps));
+    TEST_ASSERT_TRUE(azure_dps_is_registration_cached(fixture.dps));
+
+    azure_dps_clear_cache();
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_dps_register(fixture.dps));
+    TEST_ASSERT_FALSE(azure_dps_is_registration_cached(fixture.dps));
+    TEST_ASSERT_EQUAL_UINT32(3, stats->dps_registrations);
+
+    test_dps_teardown(&fixture);
+}
+#endif
+
+static void test_dps_setup(test_dps_t *fixture)
+{
+    fixture->broker = mqtt_broker_stub_create(0);
+    fixture->mqtt_buffer.length = TEST_DPS_MQTT_BUFFER_SIZE;
+    fixture->mqtt_buffer.buffer = (uint8_t *)malloc(TEST_DPS_MQTT_BUFFER_SIZE);
+
+    TEST_ASSERT_NOT_NULL(fixture->broker);
+    TEST_ASSERT_NOT_NULL(fixture->mqtt_buffer.buffer);
+
+    transport_set_driver(mqtt_broker_stub_get_driver(fixture->broker));
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_sdk_init());
+
+    // Registers with the broker, whatever a previous test cached.
+    azure_dps_clear_cache();
+
+    fixture->dps = azure_dps_create(&fixture->mqtt_buffer);
+
+    TEST_ASSERT_NOT_NULL(fixture->dps);
+
+    test_dps_init(fixture, TEST_DPS_SCOPE_ID);
+}
+
+static void test_dps_init(test_dps_t *fixture, const char *scope_id)
+{
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_dps_options_init(fixture->dps, NULL));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_dps_init(fixture->dps,
+                                                       (const uint8_t *)TEST_DPS_HOSTNAME,
+                                                       sizeof(TEST_DPS_HOSTNAME) - 1,
+                                                       (const uint8_t *)scope_id,
+                                                       strlen(scope_id),
+                                                       (const uint8_t *)MQTT_BROKER_STUB_DPS_DEVICE_ID,
+                                                       sizeof(MQTT_BROKER_STUB_DPS_DEVICE_ID) - 1));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_dps_auth_set_symmetric_key(fixture->dps,
+                                                                         (const uint8_t *)TEST_DPS_SYMMETRIC_KEY,
+                                                                         sizeof(TEST_DPS_SYMMETRIC_KEY) - 1));
+}
+
+static void test_dps_teardown(test_dps_t *fixture)
+{
+    azure_dps_deinit(fixture->dps);
+    azure_dps_free(fixture->dps);
+    azure_iot_sdk_deinit();
+
+    transport_set_driver(NULL);
+
+    mqtt_broker_stub_free(fixture->broker);
+    free(fixture->mqtt_buffer.buffer);
+}
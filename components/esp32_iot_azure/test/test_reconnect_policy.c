@@ -0,0 +1,44 @@
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_sdk.h"
+#include "infrastructure/reconnect_policy.h"
+#include "config.h"
+
+#define TEST_HOSTNAME "test.azure-devices.net"
+#define TEST_PORT 8883U
+
+TEST_CASE("Reconnect circuit opens after repeated failures, per server", "[transport]")
+{
+    uint32_t wait_ms = 0;
+    azure_iot_reconnect_statistics_t statistics;
+
+    if (CONFIG_ESP32_IOT_AZURE_TRANSPORT_CIRCUIT_BREAKER_THRESHOLD == 0)
+    {
+        TEST_IGNORE_MESSAGE("circuit breaker disabled");
+    }
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_sdk_init());
+
+    for (uint32_t i = 0; i < CONFIG_ESP32_IOT_AZURE_TRANSPORT_CIRCUIT_BREAKER_THRESHOLD; i++)
+    {
+        TEST_ASSERT_EQUAL(RECONNECT_POLICY_ATTEMPT, reconnect_policy_acquire(TEST_HOSTNAME, TEST_PORT, &wait_ms));
+
+        uint32_t delay_ms = reconnect_policy_failed(TEST_HOSTNAME, TEST_PORT);
+
+        TEST_ASSERT_TRUE(delay_ms >= CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_BASE_MS);
+        TEST_ASSERT_TRUE(delay_ms <= CONFIG_ESP32_IOT_AZURE_TRANSPORT_BACKOFF_MAX_DELAY_MS);
+    }
+
+    TEST_ASSERT_EQUAL(RECONNECT_POLICY_WAIT, reconnect_policy_acquire(TEST_HOSTNAME, TEST_PORT, &wait_ms));
+    TEST_ASSERT_TRUE(wait_ms > 0 && wait_ms <= CONFIG_ESP32_IOT_AZURE_TRANSPORT_CIRCUIT_BREAKER_OPEN_MS);
+
+    // Another server, or the same hostname on another port, is not affected.
+    TEST_ASSERT_EQUAL(RECONNECT_POLICY_ATTEMPT, reconnect_policy_acquire(TEST_HOSTNAME, 443, &wait_ms));
+
+    azure_iot_sdk_get_reconnect_statistics(&statistics);
+
+    TEST_ASSERT_EQUAL_UINT32(1, statistics.circuit_opens);
+    TEST_ASSERT_EQUAL_UINT32(1, statistics.rejected);
+    TEST_ASSERT_EQUAL_UINT32(CONFIG_ESP32_IOT_AZURE_TRANSPORT_CIRCUIT_BREAKER_THRESHOLD, statistics.failures);
+
+    azure_iot_sdk_deinit();
+}
@@ -0,0 +1,53 @@
+#include <string.h>
+#include "unity.h"
+#include "esp32_iot_azure/azure_iot_hub.h"
+#include "esp32_iot_azure/azure_iot_telemetry_batch.h"
+#include "hub_fixture.h"
+
+TEST_CASE("Telemetry batch packs samples in one message", "[hub][mqtt][telemetry]")
+{
+    hub_fixture_t fixture;
+    uint8_t batch_memory[32];
+    buffer_t batch_buffer = {
+        .buffer = batch_memory,
+        .length = sizeof(batch_memory)};
+
+    hub_fixture_setup(&fixture, 0, NULL);
+
+    azure_iot_telemetry_batch_t *batch = azure_iot_telemetry_batch_create(fixture.hub,
+                                                                          (const uint8_t *)HUB_FIXTURE_COMPONENT_NAME,
+                                                                          sizeof(HUB_FIXTURE_COMPONENT_NAME) - 1,
+                                                                          &batch_buffer,
+                                                                          0,
+                                                                          eAzureIoTHubMessageQoS0);
+    TEST_ASSERT_NOT_NULL(batch);
+
+    const mqtt_broker_stub_stats_t *stats = mqtt_broker_stub_get_stats(fixture.broker);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_telemetry_batch_add(batch, (const uint8_t *)"1", 1));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_telemetry_batch_add(batch, (const uint8_t *)"2", 1));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_telemetry_batch_add(batch, (const uint8_t *)"3", 1));
+    TEST_ASSERT_EQUAL_UINT32(0, stats->telemetry_messages);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_telemetry_batch_flush(batch));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_process_loop(fixture.hub));
+    TEST_ASSERT_EQUAL_UINT32(1, stats->telemetry_messages);
+    TEST_ASSERT_EQUAL_STRING("[1,2,3]", stats->last_telemetry);
+
+    // "[" + 5 * "12345" + 4 * "," + "]" = 31 bytes: the sixth sample sends the batch.
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_telemetry_batch_add(batch, (const uint8_t *)"12345", 5));
+    }
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_process_loop(fixture.hub));
+    TEST_ASSERT_EQUAL_UINT32(2, stats->telemetry_messages);
+    TEST_ASSERT_EQUAL_UINT32(31, strlen(stats->last_telemetry));
+    TEST_ASSERT_EQUAL_UINT32(1, azure_iot_telemetry_batch_get_sample_count(batch));
+
+    // Brackets do not fit.
+    TEST_ASSERT_EQUAL(eAzureIoTErrorOutOfMemory, azure_iot_telemetry_batch_add(batch, batch_memory, sizeof(batch_memory) - 1));
+
+    azure_iot_telemetry_batch_free(batch);
+    hub_fixture_teardown(&fixture);
+}
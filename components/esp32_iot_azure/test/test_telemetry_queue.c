@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp32_iot_azure/azure_iot_hub.h"
+#include "esp32_iot_azure/azure_iot_telemetry_batch.h"
+#include "esp32_iot_azure/azure_iot_telemetry_queue.h"
+#include "infrastructure/telemetry_log.h"
+#include "hub_fixture.h"
+#include "config.h"
+
+#define TEST_MESSAGE_COUNT 12U
+#define TEST_PROPERTIES "$.sub=" HUB_FIXTURE_COMPONENT_NAME
+
+// Enough process calls to drain the messages at the configured rate.
+#define TEST_DRAIN_ROUNDS ((TEST_MESSAGE_COUNT / CONFIG_ESP32_IOT_AZURE_HUB_TELEMETRY_QUEUE_DRAIN_RATE + 2U) * 10U)
+
+typedef struct
+{
+    hub_fixture_t hub;
+    azure_iot_telemetry_queue_t *queue;
+} test_queue_t;
+
+// The acknowledgment callback has no context.
+static azure_iot_telemetry_queue_t *QUEUE = NULL;
+
+static bool test_queue_setup(test_queue_t *fixture);
+static void test_queue_teardown(test_queue_t *fixture);
+static void test_queue_drain(test_queue_t *fixture);
+static void on_telemetry_ack(uint16_t packet_id);
+
+TEST_CASE("Telemetry queue stores while disconnected and drains in order", "[hub][mqtt][telemetry]")
+{
+    test_queue_t fixture;
+    azure_iot_telemetry_queue_statistics_t statistics;
+    char payload[16];
+
+    if (!test_queue_setup(&fixture))
+    {
+        TEST_IGNORE_MESSAGE("needs a telemetry queue partition");
+    }
+
+    const mqtt_broker_stub_stats_t *broker_stats = mqtt_broker_stub_get_stats(fixture.hub.broker);
+    uint32_t telemetry_before = broker_stats->telemetry_messages;
+
+    // Not connected: stored.
+    for (uint32_t i = 0; i < TEST_MESSAGE_COUNT; i++)
+    {
+        int length = snprintf(payload, sizeof(payload), "{\"n\":%lu}", (unsigned long)i);
+
+        TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_telemetry_queue_send(fixture.queue,
+                                                                           (const uint8_t *)payload,
+                                                                           length,
+                                                                           (const uint8_t *)TEST_PROPERTIES,
+                                                                           sizeof(TEST_PROPERTIES) - 1,
+                                                                           i % 2 == 0 ? eAzureIoTHubMessageQoS1 : eAzureIoTHubMessageQoS0,
+                                                                           0));
+    }
+
+    azure_iot_telemetry_queue_get_statistics(fixture.queue, &statistics);
+
+    TEST_ASSERT_EQUAL_UINT32(TEST_MESSAGE_COUNT, statistics.queued);
+    TEST_ASSERT_EQUAL_UINT32(TEST_MESSAGE_COUNT, statistics.pending);
+    TEST_ASSERT_EQUAL_UINT32(telemetry_before, broker_stats->telemetry_messages);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_connect(fixture.hub.hub));
+
+    test_queue_drain(&fixture);
+
+    azure_iot_telemetry_queue_get_statistics(fixture.queue, &statistics);
+    snprintf(payload, sizeof(payload), "{\"n\":%lu}", (unsigned long)(TEST_MESSAGE_COUNT - 1));
+
+    TEST_ASSERT_EQUAL_UINT32(0, statistics.pending);
+    TEST_ASSERT_EQUAL_UINT32(TEST_MESSAGE_COUNT, statistics.sent);
+    TEST_ASSERT_EQUAL_UINT32(telemetry_before + TEST_MESSAGE_COUNT, broker_stats->telemetry_messages);
+    TEST_ASSERT_EQUAL_STRING(payload, broker_stats->last_telemetry);
+
+    // Nothing stored: sent directly.
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_telemetry_queue_send(fixture.queue, (const uint8_t *)"{}", 2, NULL, 0, eAzureIoTHubMessageQoS0, 0));
+    TEST_ASSERT_EQUAL_UINT32(telemetry_before + TEST_MESSAGE_COUNT + 1, broker_stats->telemetry_messages);
+
+    test_queue_teardown(&fixture);
+}
+
+TEST_CASE("Telemetry queue drops stored messages past their time to live", "[hub][mqtt][telemetry]")
+{
+    test_queue_t fixture;
+    azure_iot_telemetry_queue_statistics_t statistics;
+
+    if (!test_queue_setup(&fixture))
+    {
+        TEST_IGNORE_MESSAGE("needs a telemetry queue partition");
+    }
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_telemetry_queue_send(fixture.queue, (const uint8_t *)"old", 3, NULL, 0, eAzureIoTHubMessageQoS0, 1));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_telemetry_queue_send(fixture.queue, (const uint8_t *)"new", 3, NULL, 0, eAzureIoTHubMessageQoS0, 0));
+
+    vTaskDelay(pdMS_TO_TICKS(1100));
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_connect(fixture.hub.hub));
+
+    test_queue_drain(&fixture);
+
+    azure_iot_telemetry_queue_get_statistics(fixture.queue, &statistics);
+
+    TEST_ASSERT_EQUAL_UINT32(1, statistics.expired);
+    TEST_ASSERT_EQUAL_UINT32(1, statistics.sent);
+    TEST_ASSERT_EQUAL_STRING("new", mqtt_broker_stub_get_stats(fixture.hub.broker)->last_telemetry);
+
+    test_queue_teardown(&fixture);
+}
+
+TEST_CASE("Telemetry batch flushed through the queue is stored with its properties", "[hub][mqtt][telemetry]")
+{
+    test_queue_t fixture;
+    azure_iot_telemetry_queue_statistics_t statistics;
+    uint8_t batch_memory[32];
+    buffer_t batch_buffer = {
+        .buffer = batch_memory,
+        .length = sizeof(batch_memory)};
+
+    if (!test_queue_setup(&fixture))
+    {
+        TEST_IGNORE_MESSAGE("needs a telemetry queue partition");
+    }
+
+    azure_iot_telemetry_batch_t *batch = azure_iot_telemetry_batch_create(fixture.hub.hub,
+                                                                          (const uint8_t *)HUB_FIXTURE_COMPONENT_NAME,
+                                                                          sizeof(HUB_FIXTURE_COMPONENT_NAME) - 1,
+                                                                          &batch_buffer,
+                                                                          0,
+                                                                          eAzureIoTHubMessageQoS1);
+    TEST_ASSERT_NOT_NULL(batch);
+
+    azure_iot_telemetry_batch_set_queue(batch, fixture.queue, 0);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_telemetry_batch_add(batch, (const uint8_t *)"1", 1));
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_telemetry_batch_add(batch, (const uint8_t *)"2", 1));
+
+    // Not connected: stored.
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_telemetry_batch_flush(batch));
+    TEST_ASSERT_EQUAL_UINT32(0, azure_iot_telemetry_batch_get_sample_count(batch));
+
+    azure_iot_telemetry_queue_get_statistics(fixture.queue, &statistics);
+
+    TEST_ASSERT_EQUAL_UINT32(1, statistics.queued);
+
+    TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_connect(fixture.hub.hub));
+
+    test_queue_drain(&fixture);
+
+    const mqtt_broker_stub_stats_t *broker_stats = mqtt_broker_stub_get_stats(fixture.hub.broker);
+
+    TEST_ASSERT_EQUAL_STRING("[1,2]", broker_stats->last_telemetry);
+    TEST_ASSERT_EQUAL_STRING_LEN(TEST_PROPERTIES "&", broker_stats->last_properties, sizeof(TEST_PROPERTIES "&") - 1);
+
+    azure_iot_telemetry_batch_free(batch);
+    test_queue_teardown(&fixture);
+}
+
+TEST_CASE("Telemetry log recovers pending messages after reopening", "[telemetry]")
+{
+    telemetry_log_record_t record;
+    telemetry_log_cursor_t cursor;
+    telemetry_log_statistics_t statistics;
+    uint8_t *data = (uint8_t *)malloc(telemetry_log_get_record_max_length());
+    telemetry_log_t *log = telemetry_log_open();
+
+    if (log == NULL)
+    {
+        free(data);
+        TEST_IGNORE_MESSAGE("needs a telemetry queue partition");
+    }
+
+    telemetry_log_rewind(log, &cursor);
+
+    while (telemetry_log_read(log, &cursor, &record, data))
+    {
+        telemetry_log_consume(log, &record);
+    }
+
+    TEST_ASSERT_TRUE(telemetry_log_append(log, 1, 0, (const uint8_t *)"$.sub=a", 7, (const uint8_t *)"first", 5));
+    TEST_ASSERT_TRUE(telemetry_log_append(log, 0, 0, NULL, 0, (const uint8_t *)"second", 6));
+
+    // Sent, not acknowledged: kept.
+    telemetry_log_rewind(log, &cursor);
+    TEST_ASSERT_TRUE(telemetry_log_read(log, &cursor, &record, data));
+
+    telemetry_log_close(log);
+
+    log = telemetry_log_open();
+
+    TEST_ASSERT_NOT_NULL(log);
+
+    telemetry_log_get_statistics(log, &statistics);
+    TEST_ASSERT_EQUAL_UINT32(2, statistics.pending);
+
+    telemetry_log_rewind(log, &cursor);
+
+    TEST_ASSERT_TRUE(telemetry_log_read(log, &cursor, &record, data));
+    TEST_ASSERT_EQUAL_UINT8(1, record.qos);
+    TEST_ASSERT_EQUAL_UINT16(7, record.properties_length);
+    TEST_ASSERT_EQUAL_UINT16(5, record.payload_length);
+    TEST_ASSERT_EQUAL_MEMORY("$.sub=afirst", data, 12);
+
+    telemetry_log_consume(log, &record);
+
+    TEST_ASSERT_TRUE(telemetry_log_read(log, &cursor, &record, data));
+    TEST_ASSERT_EQUAL_MEMORY("second", data, 6);
+
+    telemetry_log_consume(log, &record);
+
+    TEST_ASSERT_FALSE(telemetry_log_read(log, &cursor, &record, data));
+
+    telemetry_log_get_statistics(log, &statistics);
+    TEST_ASSERT_EQUAL_UINT32(0, statistics.pending);
+
+    telemetry_log_close(log);
+    free(data);
+}
+
+static bool test_queue_setup(test_queue_t *fixture)
+{
+    hub_fixture_init(&fixture->hub, 0, on_telemetry_ack);
+
+    fixture->queue = azure_iot_telemetry_queue_create(fixture->hub.hub);
+
+    QUEUE = fixture->queue;
+
+    if (fixture->queue == NULL)
+    {
+        hub_fixture_teardown(&fixture->hub);
+        return false;
+    }
+
+    azure_iot_telemetry_queue_statistics_t statistics;
+
+    azure_iot_telemetry_queue_get_statistics(fixture->queue, &statistics);
+
+    // Left by a previous run: sent, starting the test without stored messages.
+    if (statistics.pending > 0)
+    {
+        TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_hub_connect(fixture->hub.hub));
+
+        test_queue_drain(fixture);
+
+        azure_iot_hub_disconnect(fixture->hub.hub);
+        azure_iot_telemetry_queue_free(fixture->queue);
+
+        fixture->queue = azure_iot_telemetry_queue_create(fixture->hub.hub);
+
+        QUEUE = fixture->queue;
+
+        TEST_ASSERT_NOT_NULL(fixture->queue);
+    }
+
+    return true;
+}
+
+static void test_queue_teardown(test_queue_t *fixture)
+{
+    QUEUE = NULL;
+
+    azure_iot_telemetry_queue_free(fixture->queue);
+    hub_fixture_teardown(&fixture->hub);
+}
+
+static void test_queue_drain(test_queue_t *fixture)
+{
+    azure_iot_telemetry_queue_statistics_t statistics;
+
+    azure_iot_telemetry_queue_get_statistics(fixture->queue, &statistics);
+
+    for (uint32_t round = 0; round < TEST_DRAIN_ROUNDS && statistics.pending > 0; round++)
+    {
+        TEST_ASSERT_EQUAL(eAzureIoTSuccess, azure_iot_telemetry_queue_process(fixture->queue));
+
+        azure_iot_hub_process_loop(fixture->hub.hub);
+        azure_iot_telemetry_queue_get_statistics(fixture->queue, &statistics);
+
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0, statistics.pending);
+}
+
+static void on_telemetry_ack(uint16_t packet_id)
+{
+    if (QUEUE != NULL)
+    {
+        azure_iot_telemetry_queue_acknowledge(QUEUE, packet_id);
+    }
+}
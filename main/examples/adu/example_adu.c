@@ -11,6 +11,8 @@
 #include "esp32_iot_azure/extension/azure_iot_json_reader_extension.h"
 #include "dtdl/temperaturecontroller.h"
 
+#define EXAMPLE_TELEMETRY_PERIOD_MS 1000U
+
 typedef struct
 {
     azure_iot_hub_context_t *iot_hub;
@@ -162,6 +164,8 @@ bool example_adu_run(const buffer_t *iot_hub_hostname,
 
         while (true)
         {
+            TickType_t sampled_at = xTaskGetTickCount();
+
             if (azure_iot_hub_send_telemetry_from_component(iot,
                                                             (uint8_t *)TEMP_CTRL_CMP_THERMOSTAT_PRP_TLY_TEMPERATURE_NAME,
                                                             sizeof_l(TEMP_CTRL_CMP_THERMOSTAT_PRP_TLY_TEMPERATURE_NAME),
@@ -173,17 +177,21 @@ bool example_adu_run(const buffer_t *iot_hub_hostname,
                 ESP_LOGE(TAG_EX_ADU, "failure sending telemetry");
             }
 
-            if (azure_iot_hub_process_loop(iot) != eAzureIoTSuccess)
+            // Commands and messages are handled as they arrive, until the next sample is due.
+            for (uint32_t elapsed_ms = 0;
+                 elapsed_ms < EXAMPLE_TELEMETRY_PERIOD_MS;
+                 elapsed_ms = pdTICKS_TO_MS(xTaskGetTickCount() - sampled_at))
             {
-                ESP_LOGE(TAG_EX_ADU, "failure processing loop");
+                if (azure_iot_hub_process_events(iot, EXAMPLE_TELEMETRY_PERIOD_MS - elapsed_ms) != eAzureIoTSuccess)
+                {
+                    ESP_LOGE(TAG_EX_ADU, "failure processing events");
+                }
             }
 
             if (azure_adu_workflow_has_update(adu_workflow) && azure_adu_workflow_accept_update(adu_workflow, &adu_down_buffer, 4096, NULL, NULL) != eAzureIoTSuccess)
             {
                 ESP_LOGE(TAG_EX_ADU, "failure updating");
             }
-
-            vTaskDelay(pdMS_TO_TICKS(1000));
         }
 
         azure_iot_hub_unsubscribe_properties(iot);
@@ -3,15 +3,36 @@
 #include "freertos/task.h"
 #include "example_iot_hub.h"
 #include "esp32_iot_azure/azure_iot_hub.h"
+#include "esp32_iot_azure/azure_iot_provisioning.h"
+#include "esp32_iot_azure/azure_iot_telemetry_queue.h"
 #include "esp32_iot_azure/extension/azure_iot_hub_extension.h"
 #include "esp32_iot_azure/extension/azure_iot_hub_client_properties_extension.h"
 #include "esp32_iot_azure/extension/azure_iot_json_writer_extension.h"
 #include "esp32_iot_azure/extension/azure_iot_json_reader_extension.h"
+#include "esp32_iot_azure/extension/azure_iot_message_extension.h"
 #include "dtdl/temperaturecontroller.h"
 
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DIAGNOSTICS_ENABLED
+#include "esp32_iot_azure/azure_iot_diagnostics.h"
+
+#define EXAMPLE_COMPONENT_COUNT 3
+#else
+#define EXAMPLE_COMPONENT_COUNT 2
+#endif
+
+// Stored samples older than a day are not worth sending.
+#define EXAMPLE_TELEMETRY_TIME_TO_LIVE_S (24U * 60U * 60U)
+#define EXAMPLE_TELEMETRY_PERIOD_MS 1000U
+// Component name property, serialized as sent on the topic.
+#define EXAMPLE_TELEMETRY_PROPERTIES "$.sub=" TEMP_CTRL_CMP_THERMOSTAT_PRP_TLY_TEMPERATURE_NAME
+
 typedef struct
 {
     azure_iot_hub_context_t *iot_hub;
+    azure_iot_telemetry_queue_t *telemetry_queue;
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DIAGNOSTICS_ENABLED
+    azure_iot_diagnostics_t *diagnostics;
+#endif
     buffer_t scratch_buffer;
     temperature_controller_status_t device_status;
     uint8_t display_brightness;
@@ -22,6 +43,7 @@ static const char TAG_EX_IOT[] = "EX_IOT_HUB";
 
 static example_context_t EXAMPLE_CONTEXT = {
     .iot_hub = NULL,
+    .telemetry_queue = NULL,
     .scratch_buffer = BUFFER_WITH_FIXED_LENGTH(700),
     .device_status = TEMP_CONTROLLER_STATUS_NORMAL,
     .display_brightness = 50,
@@ -30,6 +52,7 @@ static example_context_t EXAMPLE_CONTEXT = {
 static void callback_cloud_to_device_subscription(AzureIoTHubClientCloudToDeviceMessageRequest_t *message, void *callback_context);
 static void callback_cloud_command_subscription(AzureIoTHubClientCommandRequest_t *message, void *callback_context);
 static void callback_cloud_properties_subscription(AzureIoTHubClientPropertiesResponse_t *message, void *callback_context);
+static void callback_telemetry_acknowledged(uint16_t packet_id);
 
 static AzureIoTResult_t device_report_initial_state(example_context_t *context);
 static AzureIoTResult_t device_change_state(example_context_t *context, const AzureIoTHubClientPropertiesResponse_t *message, uint32_t *version);
@@ -49,10 +72,15 @@ static bool example_iot_hub_setup(azure_iot_hub_context_t *iot,
         return false;
     }
 
-    iot_client_options->pxComponentList = (AzureIoTHubClientComponent_t[2]){
+    iot_client_options->pxComponentList = (AzureIoTHubClientComponent_t[EXAMPLE_COMPONENT_COUNT]){
         azureiothubCREATE_COMPONENT(TEMP_CTRL_CMP_DISPLAY_NAME),
-        azureiothubCREATE_COMPONENT(TEMP_CTRL_CMP_THERMOSTAT_NAME)};
-    iot_client_options->ulComponentListLength = 2;
+        azureiothubCREATE_COMPONENT(TEMP_CTRL_CMP_THERMOSTAT_NAME),
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DIAGNOSTICS_ENABLED
+        azureiothubCREATE_COMPONENT(AZURE_IOT_DIAGNOSTICS_COMPONENT_NAME),
+#endif
+    };
+    iot_client_options->ulComponentListLength = EXAMPLE_COMPONENT_COUNT;
+    iot_client_options->xTelemetryCallback = &callback_telemetry_acknowledged;
 
     if (azure_iot_hub_init(iot,
                            iot_hub_hostname->buffer,
@@ -70,9 +98,19 @@ static bool example_iot_hub_setup(azure_iot_hub_context_t *iot,
         return false;
     }
 
-    if (azure_iot_hub_connect(iot) != eAzureIoTSuccess)
+    AzureIoTResult_t connect_result = azure_iot_hub_connect(iot);
+
+    if (connect_result != eAzureIoTSuccess)
     {
         ESP_LOGE(TAG_EX_IOT, "failure connecting");
+
+        // Refused by the hub: the cached registration may be stale, like after the device
+        // was moved to another hub. Registers again with DPS on the next boot.
+        if (connect_result == eAzureIoTErrorServerError)
+        {
+            azure_dps_clear_cache();
+        }
+
         return false;
     }
 
@@ -123,33 +161,71 @@ bool example_iot_hub_run(const buffer_t *iot_hub_hostname,
     example_context_t *example_context = &EXAMPLE_CONTEXT;
     example_context->iot_hub = iot;
 
-    if (example_iot_hub_setup(iot, example_context, iot_hub_hostname, device_id, device_symmetric_key))
+    // Samples taken while the hub is not reachable are
+    // stored on flash and sent once it is reachable again.
+    example_context->telemetry_queue = azure_iot_telemetry_queue_create(iot);
+
+    if (example_context->telemetry_queue == NULL)
+    {
+        ESP_LOGE(TAG_EX_IOT, "failure creating telemetry queue");
+    }
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DIAGNOSTICS_ENABLED
+    // Heap, stack, reconnection, latency and error reports; tuned by the twin.
+    // Writes in the scratch buffer: never used by both at once, on this task.
+    else if ((example_context->diagnostics = azure_iot_diagnostics_create(iot, &example_context->scratch_buffer)) == NULL)
+    {
+        ESP_LOGE(TAG_EX_IOT, "failure creating diagnostics");
+    }
+#endif
+    else if (example_iot_hub_setup(iot, example_context, iot_hub_hostname, device_id, device_symmetric_key))
     {
         buffer_t telemetry_payload = BUFFER_WITH_FIXED_LENGTH(15);
 
         while (!example_context->restart_command_called)
         {
+            TickType_t sampled_at = xTaskGetTickCount();
+
             telemetry_payload.length = sprintf((char *)telemetry_payload.buffer,
                                                "{\"" TEMP_CTRL_CMP_THERMOSTAT_PRP_TLY_TEMPERATURE_NAME "\":%d}",
                                                rand() % (28 + 1 - 18) + 18);
 
-            if (azure_iot_hub_send_telemetry_from_component(iot,
-                                                            (uint8_t *)TEMP_CTRL_CMP_THERMOSTAT_PRP_TLY_TEMPERATURE_NAME,
-                                                            sizeof_l(TEMP_CTRL_CMP_THERMOSTAT_PRP_TLY_TEMPERATURE_NAME),
-                                                            telemetry_payload.buffer,
-                                                            telemetry_payload.length,
-                                                            eAzureIoTHubMessageQoS1,
-                                                            NULL) != eAzureIoTSuccess)
+            if (azure_iot_telemetry_queue_send(example_context->telemetry_queue,
+                                               telemetry_payload.buffer,
+                                               telemetry_payload.length,
+                                               (const uint8_t *)EXAMPLE_TELEMETRY_PROPERTIES,
+                                               sizeof_l(EXAMPLE_TELEMETRY_PROPERTIES),
+                                               eAzureIoTHubMessageQoS1,
+                                               EXAMPLE_TELEMETRY_TIME_TO_LIVE_S) != eAzureIoTSuccess)
             {
                 ESP_LOGE(TAG_EX_IOT, "failure sending telemetry");
             }
 
-            if (azure_iot_hub_process_loop(iot) != eAzureIoTSuccess)
+            // Commands and messages are handled as they arrive, until the next sample is due.
+            for (uint32_t elapsed_ms = 0;
+                 elapsed_ms < EXAMPLE_TELEMETRY_PERIOD_MS && !example_context->restart_command_called;
+                 elapsed_ms = pdTICKS_TO_MS(xTaskGetTickCount() - sampled_at))
             {
-                ESP_LOGE(TAG_EX_IOT, "failure processing loop");
+                AzureIoTResult_t result = azure_iot_hub_process_events(iot, EXAMPLE_TELEMETRY_PERIOD_MS - elapsed_ms);
+
+                if (result != eAzureIoTSuccess)
+                {
+                    ESP_LOGE(TAG_EX_IOT, "failure processing events");
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DIAGNOSTICS_ENABLED
+                    azure_iot_diagnostics_record_error(example_context->diagnostics, result);
+#endif
+                }
+
+                if (azure_iot_telemetry_queue_process(example_context->telemetry_queue) != eAzureIoTSuccess)
+                {
+                    ESP_LOGE(TAG_EX_IOT, "failure sending stored telemetry");
+                }
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DIAGNOSTICS_ENABLED
+                if (azure_iot_diagnostics_process(example_context->diagnostics) != eAzureIoTSuccess)
+                {
+                    ESP_LOGE(TAG_EX_IOT, "failure sending diagnostics");
+                }
+#endif
             }
-
-            vTaskDelay(pdMS_TO_TICKS(1000));
         }
 
         azure_iot_hub_unsubscribe_cloud_to_device_message(iot);
@@ -159,6 +235,14 @@ bool example_iot_hub_run(const buffer_t *iot_hub_hostname,
         success = true;
     }
 
+    azure_iot_telemetry_queue_free(example_context->telemetry_queue);
+    example_context->telemetry_queue = NULL;
+
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DIAGNOSTICS_ENABLED
+    azure_iot_diagnostics_free(example_context->diagnostics);
+    example_context->diagnostics = NULL;
+#endif
+
     azure_iot_hub_disconnect(iot);
     azure_iot_hub_deinit(iot);
     azure_iot_hub_free(iot);
@@ -170,6 +254,15 @@ bool example_iot_hub_run(const buffer_t *iot_hub_hostname,
 // SUBSCRIPTION CALLBACKS
 //
 
+static void callback_telemetry_acknowledged(uint16_t packet_id)
+{
+    // Has no context: the queue is taken from the example one.
+    if (EXAMPLE_CONTEXT.telemetry_queue != NULL)
+    {
+        azure_iot_telemetry_queue_acknowledge(EXAMPLE_CONTEXT.telemetry_queue, packet_id);
+    }
+}
+
 static void callback_cloud_to_device_subscription(AzureIoTHubClientCloudToDeviceMessageRequest_t *message, void *callback_context)
 {
     ESP_LOGI(TAG_EX_IOT, "cloud-to-device message: %.*s", (int)message->ulPayloadLength, (const char *)message->pvMessagePayload);
@@ -306,6 +399,9 @@ static AzureIoTResult_t device_change_state(example_context_t *context,
 {
     AzureIoTJSONReader_t json_reader;
     AzureIoTHubClient_t *iot_client = azure_iot_hub_get_iot_client(context->iot_hub);
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DIAGNOSTICS_ENABLED
+    bool diagnostics_changed = false;
+#endif
 
     AZ_CHECK_BEGIN()
     AZ_CHECK(AzureIoTJSONReader_Init(&json_reader, message->pvMessagePayload, message->ulPayloadLength))
@@ -342,6 +438,17 @@ static AzureIoTResult_t device_change_state(example_context_t *context,
                 continue;
             }
 
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DIAGNOSTICS_ENABLED
+            if (azure_iot_diagnostics_is_component(context->diagnostics, component_name, component_name_length))
+            {
+                AZ_CHECK(azure_iot_diagnostics_parse_property(context->diagnostics, &json_reader))
+
+                diagnostics_changed = true;
+
+                continue;
+            }
+#endif
+
             // We're expecting a "display" component.
             // We have to skip over the root property and value to continue iterating.
             if (strncasecmp(TEMP_CTRL_CMP_DISPLAY_NAME, (const char *)component_name, sizeof_l(TEMP_CTRL_CMP_DISPLAY_NAME)) != 0)
@@ -364,6 +471,14 @@ static AzureIoTResult_t device_change_state(example_context_t *context,
                 ESP_LOGI(TAG_EX_IOT, "display.brightness received: %d", context->display_brightness);
             }
         }
+
+#if CONFIG_ESP32_IOT_AZURE_HUB_FEATURES_DIAGNOSTICS_ENABLED
+        // Acknowledged here, for both the document and the updates.
+        if (diagnostics_changed)
+        {
+            AZ_CHECK(azure_iot_diagnostics_send_response(context->diagnostics, *version))
+        }
+#endif
     }
 
     AZ_CHECK_RETURN_LAST()
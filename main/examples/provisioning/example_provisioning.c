@@ -49,6 +49,16 @@ static bool example_dps_register_and_get(azure_dps_context_t *dps,
         return false;
     }
 
+    azure_dps_statistics_t statistics;
+
+    azure_dps_get_statistics(dps, &statistics);
+
+    ESP_LOGI(TAG_EX_DPS,
+             "registration %s: %lu polls, waited %lu ms",
+             azure_dps_is_registration_cached(dps) ? "cached" : "done",
+             (unsigned long)statistics.polls,
+             (unsigned long)(statistics.initial_delay_ms + statistics.waited_ms));
+
     if (azure_dps_get_device_and_hub(dps,
                                      iot_hub_hostname->buffer,
                                      &iot_hub_hostname->length,
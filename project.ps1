@@ -8,6 +8,12 @@ switch ($args[0]) {
     'build-test' {
         &docker.exe run --rm --env LC_ALL='C.UTF-8' -v ${ProjectFolder}:/project -w /project ${EspIdfDockerImage} idf.py build -C ./test
     }
+    'build-test-linux' {
+        &docker.exe run --rm --env LC_ALL='C.UTF-8' -v ${ProjectFolder}:/project -w /project ${EspIdfDockerImage} idf.py -C ./test -B ./test/build-linux -D SDKCONFIG=./test/build-linux/sdkconfig --preview set-target linux build
+    }
+    'test-linux' {
+        &docker.exe run --rm --env LC_ALL='C.UTF-8' -v ${ProjectFolder}:/project -w /project ${EspIdfDockerImage} ./test/build-linux/test_runner.elf
+    }
     'clean' {
         &docker.exe run --rm --env LC_ALL='C.UTF-8' -v ${ProjectFolder}:/project -w /project ${EspIdfDockerImage} idf.py fullclean
     }
@@ -18,6 +24,8 @@ switch ($args[0]) {
         Write-Host "Command not recognized. Valid commands:"
         Write-Host "`t* build: build the main project"
         Write-Host "`t* build-test: build the test project"
+        Write-Host "`t* build-test-linux: build the test project for the Linux host"
+        Write-Host "`t* test-linux: run the test project on the Linux host"
         Write-Host "`t* clean: clean the main project build files"
         Write-Host "`t* clean-test: clean the test project build files"
     }
@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
 #include "unity.h"
 
 static void print_banner(const char *text);
@@ -13,7 +15,13 @@ void app_main(void)
 
     unity_run_all_tests();
 
+#if CONFIG_IDF_TARGET_LINUX
+    // There is no UART to interact with on the host:
+    // exit with the failure count so scripts can check it.
+    exit(UNITY_END());
+#else
     UNITY_END();
+#endif
 
     print_banner("Starting interactive test menu");
 
@@ -0,0 +1,177 @@
+"""
+Creates a delta patch rebuilding a new firmware image from the running one.
+
+Usage: image_delta.py <old.bin> <new.bin> <output.delta>
+
+The patch is the format applied by image_patcher.c while it downloads, specified
+in docs/wiki/delta_updates.md: bsdiff records (diff bytes, extra bytes, old offset
+adjustment) interleaved in one stream behind an "AZDL" header with the new image size.
+Old regions are found by exact matches of MATCH_LENGTH bytes, extended with the bsdiff
+approximate scoring so code moved by a few bytes, with changed addresses, still diffs
+to mostly zeros. The patch is applied back before being written, to check it.
+"""
+
+import struct
+import sys
+
+MAGIC = b"AZDL"
+MATCH_LENGTH = 16
+INDEX_STRIDE = 4
+MAX_CANDIDATES = 8
+# Bytes scanned without the diff improving before the diff ends.
+EXTEND_GIVE_UP = 256
+
+
+def build_index(old):
+    """Maps MATCH_LENGTH bytes keys to old offsets, one key every INDEX_STRIDE bytes."""
+    index = {}
+
+    for offset in range(0, len(old) - MATCH_LENGTH + 1, INDEX_STRIDE):
+        candidates = index.setdefault(old[offset:offset + MATCH_LENGTH], [])
+
+        if len(candidates) < MAX_CANDIDATES:
+            candidates.append(offset)
+
+    return index
+
+
+def match_length(old, old_offset, new, new_offset):
+    length = 0
+    limit = min(len(old) - old_offset, len(new) - new_offset)
+
+    while length < limit and old[old_offset + length] == new[new_offset + length]:
+        length += 1
+
+    return length
+
+
+def find_match(index, old, new, new_offset):
+    """Longest exact match of at least MATCH_LENGTH bytes at new_offset, as (old offset, length)."""
+    best = None
+
+    # Keys are indexed every INDEX_STRIDE old bytes: a match starting between them is found
+    # from a later new offset, as the caller tries every one.
+    for old_offset in index.get(new[new_offset:new_offset + MATCH_LENGTH], ()):
+        length = match_length(old, old_offset, new, new_offset)
+
+        if best is None or length > best[1]:
+            best = (old_offset, length)
+
+    return best
+
+
+def extend_diff(old, old_offset, new, new_offset):
+    """bsdiff forward extension: the length maximizing twice the equal bytes minus the length."""
+    limit = min(len(old) - old_offset, len(new) - new_offset)
+    equal = 0
+    best_score = 0
+    best_length = 0
+
+    for length in range(1, limit + 1):
+        if old[old_offset + length - 1] == new[new_offset + length - 1]:
+            equal += 1
+
+        if equal * 2 - length > best_score:
+            best_score = equal * 2 - length
+            best_length = length
+        elif length - best_length > EXTEND_GIVE_UP:
+            break
+
+    return best_length
+
+
+def create_patch(old, new):
+    index = build_index(old)
+    records = []
+    new_offset = 0
+    old_offset = 0
+
+    while new_offset < len(new):
+        diff_length = extend_diff(old, old_offset, new, new_offset)
+        extra_offset = new_offset + diff_length
+        scan = extra_offset
+        match = None
+
+        while scan + MATCH_LENGTH <= len(new):
+            match = find_match(index, old, new, scan)
+
+            if match is not None:
+                break
+
+            scan += 1
+
+        extra_end = scan if match is not None else len(new)
+        diff = bytes((new[new_offset + i] - old[old_offset + i]) & 0xFF for i in range(diff_length))
+        adjustment = match[0] - (old_offset + diff_length) if match is not None else 0
+
+        records.append(struct.pack("<I", diff_length) + diff +
+                       struct.pack("<I", extra_end - extra_offset) + new[extra_offset:extra_end] +
+                       struct.pack("<i", adjustment))
+
+        if match is None:
+            break
+
+        new_offset = extra_end
+        old_offset = match[0]
+
+    return MAGIC + struct.pack("<I", len(new)) + b"".join(records)
+
+
+def apply_patch(old, patch):
+    """Mirrors image_patcher.c, to check the patch."""
+    if patch[:len(MAGIC)] != MAGIC:
+        raise ValueError("bad magic")
+
+    (size,) = struct.unpack_from("<I", patch, len(MAGIC))
+    position = len(MAGIC) + 4
+    old_offset = 0
+    new = bytearray()
+
+    while len(new) < size:
+        (diff_length,) = struct.unpack_from("<I", patch, position)
+        position += 4
+        new += bytes((old[old_offset + i] + patch[position + i]) & 0xFF for i in range(diff_length))
+        old_offset += diff_length
+        position += diff_length
+
+        (extra_length,) = struct.unpack_from("<I", patch, position)
+        position += 4
+        new += patch[position:position + extra_length]
+        position += extra_length
+
+        (adjustment,) = struct.unpack_from("<i", patch, position)
+        position += 4
+        old_offset += adjustment
+
+    return bytes(new)
+
+
+def main(arguments):
+    if len(arguments) != 3:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+
+    old_path, new_path, output_path = arguments
+
+    with open(old_path, "rb") as old_file:
+        old = old_file.read()
+
+    with open(new_path, "rb") as new_file:
+        new = new_file.read()
+
+    patch = create_patch(old, new)
+
+    if apply_patch(old, patch) != new:
+        print("the patch does not rebuild the new image", file=sys.stderr)
+        return 1
+
+    with open(output_path, "wb") as output_file:
+        output_file.write(patch)
+
+    print(f"{output_path}: {len(patch)} bytes, {len(new)} bytes rebuilt from {len(old)} bytes")
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))